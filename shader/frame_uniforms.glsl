@@ -0,0 +1,8 @@
+// Per-frame constants shared by the terrain stages, TerrainUniforms::FrameBlock
+#define MAX_LIGHTS 4
+
+layout(std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 lights[MAX_LIGHTS]; // Light positions in world space, w unused
+};
@@ -0,0 +1,34 @@
+// Phong lighting of the terrain. Every constant can be overridden by a define
+// injected when the program permutation is built.
+
+#ifndef NUM_LIGHTS
+#define NUM_LIGHTS 1 // Lights shaded, at most MAX_LIGHTS
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1 // Add specular highlights
+#endif
+
+#ifndef AMBIENT_STRENGTH
+#define AMBIENT_STRENGTH 0.1
+#endif
+#ifndef DIFFUSE_STRENGTH
+#define DIFFUSE_STRENGTH 0.7
+#endif
+#ifndef SPECULAR_STRENGTH
+#define SPECULAR_STRENGTH 0.6
+#endif
+#ifndef SHININESS
+#define SHININESS 32.0
+#endif
+
+// Diffuse and specular contribution of one light
+float shadeLight(vec3 normal, vec3 viewDir, vec3 toLight)
+{
+    vec3 lightDir = normalize(toLight);
+    float intensity = DIFFUSE_STRENGTH * max(0.0, dot(normal, lightDir));
+#if SPECULAR
+    vec3 reflectDir = reflect(-lightDir, normal);
+    intensity += SPECULAR_STRENGTH * pow(max(0.0, dot(viewDir, reflectDir)), SHININESS);
+#endif
+    return intensity;
+}
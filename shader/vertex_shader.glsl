@@ -1,29 +1,147 @@
 #version 150
 
+#include "frame_uniforms.glsl"
+
+#ifndef COMPACT_VERTICES
+#define COMPACT_VERTICES 0 // Read CompactVertexType instead of VertexType
+#endif
+
+#ifndef DISPLACED
+#define DISPLACED 0 // No vertex attributes: heights come from heightTexture
+#endif
+
+#ifndef INSTANCED
+#define INSTANCED 0 // Model matrix and colour are per-instance attributes
+#endif
+
+#if COMPACT_VERTICES || DISPLACED
+// x/y are rebuilt from gl_VertexID
+uniform int chunkSize;      // Quads per chunk side
+uniform int chunksPerSide;  // Chunks per terrain side
+uniform float gridSpacing;  // Distance between neighbouring vertices
+#endif
+
+#if DISPLACED
+// One GL_R32F texel per grid vertex; normal and colour are derived from it
+uniform sampler2D heightTexture;
+#elif COMPACT_VERTICES
+// Compact layout (CompactVertexType)
+in float height;
+in vec2 packedNormal; // Octahedral-encoded normal, normalized snorm16
+in vec4 color;
+#else
 in vec3 position;
 in vec3 normal;
 in vec4 color;
+#endif
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model; // Added model matrix for object transformations
-uniform vec3 lightPos; // Use vec3 for light position in world space
+#if INSTANCED
+// InstanceRenderer::Instance, read with an attribute divisor of one
+in mat4 instanceModel;
+#else
+// Per-object constants, TerrainUniforms::ObjectBlock
+layout(std140) uniform ObjectUniforms {
+    mat4 model;        // Object transformation
+    mat4 normalMatrix; // transpose(inverse(model)), computed on the CPU
+};
+#endif
 
 out vec4 fPosition;
 out vec4 fColor;
-out vec4 fLightPosition;
 out vec3 fNormal;
 
+#if COMPACT_VERTICES
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+#endif
+
+#if COMPACT_VERTICES || DISPLACED
+// Grid vertex: chunks are consecutive row-major blocks of (chunkSize + 1)^2
+// vertices, and gl_VertexID includes the block's base vertex
+ivec2 gridVertex()
+{
+    int stride = chunkSize + 1;
+    int chunk = gl_VertexID / (stride * stride);
+    int local = gl_VertexID - chunk * stride * stride;
+    return ivec2(chunk % chunksPerSide, chunk / chunksPerSide) * chunkSize
+        + ivec2(local % stride, local / stride);
+}
+
+vec3 gridPosition(ivec2 grid, float z)
+{
+    int halfSize = chunksPerSide * chunkSize / 2;
+    return vec3(vec2(grid - ivec2(halfSize)) * gridSpacing, z);
+}
+#endif
+
+#if DISPLACED
+float gridHeight(ivec2 grid)
+{
+    return texelFetch(heightTexture, grid, 0).r;
+}
+
+// Central differences of the neighbouring texels, one-sided at the edges,
+// as Terrain::sculpt and TiledHeightSource compute them
+vec3 displacedNormal(ivec2 grid)
+{
+    ivec2 last = textureSize(heightTexture, 0) - 1;
+    ivec2 low = max(grid - 1, ivec2(0));
+    ivec2 high = min(grid + 1, last);
+    float hx = (gridHeight(ivec2(high.x, grid.y)) - gridHeight(ivec2(low.x, grid.y)))
+        / (float(high.x - low.x) * gridSpacing);
+    float hy = (gridHeight(ivec2(grid.x, high.y)) - gridHeight(ivec2(grid.x, low.y)))
+        / (float(high.y - low.y) * gridSpacing);
+    return normalize(vec3(-hx, -hy, 1.0));
+}
+
+// Same shading by height as generateHeightMap()
+vec4 displacedColor(float h)
+{
+    float c = sin(h * 5.0) * 0.5 + 0.5;
+    return vec4(c, 1.0 - c, 0.5, 1.0);
+}
+#endif
+
 void main(void)
 {
+#if DISPLACED
+    ivec2 grid = gridVertex();
+    float h = gridHeight(grid);
+    vec3 vertexPosition = gridPosition(grid, h);
+    vec3 vertexNormal = displacedNormal(grid);
+    vec4 vertexColor = displacedColor(h);
+#elif COMPACT_VERTICES
+    vec3 vertexPosition = gridPosition(gridVertex(), height);
+    vec3 vertexNormal = decodeOctahedral(packedNormal);
+    vec4 vertexColor = color;
+#else
+    vec3 vertexPosition = position;
+    vec3 vertexNormal = normal;
+    vec4 vertexColor = color;
+#endif
+
+#if INSTANCED
+    // Entities may be scaled non-uniformly; their meshes are a few hundred
+    // vertices, so the inverse per vertex is cheaper than a second matrix
+    // per instance
+    mat4 model = instanceModel;
+    mat3 normalMatrix = transpose(inverse(mat3(instanceModel)));
+#endif
+
     // Apply model transformation to position
-    vec4 worldPosition = model * vec4(position, 1.0);
+    vec4 worldPosition = model * vec4(vertexPosition, 1.0);
     fPosition = view * worldPosition;
-    fLightPosition = vec4(lightPos, 1.0); // Light position in world space
-    fColor = color;
+    fColor = vertexColor;
     
     // Transform normal using inverse transpose of model matrix
-    fNormal = mat3(transpose(inverse(model))) * normal;
+    fNormal = mat3(normalMatrix) * vertexNormal;
     
     gl_Position = projection * fPosition;
 }
\ No newline at end of file
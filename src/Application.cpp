@@ -1,11 +1,32 @@
 #include "Application.hpp"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
+#include "FrameCapture.hpp"
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "ProgramCache.hpp"
+
 Application* currentApplication = nullptr;
 
+namespace {
+// Frames drawn after an event, so ImGui can settle hover and focus changes
+constexpr int kFramesPerEvent = 3;
+// Seconds between wake-ups while idle, so needsRedraw() can poll work
+constexpr double kIdleTimeout = 0.1;
+
+void redrawOnEvent() {
+  if (currentApplication) {
+    currentApplication->requestRedraw(kFramesPerEvent);
+  }
+}
+}  // namespace
+
 Application& Application::getInstance() {
   if (!currentApplication) {
     throw std::runtime_error("No Application instance exists");
@@ -13,36 +34,63 @@ Application& Application::getInstance() {
   return *currentApplication;
 }
 
-Application::Application()
-    : state(State::Ready), width(640), height(480), title("My GLFW/GLEW/GLM and ImGui App") {
+Application::Application(const ApplicationOptions& options)
+    : state(State::Ready),
+      width(options.width),
+      height(options.height),
+      title("My GLFW/GLEW/GLM and ImGui App"),
+      options(options),
+      constructionStart(std::chrono::steady_clock::now()) {
   currentApplication = this;
 
+  // Without a window nothing else would ever end the loop
+  if (this->options.headless) {
+    if (this->options.fixedTimestep <= 0.0) {
+      this->options.fixedTimestep = 1.0 / 60.0;
+    }
+    if (this->options.frameCount <= 0) {
+      this->options.frameCount = 60;
+    }
+  }
+
   std::cout << "[Info] Initializing GLFW" << std::endl;
 
-  // Initialize GLFW
-  if (!glfwInit()) {
-    throw std::runtime_error("Failed to initialize GLFW");
-  }
+  if (this->options.headless) {
+    createHeadlessWindow();
+  } else {
+    // Initialize GLFW
+    if (!glfwInit()) {
+      throw std::runtime_error("Failed to initialize GLFW");
+    }
 
-  // Configure OpenGL context (version 3.2, core profile)
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Configure OpenGL context (version 3.2, core profile)
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, this->options.glDebug ? GLFW_TRUE : GLFW_FALSE);
 
-  // Create window
-  window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
-  if (!window) {
-    glfwTerminate();
-    throw std::runtime_error("Failed to create GLFW window");
+    // Create window
+    window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (!window) {
+      glfwTerminate();
+      throw std::runtime_error("Failed to create GLFW window");
+    }
   }
 
   // Set OpenGL context
   glfwMakeContextCurrent(window);
+  if (!this->options.headless) {
+    installEventCallbacks();
+  }
 
-  // Initialize GLEW
+  // Initialize GLEW. Without an X display GLEW cannot query GLX extensions,
+  // but the core entry points it needs are loaded by then.
   glewExperimental = GL_TRUE;
   GLenum err = glewInit();
+  if (err == GLEW_ERROR_NO_GLX_DISPLAY && this->options.headless) {
+    err = GLEW_OK;
+  }
   if (err != GLEW_OK) {
     glfwTerminate();
     throw std::runtime_error(
@@ -54,12 +102,94 @@ Application::Application()
   std::cout << "Renderer: " << glGetString(GL_RENDERER) << "\n"
             << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
+  // Errors are reported as they happen from here on, without polling
+  if (this->options.glDebug) {
+    GLDebug::enable(this->options.glDebugSynchronous);
+  }
+
+  // Programs created by derived classes look their binaries up here
+  if (this->options.shaderCache) {
+    ProgramCache::setDirectory(this->options.shaderCacheDirectory.empty()
+                                   ? ProgramCache::defaultDirectory()
+                                   : this->options.shaderCacheDirectory);
+  } else {
+    ProgramCache::setDirectory("");
+  }
+
   // Configure OpenGL
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LESS);
+  GLState::setEnabled(GL_DEPTH_TEST, true);
+  GLState::depthFunc(GL_LESS);
+
+  if (this->options.headless) {
+    createFramebuffer();
+  }
+  framePacer = std::make_unique<FramePacer>(this->options.pacing, !this->options.headless);
+  if (!this->options.captureDirectory.empty()) {
+    frameCapture = std::make_unique<FrameCapture>(width, height,
+                                                  this->options.captureDirectory);
+  }
 
   // Set initial viewport
-  glViewport(0, 0, width, height);
+  GLState::viewport(0, 0, width, height);
+}
+
+Application::~Application() = default;
+
+void Application::createHeadlessWindow() {
+  // Each attempt picks a platform and a context creation API
+  struct Attempt {
+    int platform;
+    int contextApi;
+    const char* description;
+  };
+  const Attempt attempts[] = {
+      {GLFW_PLATFORM_NULL, GLFW_EGL_CONTEXT_API, "surfaceless EGL"},
+      {GLFW_PLATFORM_NULL, GLFW_OSMESA_CONTEXT_API, "OSMesa"},
+      {GLFW_ANY_PLATFORM, GLFW_NATIVE_CONTEXT_API, "hidden window"},
+  };
+
+  for (const Attempt& attempt : attempts) {
+    glfwInitHint(GLFW_PLATFORM, attempt.platform);
+    if (!glfwInit()) {
+      continue;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, options.glDebug ? GLFW_TRUE : GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, attempt.contextApi);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (window) {
+      std::cout << "[Info] Headless context: " << attempt.description
+                << std::endl;
+      return;
+    }
+    glfwTerminate();
+  }
+  throw std::runtime_error("Failed to create a headless OpenGL context");
+}
+
+void Application::createFramebuffer() {
+  glGenRenderbuffers(1, &colorRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depthRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                            colorRenderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                            depthRenderbuffer);
+  GLDebug::label(GL_FRAMEBUFFER, framebuffer, "Offscreen framebuffer");
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("Offscreen framebuffer is incomplete");
+  }
 }
 
 void Application::exit() {
@@ -71,24 +201,114 @@ void Application::run() {
     throw std::runtime_error("Application is not in Ready state");
   }
 
+  // Cold starts compile every program; warm starts load them from the cache
+  const ProgramCache::Stats& cacheStats = ProgramCache::getStats();
+  std::cout << "[Info] Start-up took "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                         constructionStart)
+                   .count()
+            << " ms, shader programs " << cacheStats.milliseconds << " ms ("
+            << cacheStats.loaded << " from cache, " << cacheStats.compiled
+            << " compiled";
+  if (cacheStats.discarded > 0) {
+    std::cout << ", " << cacheStats.discarded << " stale entries discarded";
+  }
+  std::cout << ")" << std::endl;
+
   state = State::Run;
-  time = static_cast<float>(glfwGetTime());
+  rateStart = std::chrono::steady_clock::now();
+  const bool fixedTimestep = options.fixedTimestep > 0.0;
+  time = fixedTimestep ? 0.0f : static_cast<float>(glfwGetTime());
+  int frame = 0;
+  const auto start = std::chrono::steady_clock::now();
+  PROFILE_THREAD("Main");
+  framePacer->markInput();
 
   while (state == State::Run) {
-    // Update timing
-    float currentTime = static_cast<float>(glfwGetTime());
-    deltaTime = currentTime - time;
-    time = currentTime;
+    if (isOnDemand()) {
+      waitForRedraw();
+    }
+    PROFILE_FRAME();
+    PROFILE_SCOPE("Frame");
+    framePacer->beginFrame();
+
+    // Update timing; a fixed timestep makes every run render the same frames
+    if (fixedTimestep) {
+      deltaTime = static_cast<float>(options.fixedTimestep);
+      time = static_cast<float>(frame * options.fixedTimestep);
+    } else {
+      deltaTime = static_cast<float>(framePacer->getDeltaTime());
+      time = static_cast<float>(glfwGetTime());
+    }
 
     // Check for window size changes
     detectWindowDimensionChange();
 
     // Execute user-defined render loop
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     loop();
 
+    // Queue the read-back before the back buffer is swapped away
+    if (frameCapture) {
+      GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+      frameCapture->capture(frame);
+    }
+
     // Swap buffers and process events
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    if (!options.headless) {
+      PROFILE_SCOPE("glfwSwapBuffers");
+      glfwSwapBuffers(window);
+    }
+    framePacer->endFrame();
+    {
+      PROFILE_SCOPE("glfwPollEvents");
+      glfwPollEvents();
+    }
+    framePacer->markInput();
+    countFrame(true);
+
+    GLState::endFrame();
+    GLDebug::flush(std::cerr);
+    ++frame;
+    if (options.frameCount > 0 && frame >= options.frameCount) {
+      exit();
+    }
+  }
+
+  // Wait for the GPU so the summary covers all submitted work
+  if (frameCapture) {
+    frameCapture->finish();
+    std::cout << "[Info] Captured " << frameCapture->getWrittenCount()
+              << " frames to " << options.captureDirectory << std::endl;
+    frameCapture.reset();
+  } else {
+    glFinish();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[Info] Rendered " << frame << " frames in " << seconds << " s ("
+            << (frame > 0 ? seconds * 1000.0 / frame : 0.0) << " ms per frame)"
+            << std::endl;
+  const FramePacer::Stats& pacing = framePacer->getStats();
+  std::cout << "[Info] Pacing: " << getPacingModeName(framePacer->getOptions().mode)
+            << ", " << framePacer->getOptions().maxFramesInFlight
+            << " frames in flight, input-to-GPU latency " << pacing.averageLatencyMs
+            << " ms average, " << pacing.maxLatencyMs << " ms max" << std::endl;
+  framePacer.reset();
+  if (GLDebug::isEnabled()) {
+    GLDebug::flush(std::cerr);
+    const GLDebug::Stats debugStats = GLDebug::getStats();
+    std::cout << "[Info] OpenGL debug output: " << debugStats.received << " messages, "
+              << debugStats.repeated << " repeats folded, " << debugStats.dropped
+              << " dropped" << std::endl;
+  }
+
+  if (framebuffer) {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    GLState::forgetFramebuffer(framebuffer);
+    framebuffer = colorRenderbuffer = depthRenderbuffer = 0;
   }
 
   // Clean up GLFW
@@ -103,8 +323,55 @@ void Application::detectWindowDimensionChange() {
   if (dimensionChanged) {
     width = w;
     height = h;
-    glViewport(0, 0, width, height);
+    GLState::viewport(0, 0, width, height);
     std::cout << "[Info] Window resized to " << width << "x" << height
               << std::endl;
   }
-}
\ No newline at end of file
+}
+
+void Application::installEventCallbacks() {
+  glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { redrawOnEvent(); });
+  glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { redrawOnEvent(); });
+  glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { redrawOnEvent(); });
+  glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { redrawOnEvent(); });
+  glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { redrawOnEvent(); });
+  glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { redrawOnEvent(); });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { redrawOnEvent(); });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { redrawOnEvent(); });
+  glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int) { redrawOnEvent(); });
+  glfwSetWindowCloseCallback(window, [](GLFWwindow*) { redrawOnEvent(); });
+}
+
+void Application::requestRedraw(int frames) {
+  redrawFrames = std::max(redrawFrames, frames);
+}
+
+void Application::waitForRedraw() {
+  PROFILE_SCOPE("Idle");
+  while (redrawFrames == 0 && !needsRedraw() && !glfwWindowShouldClose(window)) {
+    countFrame(false);
+    const double before = glfwGetTime();
+    glfwWaitEventsTimeout(kIdleTimeout);
+    framePacer->markInput();
+    // Returning early means an event arrived, possibly for a window that
+    // ImGui created, or glfwPostEmptyEvent() was called
+    if (glfwGetTime() - before < 0.9 * kIdleTimeout) {
+      requestRedraw(kFramesPerEvent);
+    }
+  }
+  redrawFrames = std::max(redrawFrames - 1, 0);
+}
+
+void Application::countFrame(bool drawn) {
+  if (drawn) {
+    ++framesThisSecond;
+  } else {
+    ++skippedFrames;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (now - rateStart >= std::chrono::seconds(1)) {
+    redrawRate = framesThisSecond;
+    framesThisSecond = 0;
+    rateStart = now;
+  }
+}
@@ -1,15 +1,47 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include <GL/glew.h>
+
+#include "FramePacer.hpp"
+
 struct GLFWwindow;
+class FrameCapture;
+
+// Start-up options, usually parsed from the command line
+struct ApplicationOptions {
+  bool headless = false;        // Render into an offscreen framebuffer
+  int width = 640;              // Window or framebuffer width
+  int height = 480;             // Window or framebuffer height
+  int frameCount = 0;           // Frames to run before exiting, 0 for no limit
+  double fixedTimestep = 0.0;   // Seconds per frame, 0 to follow the clock
+  FramePacingOptions pacing;    // Swap interval, frame limit and frames in flight
+  bool onDemand = false;        // Redraw only on input, animation or pending work
+  std::string captureDirectory; // Write each frame here as PPM if not empty
+  bool shaderCache = true;      // Keep linked program binaries on disk
+  std::string shaderCacheDirectory;  // Empty for ProgramCache::defaultDirectory()
+#ifdef NDEBUG
+  bool glDebug = false;         // Debug context reporting through GLDebug
+#else
+  bool glDebug = true;
+#endif
+  bool glDebugSynchronous = false;  // Report inside the offending call; stalls
+};
 
 // Manages OpenGL initialization and window handling, providing utilities for
 // window dimensions, timing, and a customizable render loop.
 class Application {
  public:
-  // Initializes GLFW, OpenGL context, and window
-  Application();
+  // Initializes GLFW, OpenGL context, and window, and configures the
+  // ProgramCache. Headless applications default to 60 frames at a fixed
+  // 1/60 s timestep.
+  explicit Application(const ApplicationOptions& options = ApplicationOptions());
+
+  virtual ~Application();
 
   // Returns the singleton instance of the Application
   static Application& getInstance();
@@ -20,13 +52,15 @@ class Application {
   // Terminates the application
   void exit();
 
-  // Returns the time between frames
+  // Returns the time between frames, smoothed by the frame pacer unless a
+  // fixed timestep is set
   float getFrameDeltaTime() const { return deltaTime; }
 
   // Returns the elapsed time since application start
   float getTime() const { return time; }
 
-  // Runs the main application loop
+  // Runs the main application loop, first reporting how long start-up and
+  // shader program creation took
   void run();
 
   // Gets the current window width
@@ -41,6 +75,31 @@ class Application {
   // Checks if window dimensions have changed since last frame
   bool windowDimensionChanged() const { return dimensionChanged; }
 
+  // Returns true if rendering goes to an offscreen framebuffer
+  bool isHeadless() const { return options.headless; }
+
+  // Returns the framebuffer frames are rendered into (0 for the window)
+  GLuint getFramebuffer() const { return framebuffer; }
+
+  // Returns the frame pacer, which exists until run() returns
+  FramePacer& getFramePacer() { return *framePacer; }
+
+  // Draws at least `frames` more frames when rendering on demand
+  void requestRedraw(int frames = 1);
+
+  // Switches rendering on demand on or off; ignored in headless mode
+  void setOnDemand(bool enabled) { options.onDemand = enabled; }
+
+  // Returns true if frames are only drawn when something changed
+  bool isOnDemand() const { return options.onDemand && !options.headless; }
+
+  // Returns the frames drawn during the last second
+  int getRedrawRate() const { return redrawRate; }
+
+  // Returns how often the loop woke up while rendering on demand without
+  // anything to draw
+  uint64_t getSkippedFrames() const { return skippedFrames; }
+
  protected:
   Application(const Application&) = delete;             // Prevent copying
   Application& operator=(const Application&) = delete;  // Prevent assignment
@@ -48,12 +107,34 @@ class Application {
   std::string title = "Application";  // Window title
   virtual void loop() {}              // Virtual render loop for derived classes
 
+  // Asked while rendering on demand and no redraw was requested; returns
+  // true if the next frame should be drawn anyway, e.g. while an animation
+  // plays or background work has a result to show. May poll that work.
+  virtual bool needsRedraw() { return false; }
+
  private:
   enum class State { Ready, Run, Exit };  // Application state
 
+  // Creates the context without a visible window, trying surfaceless EGL,
+  // then OSMesa, then a hidden window on the default platform
+  void createHeadlessWindow();
+
+  // Creates the offscreen framebuffer used in headless mode
+  void createFramebuffer();
+
   // Updates window dimensions and viewport if changed
   void detectWindowDimensionChange();
 
+  // Requests redraws on input and window events; callbacks installed later,
+  // such as ImGui's, chain to these
+  void installEventCallbacks();
+
+  // Sleeps in glfwWaitEventsTimeout until a frame should be drawn
+  void waitForRedraw();
+
+  // Counts a drawn frame, or an idle wake-up, towards the redraw rate
+  void countFrame(bool drawn);
+
   State state = State::Ready;     // Current application state
   GLFWwindow* window = nullptr;   // GLFW window handle
   float time = 0.0f;              // Time since application start
@@ -61,4 +142,17 @@ class Application {
   int width = 640;                // Window width
   int height = 480;               // Window height
   bool dimensionChanged = false;  // Flag for window size changes
+
+  ApplicationOptions options;                  // Start-up options
+  std::chrono::steady_clock::time_point constructionStart;  // For start-up time
+  GLuint framebuffer = 0;                      // Offscreen framebuffer
+  GLuint colorRenderbuffer = 0;                // Offscreen colour attachment
+  GLuint depthRenderbuffer = 0;                // Offscreen depth attachment
+  std::unique_ptr<FrameCapture> frameCapture;  // Set when capturing frames
+  std::unique_ptr<FramePacer> framePacer;      // Swap interval, limiter and fences
+  int redrawFrames = 1;                        // Frames requested by requestRedraw()
+  int redrawRate = 0;                          // Frames drawn in the last second
+  int framesThisSecond = 0;
+  std::chrono::steady_clock::time_point rateStart;
+  uint64_t skippedFrames = 0;                  // Idle wake-ups without a frame
 };
@@ -0,0 +1,385 @@
+#include "EntityStore.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+// Replaces `values` with values[order[0]], values[order[1]], ...
+template <typename T>
+void reorder(std::vector<T>& values, const std::vector<uint32_t>& order) {
+  std::vector<T> sorted;
+  sorted.reserve(order.size());
+  for (uint32_t index : order) {
+    sorted.push_back(values[index]);
+  }
+  values.swap(sorted);
+}
+
+// Returns the box around `bounds` after transforming it by `matrix`
+AABB transformBounds(const AABB& bounds, const glm::mat4& matrix) {
+  const glm::vec3 center = glm::vec3(matrix * glm::vec4(bounds.center(), 1.0f));
+  const glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+  glm::vec3 extent(0.0f);
+  for (int column = 0; column < 3; ++column) {
+    extent += glm::abs(glm::vec3(matrix[column])) * half[column];
+  }
+  return AABB{center - extent, center + extent};
+}
+}  // namespace
+
+EntityHandle EntityStore::create(uint32_t type, const glm::vec3& position,
+                                 EntityHandle parent, const AABB& bounds) {
+  const uint32_t parentIndex = parent.isNull() ? kNoParent : find(parent);
+  const uint32_t depth = parent.isNull() ? 0 : depths[parentIndex] + 1;
+  const uint32_t dense = static_cast<uint32_t>(handles.size());
+
+  EntityHandle handle;
+  if (freeSlots.empty()) {
+    handle.index = static_cast<uint32_t>(slots.size());
+    slots.emplace_back();
+  } else {
+    handle.index = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  Slot& slot = slots[handle.index];
+  slot.dense = dense;
+  handle.generation = slot.generation;
+
+  handles.push_back(handle);
+  types.push_back(type);
+  positions.push_back(position);
+  rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  scales.push_back(glm::vec3(1.0f));
+  parents.push_back(parentIndex);
+  depths.push_back(depth);
+  dirty.push_back(1);
+  localBounds.push_back(bounds);
+  worldMatrices.push_back(glm::mat4(1.0f));
+  worldBounds.push_back(bounds);
+  anyDirty = true;
+
+  // Appending keeps the order unless the entity is shallower than the last one
+  if (!unordered) {
+    if (depth == levelStarts.size()) {
+      levelStarts.push_back(dense);
+    } else if (depth + 1 < levelStarts.size()) {
+      unordered = true;
+    }
+  }
+  return handle;
+}
+
+void EntityStore::destroy(EntityHandle entity) {
+  destroy(std::vector<EntityHandle>{entity});
+}
+
+void EntityStore::destroy(const std::vector<EntityHandle>& entities) {
+  PROFILE_FUNCTION();
+  restoreOrder();
+  std::vector<uint8_t> removed(handles.size(), 0);
+  for (EntityHandle entity : entities) {
+    removed[find(entity)] = 1;
+  }
+  // Parents precede their children, so one pass reaches every descendant
+  std::vector<uint32_t> order;
+  order.reserve(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    if (parents[i] != kNoParent && removed[parents[i]]) {
+      removed[i] = 1;
+    }
+    if (removed[i]) {
+      Slot& slot = slots[handles[i].index];
+      slot.dense = kNoParent;
+      ++slot.generation;
+      freeSlots.push_back(handles[i].index);
+    } else {
+      order.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  permute(order);
+  findLevels();
+}
+
+void EntityStore::clear() {
+  for (EntityHandle handle : handles) {
+    Slot& slot = slots[handle.index];
+    slot.dense = kNoParent;
+    ++slot.generation;
+    freeSlots.push_back(handle.index);
+  }
+  permute({});
+  levelStarts.clear();
+  unordered = false;
+  anyDirty = false;
+}
+
+void EntityStore::assign(size_t count, const uint32_t* newTypes,
+                         const glm::vec3* newPositions, const glm::quat* newRotations,
+                         const glm::vec3* newScales, const uint32_t* newParents,
+                         const AABB* bounds) {
+  PROFILE_FUNCTION();
+  for (size_t i = 0; i < count; ++i) {
+    if (newParents[i] != kNoParent && newParents[i] >= count) {
+      throw std::runtime_error("Entity " + std::to_string(i) + " has parent " +
+                               std::to_string(newParents[i]) + " out of range");
+    }
+  }
+  clear();
+
+  // Bulk copies, then one handle per entity; the slots freed by clear() are
+  // reused before new ones are added
+  types.assign(newTypes, newTypes + count);
+  positions.assign(newPositions, newPositions + count);
+  rotations.assign(newRotations, newRotations + count);
+  scales.assign(newScales, newScales + count);
+  parents.assign(newParents, newParents + count);
+  localBounds.assign(bounds, bounds + count);
+  depths.assign(count, 0);
+  dirty.assign(count, 1);
+  worldMatrices.assign(count, glm::mat4(1.0f));
+  worldBounds.assign(bounds, bounds + count);
+  handles.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    EntityHandle& handle = handles[i];
+    if (freeSlots.empty()) {
+      handle.index = static_cast<uint32_t>(slots.size());
+      slots.emplace_back();
+    } else {
+      handle.index = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    slots[handle.index].dense = static_cast<uint32_t>(i);
+    handle.generation = slots[handle.index].generation;
+  }
+  anyDirty = count > 0;
+
+  // A cycle would never reach a root while the depths are computed. Walk up
+  // from every entity until a root or an entity already known to reach one;
+  // meeting the current walk again means a cycle.
+  constexpr uint8_t kUnvisited = 0, kWalking = 1, kReachesRoot = 2;
+  std::vector<uint8_t> state(count, kUnvisited);
+  std::vector<uint32_t> chain;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t node = i;
+    while (node != kNoParent && state[node] == kUnvisited) {
+      state[node] = kWalking;
+      chain.push_back(node);
+      node = parents[node];
+    }
+    if (node != kNoParent && state[node] == kWalking) {
+      clear();
+      throw std::runtime_error("Entity hierarchy contains a cycle");
+    }
+    for (uint32_t walked : chain) {
+      state[walked] = kReachesRoot;
+    }
+    chain.clear();
+  }
+  unordered = true;
+  restoreOrder();
+}
+
+bool EntityStore::isAlive(EntityHandle entity) const {
+  return entity.index < slots.size() && slots[entity.index].dense != kNoParent &&
+         slots[entity.index].generation == entity.generation;
+}
+
+uint32_t EntityStore::find(EntityHandle entity) const {
+  if (!isAlive(entity)) {
+    throw std::runtime_error("Stale or null entity handle " + std::to_string(entity.index) +
+                             ":" + std::to_string(entity.generation));
+  }
+  return slots[entity.index].dense;
+}
+
+void EntityStore::setPosition(EntityHandle entity, const glm::vec3& position) {
+  const uint32_t i = find(entity);
+  positions[i] = position;
+  dirty[i] = 1;
+  anyDirty = true;
+}
+
+void EntityStore::setRotation(EntityHandle entity, const glm::quat& rotation) {
+  const uint32_t i = find(entity);
+  rotations[i] = rotation;
+  dirty[i] = 1;
+  anyDirty = true;
+}
+
+void EntityStore::setScale(EntityHandle entity, const glm::vec3& scale) {
+  const uint32_t i = find(entity);
+  scales[i] = scale;
+  dirty[i] = 1;
+  anyDirty = true;
+}
+
+const glm::vec3& EntityStore::getPosition(EntityHandle entity) const {
+  return positions[find(entity)];
+}
+
+const glm::quat& EntityStore::getRotation(EntityHandle entity) const {
+  return rotations[find(entity)];
+}
+
+const glm::vec3& EntityStore::getScale(EntityHandle entity) const {
+  return scales[find(entity)];
+}
+
+void EntityStore::setParent(EntityHandle entity, EntityHandle parent) {
+  const uint32_t i = find(entity);
+  const uint32_t parentIndex = parent.isNull() ? kNoParent : find(parent);
+  for (uint32_t ancestor = parentIndex; ancestor != kNoParent; ancestor = parents[ancestor]) {
+    if (ancestor == i) {
+      throw std::runtime_error("Entity cannot become its own ancestor");
+    }
+  }
+  parents[i] = parentIndex;
+  dirty[i] = 1;
+  anyDirty = true;
+  // The depths of the whole subtree change; restoreOrder() recomputes them
+  unordered = true;
+}
+
+EntityHandle EntityStore::getParent(EntityHandle entity) const {
+  const uint32_t parent = parents[find(entity)];
+  return parent == kNoParent ? EntityHandle() : handles[parent];
+}
+
+uint32_t EntityStore::getType(EntityHandle entity) const {
+  return types[find(entity)];
+}
+
+const glm::mat4& EntityStore::getWorldMatrix(EntityHandle entity) const {
+  return worldMatrices[find(entity)];
+}
+
+const AABB& EntityStore::getWorldBounds(EntityHandle entity) const {
+  return worldBounds[find(entity)];
+}
+
+size_t EntityStore::updateTransforms(ThreadPool& pool) {
+  PROFILE_FUNCTION();
+  restoreOrder();
+  if (!anyDirty) {
+    return 0;
+  }
+
+  // A depth only reads the world matrices and dirty flags of the one above,
+  // which are final once its parallelFor returns
+  std::atomic<size_t> updated{0};
+  for (size_t level = 0; level < levelStarts.size(); ++level) {
+    const size_t begin = levelStarts[level];
+    const size_t end = level + 1 < levelStarts.size() ? levelStarts[level + 1] : handles.size();
+    pool.parallelFor(
+        end - begin,
+        [&](size_t first, size_t last) {
+          size_t count = 0;
+          for (size_t i = begin + first; i < begin + last; ++i) {
+            const uint32_t parent = parents[i];
+            if (parent != kNoParent && dirty[parent]) {
+              dirty[i] = 1;
+            }
+            if (!dirty[i]) {
+              continue;
+            }
+            const glm::mat3 rotation = glm::mat3_cast(rotations[i]);
+            const glm::vec3& scale = scales[i];
+            const glm::mat4 local(glm::vec4(rotation[0] * scale.x, 0.0f),
+                                  glm::vec4(rotation[1] * scale.y, 0.0f),
+                                  glm::vec4(rotation[2] * scale.z, 0.0f),
+                                  glm::vec4(positions[i], 1.0f));
+            worldMatrices[i] = parent == kNoParent ? local : worldMatrices[parent] * local;
+            worldBounds[i] = transformBounds(localBounds[i], worldMatrices[i]);
+            ++count;
+          }
+          updated += count;
+        },
+        kGrain);
+  }
+  std::fill(dirty.begin(), dirty.end(), 0);
+  anyDirty = false;
+  return updated;
+}
+
+void EntityStore::restoreOrder() {
+  if (!unordered) {
+    return;
+  }
+  PROFILE_FUNCTION();
+  // Depths from the parent links; a reparent may have put parents after
+  // their children, so walk up until a known depth
+  constexpr uint32_t kUnknownDepth = 0xFFFFFFFFu;
+  std::fill(depths.begin(), depths.end(), kUnknownDepth);
+  std::vector<uint32_t> chain;
+  uint32_t maxDepth = 0;
+  for (uint32_t i = 0; i < handles.size(); ++i) {
+    uint32_t node = i;
+    while (depths[node] == kUnknownDepth && parents[node] != kNoParent) {
+      chain.push_back(node);
+      node = parents[node];
+    }
+    if (depths[node] == kUnknownDepth) {
+      depths[node] = 0;
+    }
+    while (!chain.empty()) {
+      depths[chain.back()] = depths[node] + 1;
+      node = chain.back();
+      chain.pop_back();
+    }
+    maxDepth = std::max(maxDepth, depths[i]);
+  }
+
+  // Stable counting sort by depth
+  std::vector<size_t> offsets(maxDepth + 2, 0);
+  for (uint32_t depth : depths) {
+    ++offsets[depth + 1];
+  }
+  for (size_t d = 1; d < offsets.size(); ++d) {
+    offsets[d] += offsets[d - 1];
+  }
+  std::vector<uint32_t> order(handles.size());
+  for (uint32_t i = 0; i < handles.size(); ++i) {
+    order[offsets[depths[i]]++] = i;
+  }
+  permute(order);
+  findLevels();
+  unordered = false;
+}
+
+void EntityStore::permute(const std::vector<uint32_t>& order) {
+  std::vector<uint32_t> newIndex(handles.size(), kNoParent);
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    newIndex[order[i]] = i;
+  }
+  reorder(handles, order);
+  reorder(types, order);
+  reorder(positions, order);
+  reorder(rotations, order);
+  reorder(scales, order);
+  reorder(parents, order);
+  reorder(depths, order);
+  reorder(dirty, order);
+  reorder(localBounds, order);
+  reorder(worldMatrices, order);
+  reorder(worldBounds, order);
+  for (uint32_t i = 0; i < handles.size(); ++i) {
+    if (parents[i] != kNoParent) {
+      parents[i] = newIndex[parents[i]];
+    }
+    slots[handles[i].index].dense = i;
+  }
+}
+
+void EntityStore::findLevels() {
+  levelStarts.clear();
+  for (size_t i = 0; i < depths.size(); ++i) {
+    if (depths[i] == levelStarts.size()) {
+      levelStarts.push_back(i);
+    }
+  }
+}
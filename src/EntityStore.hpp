@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "Frustum.hpp"
+
+class ThreadPool;
+
+// Refers to an entity in an EntityStore. The generation tells a handle to a
+// destroyed entity apart from one to a newer entity reusing its slot.
+struct EntityHandle {
+  static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+  uint32_t index = kNone;    // Slot in the store
+  uint32_t generation = 0;   // Of the slot when the handle was made
+
+  bool isNull() const { return index == kNone; }
+  bool operator==(const EntityHandle&) const = default;
+};
+
+// Scene objects with a transform hierarchy, stored as structure of arrays:
+// each component lives in its own dense array, so a pass over one component
+// streams through memory instead of chasing pointers to heap nodes. Handles
+// go through a slot table to the dense index, which changes when entities are
+// destroyed or reordered.
+//
+// The dense arrays are kept sorted by hierarchy depth, lazily after a
+// reparent or an insertion under a deeper parent, so every parent precedes
+// its children and each depth is a contiguous range. updateTransforms() walks
+// the depths in order and recomputes the entities of one depth in parallel;
+// only entities that changed, or whose ancestors changed, are recomputed.
+class EntityStore {
+ public:
+  // Parent of root entities in getParents()
+  static constexpr uint32_t kNoParent = 0xFFFFFFFFu;
+
+  // Creates an entity; `bounds` are in the entity's local space
+  EntityHandle create(uint32_t type, const glm::vec3& position,
+                      EntityHandle parent = EntityHandle(),
+                      const AABB& bounds = AABB{glm::vec3(-0.5f), glm::vec3(0.5f)});
+
+  // Destroys an entity and all its descendants; takes time linear in the
+  // number of entities, so destroy in batches of handles where possible
+  void destroy(EntityHandle entity);
+  void destroy(const std::vector<EntityHandle>& entities);
+
+  // Destroys every entity; outstanding handles become stale
+  void clear();
+
+  // Returns true if the handle refers to an existing entity
+  bool isAlive(EntityHandle entity) const;
+
+  // Returns the number of entities
+  size_t size() const { return handles.size(); }
+
+  // Local transform; setting it marks the entity for updateTransforms()
+  void setPosition(EntityHandle entity, const glm::vec3& position);
+  void setRotation(EntityHandle entity, const glm::quat& rotation);
+  void setScale(EntityHandle entity, const glm::vec3& scale);
+  const glm::vec3& getPosition(EntityHandle entity) const;
+  const glm::quat& getRotation(EntityHandle entity) const;
+  const glm::vec3& getScale(EntityHandle entity) const;
+
+  // Moves an entity under another parent, or to the root with a null
+  // handle; throws if that would make the entity its own ancestor
+  void setParent(EntityHandle entity, EntityHandle parent);
+  EntityHandle getParent(EntityHandle entity) const;
+
+  // Returns the type given at creation
+  uint32_t getType(EntityHandle entity) const;
+
+  // Results of the last updateTransforms()
+  const glm::mat4& getWorldMatrix(EntityHandle entity) const;
+  const AABB& getWorldBounds(EntityHandle entity) const;
+
+  // Recomputes the world matrices and bounds of changed entities and their
+  // descendants; returns how many were recomputed
+  size_t updateTransforms(ThreadPool& pool);
+
+  // Replaces every entity with `count` entities given as dense arrays like
+  // the getters below return, e.g. read from a scene file. Parents are dense
+  // indices into the same arrays and need not precede their children; new
+  // handles are issued and the old ones become stale. Throws on an out of
+  // range parent.
+  void assign(size_t count, const uint32_t* types, const glm::vec3* positions,
+              const glm::quat* rotations, const glm::vec3* scales,
+              const uint32_t* parents, const AABB* bounds);
+
+  // Dense arrays in matching order, valid until the store changes
+  const std::vector<EntityHandle>& getHandles() const { return handles; }
+  const std::vector<uint32_t>& getTypes() const { return types; }
+  const std::vector<glm::vec3>& getPositions() const { return positions; }
+  const std::vector<glm::quat>& getRotations() const { return rotations; }
+  const std::vector<glm::vec3>& getScales() const { return scales; }
+  const std::vector<uint32_t>& getParents() const { return parents; }
+  const std::vector<AABB>& getLocalBounds() const { return localBounds; }
+  const std::vector<glm::mat4>& getWorldMatrices() const { return worldMatrices; }
+  const std::vector<AABB>& getWorldBounds() const { return worldBounds; }
+
+ private:
+  static constexpr size_t kGrain = 1024;  // Entities per parallel task
+
+  // Maps a handle's index to the entity's dense index
+  struct Slot {
+    uint32_t dense = kNoParent;  // kNoParent while the slot is free
+    uint32_t generation = 0;
+  };
+
+  // Returns the dense index of a live entity; throws on a stale handle
+  uint32_t find(EntityHandle entity) const;
+
+  // Sorts the dense arrays by depth again if an insertion or reparent broke
+  // the order, and recomputes the depth ranges
+  void restoreOrder();
+
+  // Moves every dense array into the order of `order` (new to old index)
+  void permute(const std::vector<uint32_t>& order);
+
+  // Recomputes levelStarts from the sorted depths
+  void findLevels();
+
+  // Slot table
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+
+  // Dense components, all indexed alike
+  std::vector<EntityHandle> handles;
+  std::vector<uint32_t> types;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<uint32_t> parents;  // Dense index, kNoParent for roots
+  std::vector<uint32_t> depths;   // 0 for roots
+  std::vector<uint8_t> dirty;     // Local transform changed since the last update
+  std::vector<AABB> localBounds;
+  std::vector<glm::mat4> worldMatrices;
+  std::vector<AABB> worldBounds;
+
+  std::vector<size_t> levelStarts;  // First dense index of each depth
+  bool unordered = false;           // Dense arrays no longer sorted by depth
+  bool anyDirty = false;
+};
@@ -0,0 +1,125 @@
+#include "FrameCapture.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+
+FrameCapture::FrameCapture(int width, int height, const std::string& directory)
+    : width(width), height(height), directory(directory), row(width * 3) {
+  std::filesystem::create_directories(directory);
+
+  const GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * 4;
+  for (Slot& slot : slots) {
+    glGenBuffers(1, &slot.buffer);
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    GLDebug::label(GL_BUFFER, slot.buffer, "Frame capture read-back");
+  }
+  GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture() {
+  for (Slot& slot : slots) {
+    if (slot.fence) {
+      glDeleteSync(slot.fence);
+    }
+    glDeleteBuffers(1, &slot.buffer);
+    GLState::forgetBuffer(slot.buffer);
+  }
+}
+
+void FrameCapture::capture(int frame) {
+  PROFILE_FUNCTION();
+
+  // Make room by writing what is done, blocking only when every slot is busy
+  collect(pending == kRingSize);
+
+  Slot& slot = slots[next];
+  slot.frame = frame;
+
+  // RGBA rows are always 4-byte aligned, so the default pack alignment holds
+  GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  next = (next + 1) % kRingSize;
+  ++pending;
+}
+
+void FrameCapture::finish() {
+  while (pending > 0) {
+    collect(true);
+  }
+}
+
+void FrameCapture::collect(bool wait) {
+  while (pending > 0) {
+    Slot& slot = slots[(next - pending + kRingSize) % kRingSize];
+    // The first wait flushes so the fence is guaranteed to be submitted
+    const GLuint64 timeout = wait ? 1000000000ull : 0;
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(slot.fence, 0, timeout);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    if (status == GL_WAIT_FAILED) {
+      std::cerr << "Warning: Waiting for frame " << slot.frame
+                << " read-back failed" << std::endl;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    write(slot);
+    --pending;
+    wait = false;
+  }
+}
+
+void FrameCapture::write(Slot& slot) {
+  PROFILE_FUNCTION();
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "frame_%05d.ppm", slot.frame);
+  const std::string path = (std::filesystem::path(directory) / name).string();
+
+  GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  const GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * 4;
+  const auto* pixels = static_cast<const unsigned char*>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+  if (!pixels) {
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    std::cerr << "Warning: Could not map the read-back of frame " << slot.frame
+              << std::endl;
+    return;
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  out << "P6\n" << width << " " << height << "\n255\n";
+  // OpenGL rows start at the bottom, PPM rows at the top
+  for (int y = height - 1; y >= 0; --y) {
+    const unsigned char* source = pixels + static_cast<size_t>(y) * width * 4;
+    for (int x = 0; x < width; ++x) {
+      row[x * 3 + 0] = source[x * 4 + 0];
+      row[x * 3 + 1] = source[x * 4 + 1];
+      row[x * 3 + 2] = source[x * 4 + 2];
+    }
+    out.write(reinterpret_cast<const char*>(row.data()),
+              static_cast<std::streamsize>(row.size()));
+  }
+
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (!out) {
+    std::cerr << "Warning: Could not write " << path << std::endl;
+    return;
+  }
+  ++written;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Writes rendered frames to `directory` as binary PPM files. Pixels are read
+// into a ring of pixel pack buffers and only mapped once the fence issued
+// after the read has signalled, so capturing a frame does not wait for the
+// GPU to finish it; the CPU only blocks when the whole ring is still in
+// flight.
+class FrameCapture {
+ public:
+  // Read-backs that may be in flight at once
+  static constexpr int kRingSize = 3;
+
+  // Creates the directory and the pack buffers; requires a current context
+  FrameCapture(int width, int height, const std::string& directory);
+
+  // Deletes the buffers and fences without writing pending frames
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  // Starts reading the colour buffer of the bound read framebuffer
+  void capture(int frame);
+
+  // Writes every pending frame, waiting for the GPU if needed
+  void finish();
+
+  // Returns the number of frames written so far
+  int getWrittenCount() const { return written; }
+
+ private:
+  // A read-back in flight
+  struct Slot {
+    GLuint buffer = 0;        // Pixel pack buffer
+    GLsync fence = nullptr;   // Signalled once the read completed
+    int frame = -1;           // Frame number used in the file name
+  };
+
+  // Writes the frames whose fences have signalled; with `wait` set the
+  // oldest one is waited for first
+  void collect(bool wait);
+
+  // Maps the slot's buffer and writes it as a PPM file
+  void write(Slot& slot);
+
+  int width;
+  int height;
+  std::string directory;
+  Slot slots[kRingSize];
+  int next = 0;      // Slot used by the next capture
+  int pending = 0;   // Slots in flight, ending just before `next`
+  int written = 0;   // Frames written
+  std::vector<unsigned char> row;  // Scratch space for one RGB row
+};
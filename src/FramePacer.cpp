@@ -0,0 +1,194 @@
+#include "FramePacer.hpp"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "Profiler.hpp"
+
+namespace {
+double milliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+}  // namespace
+
+void parsePacingMode(const std::string& text, FramePacingOptions& options) {
+  if (text == "vsync") {
+    options.mode = PacingMode::Vsync;
+  } else if (text == "adaptive") {
+    options.mode = PacingMode::Adaptive;
+  } else if (text == "uncapped") {
+    options.mode = PacingMode::Uncapped;
+  } else {
+    size_t end = 0;
+    double fps = 0.0;
+    try {
+      fps = std::stod(text, &end);
+    } catch (const std::exception&) {
+      end = 0;
+    }
+    if (end != text.size() || !(fps > 0.0)) {
+      throw std::runtime_error("Invalid pacing mode " + text +
+                               ", expected vsync, adaptive, uncapped or a frame rate");
+    }
+    options.mode = PacingMode::Fixed;
+    options.targetFps = fps;
+  }
+}
+
+const char* getPacingModeName(PacingMode mode) {
+  switch (mode) {
+    case PacingMode::Vsync:
+      return "vsync";
+    case PacingMode::Adaptive:
+      return "adaptive";
+    case PacingMode::Fixed:
+      return "fixed";
+    case PacingMode::Uncapped:
+      return "uncapped";
+  }
+  return "unknown";
+}
+
+FramePacer::FramePacer(const FramePacingOptions& options, bool swapChain)
+    : swapChain(swapChain) {
+  tearControl = swapChain && (glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+                              glfwExtensionSupported("WGL_EXT_swap_control_tear"));
+  setOptions(options);
+}
+
+FramePacer::~FramePacer() {
+  for (const Frame& frame : frames) {
+    glDeleteSync(frame.fence);
+  }
+}
+
+void FramePacer::setOptions(const FramePacingOptions& newOptions) {
+  options = newOptions;
+  options.maxFramesInFlight =
+      std::clamp(options.maxFramesInFlight, 1, FramePacingOptions::kMaxFramesInFlight);
+  if (!(options.targetFps > 0.0)) {
+    options.targetFps = 60.0;
+  }
+  deadline = Clock::time_point();
+  applySwapInterval();
+}
+
+void FramePacer::applySwapInterval() {
+  if (!swapChain) {
+    return;
+  }
+  int interval = 0;
+  if (options.mode == PacingMode::Vsync) {
+    interval = 1;
+  } else if (options.mode == PacingMode::Adaptive) {
+    // A negative interval swaps late frames immediately instead of waiting
+    // for the next blank
+    interval = tearControl ? -1 : 1;
+    if (!tearControl) {
+      std::cout << "[Info] No EXT_swap_control_tear, adaptive pacing falls back to vsync"
+                << std::endl;
+    }
+  }
+  glfwSwapInterval(interval);
+}
+
+void FramePacer::beginFrame() {
+  PROFILE_FUNCTION();
+  stats.framesInFlight = static_cast<int>(frames.size());
+  const Clock::time_point waitStart = Clock::now();
+  retireFrames(static_cast<size_t>(options.maxFramesInFlight));
+  const Clock::time_point now = Clock::now();
+  stats.fenceWaitMs = milliseconds(now - waitStart);
+
+  if (started) {
+    rawDeltaTime = std::chrono::duration<double>(now - lastFrameStart).count();
+    const double clamped = std::min(rawDeltaTime, kMaxDeltaTime);
+    deltaTime = deltaTime > 0.0 ? deltaTime + kSmoothing * (clamped - deltaTime) : clamped;
+  }
+  started = true;
+  lastFrameStart = now;
+}
+
+void FramePacer::endFrame() {
+  frames.push_back(Frame{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), input});
+  // Picks up frames that finished meanwhile, without waiting
+  retireFrames(FramePacingOptions::kMaxFramesInFlight + 1);
+
+  stats.limiterWaitMs = 0.0;
+  if (options.mode != PacingMode::Fixed) {
+    return;
+  }
+  PROFILE_SCOPE("Frame limiter");
+  const Clock::time_point now = Clock::now();
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options.targetFps));
+  // A late frame moves the schedule instead of rushing the next ones
+  deadline = std::max(deadline + period, now);
+  waitUntil(deadline);
+  stats.limiterWaitMs = milliseconds(Clock::now() - now);
+}
+
+void FramePacer::markInput() {
+  input = Clock::now();
+}
+
+void FramePacer::retireFrames(size_t limit) {
+  while (!frames.empty()) {
+    const Frame& oldest = frames.front();
+    const bool wait = frames.size() >= limit;
+    // The first wait flushes so the fence is guaranteed to be submitted
+    GLenum status = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     wait ? 1000000000ull : 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(oldest.fence, 0, 1000000000ull);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    retire(oldest, Clock::now());
+    glDeleteSync(oldest.fence);
+    frames.pop_front();
+  }
+}
+
+void FramePacer::retire(const Frame& frame, Clock::time_point now) {
+  // Frames rendered before the first input poll have nothing to measure
+  if (frame.input == Clock::time_point()) {
+    return;
+  }
+  stats.lastLatencyMs = milliseconds(now - frame.input);
+  latencies[stats.latencySamples % kLatencyWindow] = stats.lastLatencyMs;
+  ++stats.latencySamples;
+
+  const size_t count = std::min<size_t>(stats.latencySamples, kLatencyWindow);
+  double sum = 0.0;
+  stats.maxLatencyMs = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    sum += latencies[i];
+    stats.maxLatencyMs = std::max(stats.maxLatencyMs, latencies[i]);
+  }
+  stats.averageLatencyMs = sum / count;
+}
+
+void FramePacer::waitUntil(Clock::time_point until) {
+  // Sleep in short steps while the worst oversleep seen still fits, then
+  // spin for the rest
+  const auto step = std::chrono::milliseconds(1);
+  for (;;) {
+    const Clock::time_point before = Clock::now();
+    if (until - before <= step + std::chrono::duration<double>(sleepOvershoot)) {
+      break;
+    }
+    std::this_thread::sleep_for(step);
+    const double overshoot =
+        std::chrono::duration<double>(Clock::now() - before - step).count();
+    // Decays slowly so one bad sleep does not turn the limiter into a spin
+    sleepOvershoot = std::clamp(std::max(overshoot, sleepOvershoot * 0.99), 0.0002, 0.004);
+  }
+  while (Clock::now() < until) {
+    std::this_thread::yield();
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// How frames are paced
+enum class PacingMode {
+  Vsync,     // Swap on vertical blank
+  Adaptive,  // Swap on vertical blank, or tear when a frame is late
+  Fixed,     // Limit to a target frame rate without vsync
+  Uncapped,  // As fast as possible
+};
+
+// Frame pacing settings
+struct FramePacingOptions {
+  static constexpr int kMaxFramesInFlight = 4;  // Largest maxFramesInFlight
+
+  PacingMode mode = PacingMode::Vsync;
+  double targetFps = 60.0;    // Frame rate of PacingMode::Fixed
+  int maxFramesInFlight = 2;  // Frames the CPU may submit before the GPU finishes one
+};
+
+// Parses "vsync", "adaptive", "uncapped" or a frame rate for PacingMode::Fixed
+// into `options`; throws on anything else
+void parsePacingMode(const std::string& text, FramePacingOptions& options);
+
+// Returns "vsync", "adaptive", "fixed" or "uncapped"
+const char* getPacingModeName(PacingMode mode);
+
+// Paces the frame loop. The swap interval follows the mode; in
+// PacingMode::Fixed a limiter sleeps until shortly before each frame's
+// deadline and spins for the rest, since sleeps overshoot by up to a
+// scheduler tick. A fence after every frame bounds how far the CPU runs ahead
+// of the GPU: fewer frames in flight means input shows up on screen sooner,
+// at the cost of less overlap between CPU and GPU work. The fences also time
+// when each frame finished on the GPU, which estimates the latency from
+// polling input to presenting the frame that used it.
+class FramePacer {
+ public:
+  // Measurements of the recent frames
+  struct Stats {
+    double lastLatencyMs = 0.0;     // Input poll to GPU completion, newest frame
+    double averageLatencyMs = 0.0;  // Over the recent frames
+    double maxLatencyMs = 0.0;      // Over the recent frames
+    uint64_t latencySamples = 0;    // Frames measured so far
+    double fenceWaitMs = 0.0;       // Blocked on frames in flight, last frame
+    double limiterWaitMs = 0.0;     // Spent in the frame limiter, last frame
+    int framesInFlight = 0;         // Unfinished frames when the last one began
+  };
+
+  // Applies the swap interval if `swapChain`; requires a current context
+  FramePacer(const FramePacingOptions& options, bool swapChain);
+
+  ~FramePacer();
+
+  FramePacer(const FramePacer&) = delete;
+  FramePacer& operator=(const FramePacer&) = delete;
+
+  // Changes the settings between frames
+  void setOptions(const FramePacingOptions& options);
+
+  // Returns the settings
+  const FramePacingOptions& getOptions() const { return options; }
+
+  // Call before rendering: waits until fewer than the maximum frames are in
+  // flight and updates the delta time
+  void beginFrame();
+
+  // Call after the swap: fences the frame and waits for the limiter
+  void endFrame();
+
+  // Call right after polling events: the next frame responds to this input
+  void markInput();
+
+  // Returns the smoothed seconds between frames, clamped so that one long
+  // stall does not move animations by a large step
+  double getDeltaTime() const { return deltaTime; }
+
+  // Returns the unsmoothed seconds between the last two frames
+  double getRawDeltaTime() const { return rawDeltaTime; }
+
+  // Returns the measurements
+  const Stats& getStats() const { return stats; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kLatencyWindow = 120;  // Frames averaged in Stats
+  static constexpr double kMaxDeltaTime = 0.1;   // Seconds
+  static constexpr double kSmoothing = 0.2;      // Weight of the newest delta
+
+  // A submitted frame
+  struct Frame {
+    GLsync fence = nullptr;
+    Clock::time_point input;  // When the input it responds to was polled
+  };
+
+  // Sets the swap interval for the mode
+  void applySwapInterval();
+
+  // Retires finished frames; waits for the oldest while `limit` or more are
+  // in flight
+  void retireFrames(size_t limit);
+
+  // Records a frame that finished at `now`
+  void retire(const Frame& frame, Clock::time_point now);
+
+  // Sleeps, then spins, until `until`
+  void waitUntil(Clock::time_point until);
+
+  FramePacingOptions options;
+  bool swapChain;
+  bool tearControl = false;  // EXT_swap_control_tear, needed for Adaptive
+  std::deque<Frame> frames;  // Oldest first
+  Clock::time_point input;
+  Clock::time_point lastFrameStart;
+  Clock::time_point deadline;  // Of the next frame in PacingMode::Fixed
+  bool started = false;
+  double deltaTime = 0.0;
+  double rawDeltaTime = 0.0;
+  double sleepOvershoot = 0.002;  // Largest recent oversleep, seconds
+  std::array<double, kLatencyWindow> latencies{};
+  Stats stats;
+};
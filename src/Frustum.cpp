@@ -0,0 +1,36 @@
+#include "Frustum.hpp"
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+  // Gribb/Hartmann: each plane is the sum or difference of the fourth row
+  // with one of the first three rows. GLM matrices are column-major, so row i
+  // is (m[0][i], m[1][i], m[2][i], m[3][i]).
+  auto row = [&](int i) {
+    return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                     viewProjection[2][i], viewProjection[3][i]);
+  };
+  glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+  planes[0] = r3 + r0;  // Left
+  planes[1] = r3 - r0;  // Right
+  planes[2] = r3 + r1;  // Bottom
+  planes[3] = r3 - r1;  // Top
+  planes[4] = r3 + r2;  // Near
+  planes[5] = r3 - r2;  // Far
+
+  for (auto& plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+}
+
+bool Frustum::intersects(const AABB& box) const {
+  for (const auto& plane : planes) {
+    // Test the corner furthest along the plane normal
+    glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                       plane.y >= 0.0f ? box.max.y : box.min.y,
+                       plane.z >= 0.0f ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
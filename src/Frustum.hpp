@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct AABB {
+  glm::vec3 min = glm::vec3(0.0f);  // Minimum corner
+  glm::vec3 max = glm::vec3(0.0f);  // Maximum corner
+
+  // Grows the box to contain the point
+  void extend(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  // Returns the box center
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+};
+
+// View frustum as six planes, used for CPU-side visibility culling.
+class Frustum {
+ public:
+  Frustum() = default;
+
+  // Extracts the planes from a combined projection * view matrix
+  explicit Frustum(const glm::mat4& viewProjection);
+
+  // Returns false only if the box lies entirely outside one of the planes.
+  // The test is conservative: boxes near a frustum corner may be reported
+  // visible although they are not.
+  bool intersects(const AABB& box) const;
+
+ private:
+  // Planes as (normal, distance) pointing inwards, in the order
+  // left, right, bottom, top, near, far
+  glm::vec4 planes[6];
+};
@@ -0,0 +1,229 @@
+#include "GLDebug.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+
+namespace GLDebug {
+
+namespace {
+constexpr size_t kRecentMessages = 64;
+constexpr uint64_t kNewMessagesPerSecond = 20;
+constexpr GLsizei kMaxLabelLength = 255;  // GL_MAX_LABEL_LENGTH is at least 256
+
+// Whether the driver has KHR_debug: unknown until first queried
+enum class Support { Unknown, Yes, No };
+Support support = Support::Unknown;
+bool enabled = false;
+
+// Written by the callback, possibly on a driver thread
+std::mutex mutex;
+std::deque<Message> recent;    // Distinct messages, oldest first
+std::vector<Message> pending;  // Not printed yet
+Stats stats;
+uint64_t reportedDrops = 0;    // Drops already printed
+std::chrono::steady_clock::time_point windowStart;
+uint64_t windowMessages = 0;   // New messages in the current second
+std::atomic<bool> hasPending{false};
+
+bool available() {
+  if (support == Support::Unknown) {
+    support = GLEW_VERSION_4_3 || GLEW_KHR_debug ? Support::Yes : Support::No;
+  }
+  return support == Support::Yes;
+}
+
+bool isError(const Message& message) {
+  return message.type == GL_DEBUG_TYPE_ERROR || message.severity == GL_DEBUG_SEVERITY_HIGH;
+}
+
+const char* sourceName(GLenum source) {
+  switch (source) {
+    case GL_DEBUG_SOURCE_API:
+      return "api";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+      return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:
+      return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:
+      return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:
+      return "application";
+    default:
+      return "other";
+  }
+}
+
+const char* typeName(GLenum type) {
+  switch (type) {
+    case GL_DEBUG_TYPE_ERROR:
+      return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+      return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+      return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY:
+      return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:
+      return "performance";
+    case GL_DEBUG_TYPE_MARKER:
+      return "marker";
+    default:
+      return "other";
+  }
+}
+
+const char* severityName(GLenum severity) {
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+      return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      return "medium";
+    case GL_DEBUG_SEVERITY_LOW:
+      return "low";
+    default:
+      return "notification";
+  }
+}
+
+void GLAPIENTRY receive(GLenum source, GLenum type, GLuint id, GLenum severity,
+                        GLsizei length, const GLchar* text, const void*) {
+  const std::string_view view =
+      length >= 0 ? std::string_view(text, length) : std::string_view(text);
+  std::lock_guard<std::mutex> lock(mutex);
+  ++stats.received;
+
+  // Drivers repeat the same message every frame; count it instead
+  for (Message& message : recent) {
+    if (message.id == id && message.source == source && message.type == type &&
+        message.severity == severity && message.text == view) {
+      ++message.count;
+      ++stats.repeated;
+      return;
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  if (now - windowStart >= std::chrono::seconds(1)) {
+    windowStart = now;
+    windowMessages = 0;
+  }
+  if (++windowMessages > kNewMessagesPerSecond) {
+    ++stats.dropped;
+    hasPending = true;
+    return;
+  }
+
+  Message message{source, type, severity, id, std::string(view), 1};
+  pending.push_back(message);
+  recent.push_back(std::move(message));
+  if (recent.size() > kRecentMessages) {
+    recent.pop_front();
+  }
+  hasPending = true;
+}
+}  // namespace
+
+bool enable(bool synchronous) {
+  if (!available()) {
+    std::cout << "[Info] Driver has no KHR_debug, OpenGL debug output disabled"
+              << std::endl;
+    return false;
+  }
+  glEnable(GL_DEBUG_OUTPUT);
+  if (synchronous) {
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  } else {
+    glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  }
+  glDebugMessageCallback(receive, nullptr);
+  // Notifications include every debug group push and pop
+  glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0,
+                        nullptr, GL_FALSE);
+  enabled = true;
+
+  GLint flags = 0;
+  glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+  std::cout << "[Info] OpenGL debug output enabled ("
+            << (synchronous ? "synchronous" : "asynchronous")
+            << ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) ? ", debug context" : ", no debug context")
+            << ")" << std::endl;
+  return true;
+}
+
+bool isEnabled() {
+  return enabled;
+}
+
+void label(GLenum identifier, GLuint name, std::string_view text) {
+  if (available()) {
+    glObjectLabel(identifier, name,
+                  std::min(static_cast<GLsizei>(text.size()), kMaxLabelLength), text.data());
+  }
+}
+
+void pushGroup(std::string_view name) {
+  if (available()) {
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0,
+                     std::min(static_cast<GLsizei>(name.size()), kMaxLabelLength),
+                     name.data());
+  }
+}
+
+void popGroup() {
+  if (available()) {
+    glPopDebugGroup();
+  }
+}
+
+void flush(std::ostream& out) {
+  if (!hasPending.exchange(false)) {
+    return;
+  }
+  std::vector<Message> messages;
+  uint64_t drops = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    messages.swap(pending);
+    drops = stats.dropped - reportedDrops;
+    reportedDrops = stats.dropped;
+  }
+  for (const Message& message : messages) {
+    out << (isError(message) ? "OpenGL Error: " : "Warning: OpenGL ") << describe(message)
+        << "\n";
+  }
+  if (drops > 0) {
+    out << "Warning: " << drops << " OpenGL messages over the rate limit were dropped\n";
+  }
+  out << std::flush;
+}
+
+std::vector<Message> getRecent() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::vector<Message>(recent.begin(), recent.end());
+}
+
+Stats getStats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+}
+
+std::string describe(const Message& message) {
+  std::string text = std::string(typeName(message.type)) + " (" +
+                     sourceName(message.source) + ", " + severityName(message.severity) +
+                     ") " + std::to_string(message.id) + ": " + message.text;
+  // Most drivers end their messages with a newline
+  while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+    text.pop_back();
+  }
+  if (message.count > 1) {
+    text += " (x" + std::to_string(message.count) + ")";
+  }
+  return text;
+}
+
+}  // namespace GLDebug
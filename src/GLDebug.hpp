@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// OpenGL diagnostics through KHR_debug. The driver reports errors and
+// warnings to a callback, on its own threads and without the application
+// ever waiting on glGetError. Repeats of a message are folded into the first
+// one and bursts of new messages are rate-limited, so a mistake in the frame
+// loop cannot flood the log; the most recent messages are kept in a ring.
+// Object labels and debug groups name resources and passes in debugger
+// captures and in the driver's messages; they work whenever the driver has
+// KHR_debug, with or without a debug context.
+namespace GLDebug {
+
+// A message reported by the driver
+struct Message {
+  GLenum source = 0;
+  GLenum type = 0;
+  GLenum severity = 0;
+  GLuint id = 0;
+  std::string text;
+  uint64_t count = 0;  // Occurrences, including folded repeats
+};
+
+// Message totals since enable()
+struct Stats {
+  uint64_t received = 0;  // All messages delivered to the callback
+  uint64_t repeated = 0;  // Folded into an earlier identical message
+  uint64_t dropped = 0;   // New messages over the rate limit
+};
+
+// Installs the callback if the driver has KHR_debug and returns whether it
+// did. Notifications are filtered out; `synchronous` delivers messages on
+// the calling thread, inside the offending call, which helps with a debugger
+// but stalls the pipeline.
+bool enable(bool synchronous = false);
+
+// Returns true once enable() succeeded
+bool isEnabled();
+
+// Names an object in messages and captures; `identifier` is GL_BUFFER,
+// GL_VERTEX_ARRAY, GL_PROGRAM, GL_FRAMEBUFFER, ... The object must have been
+// bound or created before.
+void label(GLenum identifier, GLuint name, std::string_view text);
+
+// Opens and closes a named region of commands. Prefer DebugGroup.
+void pushGroup(std::string_view name);
+void popGroup();
+
+// Prints the messages received since the last call; cheap when there are
+// none, so it can run every frame
+void flush(std::ostream& out);
+
+// Returns the most recent distinct messages, oldest first
+std::vector<Message> getRecent();
+
+// Returns the totals
+Stats getStats();
+
+// Formats a message as "error (api, high) 1282: text"
+std::string describe(const Message& message);
+
+}  // namespace GLDebug
+
+// Names the commands issued during its lifetime
+class DebugGroup {
+ public:
+  explicit DebugGroup(std::string_view name) { GLDebug::pushGroup(name); }
+  ~DebugGroup() { GLDebug::popGroup(); }
+
+  DebugGroup(const DebugGroup&) = delete;
+  DebugGroup& operator=(const DebugGroup&) = delete;
+};
@@ -0,0 +1,280 @@
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace GLState {
+
+namespace {
+// Never a valid name or enum, so it differs from anything set
+constexpr GLuint kUnknown = 0xFFFFFFFFu;
+constexpr GLuint kMaxTextureUnits = 32;
+
+constexpr std::array<GLenum, 6> kBufferTargets = {
+    GL_ARRAY_BUFFER,       GL_UNIFORM_BUFFER,    GL_PIXEL_PACK_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER};
+constexpr std::array<GLenum, 4> kTextureTargets = {
+    GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP};
+constexpr std::array<GLenum, 7> kCapabilities = {
+    GL_DEPTH_TEST,   GL_BLEND,          GL_CULL_FACE,          GL_SCISSOR_TEST,
+    GL_STENCIL_TEST, GL_PRIMITIVE_RESTART, GL_POLYGON_OFFSET_FILL};
+
+// A glBindBufferRange binding point
+struct Range {
+  GLuint buffer = kUnknown;
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+
+  bool operator==(const Range&) const = default;
+};
+
+struct Viewport {
+  GLint x = 0;
+  GLint y = 0;
+  GLsizei width = -1;
+  GLsizei height = -1;
+
+  bool operator==(const Viewport&) const = default;
+};
+
+// Everything defaults to unknown
+struct State {
+  GLuint program = kUnknown;
+  GLuint vertexArray = kUnknown;
+  GLuint elementBuffer = kUnknown;  // Of the bound vertex array
+  GLuint drawFramebuffer = kUnknown;
+  GLuint readFramebuffer = kUnknown;
+  std::array<GLuint, kBufferTargets.size()> buffers;
+  std::vector<Range> uniformRanges;  // Grown on demand
+  GLuint activeUnit = kUnknown;
+  std::array<std::array<GLuint, kTextureTargets.size()>, kMaxTextureUnits> textures;
+  std::array<int, kCapabilities.size()> enabled;  // -1 unknown, 0 or 1
+  GLenum depthFunc = kUnknown;
+  int depthMask = -1;
+  std::array<GLenum, 2> blendFunc = {kUnknown, kUnknown};
+  GLenum blendEquation = kUnknown;
+  GLuint restartIndex = kUnknown;
+  Viewport viewport;
+
+  State() {
+    buffers.fill(kUnknown);
+    for (auto& unit : textures) {
+      unit.fill(kUnknown);
+    }
+    enabled.fill(-1);
+  }
+};
+
+State state;
+Counters frame;
+Counters last;
+Counters total;
+
+// Counts a call as skipped if it is redundant, issued otherwise, and
+// returns `redundant`
+bool count(bool redundant) {
+  ++(redundant ? frame.skipped : frame.issued);
+  ++(redundant ? total.skipped : total.issued);
+  return redundant;
+}
+
+// Records `value` and returns true if it differs from `current`
+template <typename T>
+bool change(T& current, const T& value) {
+  if (count(current == value)) {
+    return false;
+  }
+  current = value;
+  return true;
+}
+
+template <typename Array>
+int indexOf(const Array& values, GLenum value) {
+  const auto found = std::find(values.begin(), values.end(), value);
+  return found == values.end() ? -1 : static_cast<int>(found - values.begin());
+}
+
+void forget(GLuint& binding, GLuint name) {
+  if (binding == name) {
+    binding = kUnknown;
+  }
+}
+}  // namespace
+
+void invalidate() {
+  state = State();
+}
+
+void useProgram(GLuint program) {
+  if (change(state.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void bindVertexArray(GLuint vertexArray) {
+  if (change(state.vertexArray, vertexArray)) {
+    glBindVertexArray(vertexArray);
+    state.elementBuffer = kUnknown;
+  }
+}
+
+void bindBuffer(GLenum target, GLuint buffer) {
+  if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    if (change(state.elementBuffer, buffer)) {
+      glBindBuffer(target, buffer);
+    }
+    return;
+  }
+  const int index = indexOf(kBufferTargets, target);
+  if (index < 0) {
+    count(false);
+    glBindBuffer(target, buffer);
+  } else if (change(state.buffers[index], buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset,
+                     GLsizeiptr size) {
+  if (target != GL_UNIFORM_BUFFER) {
+    count(false);
+    glBindBufferRange(target, index, buffer, offset, size);
+    return;
+  }
+  if (index >= state.uniformRanges.size()) {
+    state.uniformRanges.resize(index + 1);
+  }
+  if (change(state.uniformRanges[index], Range{buffer, offset, size})) {
+    glBindBufferRange(target, index, buffer, offset, size);
+    state.buffers[indexOf(kBufferTargets, target)] = buffer;
+  }
+}
+
+void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  if (change(state.activeUnit, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+  const int index = indexOf(kTextureTargets, target);
+  if (index < 0 || unit >= kMaxTextureUnits) {
+    count(false);
+    glBindTexture(target, texture);
+  } else if (change(state.textures[unit][index], texture)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void bindFramebuffer(GLenum target, GLuint framebuffer) {
+  // GL_FRAMEBUFFER sets both bindings with one call
+  const bool draw = target != GL_READ_FRAMEBUFFER;
+  const bool read = target != GL_DRAW_FRAMEBUFFER;
+  if (count((!draw || state.drawFramebuffer == framebuffer) &&
+            (!read || state.readFramebuffer == framebuffer))) {
+    return;
+  }
+  if (draw) {
+    state.drawFramebuffer = framebuffer;
+  }
+  if (read) {
+    state.readFramebuffer = framebuffer;
+  }
+  glBindFramebuffer(target, framebuffer);
+}
+
+void setEnabled(GLenum capability, bool enabled) {
+  const int index = indexOf(kCapabilities, capability);
+  if (index < 0) {
+    count(false);
+  } else if (!change(state.enabled[index], enabled ? 1 : 0)) {
+    return;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void depthFunc(GLenum func) {
+  if (change(state.depthFunc, func)) {
+    glDepthFunc(func);
+  }
+}
+
+void depthMask(bool write) {
+  if (change(state.depthMask, write ? 1 : 0)) {
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void blendFunc(GLenum source, GLenum destination) {
+  if (change(state.blendFunc, {source, destination})) {
+    glBlendFunc(source, destination);
+  }
+}
+
+void blendEquation(GLenum mode) {
+  if (change(state.blendEquation, mode)) {
+    glBlendEquation(mode);
+  }
+}
+
+void primitiveRestartIndex(GLuint index) {
+  if (change(state.restartIndex, index)) {
+    glPrimitiveRestartIndex(index);
+  }
+}
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (change(state.viewport, Viewport{x, y, width, height})) {
+    glViewport(x, y, width, height);
+  }
+}
+
+void forgetProgram(GLuint program) {
+  forget(state.program, program);
+}
+
+void forgetVertexArray(GLuint vertexArray) {
+  if (state.vertexArray == vertexArray) {
+    state.vertexArray = state.elementBuffer = kUnknown;
+  }
+}
+
+void forgetBuffer(GLuint buffer) {
+  forget(state.elementBuffer, buffer);
+  for (GLuint& binding : state.buffers) {
+    forget(binding, buffer);
+  }
+  for (Range& range : state.uniformRanges) {
+    forget(range.buffer, buffer);
+  }
+}
+
+void forgetTexture(GLuint texture) {
+  for (auto& unit : state.textures) {
+    for (GLuint& binding : unit) {
+      forget(binding, texture);
+    }
+  }
+}
+
+void forgetFramebuffer(GLuint framebuffer) {
+  forget(state.drawFramebuffer, framebuffer);
+  forget(state.readFramebuffer, framebuffer);
+}
+
+void endFrame() {
+  last = frame;
+  frame = Counters();
+}
+
+const Counters& getLastFrame() {
+  return last;
+}
+
+const Counters& getTotal() {
+  return total;
+}
+
+}  // namespace GLState
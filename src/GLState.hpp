@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+
+// Shadow copy of the context state the renderer changes most: the program,
+// vertex array, buffer, texture and framebuffer bindings, a few capabilities
+// and the depth, blend and restart settings. Calls that would set what is
+// already set are skipped. The shadow is only right while every change goes
+// through here, so code that changes this state directly must either
+// restore it (Dear ImGui's backend does) or call invalidate(). State starts
+// out unknown, so the first call for each binding is always issued.
+namespace GLState {
+
+// Calls issued to the driver and calls skipped as redundant
+struct Counters {
+  uint64_t issued = 0;
+  uint64_t skipped = 0;
+};
+
+// Forgets everything, so the next call of every kind is issued
+void invalidate();
+
+// glUseProgram
+void useProgram(GLuint program);
+
+// glBindVertexArray; the element buffer binding follows the vertex array
+void bindVertexArray(GLuint vertexArray);
+
+// glBindBuffer. Binding an element buffer changes the bound vertex array.
+void bindBuffer(GLenum target, GLuint buffer);
+
+// glBindBufferRange, which also binds the buffer to `target`
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset,
+                     GLsizeiptr size);
+
+// glActiveTexture and glBindTexture
+void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+// glBindFramebuffer; GL_FRAMEBUFFER binds both draw and read
+void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+// glEnable or glDisable
+void setEnabled(GLenum capability, bool enabled);
+
+// glDepthFunc
+void depthFunc(GLenum func);
+
+// glDepthMask
+void depthMask(bool write);
+
+// glBlendFunc
+void blendFunc(GLenum source, GLenum destination);
+
+// glBlendEquation
+void blendEquation(GLenum mode);
+
+// glPrimitiveRestartIndex
+void primitiveRestartIndex(GLuint index);
+
+// glViewport
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// Call after deleting objects: deletion unbinds them, and a later object
+// may reuse the name
+void forgetProgram(GLuint program);
+void forgetVertexArray(GLuint vertexArray);
+void forgetBuffer(GLuint buffer);
+void forgetTexture(GLuint texture);
+void forgetFramebuffer(GLuint framebuffer);
+
+// Call once per frame: makes the counts so far the last frame's and starts
+// counting again
+void endFrame();
+
+// Returns the counts of the last completed frame
+const Counters& getLastFrame();
+
+// Returns the counts since start-up
+const Counters& getTotal();
+
+}  // namespace GLState
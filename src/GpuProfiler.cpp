@@ -0,0 +1,68 @@
+#include "GpuProfiler.hpp"
+
+#include <cstddef>
+#include <utility>
+
+GpuProfiler::GpuProfiler() {
+  // GL_TIME_ELAPSED is core in 3.3 and available on 3.2 via ARB_timer_query
+  supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+GpuProfiler::~GpuProfiler() {
+  if (!allQueries.empty()) {
+    glDeleteQueries(static_cast<GLsizei>(allQueries.size()), allQueries.data());
+  }
+}
+
+void GpuProfiler::beginFrame() {
+  if (!supported) {
+    return;
+  }
+
+  // The slot of the new frame holds the queries from kLatency frames ago
+  ++frame;
+  std::vector<Pending>& slot = frames[frame % kLatency];
+  late.insert(late.end(), slot.begin(), slot.end());
+  slot.clear();
+
+  // Results arrive in submission order, so stop at the first pending one
+  size_t done = 0;
+  for (; done < late.size(); ++done) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(late[done].query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(late[done].query, GL_QUERY_RESULT, &elapsed);
+    Profiler::recordGpuEvent(late[done].name, late[done].cpuStart, elapsed);
+    freeQueries.push_back(late[done].query);
+  }
+  late.erase(late.begin(), late.begin() + static_cast<ptrdiff_t>(done));
+}
+
+GpuProfiler::Scope::Scope(GpuProfiler& owner, const char* name) : profiler(nullptr) {
+  if (!owner.supported || owner.active) {
+    return;
+  }
+  GLuint query;
+  if (owner.freeQueries.empty()) {
+    glGenQueries(1, &query);
+    owner.allQueries.push_back(query);
+  } else {
+    query = owner.freeQueries.back();
+    owner.freeQueries.pop_back();
+  }
+  owner.frames[owner.frame % kLatency].push_back(
+      Pending{name, Profiler::now(), query});
+  owner.active = true;
+  profiler = &owner;
+  glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+GpuProfiler::Scope::~Scope() {
+  if (profiler) {
+    glEndQuery(GL_TIME_ELAPSED);
+    profiler->active = false;
+  }
+}
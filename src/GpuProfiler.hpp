@@ -0,0 +1,71 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.hpp"
+
+// Measures GPU time of render passes with GL_TIME_ELAPSED queries and feeds
+// the results to Profiler::recordGpuEvent(). Queries are read back
+// kLatency frames after they were issued, and only once their result is
+// available, so measuring never stalls the pipeline. GL_TIME_ELAPSED queries
+// cannot nest: a scope opened inside another one is not measured.
+class GpuProfiler {
+ public:
+  // Frames between issuing a query and reading it back
+  static constexpr int kLatency = 4;
+
+  // Detects timer query support; requires a current context
+  GpuProfiler();
+
+  // Deletes the query objects
+  ~GpuProfiler();
+
+  GpuProfiler(const GpuProfiler&) = delete;
+  GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+  // Returns false if the context has no timer queries
+  bool isSupported() const { return supported; }
+
+  // Collects the results that became available and starts a new frame
+  void beginFrame();
+
+  // Times the GPU work submitted during its lifetime
+  class Scope {
+   public:
+    Scope(GpuProfiler& profiler, const char* name);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    GpuProfiler* profiler;  // Null if this scope is not measured
+  };
+
+ private:
+  // A query waiting for its result
+  struct Pending {
+    const char* name;   // Scope name
+    uint64_t cpuStart;  // Profiler::now() when the query began
+    GLuint query;       // Query object
+  };
+
+  bool supported = false;                 // Timer queries are available
+  bool active = false;                    // A query is running
+  int frame = 0;                          // Frames started so far
+  std::vector<Pending> frames[kLatency];  // Queries issued per frame slot
+  std::vector<Pending> late;              // Read back but not yet available
+  std::vector<GLuint> freeQueries;        // Query objects ready for reuse
+  std::vector<GLuint> allQueries;         // Every query object created
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_GPU_SCOPE(profiler, name) \
+  GpuProfiler::Scope PROFILE_CONCAT(profileGpuScope, __LINE__)(profiler, name)
+#define PROFILE_GPU_FRAME(profiler) (profiler).beginFrame()
+#else
+#define PROFILE_GPU_SCOPE(profiler, name) ((void)0)
+#define PROFILE_GPU_FRAME(profiler) ((void)0)
+#endif
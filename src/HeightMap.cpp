@@ -0,0 +1,156 @@
+#include "HeightMap.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "Profiler.hpp"
+#include "SimdMath.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+// Rounds n up to a whole number of SIMD lanes
+size_t padToWidth(size_t n) {
+  return (n + simd::kWidth - 1) / simd::kWidth * simd::kWidth;
+}
+
+// Per-column values shared by every row of a region
+struct ColumnTable {
+  int columns = 0;           // Number of valid columns
+  std::vector<float> coord;  // Grid x coordinate
+  std::vector<float> sin;    // sin(frequency * x)
+  std::vector<float> cos;    // cos(frequency * x)
+};
+
+ColumnTable buildColumnTable(const HeightMapParams& params,
+                             int firstColumn,
+                             int columns) {
+  size_t padded = padToWidth(static_cast<size_t>(columns));
+
+  ColumnTable table;
+  table.columns = columns;
+  table.coord.resize(padded, 0.0f);
+  table.sin.resize(padded);
+  table.cos.resize(padded);
+  for (int x = 0; x < columns; ++x) {
+    table.coord[x] = (firstColumn + x - params.size / 2) * params.spacing;
+  }
+  const simd::Float frequency = simd::set1(params.frequency);
+  for (size_t x = 0; x < padded; x += simd::kWidth) {
+    simd::Float s, c;
+    simd::sincos(simd::mul(frequency, simd::load(&table.coord[x])), s, c);
+    simd::store(&table.sin[x], s);
+    simd::store(&table.cos[x], c);
+  }
+  return table;
+}
+
+// Evaluates grid rows [firstRow, lastRow) for the table's columns into `out`,
+// one tightly packed row of table.columns vertices after another
+void generateRows(const HeightMapParams& params,
+                  const ColumnTable& table,
+                  int firstRow,
+                  int lastRow,
+                  VertexType* out) {
+  const int columns = table.columns;
+  const size_t padded = table.coord.size();
+
+  // Structure-of-arrays scratch for one row, converted to VertexType at the end
+  std::vector<float> scratch(padded * 5);
+  float* height = scratch.data();
+  float* normalX = height + padded;
+  float* normalY = normalX + padded;
+  float* normalZ = normalY + padded;
+  float* shade = normalZ + padded;
+
+  const simd::Float scale = simd::set1(params.heightScale);
+  const simd::Float slope = simd::set1(params.heightScale * params.frequency);
+  const simd::Float one = simd::set1(1.0f);
+  const simd::Float half = simd::set1(0.5f);
+  const simd::Float five = simd::set1(5.0f);
+
+  for (int y = firstRow; y < lastRow; ++y) {
+    const float yy = (y - params.size / 2) * params.spacing;
+    const simd::Float sinY = simd::set1(std::sin(params.frequency * yy));
+    const simd::Float cosY = simd::set1(std::cos(params.frequency * yy));
+
+    for (size_t x = 0; x < padded; x += simd::kWidth) {
+      simd::Float sinX = simd::load(&table.sin[x]);
+      simd::Float cosX = simd::load(&table.cos[x]);
+
+      // h = A sin(fx) sin(fy) and its partial derivatives
+      simd::Float h = simd::mul(scale, simd::mul(sinX, sinY));
+      simd::Float hx = simd::mul(slope, simd::mul(cosX, sinY));
+      simd::Float hy = simd::mul(slope, simd::mul(sinX, cosY));
+
+      // normal = normalize(-hx, -hy, 1)
+      simd::Float lengthSq =
+          simd::add(simd::add(simd::mul(hx, hx), simd::mul(hy, hy)), one);
+      simd::Float invLength = simd::div(one, simd::sqrt(lengthSq));
+      simd::Float zero = simd::set1(0.0f);
+      simd::store(&height[x], h);
+      simd::store(&normalX[x], simd::mul(simd::sub(zero, hx), invLength));
+      simd::store(&normalY[x], simd::mul(simd::sub(zero, hy), invLength));
+      simd::store(&normalZ[x], invLength);
+
+      // Color based on height for visual variation
+      simd::Float c = simd::sin(simd::mul(h, five));
+      simd::store(&shade[x], simd::add(simd::mul(c, half), half));
+    }
+
+    VertexType* row = out + static_cast<size_t>(y - firstRow) * columns;
+    for (int x = 0; x < columns; ++x) {
+      row[x].position = glm::vec3(table.coord[x], yy, height[x]);
+      row[x].normal = glm::vec3(normalX[x], normalY[x], normalZ[x]);
+      row[x].color = glm::vec4(shade[x], 1.0f - shade[x], 0.5f, 1.0f);
+    }
+  }
+}
+}  // namespace
+
+// Computes height for a given 2D position using a sine-based function
+float heightMap(const glm::vec2& position, const HeightMapParams& params) {
+  return params.heightScale * std::sin(params.frequency * position.x) *
+         std::sin(params.frequency * position.y);
+}
+
+// Generates a vertex for the heightmap at the given 2D position
+VertexType getHeightMap(const glm::vec2& position, const HeightMapParams& params) {
+  const glm::vec2 dx(0.01f, 0.0f);  // Small offset for x-derivative
+  const glm::vec2 dy(0.0f, 0.01f);  // Small offset for y-derivative
+
+  VertexType vertex;
+  float h = heightMap(position, params);
+  // Approximate partial derivatives for normal calculation
+  float hx = 100.0f * (heightMap(position + dx, params) - h);
+  float hy = 100.0f * (heightMap(position + dy, params) - h);
+
+  vertex.position = glm::vec3(position, h);
+  vertex.normal = glm::normalize(glm::vec3(-hx, -hy, 1.0f));
+  // Color based on height for visual variation
+  float c = std::sin(h * 5.0f) * 0.5f + 0.5f;
+  vertex.color = glm::vec4(c, 1.0f - c, 0.5f, 1.0f);
+
+  return vertex;
+}
+
+void generateHeightMap(const HeightMapParams& params, VertexType* out) {
+  PROFILE_FUNCTION();
+  const int columns = params.verticesPerSide();
+  const ColumnTable table = buildColumnTable(params, 0, columns);
+
+  // Bands of at least 16 rows keep the per-band scratch setup negligible
+  ThreadPool::shared().parallelFor(
+      static_cast<size_t>(columns),
+      [&](size_t begin, size_t end) {
+        generateRows(params, table, static_cast<int>(begin),
+                     static_cast<int>(end), out + begin * columns);
+      },
+      16);
+}
+
+void generateHeightMapRegion(const HeightMapParams& params,
+                             const HeightMapRegion& region,
+                             VertexType* out) {
+  const ColumnTable table = buildColumnTable(params, region.x, region.width);
+  generateRows(params, table, region.y, region.y + region.height, out);
+}
@@ -0,0 +1,13 @@
+#include "HeightSource.hpp"
+
+#include <cmath>
+
+glm::vec2 AnalyticHeightSource::getHeightRange() const {
+  const float amplitude = std::abs(params.heightScale);
+  return glm::vec2(-amplitude, amplitude);
+}
+
+void AnalyticHeightSource::generateRegion(const HeightMapRegion& region,
+                                          VertexType* out) const {
+  generateHeightMapRegion(params, region, out);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "HeightMap.hpp"
+
+// Region of a HeightSource wanted soon, for HeightSource::prefetch()
+struct HeightRequest {
+  HeightMapRegion region;
+  float distance = 0.0f;  // From the camera; nearer requests load first
+};
+
+// Surface sampled on a regular grid of (size.x + 1) x (size.y + 1) vertices,
+// where vertex (x, y) lies at ((x - size.x / 2) * spacing,
+// (y - size.y / 2) * spacing) as in HeightMapParams. Terrain generates its
+// chunks from a source, so the analytic surface and elevation data read from
+// disk are interchangeable.
+//
+// Sources that read data from elsewhere may not have every region at hand:
+// isResident() tells whether generating one would block, and prefetch()
+// starts loading regions ahead of their use. Sources must allow concurrent
+// calls of the const members.
+class HeightSource {
+ public:
+  virtual ~HeightSource() = default;
+
+  // Returns the number of quads along x and along y
+  virtual glm::ivec2 getSize() const = 0;
+
+  // Returns the distance between neighbouring vertices
+  virtual float getSpacing() const = 0;
+
+  // Returns the lowest and highest height of the surface, which bound regions
+  // that have not been generated yet
+  virtual glm::vec2 getHeightRange() const = 0;
+
+  // Returns true if generateRegion() would not have to wait for data
+  virtual bool isResident(const HeightMapRegion&) const { return true; }
+
+  // Replaces earlier prefetches: loads what `requests` need in the
+  // background, nearest first
+  virtual void prefetch(const std::vector<HeightRequest>&) {}
+
+  // Fills `out` (region.width * region.height vertices, row-major) with the
+  // vertices of `region`, waiting for data that is not resident
+  virtual void generateRegion(const HeightMapRegion& region, VertexType* out) const = 0;
+};
+
+// The analytic heightMap() surface: getHeightMap() evaluated over the grid of
+// HeightMapParams by the SIMD kernels of generateHeightMapRegion(). Always
+// resident.
+class AnalyticHeightSource : public HeightSource {
+ public:
+  explicit AnalyticHeightSource(const HeightMapParams& params) : params(params) {}
+
+  // Returns the grid and surface parameters
+  const HeightMapParams& getParams() const { return params; }
+
+  glm::ivec2 getSize() const override { return glm::ivec2(params.size); }
+  float getSpacing() const override { return params.spacing; }
+  glm::vec2 getHeightRange() const override;
+  void generateRegion(const HeightMapRegion& region, VertexType* out) const override;
+
+ private:
+  HeightMapParams params;
+};
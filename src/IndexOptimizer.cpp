@@ -0,0 +1,273 @@
+#include "IndexOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace IndexOptimizer {
+
+namespace {
+// Forsyth scoring constants
+constexpr int kCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // The most recent triangle's vertices get a fixed score so the
+      // algorithm does not favour re-using just those
+      score = kLastTriangleScore;
+    } else {
+      float scaler = 1.0f / (kCacheSize - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+    }
+  }
+  // Favour vertices with few triangles left so they are finished early
+  score += kValenceBoostScale *
+           std::pow(static_cast<float>(remainingTriangles), -kValenceBoostPower);
+  return score;
+}
+
+// Counts FIFO cache misses for the vertices of `indices`, skipping restarts
+size_t countMisses(const uint32_t* indices,
+                   size_t count,
+                   uint32_t vertexCount,
+                   unsigned cacheSize) {
+  // A vertex is cached while fewer than cacheSize misses happened since it
+  // was inserted
+  std::vector<size_t> insertedAt(vertexCount, 0);
+  std::vector<bool> seen(vertexCount, false);
+  size_t misses = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t v = indices[i];
+    if (v == kRestartIndex) {
+      continue;
+    }
+    if (!seen[v] || misses - insertedAt[v] >= cacheSize) {
+      seen[v] = true;
+      insertedAt[v] = misses;
+      ++misses;
+    }
+  }
+  return misses;
+}
+
+// Returns true if triangle t contains the directed edge a -> b, and stores
+// its remaining vertex in `third`
+bool hasEdge(const uint32_t* t, uint32_t a, uint32_t b, uint32_t& third) {
+  for (int r = 0; r < 3; ++r) {
+    if (t[r] == a && t[(r + 1) % 3] == b) {
+      third = t[(r + 2) % 3];
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Vertex -> triangle adjacency in compressed rows
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (uint32_t v : indices) {
+    ++remaining[v];
+  }
+  std::vector<uint32_t> offset(vertexCount + 1, 0);
+  for (uint32_t v = 0; v < vertexCount; ++v) {
+    offset[v + 1] = offset[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+      }
+    }
+  }
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> score(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; ++v) {
+    score[v] = vertexScore(-1, remaining[v]);
+  }
+  auto triangleScore = [&](size_t t) {
+    return score[indices[t * 3]] + score[indices[t * 3 + 1]] +
+           score[indices[t * 3 + 2]];
+  };
+  std::vector<bool> emitted(triangleCount, false);
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> nextCache;
+  cache.reserve(kCacheSize + 3);
+  nextCache.reserve(kCacheSize + 3);
+
+  // Start with the best triangle overall
+  size_t best = 0;
+  for (size_t t = 1; t < triangleCount; ++t) {
+    if (triangleScore(t) > triangleScore(best)) {
+      best = t;
+    }
+  }
+  size_t scanCursor = 0;
+
+  for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+    if (best == SIZE_MAX) {
+      // Nothing adjacent to the cache: continue with the next unused triangle
+      while (emitted[scanCursor]) {
+        ++scanCursor;
+      }
+      best = scanCursor;
+    }
+
+    emitted[best] = true;
+    const uint32_t* tri = &indices[best * 3];
+    output.insert(output.end(), tri, tri + 3);
+
+    // Remove the triangle from its vertices' adjacency
+    for (int k = 0; k < 3; ++k) {
+      uint32_t v = tri[k];
+      uint32_t* begin = &adjacency[offset[v]];
+      uint32_t* end = begin + remaining[v];
+      std::remove(begin, end, static_cast<uint32_t>(best));
+      --remaining[v];
+    }
+
+    // Move the triangle's vertices to the front of the LRU cache
+    nextCache.assign(tri, tri + 3);
+    for (uint32_t v : cache) {
+      if (v != tri[0] && v != tri[1] && v != tri[2]) {
+        nextCache.push_back(v);
+      }
+    }
+    std::swap(cache, nextCache);
+
+    // Rescore every vertex that was or still is in the cache
+    for (size_t i = 0; i < cache.size(); ++i) {
+      uint32_t v = cache[i];
+      cachePosition[v] = i < static_cast<size_t>(kCacheSize) ? static_cast<int>(i) : -1;
+      score[v] = vertexScore(cachePosition[v], remaining[v]);
+    }
+    if (cache.size() > static_cast<size_t>(kCacheSize)) {
+      cache.resize(kCacheSize);
+    }
+
+    // Pick the best triangle touching the cache
+    best = SIZE_MAX;
+    float bestScore = -1.0f;
+    for (uint32_t v : cache) {
+      for (uint32_t i = 0; i < remaining[v]; ++i) {
+        uint32_t t = adjacency[offset[v] + i];
+        float s = triangleScore(t);
+        if (s > bestScore) {
+          bestScore = s;
+          best = t;
+        }
+      }
+    }
+  }
+
+  indices.swap(output);
+}
+
+std::vector<uint32_t> buildTriangleStrips(const uint32_t* indices, size_t count) {
+  std::vector<uint32_t> strips;
+  strips.reserve(count);
+  const size_t triangleCount = count / 3;
+
+  size_t t = 0;
+  while (t < triangleCount) {
+    const uint32_t* first = &indices[t * 3];
+
+    // Rotate the first triangle so that the next one can continue the strip
+    int rotation = 0;
+    if (t + 1 < triangleCount) {
+      for (int r = 0; r < 3; ++r) {
+        uint32_t third;
+        if (hasEdge(&indices[(t + 1) * 3], first[(r + 2) % 3], first[(r + 1) % 3],
+                    third)) {
+          rotation = r;
+          break;
+        }
+      }
+    }
+    if (!strips.empty()) {
+      strips.push_back(kRestartIndex);
+    }
+    for (int k = 0; k < 3; ++k) {
+      strips.push_back(first[(rotation + k) % 3]);
+    }
+    ++t;
+
+    // Triangle n of a strip is (v[n], v[n+1], v[n+2]) for even n and
+    // (v[n+1], v[n], v[n+2]) for odd n
+    size_t length = 1;
+    while (t < triangleCount) {
+      uint32_t a = strips[strips.size() - 2];
+      uint32_t b = strips[strips.size() - 1];
+      uint32_t third;
+      bool joined = (length % 2 == 0) ? hasEdge(&indices[t * 3], a, b, third)
+                                      : hasEdge(&indices[t * 3], b, a, third);
+      if (!joined) {
+        break;
+      }
+      strips.push_back(third);
+      ++length;
+      ++t;
+    }
+  }
+  return strips;
+}
+
+size_t countStripTriangles(const uint32_t* indices, size_t count) {
+  size_t triangles = 0;
+  size_t run = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (indices[i] == kRestartIndex) {
+      run = 0;
+      continue;
+    }
+    if (++run >= 3) {
+      ++triangles;
+    }
+  }
+  return triangles;
+}
+
+double computeAcmr(const uint32_t* indices,
+                   size_t count,
+                   uint32_t vertexCount,
+                   unsigned cacheSize) {
+  size_t triangles = count / 3;
+  if (triangles == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(countMisses(indices, count, vertexCount, cacheSize)) /
+         triangles;
+}
+
+double computeStripAcmr(const uint32_t* indices,
+                        size_t count,
+                        uint32_t vertexCount,
+                        unsigned cacheSize) {
+  size_t triangles = countStripTriangles(indices, count);
+  if (triangles == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(countMisses(indices, count, vertexCount, cacheSize)) /
+         triangles;
+}
+
+}  // namespace IndexOptimizer
@@ -0,0 +1,204 @@
+#include "InstanceRenderer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "TerrainRenderer.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+constexpr size_t kInitialInstances = 4096;
+
+// Packs a colour into RGBA8, red in the lowest byte
+uint32_t packColor(const glm::vec4& color) {
+  uint32_t packed = 0;
+  for (int i = 0; i < 4; ++i) {
+    const float channel = std::clamp(color[i], 0.0f, 1.0f);
+    packed |= static_cast<uint32_t>(channel * 255.0f + 0.5f) << (8 * i);
+  }
+  return packed;
+}
+
+// glVertexAttribDivisor is core in 3.3, the context asks for 3.2
+void setDivisor(GLuint location, GLuint divisor) {
+  if (GLEW_VERSION_3_3) {
+    glVertexAttribDivisor(location, divisor);
+  } else {
+    glVertexAttribDivisorARB(location, divisor);
+  }
+}
+
+void* byteOffset(size_t offset) {
+  return reinterpret_cast<void*>(static_cast<uintptr_t>(offset));
+}
+}  // namespace
+
+InstanceRenderer::InstanceRenderer()
+    : instanceBuffer(GL_ARRAY_BUFFER, kInitialInstances * sizeof(Instance), "Instances") {}
+
+InstanceRenderer::~InstanceRenderer() {
+  for (Mesh& mesh : meshes) {
+    if (mesh.vao == 0) {
+      continue;
+    }
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteBuffers(1, &mesh.ibo);
+    GLState::forgetVertexArray(mesh.vao);
+    GLState::forgetBuffer(mesh.vbo);
+    GLState::forgetBuffer(mesh.ibo);
+  }
+}
+
+bool InstanceRenderer::isSupported() {
+  return GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays;
+}
+
+void InstanceRenderer::addMesh(uint32_t type, const PrimitiveMesh& primitive,
+                               const glm::vec4& color) {
+  if (type >= meshes.size()) {
+    meshes.resize(type + 1);
+  }
+  Mesh& mesh = meshes[type];
+  if (mesh.vao == 0) {
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ibo);
+    const std::string name = "Mesh " + std::to_string(type);
+    GLDebug::label(GL_VERTEX_ARRAY, mesh.vao, name + " VAO");
+    GLDebug::label(GL_BUFFER, mesh.vbo, name + " vertices");
+    GLDebug::label(GL_BUFFER, mesh.ibo, name + " indices");
+  }
+  mesh.indexCount = static_cast<GLsizei>(primitive.indices.size());
+  mesh.color = packColor(color);
+
+  GLState::bindVertexArray(mesh.vao);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+  glBufferData(GL_ARRAY_BUFFER, primitive.vertices.size() * sizeof(VertexType),
+               primitive.vertices.data(), GL_STATIC_DRAW);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, primitive.indices.size() * sizeof(uint16_t),
+               primitive.indices.data(), GL_STATIC_DRAW);
+
+  // Per-vertex attributes; the colour comes from the instance instead
+  using namespace TerrainAttributes;
+  glEnableVertexAttribArray(kPosition);
+  glVertexAttribPointer(kPosition, 3, GL_FLOAT, GL_FALSE, sizeof(VertexType),
+                        byteOffset(offsetof(VertexType, position)));
+  glEnableVertexAttribArray(kNormal);
+  glVertexAttribPointer(kNormal, 3, GL_FLOAT, GL_FALSE, sizeof(VertexType),
+                        byteOffset(offsetof(VertexType, normal)));
+
+  // Per-instance attributes, pointed at this frame's data before each draw
+  for (GLuint location = kInstanceModel; location < kInstanceModel + 4; ++location) {
+    glEnableVertexAttribArray(location);
+    setDivisor(location, 1);
+  }
+  glEnableVertexAttribArray(kColor);
+  setDivisor(kColor, 1);
+  GLState::bindVertexArray(0);
+}
+
+void InstanceRenderer::setInstanceAttributes(GLintptr offset) {
+  using namespace TerrainAttributes;
+  GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer.getBuffer());
+  for (GLuint column = 0; column < 4; ++column) {
+    glVertexAttribPointer(kInstanceModel + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          byteOffset(offset + offsetof(Instance, model) +
+                                     column * sizeof(glm::vec4)));
+  }
+  glVertexAttribPointer(kColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+                        byteOffset(offset + offsetof(Instance, color)));
+}
+
+const InstanceRenderer::Stats& InstanceRenderer::draw(const EntityStore& store,
+                                                      const Frustum& frustum,
+                                                      ThreadPool& pool) {
+  PROFILE_FUNCTION();
+  stats = Stats();
+  const size_t count = store.size();
+  if (count == 0 || meshes.empty()) {
+    return stats;
+  }
+  const std::vector<uint32_t>& types = store.getTypes();
+  const std::vector<glm::mat4>& matrices = store.getWorldMatrices();
+  const std::vector<AABB>& bounds = store.getWorldBounds();
+
+  // Cull, keeping the type of each visible entity
+  slots.resize(count);
+  {
+    PROFILE_SCOPE("Instance culling");
+    pool.parallelFor(
+        count,
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const uint32_t type = types[i];
+            const bool drawable = type < meshes.size() && meshes[type].vao != 0;
+            slots[i] = drawable && frustum.intersects(bounds[i]) ? type : kCulled;
+          }
+        },
+        kGrain);
+  }
+
+  // Counting sort by type: turn the types into instance indices
+  firsts.assign(meshes.size() + 1, 0);
+  for (uint32_t slot : slots) {
+    if (slot != kCulled) {
+      ++firsts[slot + 1];
+    }
+  }
+  for (size_t type = 1; type < firsts.size(); ++type) {
+    firsts[type] += firsts[type - 1];
+  }
+  stats.instances = firsts.back();
+  stats.culled = count - stats.instances;
+  if (stats.instances == 0) {
+    return stats;
+  }
+  {
+    std::vector<size_t> next(firsts.begin(), firsts.end() - 1);
+    for (uint32_t& slot : slots) {
+      if (slot != kCulled) {
+        slot = static_cast<uint32_t>(next[slot]++);
+      }
+    }
+  }
+
+  // Write the instances straight into the mapped buffer
+  Instance* instances = reinterpret_cast<Instance*>(
+      instanceBuffer.beginFrame(stats.instances * sizeof(Instance)));
+  {
+    PROFILE_SCOPE("Instance upload");
+    pool.parallelFor(
+        count,
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            if (slots[i] != kCulled) {
+              instances[slots[i]] = Instance{matrices[i], meshes[types[i]].color};
+            }
+          }
+        },
+        kGrain);
+  }
+  instanceBuffer.flush();
+
+  const GLintptr base = instanceBuffer.getOffset();
+  for (size_t type = 0; type < meshes.size(); ++type) {
+    const size_t instanceCount = firsts[type + 1] - firsts[type];
+    if (instanceCount == 0) {
+      continue;
+    }
+    const Mesh& mesh = meshes[type];
+    GLState::bindVertexArray(mesh.vao);
+    setInstanceAttributes(base + static_cast<GLintptr>(firsts[type] * sizeof(Instance)));
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, nullptr,
+                            static_cast<GLsizei>(instanceCount));
+    ++stats.drawCalls;
+  }
+  instanceBuffer.endFrame();
+  return stats;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "EntityStore.hpp"
+#include "Frustum.hpp"
+#include "Primitives.hpp"
+#include "StreamBuffer.hpp"
+
+class ThreadPool;
+
+// Draws the entities of an EntityStore with one glDrawElementsInstanced call
+// per mesh. Every frame the entities are culled against the view frustum,
+// counted per type, and the model matrix and colour of each visible one are
+// written in parallel, grouped by type, into a StreamBuffer that the mesh
+// vertex arrays read with an attribute divisor of one. The CPU cost is then a
+// copy per visible entity rather than a uniform update and draw call each.
+class InstanceRenderer {
+ public:
+  // Measurements of the last draw()
+  struct Stats {
+    size_t drawCalls = 0;  // One per mesh with visible instances
+    size_t instances = 0;  // Entities drawn
+    size_t culled = 0;     // Entities outside the frustum or without a mesh
+  };
+
+  // Creates the instance buffer; requires a current context
+  InstanceRenderer();
+
+  // Releases the meshes
+  ~InstanceRenderer();
+
+  InstanceRenderer(const InstanceRenderer&) = delete;
+  InstanceRenderer& operator=(const InstanceRenderer&) = delete;
+
+  // Returns true if the context can draw instances with per-instance
+  // attributes (OpenGL 3.3 or ARB_instanced_arrays)
+  static bool isSupported();
+
+  // Uploads the mesh drawn for entities of `type`, in `color`
+  void addMesh(uint32_t type, const PrimitiveMesh& mesh, const glm::vec4& color);
+
+  // Draws the store's visible entities whose type has a mesh. The INSTANCED
+  // permutation of the terrain program must be in use.
+  const Stats& draw(const EntityStore& store, const Frustum& frustum, ThreadPool& pool);
+
+  // Returns the measurements of the last draw()
+  const Stats& getStats() const { return stats; }
+
+ private:
+  static constexpr uint32_t kCulled = 0xFFFFFFFFu;
+  static constexpr size_t kGrain = 2048;  // Entities per parallel task
+
+  // Per-instance attributes
+  struct Instance {
+    glm::mat4 model;
+    uint32_t color;  // RGBA8
+  };
+
+  // Buffers of one uploaded mesh
+  struct Mesh {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    GLsizei indexCount = 0;
+    uint32_t color = 0;  // RGBA8
+  };
+
+  // Points the instance attributes of the bound mesh at the instances
+  // starting at byte `offset` of the instance buffer
+  void setInstanceAttributes(GLintptr offset);
+
+  std::vector<Mesh> meshes;       // Indexed by entity type; vao 0 if none
+  StreamBuffer instanceBuffer;
+  std::vector<uint32_t> slots;    // Instance index of each entity, or kCulled
+  std::vector<size_t> firsts;     // First instance of each type
+  Stats stats;
+};
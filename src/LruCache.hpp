@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Values under keys in least recently used order. The cache does not decide
+// when to evict: owners with a byte budget pop the oldest entries until they
+// fit, and can look at an entry before evicting it, e.g. to keep what the
+// current frame still uses.
+template <typename Key, typename Value>
+class LruCache {
+ public:
+  using Entry = std::pair<const Key, Value>;
+
+  // Returns the value under `key` and makes it the most recent, or nullptr
+  Value* find(const Key& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+      return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->second;
+  }
+
+  // Returns the value under `key` without changing the order, or nullptr
+  const Value* peek(const Key& key) const {
+    auto it = index.find(key);
+    return it == index.end() ? nullptr : &it->second->second;
+  }
+
+  // Adds or replaces the value under `key` as the most recent
+  Value& insert(const Key& key, Value value) {
+    if (Value* existing = find(key)) {
+      *existing = std::move(value);
+      return *existing;
+    }
+    entries.emplace_front(key, std::move(value));
+    index.emplace(key, entries.begin());
+    return entries.front().second;
+  }
+
+  // Removes the value under `key`, if any
+  void erase(const Key& key) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+      entries.erase(it->second);
+      index.erase(it);
+    }
+  }
+
+  // Returns the least recently used entry; the cache must not be empty
+  Entry& oldest() { return entries.back(); }
+
+  // Removes the least recently used entry and returns its value
+  Value popOldest() {
+    Value value = std::move(entries.back().second);
+    index.erase(entries.back().first);
+    entries.pop_back();
+    return value;
+  }
+
+  // Removes every entry
+  void clear() {
+    index.clear();
+    entries.clear();
+  }
+
+  // Returns the number of entries
+  size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+ private:
+  std::list<Entry> entries;  // Most recent first
+  std::unordered_map<Key, typename std::list<Entry>::iterator> index;
+};
@@ -0,0 +1,102 @@
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) : path(path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  LARGE_INTEGER fileSize{};
+  GetFileSizeEx(file, &fileSize);
+  length = static_cast<size_t>(fileSize.QuadPart);
+  fileHandle = file;
+  if (length == 0) {
+    return;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    throw std::runtime_error("Cannot map " + path);
+  }
+  mappingHandle = mapping;
+  bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!bytes) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    throw std::runtime_error("Cannot map " + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (bytes) {
+    UnmapViewOfFile(bytes);
+  }
+  if (mappingHandle) {
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+  }
+  if (fileHandle) {
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+  }
+}
+
+void MappedFile::willNeed(size_t, size_t) const {}
+#else
+MappedFile::MappedFile(const std::string& path) : path(path) {
+  const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (descriptor < 0) {
+    throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+  }
+  struct stat status {};
+  if (fstat(descriptor, &status) != 0) {
+    const int error = errno;
+    close(descriptor);
+    throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(error));
+  }
+  length = static_cast<size_t>(status.st_size);
+  if (length > 0) {
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      close(descriptor);
+      throw std::runtime_error("Cannot map " + path + ": " + std::strerror(error));
+    }
+    bytes = static_cast<const uint8_t*>(mapping);
+  }
+  // The mapping keeps the file alive
+  close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+  if (bytes) {
+    munmap(const_cast<uint8_t*>(bytes), length);
+  }
+}
+
+void MappedFile::willNeed(size_t offset, size_t size) const {
+  if (!bytes || offset >= length) {
+    return;
+  }
+  // madvise wants a page-aligned start
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t begin = offset / page * page;
+  const size_t end = std::min(length, offset + size);
+  madvise(const_cast<uint8_t*>(bytes) + begin, end - begin, MADV_WILLNEED);
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read from disk on first
+// access, so opening even a very large file is cheap, and the data is shared
+// with the page cache instead of being copied into the process.
+class MappedFile {
+ public:
+  // Maps `path`; throws std::runtime_error if it cannot be opened or mapped
+  explicit MappedFile(const std::string& path);
+
+  // Unmaps the file; pointers into it become invalid
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns the first byte of the file, or nullptr if it is empty
+  const uint8_t* data() const { return bytes; }
+
+  // Returns the file size in bytes
+  size_t size() const { return length; }
+
+  // Returns the path the file was opened with
+  const std::string& getPath() const { return path; }
+
+  // Asks the OS to start reading `size` bytes at `offset` ahead of their
+  // first access; a hint only, and a no-op where it is unsupported
+  void willNeed(size_t offset, size_t size) const;
+
+ private:
+  std::string path;
+  const uint8_t* bytes = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#endif
+};
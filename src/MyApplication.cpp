@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/matrix_operation.hpp>
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <cmath>
@@ -12,112 +13,125 @@
 #include <imgui_impl_opengl3.h>
 
 #include "asset.hpp"
+#include "GLDebug.hpp"
+#include "GLState.hpp"
 #include "glError.hpp"
-
-// Vertex structure for heightmap mesh
-struct VertexType {
-    glm::vec3 position;  // 3D position of the vertex
-    glm::vec3 normal;    // Surface normal for lighting
-    glm::vec4 color;     // RGBA color of the vertex
-};
-
-// Computes height for a given 2D position using a sine-based function
-float heightMap(const glm::vec2& position) {
-    return 2.0f * std::sin(position.x) * std::sin(position.y);
+#include "Primitives.hpp"
+#include "Profiler.hpp"
+#include "SceneFile.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+// Grid parameters of the terrain built at startup
+HeightMapParams makeTerrainParams() {
+    HeightMapParams params;
+    params.size = 128;
+    return params;
 }
 
-// Generates a vertex for the heightmap at the given 2D position
-VertexType getHeightMap(const glm::vec2& position) {
-    const glm::vec2 dx(0.01f, 0.0f);  // Small offset for x-derivative
-    const glm::vec2 dy(0.0f, 0.01f);  // Small offset for y-derivative
-
-    VertexType vertex;
-    float h = heightMap(position);
-    // Approximate partial derivatives for normal calculation
-    float hx = 100.0f * (heightMap(position + dx) - h);
-    float hy = 100.0f * (heightMap(position + dy) - h);
+// Index of a terrain program permutation in MyApplication::terrainPrograms
+size_t terrainProgramIndex(VertexFormat format, bool specular, int lights) {
+    return (static_cast<size_t>(format) * 2 + (specular ? 1 : 0)) *
+        TerrainUniforms::kMaxLights + (lights - 1);
+}
 
-    vertex.position = glm::vec3(position, h);
-    vertex.normal = glm::normalize(glm::vec3(-hx, -hy, 1.0f));
-    // Color based on height for visual variation
-    float c = std::sin(h * 5.0f) * 0.5f + 0.5f;
-    vertex.color = glm::vec4(c, 1.0f - c, 0.5f, 1.0f);
+// Submits every terrain program permutation to the driver
+std::vector<ShaderManager::ProgramId> addTerrainPrograms(ShaderManager& shaderManager) {
+    std::vector<ShaderManager::ProgramId> programs(6 * TerrainUniforms::kMaxLights);
+    for (VertexFormat format : { VertexFormat::Full, VertexFormat::Compact, VertexFormat::Displaced }) {
+        for (bool specular : { false, true }) {
+            for (int lights = 1; lights <= TerrainUniforms::kMaxLights; ++lights) {
+                programs[terrainProgramIndex(format, specular, lights)] = shaderManager.add(
+                    getTerrainShaderStages(), makeTerrainDefines(format, specular, lights),
+                    TerrainAttributes::getLocations());
+            }
+        }
+    }
+    return programs;
+}
 
-    return vertex;
+// Index of an object program permutation in MyApplication::objectPrograms
+size_t objectProgramIndex(bool specular, int lights) {
+    return (specular ? 1 : 0) * TerrainUniforms::kMaxLights + (lights - 1);
 }
 
-MyApplication::MyApplication()
-    : Application(),
-    vertexShader(SHADER_DIR "/vertex_shader.glsl", GL_VERTEX_SHADER),
-    fragmentShader(SHADER_DIR "/fragment_shader.glsl", GL_FRAGMENT_SHADER),
-    shaderProgram({ vertexShader, fragmentShader }) {
-    glCheckError(__FILE__, __LINE__);
-
-    // Generate heightmap mesh
-    std::vector<VertexType> vertices;
-    std::vector<GLuint> indices;
-
-    // Create grid of vertices
-    for (int y = 0; y <= size; ++y) {
-        for (int x = 0; x <= size; ++x) {
-            float xx = (x - size / 2) * 0.1f;
-            float yy = (y - size / 2) * 0.1f;
-            vertices.push_back(getHeightMap({ xx, yy }));
+// Submits the instanced permutations used for the GameObject meshes
+std::vector<ShaderManager::ProgramId> addObjectPrograms(ShaderManager& shaderManager) {
+    std::vector<ShaderManager::ProgramId> programs(2 * TerrainUniforms::kMaxLights);
+    for (bool specular : { false, true }) {
+        for (int lights = 1; lights <= TerrainUniforms::kMaxLights; ++lights) {
+            programs[objectProgramIndex(specular, lights)] = shaderManager.add(
+                getTerrainShaderStages(),
+                makeTerrainDefines(VertexFormat::Full, specular, lights, true),
+                TerrainAttributes::getLocations());
         }
     }
+    return programs;
+}
 
-    // Generate indices for triangle mesh
-    for (int y = 0; y < size; ++y) {
-        for (int x = 0; x < size; ++x) {
-            int base = x + (size + 1) * y;
-            // First triangle
-            indices.push_back(base);
-            indices.push_back(base + 1);
-            indices.push_back(base + size + 2);
-            // Second triangle
-            indices.push_back(base + size + 2);
-            indices.push_back(base + size + 1);
-            indices.push_back(base);
-        }
+// Frame constants; the first light is the one set in the UI and the others
+// are copies rotated about the vertical axis in quarter turns
+TerrainUniforms::FrameBlock makeFrameBlock(const glm::mat4& projection,
+                                           const glm::mat4& view,
+                                           const glm::vec3& lightPos) {
+    TerrainUniforms::FrameBlock block{ projection, view, {} };
+    for (int i = 0; i < TerrainUniforms::kMaxLights; ++i) {
+        const float angle = glm::radians(90.0f * i);
+        const float c = std::cos(angle), s = std::sin(angle);
+        block.lights[i] = glm::vec4(c * lightPos.x - s * lightPos.y,
+            s * lightPos.x + c * lightPos.y, lightPos.z, 1.0f);
+    }
+    return block;
+}
+
+// Percentage of cache lookups that hit
+double hitRate(uint64_t hits, uint64_t misses) {
+    return hits + misses > 0 ? 100.0 * hits / (hits + misses) : 100.0;
+}
+}  // namespace
+
+MyApplication::MyApplication(const ApplicationOptions& options)
+    : Application(options),
+    shaderManager(SHADER_DIR, !isHeadless()),
+    terrainPrograms(addTerrainPrograms(shaderManager)),
+    objectPrograms(addObjectPrograms(shaderManager)),
+    simulation(simulationTickRate, !isHeadless()),
+    terrain(makeTerrainParams(), chunkSize),
+    uniformRing(uniformRingBytes),
+    terrainParams(terrain.getParams()),
+    terrainBuilder([] { glfwPostEmptyEvent(); }) {
+    // Collect the programs compiled while the terrain was generated
+    for (ShaderManager::ProgramId id : terrainPrograms) {
+        TerrainUniforms::bindBlocks(shaderManager.get(id));
     }
+    for (ShaderManager::ProgramId id : objectPrograms) {
+        TerrainUniforms::bindBlocks(shaderManager.get(id), true);
+    }
+    std::cout << "Shader permutations:\n";
+    shaderManager.printPrograms(std::cout);
+    GL_CHECK_ERROR();
 
     // Log mesh statistics
-    std::cout << "Vertices: " << vertices.size() << "\n";
-    std::cout << "Indices: " << indices.size() << "\n";
-
-    // Set up Vertex Buffer Object (VBO)
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(VertexType)),
-        vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Set up Index Buffer Object (IBO)
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLuint)),
-        indices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    // Set up Vertex Array Object (VAO)
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    // Map vertex attributes to shader inputs
-    shaderProgram.setAttribute("position", 3, sizeof(VertexType),
-        offsetof(VertexType, position));
-    shaderProgram.setAttribute("normal", 3, sizeof(VertexType),
-        offsetof(VertexType, normal));
-    shaderProgram.setAttribute("color", 4, sizeof(VertexType),
-        offsetof(VertexType, color));
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBindVertexArray(0);
-
-    // Enable depth testing for proper rendering
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    std::cout << "Vertices: " << terrain.getVertices().size() << "\n";
+    std::cout << "Chunks: " << terrain.getChunks().size() << " ("
+        << terrain.getLod().getLevelCount() << " LOD levels)\n";
+
+    // Upload the chunked heightmap mesh
+    terrainRenderer.upload(terrain, vertexFormat);
+    std::cout << "Vertex buffer: " << terrainRenderer.getVertexBytes() << " bytes\n";
+    std::cout << "Index buffer: " << terrainRenderer.getIndexBytes() << " bytes, ACMR "
+        << terrain.getLod().getStats().acmrOriginal << " -> "
+        << terrain.getLod().getStats().acmrOptimized << "\n";
+
+    // Meshes of the GameObject types, drawn instanced
+    if (InstanceRenderer::isSupported()) {
+        instanceRenderer = std::make_unique<InstanceRenderer>();
+        instanceRenderer->addMesh(Cube, makeCube(), glm::vec4(0.9f, 0.5f, 0.2f, 1.0f));
+        instanceRenderer->addMesh(Sphere, makeSphere(), glm::vec4(0.3f, 0.5f, 0.9f, 1.0f));
+    } else {
+        std::cerr << "Warning: Instanced arrays are not supported, objects are not drawn"
+            << std::endl;
+    }
 
     // Initialize ImGui
     initImGui(getWindow());
@@ -131,7 +145,11 @@ void MyApplication::initImGui(GLFWwindow* windowParam) {
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;         // Enable Docking
-    io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;       // Enable Multi-Viewport / Platform Windows
+    if (isHeadless()) {
+        io.IniFilename = nullptr;                             // Keep runs reproducible
+    } else {
+        io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;   // Enable Multi-Viewport / Platform Windows
+    }
     //io.ConfigViewportsNoAutoMerge = true;
     //io.ConfigViewportsNoTaskBarIcon = true;
 
@@ -163,24 +181,269 @@ void MyApplication::initImGui(GLFWwindow* windowParam) {
     lightPosArray[2] = lightPos.z;
 }
 
+ShaderProgram& MyApplication::getTerrainProgram() {
+    const VertexFormat format = demStreamer ? VertexFormat::Full : terrainRenderer.getVertexFormat();
+    return shaderManager.get(terrainPrograms[terrainProgramIndex(format, specular, lightCount)]);
+}
+
+ShaderProgram& MyApplication::getObjectProgram() {
+    return shaderManager.get(objectPrograms[objectProgramIndex(specular, lightCount)]);
+}
+
+void MyApplication::updateTerrain() {
+    PROFILE_FUNCTION();
+
+    // Start streaming a finished rebuild into the back buffers
+    if (!terrainRenderer.isUploading()) {
+        if (std::unique_ptr<TerrainBuild> build = terrainBuilder.takeResult()) {
+            pendingTerrain = std::move(build->terrain);
+            pendingRequested = build->requested;
+            terrainBuildTime = build->buildSeconds;
+            terrainRenderer.beginUpload(std::move(build->mesh));
+        }
+    }
+
+    // The front buffers keep drawing the old terrain until the upload is done
+    if (terrainRenderer.isUploading() && terrainRenderer.continueUpload(terrainUploadBudget)) {
+        terrain = std::move(*pendingTerrain);
+        pendingTerrain.reset();
+        sceneSource.reset();  // The new terrain has its own vertices
+        std::chrono::duration<double> latency = std::chrono::steady_clock::now() - pendingRequested;
+        terrainRebuildLatency = latency.count();
+
+        // Settings toggled while the rebuild was in flight
+        if (terrain.getLod().getOptions() != lodOptions) {
+            terrain.setLodOptions(lodOptions);
+            terrainRenderer.uploadIndices(terrain);
+        }
+        if (terrainRenderer.getVertexFormat() != vertexFormat) {
+            terrainRenderer.upload(terrain, vertexFormat);
+        }
+    }
+}
+
+bool MyApplication::needsRedraw() {
+    return animateCamera || (spinObjects && objects.size() > 0) || terrainRenderer.isUploading()
+        || terrainBuilder.hasResult() || shaderManager.hasPendingWork()
+        || (demStreamer && demStreamer->isStreaming());
+}
+
+EntityHandle MyApplication::addObject(ObjectType type) {
+    // Golden-angle spiral: evenly spread however many objects there are
+    const float n = static_cast<float>(objects.size());
+    const float radius = 0.5f * std::sqrt(n);
+    const float angle = 2.39996323f * n;
+    const glm::vec3 position(radius * std::cos(angle), radius * std::sin(angle),
+        terrainParams.heightScale + 1.0f);
+    selectedObject = objects.create(type, position);
+    return selectedObject;
+}
+
+void MyApplication::updateObjects() {
+    PROFILE_FUNCTION();
+    const auto start = std::chrono::steady_clock::now();
+    if (spinObjects) {
+        const glm::quat spin = glm::angleAxis(getFrameDeltaTime(), glm::vec3(0.0f, 0.0f, 1.0f));
+        for (EntityHandle object : objects.getHandles()) {
+            if (objects.getParent(object).isNull())
+                objects.setRotation(object, spin * objects.getRotation(object));
+        }
+    }
+    objectsUpdated = objects.updateTransforms(ThreadPool::shared());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    objectUpdateTime = elapsed.count();
+}
+
+void MyApplication::newScene() {
+    closeDem();
+    objects.clear();
+    selectedObject = EntityHandle();
+    terrainParams = makeTerrainParams();
+    terrainBuilder.request(terrainParams, chunkSize, lodOptions, vertexFormat);
+    scenePath.clear();
+    sceneError.clear();
+}
+
+bool MyApplication::openScene(const std::string& path) {
+    PROFILE_FUNCTION();
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        auto scene = std::make_unique<SceneFile>(path);
+        Terrain loaded = scene->makeTerrain();
+        EntityStore loadedObjects;
+        scene->readObjects(loadedObjects);
+
+        // Rebuilds of the previous terrain must not replace the loaded one
+        terrainBuilder.cancel();
+        terrainRenderer.cancelUpload();
+        pendingTerrain.reset();
+
+        // Straight from the mapping into the buffers
+        terrainRenderer.upload(scene->getMesh());
+        terrain = std::move(loaded);
+        objects = std::move(loadedObjects);
+        selectedObject = EntityHandle();
+        closeDem();
+        terrainParams = terrain.getParams();
+        lodOptions = terrain.getLod().getOptions();
+        vertexFormat = scene->getVertexFormat();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        sceneLoadTime = elapsed.count();
+        sceneSource = std::move(scene);
+        scenePath = path;
+        sceneError.clear();
+        std::cout << "[Info] Opened " << path << " (" << sceneSource->getFile().size() / 1048576.0
+            << " MiB) in " << 1000.0 * sceneLoadTime << " ms" << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        sceneError = e.what();
+        std::cerr << "Warning: Cannot open scene: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MyApplication::saveScene(const std::string& path) {
+    PROFILE_FUNCTION();
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        ::saveScene(path, terrain, vertexFormat, objects, sceneSource.get());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        scenePath = path;
+        sceneError.clear();
+        std::cout << "[Info] Saved " << path << " in " << 1000.0 * elapsed.count() << " ms"
+            << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        sceneError = e.what();
+        std::cerr << "Warning: Cannot save scene: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MyApplication::openDem(const std::string& path) {
+    PROFILE_FUNCTION();
+    try {
+        // Finished tiles wake the render loop to upload their chunks
+        TileCacheOptions cacheOptions;
+        cacheOptions.cacheBudget = static_cast<size_t>(tileBudgetMiB) << 20;
+        cacheOptions.onLoaded = [] { glfwPostEmptyEvent(); };
+        auto source = std::make_unique<TiledHeightSource>(path, cacheOptions);
+        TerrainStreamOptions streamOptions;
+        streamOptions.chunkSize = std::min(chunkSize, source->getInfo().tileSize);
+        streamOptions.viewDistance = farPlane;
+        streamOptions.gpuBudget = static_cast<size_t>(gpuBudgetMiB) << 20;
+        auto streamer = std::make_unique<TerrainStreamer>(*source, streamOptions, lodOptions);
+
+        closeDem();
+        demSource = std::move(source);
+        demStreamer = std::move(streamer);
+        demPath = path;
+        sceneError.clear();
+        const DemInfo& info = demSource->getInfo();
+        std::cout << "[Info] Streaming " << path << ": " << info.tilesX << "x" << info.tilesY
+            << " tiles of " << info.tileSize << " quads" << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        sceneError = e.what();
+        std::cerr << "Warning: Cannot open DEM: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void MyApplication::closeDem() {
+    demStreamer.reset();
+    demSource.reset();
+    demPath.clear();
+}
+
+void MyApplication::sculptTerrain(float amount) {
+    PROFILE_FUNCTION();
+    const HeightMapRegion region = terrain.sculpt(
+        glm::vec2(brushPosition[0], brushPosition[1]), brushRadius, amount);
+    sculptBytes = terrainRenderer.updateHeights(terrain, region);
+}
+
+void MyApplication::drawScenePrompts() {
+    enum Prompt { OpenScenePrompt, SaveScenePrompt, OpenDemPrompt };
+    for (Prompt prompt : { OpenScenePrompt, SaveScenePrompt, OpenDemPrompt }) {
+        static const char* const titles[] = { "Open Scene", "Save Scene As", "Open DEM" };
+        const char* title = titles[prompt];
+        const bool save = prompt == SaveScenePrompt;
+        bool& requested = prompt == OpenScenePrompt ? openScenePrompt
+            : save ? saveScenePrompt : openDemPrompt;
+        if (requested) {
+            const std::string& path = prompt == OpenDemPrompt ? demPath : scenePath;
+            std::snprintf(scenePathInput, sizeof(scenePathInput), "%s", !path.empty() ? path.c_str()
+                : prompt == OpenDemPrompt ? "terrain.dem" : "scene.terrain");
+            sceneError.clear();
+            ImGui::OpenPopup(title);
+            requested = false;
+        }
+        if (ImGui::BeginPopupModal(title, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+            bool confirmed = ImGui::InputText("Path", scenePathInput, sizeof(scenePathInput),
+                ImGuiInputTextFlags_EnterReturnsTrue);
+            confirmed |= ImGui::Button(save ? "Save" : "Open");
+            if (confirmed && (prompt == OpenDemPrompt ? openDem(scenePathInput)
+                    : save ? saveScene(scenePathInput) : openScene(scenePathInput)))
+                ImGui::CloseCurrentPopup();
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel"))
+                ImGui::CloseCurrentPopup();
+            if (!sceneError.empty())
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", sceneError.c_str());
+            ImGui::EndPopup();
+        }
+    }
+}
+
 void MyApplication::loop() {
+    PROFILE_FUNCTION();
+    PROFILE_GPU_FRAME(gpuProfiler);
+
     // Exit if window is closed
     if (glfwWindowShouldClose(getWindow())) {
         exit();
     }
 
-    float t = getTime();
+    shaderManager.update();
+    updateTerrain();
+    updateObjects();
+
+    // Hand the UI settings to the simulation and take its latest state;
+    // headless runs tick it here, in step with the fixed timestep
+    SimulationInput input;
+    input.animateCamera = animateCamera;
+    input.lightPos = glm::vec3(lightPosArray[0], lightPosArray[1], lightPosArray[2]);
+    simulation.setInput(input);
+    const SimulationState scene = simulation.sample(
+        simulation.isThreaded() ? simulation.now() : static_cast<double>(getTime()));
+
     // Configure camera and transformation matrices
-    projection = glm::perspective(glm::radians(45.0f), getWindowRatio(), 0.1f, 100.0f);
-    view = glm::lookAt(glm::vec3(20.0f * std::sin(t), 20.0f * std::cos(t), 20.0),
-        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    const glm::vec3 eye = scene.eye;
+    projection = glm::perspective(lodSettings.fieldOfView, getWindowRatio(), 0.1f, farPlane);
+    view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model = glm::mat4(1.0f); // No additional model transformations
-    lightPos = glm::vec3(lightPosArray[0], lightPosArray[1], lightPosArray[2]);
+    lightPos = scene.lightPos;
+
+    // Cull terrain chunks against the view frustum and pick their detail level;
+    // a streamed DEM also loads and uploads the chunks around the eye
+    const Frustum frustum(projection * view * model);
+    lodSettings.viewportHeight = static_cast<float>(getHeight());
+    if (demStreamer) {
+        demStreamer->update(eye, frustum, lodSettings);
+    } else {
+        terrain.cull(frustum, visibleChunks);
+        terrain.selectLod(lodSettings, eye, visibleChunks, terrainDraws);
+    }
 
     // Start ImGui frame
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+    {
+        PROFILE_SCOPE("ImGui::NewFrame");
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+    }
 
     // Main ImGui windows with docking, fuck this shit for real, i need someone to fix this, or  i will fix later
     {
@@ -210,17 +473,28 @@ void MyApplication::loop() {
         if (ImGui::BeginMenuBar()) {
             if (ImGui::BeginMenu("File")) {
                 if (ImGui::MenuItem("New Scene")) {
-                    std::cout << "New Scene clicked\n";
+                    newScene();
                 }
                 if (ImGui::MenuItem("Open Scene")) {
-                    std::cout << "Open Scene clicked\n";
+                    openScenePrompt = true;
                 }
                 if (ImGui::MenuItem("Save Scene")) {
-                    std::cout << "Save Scene clicked\n";
+                    if (scenePath.empty())
+                        saveScenePrompt = true;
+                    else
+                        saveScene(scenePath);
                 }
                 if (ImGui::MenuItem("Save As")) {
-                    std::cout << "Save As clicked\n";
+                    saveScenePrompt = true;
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Open DEM")) {
+                    openDemPrompt = true;
+                }
+                if (ImGui::MenuItem("Close DEM", nullptr, false, demStreamer != nullptr)) {
+                    closeDem();
                 }
+                ImGui::Separator();
                 if (ImGui::MenuItem("Exit")) {
                     std::cout << "Exit clicked\n";
                 }
@@ -249,13 +523,26 @@ void MyApplication::loop() {
             }
             if (ImGui::BeginMenu("GameObject")) {
                 if (ImGui::MenuItem("Add Cube")) {
-                    std::cout << "Add Cube clicked\n";
+                    addObject(Cube);
                 }
                 if (ImGui::MenuItem("Add Sphere")) {
-                    std::cout << "Add Sphere clicked\n";
+                    addObject(Sphere);
                 }
-                if (ImGui::MenuItem("Delete")) {
-                    std::cout << "Delete clicked\n";
+                if (ImGui::MenuItem("Add 10000 Objects")) {
+                    // Cubes, each carrying a sphere as a child
+                    for (int i = 0; i < 5000; ++i) {
+                        EntityHandle cube = addObject(Cube);
+                        objects.create(Sphere, glm::vec3(0.0f, 0.0f, 1.0f), cube);
+                    }
+                }
+                if (ImGui::MenuItem("Delete", nullptr, false, objects.isAlive(selectedObject))) {
+                    objects.destroy(selectedObject);
+                    const std::vector<EntityHandle>& remaining = objects.getHandles();
+                    selectedObject = remaining.empty() ? EntityHandle() : remaining.back();
+                }
+                if (ImGui::MenuItem("Delete All", nullptr, false, objects.size() > 0)) {
+                    objects.clear();
+                    selectedObject = EntityHandle();
                 }
                 ImGui::EndMenu();
             }
@@ -270,6 +557,7 @@ void MyApplication::loop() {
             }
             ImGui::EndMenuBar();
         }
+        drawScenePrompts();
 
         ImGui::End();
     }
@@ -284,6 +572,134 @@ void MyApplication::loop() {
             showMetrics = false;
         if (ImGui::Checkbox("Metrics", &showMetrics))
             showDemoWindow = false;
+        ImGui::Checkbox("Profiler", &showProfiler);
+
+        // Rendering on demand sleeps until input or background work needs a frame
+        bool onDemand = isOnDemand();
+        if (ImGui::Checkbox("Render on Demand", &onDemand))
+            setOnDemand(onDemand);
+        ImGui::SameLine();
+        ImGui::Checkbox("Animate Camera", &animateCamera);
+        ImGui::Text("Redraws: %d fps, %llu idle wake-ups", getRedrawRate(),
+            static_cast<unsigned long long>(getSkippedFrames()));
+        const Simulation::Stats simulationStats = simulation.getStats();
+        ImGui::Text("Simulation: %.0f Hz%s, %llu ticks, %llu dropped, %.2f ms max tick",
+            simulationTickRate, simulation.isThreaded() ? " threaded" : "",
+            static_cast<unsigned long long>(simulationStats.ticks),
+            static_cast<unsigned long long>(simulationStats.dropped), simulationStats.maxTickMs);
+
+        // Frame pacing; fewer frames in flight trade throughput for latency
+        FramePacer& pacer = getFramePacer();
+        FramePacingOptions pacing = pacer.getOptions();
+        static const char* const pacingNames[] = { "Vsync", "Adaptive", "Fixed FPS", "Uncapped" };
+        int pacingIndex = static_cast<int>(pacing.mode);
+        float targetFps = static_cast<float>(pacing.targetFps);
+        bool pacingChanged = ImGui::Combo("Pacing", &pacingIndex, pacingNames, 4);
+        if (pacingIndex == static_cast<int>(PacingMode::Fixed))
+            pacingChanged |= ImGui::SliderFloat("Target FPS", &targetFps, 10.0f, 480.0f, "%.0f");
+        pacingChanged |= ImGui::SliderInt("Frames in Flight", &pacing.maxFramesInFlight, 1,
+            FramePacingOptions::kMaxFramesInFlight);
+        if (pacingChanged) {
+            pacing.mode = static_cast<PacingMode>(pacingIndex);
+            pacing.targetFps = targetFps;
+            pacer.setOptions(pacing);
+        }
+        const FramePacer::Stats& pacingStats = pacer.getStats();
+        ImGui::Text("Input latency: %.1f ms avg, %.1f ms max (to GPU completion)",
+            pacingStats.averageLatencyMs, pacingStats.maxLatencyMs);
+        ImGui::Text("Waits: %.2f ms on fences, %.2f ms in limiter",
+            pacingStats.fenceWaitMs, pacingStats.limiterWaitMs);
+
+        if (demStreamer) {
+            // Streamed DEM: decoded tiles in RAM, chunk vertices in VRAM
+            const DemInfo& demInfo = demSource->getInfo();
+            const TiledHeightSource::Stats tileStats = demSource->getStats();
+            const TerrainStreamer::Stats& streamStats = demStreamer->getStats();
+            ImGui::Text("DEM: %s, %dx%d tiles of %d quads", demPath.c_str(),
+                demInfo.tilesX, demInfo.tilesY, demInfo.tileSize);
+            ImGui::Text("Tile cache: %.1f%% hits, %.1f / %d MiB (%zu tiles), %zu queued",
+                hitRate(tileStats.hits, tileStats.misses), tileStats.residentBytes / 1048576.0,
+                tileBudgetMiB, tileStats.residentTiles, tileStats.queued);
+            ImGui::Text("Tile loads: %llu, %llu failed, %.2f ms each",
+                static_cast<unsigned long long>(tileStats.loads),
+                static_cast<unsigned long long>(tileStats.failures), tileStats.loadMs);
+            ImGui::Text("Chunk cache: %.1f%% hits, %.1f / %.1f MiB (%zu chunks), %llu evictions",
+                hitRate(streamStats.hits, streamStats.misses), streamStats.residentBytes / 1048576.0,
+                streamStats.capacityBytes / 1048576.0, streamStats.residentChunks,
+                static_cast<unsigned long long>(streamStats.evictions));
+            ImGui::Text("Terrain chunks: %zu / %zu visible, %zu waiting, %zu uploaded",
+                streamStats.visibleChunks, streamStats.windowChunks, streamStats.missingChunks,
+                streamStats.uploads);
+            ImGui::SliderInt("Tile Budget (MiB)", &tileBudgetMiB, 16, 4096);
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                demSource->setCacheBudget(static_cast<size_t>(tileBudgetMiB) << 20);
+            ImGui::SliderInt("GPU Budget (MiB)", &gpuBudgetMiB, 16, 2048);
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                demStreamer->setGpuBudget(static_cast<size_t>(gpuBudgetMiB) << 20);
+        } else {
+            ImGui::Text("Terrain chunks: %d / %d visible", static_cast<int>(visibleChunks.size()),
+                static_cast<int>(terrain.getChunks().size()));
+        }
+        ImGui::Text("Triangles submitted: %zu", terrainTriangles);
+        ImGui::Checkbox("Terrain LOD", &lodSettings.enabled);
+        ImGui::SliderFloat("Pixel Error", &lodSettings.pixelError, 0.25f, 32.0f, "%.2f px",
+            ImGuiSliderFlags_Logarithmic);
+
+        // Index buffer layout and post-transform cache efficiency
+        bool lodOptionsChanged = ImGui::Checkbox("Vertex Cache Order", &lodOptions.optimizeVertexCache);
+        lodOptionsChanged |= ImGui::Checkbox("Triangle Strips", &lodOptions.triangleStrips);
+        if (lodOptionsChanged) {
+            terrain.setLodOptions(lodOptions);
+            terrainRenderer.uploadIndices(terrain);
+            if (demStreamer)
+                demStreamer->setLodOptions(lodOptions);
+        }
+        const TerrainLod::Stats& lodStats = terrain.getLod().getStats();
+        ImGui::Text("Indices: %s, %.1f KiB",
+            terrainRenderer.getIndexType() == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit",
+            terrainRenderer.getIndexBytes() / 1024.0);
+        ImGui::Text("ACMR: %.3f -> %.3f", lodStats.acmrOriginal, lodStats.acmrOptimized);
+
+        // Vertex layout: 40 byte floats, 12 byte quantized, or a 4 byte
+        // height texel per vertex displaced in the vertex shader
+        static const char* const vertexFormatNames[] = { "Full (40 B)", "Compact (12 B)", "Displaced (4 B)" };
+        // A terrain read from a scene has no CPU vertices to convert; the
+        // mapped file holds the only copy of its heights, so it keeps the
+        // layout it was saved with
+        int vertexFormatIndex = static_cast<int>(vertexFormat);
+        ImGui::BeginDisabled(terrain.getVertices().empty());
+        if (ImGui::Combo("Vertex Layout", &vertexFormatIndex, vertexFormatNames, 3)) {
+            vertexFormat = static_cast<VertexFormat>(vertexFormatIndex);
+            terrainRenderer.upload(terrain, vertexFormat);
+        }
+        ImGui::EndDisabled();
+        ImGui::Text(terrainRenderer.getVertexFormat() == VertexFormat::Displaced
+                ? "Height texture: %.1f KiB" : "Vertices: %.1f KiB",
+            terrainRenderer.getVertexBytes() / 1024.0);
+        ImGui::Text("Uniform ring: %s, %llu stalls",
+            uniformRing.isPersistent() ? "persistent" : "orphaning",
+            static_cast<unsigned long long>(uniformRing.getStallCount()));
+        const GLState::Counters& stateCalls = GLState::getLastFrame();
+        ImGui::Text("GL state calls: %llu issued, %llu skipped",
+            static_cast<unsigned long long>(stateCalls.issued),
+            static_cast<unsigned long long>(stateCalls.skipped));
+        ImGui::Text("Shader reloads: %d (%d failed)%s", shaderManager.getReloadCount(),
+            shaderManager.getFailureCount(), shaderManager.isWatching() ? "" : ", not watching");
+        if (!shaderManager.getLastError().empty()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s",
+                shaderManager.getLastError().c_str());
+        }
+        if (GLDebug::isEnabled()) {
+            const GLDebug::Stats debugStats = GLDebug::getStats();
+            if (ImGui::TreeNode("GL debug", "GL debug: %llu messages, %llu dropped",
+                    static_cast<unsigned long long>(debugStats.received),
+                    static_cast<unsigned long long>(debugStats.dropped))) {
+                for (const GLDebug::Message& message : GLDebug::getRecent()) {
+                    ImGui::TextWrapped("%s", GLDebug::describe(message).c_str());
+                }
+                ImGui::TreePop();
+            }
+        }
 
         ImGui::Separator();
 
@@ -292,13 +708,66 @@ void MyApplication::loop() {
         ImGui::SliderFloat("X", &lightPosArray[0], -20.0f, 20.0f);
         ImGui::SliderFloat("Y", &lightPosArray[1], -20.0f, 20.0f);
         ImGui::SliderFloat("Z", &lightPosArray[2], -20.0f, 20.0f);
+        ImGui::SliderInt("Lights", &lightCount, 1, TerrainUniforms::kMaxLights);
+        ImGui::Checkbox("Specular", &specular);
+
+        // Objects from the GameObject menu
+        ImGui::Checkbox("Spin Objects", &spinObjects);
+        ImGui::Text("Objects: %zu, %zu transforms updated in %.2f ms", objects.size(),
+            objectsUpdated, 1000.0 * objectUpdateTime);
+        if (instanceRenderer) {
+            const InstanceRenderer::Stats& instanceStats = instanceRenderer->getStats();
+            ImGui::Text("Object draw calls: %zu (%zu instances, %zu culled)",
+                instanceStats.drawCalls, instanceStats.instances, instanceStats.culled);
+        }
 
         // Clear Color
         ImGui::ColorEdit3("Clear Color", clearColor);
 
-        // Heightmap controls
-        static float heightScale = 2.0f;
-        ImGui::SliderFloat("Height Scale", &heightScale, 0.1f, 5.0f);
+        // Heightmap controls; edits are regenerated on the builder thread
+        static const int gridSizes[] = { 64, 128, 256, 512, 1024, 2048 };
+        static const char* const gridSizeNames[] = { "64", "128", "256", "512", "1024", "2048" };
+        int gridSizeIndex = 0;
+        while (gridSizeIndex < 5 && gridSizes[gridSizeIndex] < terrainParams.size)
+            ++gridSizeIndex;
+        bool paramsChanged = ImGui::SliderFloat("Height Scale", &terrainParams.heightScale, 0.1f, 5.0f);
+        paramsChanged |= ImGui::SliderFloat("Frequency", &terrainParams.frequency, 0.1f, 4.0f);
+        if (ImGui::Combo("Grid Size", &gridSizeIndex, gridSizeNames, 6)) {
+            terrainParams.size = gridSizes[gridSizeIndex];
+            paramsChanged = true;
+        }
+        if (paramsChanged)
+            terrainBuilder.request(terrainParams, chunkSize, lodOptions, vertexFormat);
+
+        // Height brush; needs the terrain's CPU vertices and no rebuild in flight
+        const float extent = 0.5f * terrain.getParams().size * terrain.getParams().spacing;
+        ImGui::SliderFloat2("Brush Position", brushPosition, -extent, extent);
+        ImGui::SliderFloat("Brush Radius", &brushRadius, 0.1f, 5.0f);
+        ImGui::SliderFloat("Brush Strength", &brushStrength, 0.01f, 1.0f);
+        ImGui::BeginDisabled(terrain.getVertices().empty() || terrainBuilder.isBusy()
+            || terrainRenderer.isUploading() || demStreamer != nullptr);
+        if (ImGui::Button("Raise"))
+            sculptTerrain(brushStrength);
+        ImGui::SameLine();
+        if (ImGui::Button("Lower"))
+            sculptTerrain(-brushStrength);
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::Text("Last edit: %.1f KiB uploaded", sculptBytes / 1024.0);
+
+        if (terrainRenderer.isUploading())
+            ImGui::Text("Regeneration: uploading %.0f%%", 100.0f * terrainRenderer.getUploadProgress());
+        else if (terrainBuilder.isBusy())
+            ImGui::Text("Regeneration: building");
+        else
+            ImGui::Text("Regeneration: idle");
+        ImGui::Text("Last rebuild: %.1f ms build, %.1f ms latency",
+            1000.0 * terrainBuildTime, 1000.0 * terrainRebuildLatency);
+        if (sceneSource)
+            ImGui::Text("Scene: %s, %.1f MiB mapped, opened in %.1f ms", scenePath.c_str(),
+                sceneSource->getFile().size() / 1048576.0, 1000.0 * sceneLoadTime);
+        else
+            ImGui::Text("Scene: %s", scenePath.empty() ? "unsaved" : scenePath.c_str());
 
         ImGui::End();
     }
@@ -311,28 +780,46 @@ void MyApplication::loop() {
     if (showMetrics)
         ImGui::ShowMetricsWindow(&showMetrics);
 
+    // Show profiler timeline
+    if (showProfiler)
+        profilerWindow.draw(&showProfiler);
+
     // Rendering
-    ImGui::Render();
+    {
+        PROFILE_SCOPE("ImGui::Render");
+        ImGui::Render();
+    }
     int display_w, display_h;
     glfwGetFramebufferSize(getWindow(), &display_w, &display_h);
-    glViewport(0, 0, display_w, display_h);
+    GLState::viewport(0, 0, display_w, display_h);
     glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Render 3D scene
-    shaderProgram.use();
-    shaderProgram.setUniform("projection", projection);
-    shaderProgram.setUniform("view", view);
-    shaderProgram.setUniform("model", model);
-    shaderProgram.setUniform("lightPos", lightPos);
-
-    glCheckError(__FILE__, __LINE__);
-
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, size * size * 2 * 3, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
-
-    shaderProgram.unuse();
+    {
+        PROFILE_SCOPE("Scene");
+        PROFILE_GPU_SCOPE(gpuProfiler, "Scene");
+        DebugGroup debugGroup("Scene");
+        uniformRing.beginFrame();
+        ShaderProgram& shaderProgram = getTerrainProgram();
+        shaderProgram.use();
+        uniformRing.bind(TerrainUniforms::kFrameBinding,
+            uniformRing.push(makeFrameBlock(projection, view, lightPos)));
+        uniformRing.bind(TerrainUniforms::kObjectBinding,
+            uniformRing.push(TerrainUniforms::makeObjectBlock(model)));
+
+        GL_CHECK_ERROR();
+
+        terrainTriangles = demStreamer ? demStreamer->draw()
+            : terrainRenderer.draw(terrain, terrainDraws, shaderProgram);
+
+        // One instanced draw per object mesh, sharing the frame block
+        if (instanceRenderer && objects.size() > 0) {
+            getObjectProgram().use();
+            instanceRenderer->draw(objects, frustum, ThreadPool::shared());
+        }
+        uniformRing.endFrame();
+    }
 
     // Render ImGui
     renderImGui();
@@ -347,6 +834,10 @@ void MyApplication::loop() {
 }
 
 void MyApplication::renderImGui() {
+    PROFILE_FUNCTION();
+    PROFILE_GPU_SCOPE(gpuProfiler, "ImGui");
+    DebugGroup debugGroup("ImGui");
+    // The backend restores the state it changes, so GLState stays valid
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
@@ -1,8 +1,25 @@
 #pragma once
 
+#include <chrono>
 #include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
 #include "Application.hpp"
+#include "EntityStore.hpp"
+#include "GpuProfiler.hpp"
+#include "InstanceRenderer.hpp"
+#include "ProfilerWindow.hpp"
+#include "SceneFile.hpp"
 #include "Shader.hpp"
+#include "ShaderManager.hpp"
+#include "Simulation.hpp"
+#include "Terrain.hpp"
+#include "TerrainBuilder.hpp"
+#include "TerrainRenderer.hpp"
+#include "TerrainStreamer.hpp"
+#include "TiledHeightSource.hpp"
+#include "UniformRing.hpp"
 
 // Forward declarations
 struct GLFWwindow;
@@ -10,38 +27,138 @@ struct GLFWwindow;
 // Application class for rendering a heightmap mesh with custom shaders
 class MyApplication : public Application {
 public:
-	MyApplication();
+	explicit MyApplication(const ApplicationOptions& options = ApplicationOptions());
 	~MyApplication();
 
 protected:
 	// Main render loop
 	virtual void loop();
 
+	// Keeps drawing while the camera moves or background work has results
+	virtual bool needsRedraw();
+
 private:
-	static const int size = 100;  // Grid size for heightmap
+	static const int chunkSize = 32;  // Quads per terrain chunk side
+	static const size_t terrainUploadBudget = 4 << 20;  // Bytes streamed per frame
+	static const size_t uniformRingBytes = 64 << 10;    // Uniform block bytes per frame
+	static constexpr float farPlane = 100.0f;  // Far clip distance, also the DEM view distance
 
-	// Shader resources
-	Shader vertexShader;
-	Shader fragmentShader;
-	ShaderProgram shaderProgram;
+	// Shader resources; the terrain programs compile while the terrain is generated
+	ShaderManager shaderManager;
+	std::vector<ShaderManager::ProgramId> terrainPrograms;  // See getTerrainProgram()
+	std::vector<ShaderManager::ProgramId> objectPrograms;   // See getObjectProgram()
+	bool specular = true;  // Permutation with specular highlights
+	int lightCount = 1;    // Permutation shading this many lights
 
 	// Transformation matrices and light position
 	glm::mat4 projection = glm::mat4(1.0f);               // Projection matrix
 	glm::mat4 view = glm::mat4(1.0f);                     // View matrix
 	glm::mat4 model = glm::mat4(1.0f);                    // Model matrix
 	glm::vec3 lightPos = glm::vec3(10.0f, 10.0f, 10.0f);  // Light position
+	bool animateCamera = true;  // Orbit the camera around the terrain
+
+	// Camera and light updates, on their own thread unless headless
+	static constexpr double simulationTickRate = 60.0;  // Ticks per second
+	Simulation simulation;
+
+	// Chunked heightmap terrain
+	Terrain terrain;
+	TerrainRenderer terrainRenderer;
+	UniformRing uniformRing;           // Per-frame and per-object uniform blocks
+	std::vector<int> visibleChunks;    // Chunks that passed frustum culling this frame
+	std::vector<TerrainDraw> terrainDraws;  // Visible chunks with their LOD level
+	TerrainLodSettings lodSettings;    // Pixel error budget and projection
+	size_t terrainTriangles = 0;       // Triangles submitted this frame
+
+	// Objects added through the GameObject menu
+	enum ObjectType : uint32_t { Cube = 0, Sphere = 1 };
+	EntityStore objects;
+	std::unique_ptr<InstanceRenderer> instanceRenderer;  // Null without instanced arrays
+	EntityHandle selectedObject;    // Removed by GameObject > Delete
+	bool spinObjects = false;       // Rotate every root object each frame
+	size_t objectsUpdated = 0;      // Transforms recomputed this frame
+	double objectUpdateTime = 0.0;  // Seconds spent recomputing them
+
+	// Live terrain parameters, rebuilt in the background when edited
+	HeightMapParams terrainParams;        // Parameters shown in the UI
+	TerrainLodOptions lodOptions;         // Index list layout shown in the UI
+	VertexFormat vertexFormat = VertexFormat::Compact;  // Vertex layout shown in the UI
+	TerrainBuilder terrainBuilder;        // Worker thread regenerating the terrain
+	std::unique_ptr<Terrain> pendingTerrain;  // Terrain whose mesh is being streamed
+	std::chrono::steady_clock::time_point pendingRequested;  // When it was requested
+	double terrainBuildTime = 0.0;        // Worker time of the last rebuild (s)
+	double terrainRebuildLatency = 0.0;   // Request to first frame of the last rebuild (s)
 
-	// OpenGL buffer objects
-	GLuint vao;  // Vertex Array Object
-	GLuint vbo;  // Vertex Buffer Object
-	GLuint ibo;  // Index Buffer Object
+	// Height brush of the Control Panel
+	float brushPosition[2] = { 0.0f, 0.0f };  // World x/y of its centre
+	float brushRadius = 1.0f;
+	float brushStrength = 0.2f;   // Height added at the centre per click
+	size_t sculptBytes = 0;       // Uploaded by the last edit
+
+	// Scene file, from the File menu
+	std::string scenePath;                   // Empty until opened or saved
+	std::unique_ptr<SceneFile> sceneSource;  // Mapping the terrain was read from, kept
+	                                         // while the terrain has no CPU vertices
+	double sceneLoadTime = 0.0;              // Seconds the last open took
+	std::string sceneError;                  // Why the last open or save failed
+	bool openScenePrompt = false;            // Open the path prompts next frame
+	bool saveScenePrompt = false;
+	char scenePathInput[512] = {};
+
+	// Elevation tiles from File > Open DEM, drawn instead of the terrain while open
+	std::unique_ptr<TiledHeightSource> demSource;
+	std::unique_ptr<TerrainStreamer> demStreamer;  // Reads demSource, so declared after it
+	std::string demPath;
+	int tileBudgetMiB = 256;  // Decoded tile cache budget
+	int gpuBudgetMiB = 256;   // Streamed chunk vertex buffer budget
+	bool openDemPrompt = false;
+
+	// Profiling
+	GpuProfiler gpuProfiler;        // Timer queries around the scene and ImGui passes
+	ProfilerWindow profilerWindow;  // Timeline and trace export
 
 	// ImGui resources
 	bool showDemoWindow = true;
 	bool showMetrics = false;
+	bool showProfiler = false;
 	float clearColor[4] = { 0.1f, 0.1f, 0.2f, 1.0f };
 	float lightPosArray[3] = { 10.0f, 10.0f, 10.0f };
 
+	// Swaps in finished background rebuilds, a slice of upload per frame
+	void updateTerrain();
+
+	// Adds an object above the terrain, spiralling out from its centre
+	EntityHandle addObject(ObjectType type);
+
+	// Spins the objects if enabled and recomputes the changed transforms
+	void updateObjects();
+
+	// File menu: clears the objects and regenerates the default terrain, or
+	// reads or writes a scene file. Open and save report failures in the UI
+	// and return false, leaving the current scene as it was.
+	void newScene();
+	bool openScene(const std::string& path);
+	bool saveScene(const std::string& path);
+
+	// File menu: streams a DEM tile set in place of the terrain, or goes back
+	// to the terrain. Opening reports failures like openScene().
+	bool openDem(const std::string& path);
+	void closeDem();
+
+	// Path prompts of Open Scene, Save As and Open DEM
+	void drawScenePrompts();
+
+	// Raises (or, if negative, lowers) the terrain under the brush and
+	// uploads what changed
+	void sculptTerrain(float amount);
+
+	// Returns the terrain program permutation for the uploaded vertex format,
+	// or VertexType while a DEM is streamed, and the lighting options
+	ShaderProgram& getTerrainProgram();
+
+	// Returns the instanced permutation for the lighting options
+	ShaderProgram& getObjectProgram();
+
 	// ImGui initialization and rendering
 	void initImGui(GLFWwindow* windowParam);
 	void renderImGui();
@@ -0,0 +1,67 @@
+#include "Primitives.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+PrimitiveMesh makeCube(float size) {
+  PrimitiveMesh mesh;
+  const float h = 0.5f * size;
+  // One face per axis direction, four vertices each so normals stay flat
+  for (int axis = 0; axis < 3; ++axis) {
+    for (float side : {-1.0f, 1.0f}) {
+      glm::vec3 normal(0.0f);
+      normal[axis] = side;
+      // Tangents chosen so that the quads wind counter-clockwise from outside
+      glm::vec3 u(0.0f), v(0.0f);
+      u[(axis + 1) % 3] = 1.0f;
+      v[(axis + 2) % 3] = side;
+      const uint16_t base = static_cast<uint16_t>(mesh.vertices.size());
+      for (int corner = 0; corner < 4; ++corner) {
+        const float a = (corner == 1 || corner == 2) ? 1.0f : -1.0f;
+        const float b = corner >= 2 ? 1.0f : -1.0f;
+        mesh.vertices.push_back(
+            VertexType{(normal + a * u + b * v) * h, normal, glm::vec4(1.0f)});
+      }
+      for (uint16_t index : {0, 1, 2, 0, 2, 3}) {
+        mesh.indices.push_back(static_cast<uint16_t>(base + index));
+      }
+    }
+  }
+  mesh.bounds = AABB{glm::vec3(-h), glm::vec3(h)};
+  return mesh;
+}
+
+PrimitiveMesh makeSphere(float radius, int segments, int rings) {
+  if (segments < 3 || rings < 2 || (segments + 1) * (rings + 1) > 0xFFFF) {
+    throw std::runtime_error("Sphere needs 3+ segments, 2+ rings and 16-bit indices");
+  }
+  PrimitiveMesh mesh;
+  const float pi = 3.14159265358979f;
+  // Seams and poles repeat vertices so each ring is a plain grid row
+  for (int ring = 0; ring <= rings; ++ring) {
+    const float theta = pi * ring / rings;
+    for (int segment = 0; segment <= segments; ++segment) {
+      const float phi = 2.0f * pi * segment / segments;
+      const glm::vec3 normal(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+                             std::cos(theta));
+      mesh.vertices.push_back(VertexType{normal * radius, normal, glm::vec4(1.0f)});
+    }
+  }
+  const int stride = segments + 1;
+  for (int ring = 0; ring < rings; ++ring) {
+    for (int segment = 0; segment < segments; ++segment) {
+      const uint16_t a = static_cast<uint16_t>(ring * stride + segment);
+      const uint16_t b = static_cast<uint16_t>(a + stride);
+      // The triangles touching a pole would be degenerate on the other side
+      if (ring > 0) {
+        mesh.indices.insert(mesh.indices.end(), {a, b, static_cast<uint16_t>(a + 1)});
+      }
+      if (ring < rings - 1) {
+        mesh.indices.insert(mesh.indices.end(),
+                            {static_cast<uint16_t>(a + 1), b, static_cast<uint16_t>(b + 1)});
+      }
+    }
+  }
+  mesh.bounds = AABB{glm::vec3(-radius), glm::vec3(radius)};
+  return mesh;
+}
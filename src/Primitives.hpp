@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.hpp"
+#include "HeightMap.hpp"
+
+// Indexed triangle mesh of a simple shape, centred on the origin. Vertex
+// colours are white; instanced drawing supplies colours per instance.
+struct PrimitiveMesh {
+  std::vector<VertexType> vertices;
+  std::vector<uint16_t> indices;  // Triangle list
+  AABB bounds;                    // Of the vertices
+};
+
+// Returns a cube with edges of length `size` and flat faces
+PrimitiveMesh makeCube(float size = 1.0f);
+
+// Returns a UV sphere with `segments` around its axis and `rings` from pole
+// to pole
+PrimitiveMesh makeSphere(float radius = 0.5f, int segments = 24, int rings = 12);
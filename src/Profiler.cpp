@@ -0,0 +1,237 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace Profiler {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point epoch = Clock::now();
+
+// Ring buffer entry. The fields are relaxed atomics so readers may copy a
+// slot while its owner overwrites it; on common targets these are plain
+// loads and stores.
+struct Slot {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<uint64_t> start{0};
+  std::atomic<uint64_t> end{0};
+  std::atomic<uint32_t> depth{0};
+};
+
+// Events of one thread. Only the owning thread writes. As in a seqlock,
+// `begun` is bumped before a slot is overwritten and `head` after, so a
+// reader can tell which of the slots it copied may be torn.
+struct ThreadBuffer {
+  uint32_t id = 0;                 // Sequential id
+  std::string name;                // Guarded by registryMutex
+  std::unique_ptr<Slot[]> slots{new Slot[kEventsPerThread]};
+  std::atomic<uint64_t> begun{0};  // Number of events started being written
+  std::atomic<uint64_t> head{0};   // Number of events completely written
+  uint32_t depth = 0;              // Open scopes, owner thread only
+};
+
+// Buffers are shared with the registry so their events outlive the thread
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& threadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+    auto created = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    created->id = static_cast<uint32_t>(registry.size());
+    created->name = "Thread " + std::to_string(created->id);
+    registry.push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+// Frame starts and GPU events only come from the render thread, once or a
+// few times per frame, so a mutex is cheap enough
+std::mutex frameMutex;
+std::deque<uint64_t> frameStarts;
+
+constexpr size_t kGpuEventHistory = 4096;
+std::mutex gpuMutex;
+std::deque<Event> gpuEvents;
+
+// Writes `text` as a JSON string literal
+void writeJsonString(std::ostream& out, const char* text) {
+  out << '"';
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\';
+    }
+    out << *c;
+  }
+  out << '"';
+}
+
+// Writes one complete ("X") trace event; times are in microseconds
+void writeTraceEvent(std::ostream& out,
+                     const Event& event,
+                     uint32_t tid,
+                     const char* category) {
+  out << ",\n{\"name\":";
+  writeJsonString(out, event.name);
+  out << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+      << ",\"ts\":" << event.start / 1000.0
+      << ",\"dur\":" << (event.end - event.start) / 1000.0
+      << ",\"args\":{\"depth\":" << event.depth << "}}";
+}
+}  // namespace
+
+uint64_t now() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch)
+          .count());
+}
+
+void setThreadName(const std::string& name) {
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(registryMutex);
+  buffer.name = name;
+}
+
+void beginFrame() {
+  uint64_t time = now();
+  std::lock_guard<std::mutex> lock(frameMutex);
+  frameStarts.push_back(time);
+  if (frameStarts.size() > kFrameHistory) {
+    frameStarts.pop_front();
+  }
+}
+
+std::vector<uint64_t> getFrameStarts() {
+  std::lock_guard<std::mutex> lock(frameMutex);
+  return std::vector<uint64_t>(frameStarts.begin(), frameStarts.end());
+}
+
+std::vector<ThreadEvents> collectEvents() {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffers = registry;
+    for (const auto& buffer : buffers) {
+      names.push_back(buffer->name);
+    }
+  }
+
+  std::vector<ThreadEvents> result;
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    const ThreadBuffer& buffer = *buffers[b];
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+    if (head == 0) {
+      continue;
+    }
+    uint64_t first = head > kEventsPerThread ? head - kEventsPerThread : 0;
+
+    std::vector<Event> events;
+    events.reserve(head - first);
+    for (uint64_t i = first; i < head; ++i) {
+      const Slot& slot = buffer.slots[i % kEventsPerThread];
+      Event event;
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.start = slot.start.load(std::memory_order_relaxed);
+      event.end = slot.end.load(std::memory_order_relaxed);
+      event.depth = slot.depth.load(std::memory_order_relaxed);
+      events.push_back(event);
+    }
+
+    // Drop the slots the owner may have overwritten while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t begun = buffer.begun.load(std::memory_order_relaxed);
+    uint64_t valid = begun > kEventsPerThread ? begun - kEventsPerThread : 0;
+    if (valid > first) {
+      events.erase(events.begin(),
+                   events.begin() + static_cast<ptrdiff_t>(
+                                        std::min(valid - first, head - first)));
+    }
+
+    ThreadEvents thread;
+    thread.threadId = buffer.id;
+    thread.threadName = names[b];
+    thread.events = std::move(events);
+    result.push_back(std::move(thread));
+  }
+  return result;
+}
+
+void recordGpuEvent(const char* name, uint64_t cpuStart, uint64_t duration) {
+  std::lock_guard<std::mutex> lock(gpuMutex);
+  gpuEvents.push_back(Event{name, cpuStart, cpuStart + duration, 0});
+  if (gpuEvents.size() > kGpuEventHistory) {
+    gpuEvents.pop_front();
+  }
+}
+
+std::vector<Event> getGpuEvents() {
+  std::lock_guard<std::mutex> lock(gpuMutex);
+  return std::vector<Event>(gpuEvents.begin(), gpuEvents.end());
+}
+
+bool exportChromeTrace(const std::string& path) {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+
+  std::vector<ThreadEvents> threads = collectEvents();
+  std::vector<Event> gpu = getGpuEvents();
+  // GPU durations are measured with GL_TIME_ELAPSED, so they are placed at
+  // the CPU time their commands were issued on a separate track
+  const uint32_t gpuTid = 1000;
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+      << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":"
+         "\"opengl-cmake-starter-project\"}}";
+  for (const ThreadEvents& thread : threads) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << thread.threadId << ",\"args\":{\"name\":";
+    writeJsonString(out, thread.threadName.c_str());
+    out << "}}";
+    for (const Event& event : thread.events) {
+      writeTraceEvent(out, event, thread.threadId, "cpu");
+    }
+  }
+  out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpuTid
+      << ",\"args\":{\"name\":\"GPU\"}}";
+  for (const Event& event : gpu) {
+    writeTraceEvent(out, event, gpuTid, "gpu");
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+Scope::Scope(const char* name) : name(name), start(now()) {
+  ++threadBuffer().depth;
+}
+
+Scope::~Scope() {
+  uint64_t end = now();
+  ThreadBuffer& buffer = threadBuffer();
+  --buffer.depth;
+
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.begun.store(head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Slot& slot = buffer.slots[head % kEventsPerThread];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.depth.store(buffer.depth, std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+}  // namespace Profiler
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Set to 0 (CMake option ENABLE_PROFILER=OFF) to compile every PROFILE_*
+// macro to nothing
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// CPU scope profiler. Every thread records completed scopes into its own
+// fixed-size ring buffer without locks; readers copy the rings on demand for
+// the timeline window and the Chrome trace export. GPU durations measured by
+// GpuProfiler are kept alongside.
+namespace Profiler {
+
+// One completed scope
+struct Event {
+  const char* name = nullptr;  // Static string, e.g. a literal or __func__
+  uint64_t start = 0;          // Nanoseconds since the profiler epoch
+  uint64_t end = 0;            // Nanoseconds since the profiler epoch
+  uint32_t depth = 0;          // Nesting depth on the recording thread
+};
+
+// Copy of the events still held for one thread, ordered by end time
+struct ThreadEvents {
+  uint32_t threadId = 0;   // Sequential id in registration order
+  std::string threadName;  // Name from setThreadName(), or "Thread <id>"
+  std::vector<Event> events;
+};
+
+// Events kept per thread before the oldest are overwritten
+constexpr size_t kEventsPerThread = 1 << 14;
+
+// Frame starts kept for the timeline
+constexpr size_t kFrameHistory = 256;
+
+// Returns nanoseconds since the profiler epoch (first use)
+uint64_t now();
+
+// Names the calling thread in the timeline and trace
+void setThreadName(const std::string& name);
+
+// Marks the start of a frame; called by the render loop
+void beginFrame();
+
+// Returns the start times of recent frames, oldest first
+std::vector<uint64_t> getFrameStarts();
+
+// Copies the events of every thread that recorded any
+std::vector<ThreadEvents> collectEvents();
+
+// Stores a GPU duration; `cpuStart` places it on the timeline
+void recordGpuEvent(const char* name, uint64_t cpuStart, uint64_t duration);
+
+// Returns the recent GPU events, oldest first
+std::vector<Event> getGpuEvents();
+
+// Writes all held CPU and GPU events in the Chrome trace event format
+// (chrome://tracing, Perfetto). Returns false if the file cannot be written.
+bool exportChromeTrace(const std::string& path);
+
+// Records the lifetime of a scope on the calling thread
+class Scope {
+ public:
+  explicit Scope(const char* name);
+  ~Scope();
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  const char* name;  // Scope name
+  uint64_t start;    // Start time
+};
+
+}  // namespace Profiler
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) \
+  ::Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_FRAME() ::Profiler::beginFrame()
+#define PROFILE_THREAD(name) ::Profiler::setThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,135 @@
+#include "ProfilerWindow.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+#include "imgui.h"
+
+namespace {
+// Returns a stable colour for a scope name
+ImU32 scopeColor(const char* name) {
+  static const ImU32 palette[] = {
+      IM_COL32(86, 156, 214, 255),  IM_COL32(78, 201, 176, 255),
+      IM_COL32(220, 160, 90, 255),  IM_COL32(197, 134, 192, 255),
+      IM_COL32(156, 220, 110, 255), IM_COL32(214, 110, 110, 255),
+      IM_COL32(206, 190, 120, 255), IM_COL32(120, 140, 220, 255),
+  };
+  size_t hash = std::hash<std::string_view>()(name);
+  return palette[hash % (sizeof(palette) / sizeof(palette[0]))];
+}
+}  // namespace
+
+void ProfilerWindow::draw(bool* open) {
+  if (!ImGui::Begin("Profiler", open)) {
+    ImGui::End();
+    return;
+  }
+
+  if (!paused) {
+    frameStarts = Profiler::getFrameStarts();
+    threads = Profiler::collectEvents();
+    gpuEvents = Profiler::getGpuEvents();
+  }
+
+#if !PROFILER_ENABLED
+  ImGui::TextDisabled("Profiling was disabled at compile time (ENABLE_PROFILER=OFF)");
+#endif
+
+  ImGui::Checkbox("Pause", &paused);
+  ImGui::SameLine();
+  if (ImGui::Button("Export Chrome Trace")) {
+    exportStatus = Profiler::exportChromeTrace(exportPath)
+                       ? "Wrote " + exportPath
+                       : "Could not write " + exportPath;
+  }
+  if (!exportStatus.empty()) {
+    ImGui::SameLine();
+    ImGui::TextUnformatted(exportStatus.c_str());
+  }
+
+  if (frameStarts.size() < 3) {
+    ImGui::TextDisabled("Waiting for frames...");
+    ImGui::End();
+    return;
+  }
+
+  // Frame time history
+  std::vector<float> frameTimes;
+  for (size_t i = 1; i < frameStarts.size(); ++i) {
+    frameTimes.push_back((frameStarts[i] - frameStarts[i - 1]) / 1e6f);
+  }
+  float worst = *std::max_element(frameTimes.begin(), frameTimes.end());
+  ImGui::PlotLines("##FrameTimes", frameTimes.data(),
+                   static_cast<int>(frameTimes.size()), 0, "Frame time (ms)",
+                   0.0f, std::max(worst, 1.0f),
+                   ImVec2(ImGui::GetContentRegionAvail().x, 60.0f));
+
+  // The newest frame is still running, so count back from the one before
+  const int completeFrames = static_cast<int>(frameStarts.size()) - 1;
+  ImGui::SliderInt("Frames Back", &frameOffset, 0, completeFrames - 1);
+  frameOffset = std::clamp(frameOffset, 0, completeFrames - 1);
+  const size_t frame = frameStarts.size() - 2 - frameOffset;
+  const uint64_t frameStart = frameStarts[frame];
+  const uint64_t frameEnd = frameStarts[frame + 1];
+  ImGui::Text("Frame: %.3f ms", (frameEnd - frameStart) / 1e6);
+
+  ImGui::Separator();
+  for (const Profiler::ThreadEvents& thread : threads) {
+    drawLane(thread.threadName.c_str(), thread.events, frameStart, frameEnd);
+  }
+  drawLane("GPU", gpuEvents, frameStart, frameEnd);
+
+  ImGui::End();
+}
+
+void ProfilerWindow::drawLane(const char* label,
+                              const std::vector<Profiler::Event>& events,
+                              uint64_t frameStart,
+                              uint64_t frameEnd) {
+  uint32_t depths = 0;
+  for (const Profiler::Event& event : events) {
+    if (event.end > frameStart && event.start < frameEnd) {
+      depths = std::max(depths, event.depth + 1);
+    }
+  }
+  if (depths == 0) {
+    return;
+  }
+
+  ImGui::TextUnformatted(label);
+  const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+  const ImVec2 origin = ImGui::GetCursorScreenPos();
+  const float width = ImGui::GetContentRegionAvail().x;
+  const double scale = width / static_cast<double>(frameEnd - frameStart);
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  const ImVec2 laneMax(origin.x + width, origin.y + rowHeight * depths);
+  drawList->PushClipRect(origin, laneMax, true);
+
+  for (const Profiler::Event& event : events) {
+    if (event.end <= frameStart || event.start >= frameEnd) {
+      continue;
+    }
+    // Clamp scopes that cross the frame boundaries
+    uint64_t start = std::max(event.start, frameStart);
+    uint64_t end = std::min(event.end, frameEnd);
+    ImVec2 min(origin.x + static_cast<float>((start - frameStart) * scale),
+               origin.y + rowHeight * event.depth);
+    ImVec2 max(std::max(min.x + 1.0f,
+                        origin.x + static_cast<float>((end - frameStart) * scale)),
+               min.y + rowHeight - 1.0f);
+    drawList->AddRectFilled(min, max, scopeColor(event.name));
+    if (max.x - min.x > 30.0f) {
+      drawList->PushClipRect(min, max, true);
+      drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255),
+                        event.name);
+      drawList->PopClipRect();
+    }
+    if (ImGui::IsMouseHoveringRect(min, max)) {
+      ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1e6);
+    }
+  }
+
+  drawList->PopClipRect();
+  ImGui::Dummy(ImVec2(width, rowHeight * depths));
+}
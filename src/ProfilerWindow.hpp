@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Profiler.hpp"
+
+// ImGui window showing the profiler data: a frame time graph, a timeline of
+// one frame with a lane per thread (scopes stacked by depth) plus a GPU lane,
+// and a button that exports the held events as a Chrome trace.
+class ProfilerWindow {
+ public:
+  // Draws the window; `open` is cleared when it is closed
+  void draw(bool* open);
+
+ private:
+  // Draws the scopes of one lane that overlap [frameStart, frameEnd)
+  void drawLane(const char* label,
+                const std::vector<Profiler::Event>& events,
+                uint64_t frameStart,
+                uint64_t frameEnd);
+
+  bool paused = false;     // Keep showing the same snapshot
+  int frameOffset = 0;     // Frames back from the last complete one
+  std::string exportPath = "trace.json";  // Chrome trace destination
+  std::string exportStatus;               // Result of the last export
+
+  // Snapshot shown by the window
+  std::vector<uint64_t> frameStarts;
+  std::vector<Profiler::ThreadEvents> threads;
+  std::vector<Profiler::Event> gpuEvents;
+};
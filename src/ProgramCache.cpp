@@ -0,0 +1,235 @@
+#include "ProgramCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace ProgramCache {
+
+namespace {
+constexpr char kMagic[4] = {'G', 'L', 'P', 'B'};
+constexpr uint32_t kVersion = 1;
+
+// Precedes the binary in every entry
+struct EntryHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;       // Must match the file name's key
+  uint32_t format;    // Binary format reported by glGetProgramBinary
+  uint32_t length;    // Bytes of binary following the header
+  uint64_t checksum;  // Hash of the binary
+};
+
+// Whether the driver supports binaries: unknown until first queried
+enum class Support { Unknown, Yes, No };
+
+std::string directory;
+Support support = Support::Unknown;
+std::vector<GLint> formats;  // GL_PROGRAM_BINARY_FORMATS
+Stats stats;
+
+// 64-bit FNV-1a, continuing from `hash`
+uint64_t fnv1a(const void* data, size_t size,
+               uint64_t hash = 14695981039346656037ull) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+std::filesystem::path entryPath(uint64_t key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "program-%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return std::filesystem::path(directory) / name;
+}
+
+// Deletes an entry that cannot be used
+void discard(const std::filesystem::path& path, const char* reason) {
+  std::cerr << "Warning: Discarding shader cache entry " << path.string() << ": "
+            << reason << std::endl;
+  std::error_code error;
+  std::filesystem::remove(path, error);
+  ++stats.discarded;
+}
+}  // namespace
+
+std::string defaultDirectory() {
+  std::filesystem::path base;
+  if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome) {
+    base = cacheHome;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    base = std::filesystem::path(home) / ".cache";
+  } else {
+    return "shader-cache";
+  }
+  return (base / "opengl-cmake-starter-project" / "shaders").string();
+}
+
+void setDirectory(const std::string& path) {
+  directory = path;
+}
+
+const std::string& getDirectory() {
+  return directory;
+}
+
+bool isAvailable() {
+  if (directory.empty()) {
+    return false;
+  }
+  if (support == Support::Unknown) {
+    support = Support::No;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+      GLint count = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+      if (count > 0) {
+        formats.resize(count);
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        support = Support::Yes;
+      }
+    }
+    if (support == Support::No) {
+      std::cout << "[Info] Driver has no program binary formats, shader cache disabled"
+                << std::endl;
+    }
+  }
+  return support == Support::Yes;
+}
+
+uint64_t makeKey(const std::vector<std::string_view>& parts) {
+  uint64_t hash = fnv1a(&kVersion, sizeof(kVersion));
+  // A zero byte after every part keeps ("ab", "c") apart from ("a", "bc")
+  auto add = [&](std::string_view part) {
+    hash = fnv1a(part.data(), part.size(), hash);
+    hash = fnv1a("", 1, hash);
+  };
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const auto* value = reinterpret_cast<const char*>(glGetString(name));
+    add(value ? value : "");
+  }
+  for (std::string_view part : parts) {
+    add(part);
+  }
+  return hash;
+}
+
+bool load(GLuint program, uint64_t key) {
+  if (!isAvailable()) {
+    return false;
+  }
+  const std::filesystem::path path = entryPath(key);
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  EntryHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.key != key) {
+    discard(path, "bad header");
+    return false;
+  }
+  // Check the length against the file before allocating, so a corrupt
+  // header cannot ask for gigabytes
+  std::error_code error;
+  const uintmax_t fileSize = std::filesystem::file_size(path, error);
+  if (error || fileSize != sizeof(header) + static_cast<uintmax_t>(header.length)) {
+    discard(path, "truncated or corrupt");
+    return false;
+  }
+  std::vector<char> binary(header.length);
+  if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size())) ||
+      fnv1a(binary.data(), binary.size()) != header.checksum) {
+    discard(path, "truncated or corrupt");
+    return false;
+  }
+  if (std::find(formats.begin(), formats.end(), static_cast<GLint>(header.format)) ==
+      formats.end()) {
+    discard(path, "binary format not supported by the driver");
+    return false;
+  }
+
+  glProgramBinary(program, header.format, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    discard(path, "rejected by the driver");
+    return false;
+  }
+  return true;
+}
+
+void prepare(GLuint program) {
+  if (isAvailable()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void store(GLuint program, uint64_t key) {
+  if (!isAvailable()) {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  binary.resize(length);
+
+  EntryHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.key = key;
+  header.format = format;
+  header.length = static_cast<uint32_t>(binary.size());
+  header.checksum = fnv1a(binary.data(), binary.size());
+
+  // Write to a temporary file and rename it, so a crash or a concurrent
+  // instance never leaves a half-written entry under the real name
+  const std::filesystem::path path = entryPath(key);
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!file) {
+      std::cerr << "Warning: Could not write shader cache entry " << temporary.string()
+                << std::endl;
+      file.close();
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::cerr << "Warning: Could not write shader cache entry " << path.string()
+              << ": " << error.message() << std::endl;
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+void record(bool loaded, double milliseconds) {
+  ++(loaded ? stats.loaded : stats.compiled);
+  stats.milliseconds += milliseconds;
+}
+
+const Stats& getStats() {
+  return stats;
+}
+
+}  // namespace ProgramCache
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-disk cache of linked program binaries (ARB_get_program_binary). Entries
+// are keyed by a hash of the exact shader sources given to the compiler and
+// of the driver's vendor, renderer and version strings, so editing a shader
+// or updating the driver selects a new entry. Entries that fail their
+// checksum or that the driver refuses are deleted, and the program is
+// compiled as usual.
+namespace ProgramCache {
+
+// Program creation counters of this process
+struct Stats {
+  int loaded = 0;             // Programs created from a cache entry
+  int compiled = 0;           // Programs compiled and linked from source
+  int discarded = 0;          // Corrupt or stale entries deleted
+  double milliseconds = 0.0;  // Total time spent creating programs
+};
+
+// Returns $XDG_CACHE_HOME or ~/.cache, followed by the project's directory
+std::string defaultDirectory();
+
+// Selects the cache directory; an empty string disables the cache
+void setDirectory(const std::string& directory);
+
+// Returns the cache directory, empty if the cache is disabled
+const std::string& getDirectory();
+
+// Returns true if the cache is enabled and the driver exposes at least one
+// binary format; requires a current context
+bool isAvailable();
+
+// Hashes the source parts together with the driver strings
+uint64_t makeKey(const std::vector<std::string_view>& parts);
+
+// Replaces the program with the binary cached under `key`. Returns false if
+// there is no usable entry; the program is then left unlinked.
+bool load(GLuint program, uint64_t key);
+
+// Asks the driver to keep the binary of a program about to be linked
+void prepare(GLuint program);
+
+// Writes the binary of a linked program under `key`; failures only warn
+void store(GLuint program, uint64_t key);
+
+// Counts one created program
+void record(bool loaded, double milliseconds);
+
+// Returns the counters so far
+const Stats& getStats();
+
+}  // namespace ProgramCache
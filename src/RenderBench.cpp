@@ -0,0 +1,181 @@
+#include "RenderBench.hpp"
+
+#include <GLFW/glfw3.h>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stdexcept>
+
+#include "Frustum.hpp"
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Primitives.hpp"
+#include "ThreadPool.hpp"
+#include "asset.hpp"
+#include "glError.hpp"
+
+namespace {
+// Grid of `size` quads per side with the default spacing and surface
+HeightMapParams makeTerrainParams(int size) {
+  HeightMapParams params;
+  params.size = size;
+  return params;
+}
+
+// Milliseconds between two steady clock points
+double milliseconds(std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+}  // namespace
+
+RenderBench::RenderBench(const ApplicationOptions& options, int size, bool lod, int objects)
+    : Application(options),
+      frameCount(options.frameCount),
+      shaderManager(SHADER_DIR, false),
+      shaderProgram(shaderManager.get(shaderManager.add(
+          getTerrainShaderStages(), makeTerrainDefines(VertexFormat::Compact, true, 1),
+          TerrainAttributes::getLocations()))),
+      terrain(makeTerrainParams(size), chunkSize),
+      uniformRing(4096) {
+  if (frameCount <= 0) {
+    throw std::runtime_error("RenderBench needs a frame count");
+  }
+  lodSettings.enabled = lod;
+  TerrainUniforms::bindBlocks(shaderProgram);
+  terrainRenderer.upload(terrain, VertexFormat::Compact);
+  if (objects > 0) {
+    if (!InstanceRenderer::isSupported()) {
+      throw std::runtime_error("Drawing objects needs instanced arrays");
+    }
+    objectProgram = &shaderManager.get(shaderManager.add(
+        getTerrainShaderStages(), makeTerrainDefines(VertexFormat::Full, true, 1, true),
+        TerrainAttributes::getLocations()));
+    TerrainUniforms::bindBlocks(*objectProgram, true);
+    instanceRenderer = std::make_unique<InstanceRenderer>();
+    instanceRenderer->addMesh(0, makeCube(), glm::vec4(0.9f, 0.5f, 0.2f, 1.0f));
+    instanceRenderer->addMesh(1, makeSphere(), glm::vec4(0.3f, 0.5f, 0.9f, 1.0f));
+    addObjects(objects);
+  }
+
+  // Same check as GpuProfiler; without timer queries only CPU times exist
+  timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (timerQueries) {
+    queries.resize(frameCount);
+    glGenQueries(frameCount, queries.data());
+  }
+  result.cpuTimes.reserve(frameCount);
+  result.frameTimes.reserve(frameCount);
+  GL_CHECK_ERROR();
+}
+
+void RenderBench::loop() {
+  const auto frameStart = std::chrono::steady_clock::now();
+  if (frame > 0) {
+    result.frameTimes.push_back(milliseconds(lastFrameStart, frameStart));
+  }
+  lastFrameStart = frameStart;
+  // Frames finish in order, at most one per frame once the queue is full
+  const FramePacer::Stats& pacing = getFramePacer().getStats();
+  if (pacing.latencySamples > latencySamples) {
+    latencySamples = pacing.latencySamples;
+    result.latencies.push_back(pacing.lastLatencyMs);
+  }
+
+  if (!isHeadless() && glfwWindowShouldClose(getWindow())) {
+    exit();
+    return;
+  }
+
+  // Orbit the terrain like the CPU LOD benchmark does
+  const float extent = terrain.getParams().size * terrain.getParams().spacing;
+  const float angle = getTime();
+  const glm::vec3 eye(0.3f * extent * std::sin(angle), 0.3f * extent * std::cos(angle),
+                      0.05f * extent);
+  const glm::mat4 projection =
+      glm::perspective(lodSettings.fieldOfView, getWindowRatio(), 0.1f, extent);
+  const glm::mat4 view =
+      glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+  const Frustum frustum(projection * view);
+  terrain.cull(frustum, visibleChunks);
+  lodSettings.viewportHeight = static_cast<float>(getHeight());
+  terrain.selectLod(lodSettings, eye, visibleChunks, terrainDraws);
+
+  GLState::viewport(0, 0, getWidth(), getHeight());
+  glClearColor(0.1f, 0.1f, 0.2f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  if (timerQueries) {
+    glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+  }
+  DebugGroup debugGroup("Terrain");
+  uniformRing.beginFrame();
+  shaderProgram.use();
+  const TerrainUniforms::FrameBlock frameBlock{
+      projection, view, {glm::vec4(0.0f, 0.0f, 0.3f * extent, 1.0f)}};
+  uniformRing.bind(TerrainUniforms::kFrameBinding, uniformRing.push(frameBlock));
+  uniformRing.bind(TerrainUniforms::kObjectBinding,
+                   uniformRing.push(TerrainUniforms::makeObjectBlock(glm::mat4(1.0f))));
+  triangles += terrainRenderer.draw(terrain, terrainDraws, shaderProgram);
+  if (instanceRenderer) {
+    // Spin every object so that all transforms and instances are rewritten
+    const glm::quat spin = glm::angleAxis(0.02f, glm::vec3(0.0f, 0.0f, 1.0f));
+    for (EntityHandle object : objects.getHandles()) {
+      objects.setRotation(object, spin * objects.getRotation(object));
+    }
+    objects.updateTransforms(ThreadPool::shared());
+    objectProgram->use();
+    const InstanceRenderer::Stats& stats =
+        instanceRenderer->draw(objects, frustum, ThreadPool::shared());
+    instances += stats.instances;
+    drawCalls += stats.drawCalls;
+  }
+  uniformRing.endFrame();
+  if (timerQueries) {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  result.cpuTimes.push_back(milliseconds(frameStart, std::chrono::steady_clock::now()));
+
+  if (isHeadless()) {
+    glFinish();
+  }
+
+  ++frame;
+  if (frame == frameCount) {
+    result.trianglesPerFrame = static_cast<double>(triangles) / frameCount;
+    result.instancesPerFrame = static_cast<double>(instances) / frameCount;
+    result.drawCallsPerFrame = static_cast<double>(drawCalls) / frameCount;
+    result.stateCallsIssued = GLState::getLastFrame().issued;
+    result.stateCallsSkipped = GLState::getLastFrame().skipped;
+    readGpuTimes();
+  }
+}
+
+void RenderBench::readGpuTimes() {
+  if (!timerQueries) {
+    return;
+  }
+  // The run is over, so waiting for the results no longer skews the timings
+  result.gpuTimes.reserve(frame);
+  for (int i = 0; i < frame; ++i) {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+    result.gpuTimes.push_back(elapsed / 1e6);
+  }
+  glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+  queries.clear();
+  timerQueries = false;
+}
+
+void RenderBench::addObjects(int count) {
+  const float extent = terrain.getParams().size * terrain.getParams().spacing;
+  const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+  const float step = extent / side;
+  const float height = terrain.getParams().heightScale + 1.0f;
+  for (int i = 0; i < count; ++i) {
+    const glm::vec3 position((i % side + 0.5f) * step - 0.5f * extent,
+                             (i / side + 0.5f) * step - 0.5f * extent, height);
+    objects.create(static_cast<uint32_t>(i % 2), position);
+  }
+}
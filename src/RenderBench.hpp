@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Application.hpp"
+#include "EntityStore.hpp"
+#include "InstanceRenderer.hpp"
+#include "Shader.hpp"
+#include "ShaderManager.hpp"
+#include "Terrain.hpp"
+#include "TerrainRenderer.hpp"
+#include "UniformRing.hpp"
+
+// Per-frame measurements of a render benchmark run, in milliseconds
+struct RenderBenchResult {
+  std::vector<double> cpuTimes;    // Culling, LOD selection and draw submission
+  std::vector<double> gpuTimes;    // GL_TIME_ELAPSED of the terrain draws
+  std::vector<double> frameTimes;  // Between the starts of consecutive frames
+  std::vector<double> latencies;   // Input poll to GPU completion, see FramePacer
+  double trianglesPerFrame = 0.0;  // Mean triangles submitted
+  uint64_t stateCallsIssued = 0;   // GLState calls of the last complete frame
+  uint64_t stateCallsSkipped = 0;  // ... and those skipped as redundant
+  double instancesPerFrame = 0.0;  // Mean objects drawn instanced
+  double drawCallsPerFrame = 0.0;  // Mean instanced draw calls
+};
+
+// Draws the terrain, and optionally spinning objects scattered over it, from a
+// camera orbiting at a fixed timestep, like MyApplication without the ImGui
+// overlay, and records per-frame timings.
+// Headless runs have no swap to throttle them, so each frame waits for the
+// GPU at its end and frame times cover rendering, not just submission.
+class RenderBench : public Application {
+ public:
+  // Generates and uploads a terrain of `size` quads per side and scatters
+  // `objects` cubes and spheres over it; the options must set a frame count
+  RenderBench(const ApplicationOptions& options, int size, bool lod, int objects = 0);
+
+  // Returns the measurements; complete once run() returned
+  const RenderBenchResult& getResult() const { return result; }
+
+ protected:
+  // Renders one frame and records its timings
+  void loop() override;
+
+ private:
+  static const int chunkSize = 16;  // Quads per terrain chunk side
+
+  // Waits for and collects the timer queries of every frame
+  void readGpuTimes();
+
+  // Adds `count` objects on a grid over the terrain, alternating cubes and
+  // spheres
+  void addObjects(int count);
+
+  int frameCount;                  // Frames the run renders
+  TerrainLodSettings lodSettings;  // LOD budget, disabled by --lod off
+
+  ShaderManager shaderManager;
+  ShaderProgram& shaderProgram;    // Compact, specular, one light
+  Terrain terrain;
+  TerrainRenderer terrainRenderer;
+  UniformRing uniformRing;
+  std::vector<int> visibleChunks;
+  std::vector<TerrainDraw> terrainDraws;
+  EntityStore objects;
+  std::unique_ptr<InstanceRenderer> instanceRenderer;  // Null without objects
+  ShaderProgram* objectProgram = nullptr;  // Instanced, specular, one light
+
+  bool timerQueries = false;   // GL_TIME_ELAPSED is available
+  std::vector<GLuint> queries; // One timer query per frame
+  int frame = 0;               // Frames rendered so far
+  size_t triangles = 0;        // Triangles submitted over all frames
+  size_t instances = 0;        // Objects drawn over all frames
+  size_t drawCalls = 0;        // Instanced draws over all frames
+  std::chrono::steady_clock::time_point lastFrameStart;
+  uint64_t latencySamples = 0;  // FramePacer samples already recorded
+  RenderBenchResult result;
+};
@@ -0,0 +1,392 @@
+#include "SceneFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Profiler.hpp"
+
+using namespace SceneFormat;
+
+namespace {
+static_assert(sizeof(Header) + kMaxSections * sizeof(Section) <= kAlignment,
+              "The section table must fit in front of the first section");
+static_assert(std::is_trivially_copyable_v<TerrainChunk> && sizeof(TerrainChunk) == 68,
+              "TerrainChunk is stored as is; a layout change needs a new version");
+static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::quat) == 16 && sizeof(AABB) == 24,
+              "Object components are stored as is");
+
+constexpr size_t kVertexBatch = 1 << 16;  // Vertices compressed per write
+constexpr char kZeros[kAlignment] = {};
+
+// Writes sections one after another, each padded to kAlignment, and the
+// header and section table last, into the space reserved at the start
+class SectionWriter {
+ public:
+  explicit SectionWriter(const std::filesystem::path& path)
+      : path(path), out(path, std::ios::binary | std::ios::trunc) {
+    if (!out) {
+      throw std::runtime_error("Cannot create " + path.string());
+    }
+    // Room for the header and the section table
+    write(kZeros, kAlignment);
+  }
+
+  // Starts a section of `count` elements of `elementSize` bytes
+  void begin(SectionType type, uint32_t elementSize, uint64_t count) {
+    if (sections.size() == kMaxSections) {
+      throw std::runtime_error("Too many sections in " + path.string());
+    }
+    sections.push_back(Section{static_cast<uint32_t>(type), elementSize, count, position,
+                               uint64_t(elementSize) * count});
+  }
+
+  // Appends to the current section
+  void write(const void* data, size_t bytes) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    position += bytes;
+  }
+
+  // Ends the current section, checking that it got all its elements
+  void end() {
+    const Section& section = sections.back();
+    if (position - section.offset != section.size) {
+      throw std::runtime_error("Scene section " + std::to_string(section.type) + " has " +
+                               std::to_string(position - section.offset) +
+                               " bytes, expected " + std::to_string(section.size));
+    }
+    pad();
+  }
+
+  // Writes a whole section from an array
+  template <typename T>
+  void writeArray(SectionType type, const T* data, size_t count) {
+    begin(type, sizeof(T), count);
+    write(data, count * sizeof(T));
+    end();
+  }
+
+  // Writes the header and the section table and closes the file
+  void finish() {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.fileSize = position;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sections.data()),
+              static_cast<std::streamsize>(sections.size() * sizeof(Section)));
+    out.close();
+    if (!out) {
+      throw std::runtime_error("Cannot write " + path.string());
+    }
+  }
+
+ private:
+  // Zero-fills up to the next kAlignment boundary
+  void pad() {
+    const uint64_t padding = (kAlignment - position % kAlignment) % kAlignment;
+    write(kZeros, padding);
+    if (!out) {
+      throw std::runtime_error("Cannot write " + path.string());
+    }
+  }
+
+  std::filesystem::path path;
+  std::ofstream out;
+  uint64_t position = 0;
+  std::vector<Section> sections;
+};
+
+// Writes the vertices of a terrain that has them in `format`
+void writeVertices(SectionWriter& writer, const Terrain& terrain, VertexFormat format) {
+  const std::vector<VertexType>& vertices = terrain.getVertices();
+  if (format == VertexFormat::Displaced) {
+    // The (size + 1)^2 grid heights, a batch of rows at a time
+    const int side = terrain.getParams().verticesPerSide();
+    writer.begin(SectionType::TerrainVertices, sizeof(float), terrain.getParams().vertexCount());
+    const int rows = std::max(static_cast<int>(kVertexBatch / side), 1);
+    std::vector<float> batch(static_cast<size_t>(std::min(rows, side)) * side);
+    for (int first = 0; first < side; first += rows) {
+      const int count = std::min(rows, side - first);
+      terrain.getHeights({0, first, side, count}, batch.data());
+      writer.write(batch.data(), static_cast<size_t>(count) * side * sizeof(float));
+    }
+    writer.end();
+    return;
+  }
+  if (format == VertexFormat::Full) {
+    writer.writeArray(SectionType::TerrainVertices, vertices.data(), vertices.size());
+    return;
+  }
+  writer.begin(SectionType::TerrainVertices, sizeof(CompactVertexType), vertices.size());
+  std::vector<CompactVertexType> batch(std::min(kVertexBatch, vertices.size()));
+  for (size_t first = 0; first < vertices.size(); first += batch.size()) {
+    const size_t count = std::min(batch.size(), vertices.size() - first);
+    compressVertices(vertices.data() + first, count, batch.data());
+    writer.write(batch.data(), count * sizeof(CompactVertexType));
+  }
+  writer.end();
+}
+}  // namespace
+
+SceneFile::SceneFile(const std::string& path) : file(path) {
+  PROFILE_FUNCTION();
+  const uint64_t fileSize = file.size();
+  if (fileSize < sizeof(Header)) {
+    throw std::runtime_error(path + " is not a scene file");
+  }
+  header = reinterpret_cast<const Header*>(file.data());
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error(path + " is not a scene file");
+  }
+  if (header->version != kVersion) {
+    throw std::runtime_error(path + " has scene format version " +
+                             std::to_string(header->version) + ", this build reads " +
+                             std::to_string(kVersion));
+  }
+  if (header->fileSize != fileSize || header->sectionCount > kMaxSections ||
+      sizeof(Header) + header->sectionCount * sizeof(Section) > fileSize) {
+    throw std::runtime_error(path + " is truncated or corrupt");
+  }
+  sections = reinterpret_cast<const Section*>(file.data() + sizeof(Header));
+  for (uint32_t i = 0; i < header->sectionCount; ++i) {
+    const Section& section = sections[i];
+    if (section.offset % kAlignment != 0 || section.offset > fileSize ||
+        section.size > fileSize - section.offset ||
+        (section.elementSize == 0 ? section.count != 0
+                                  : section.count != section.size / section.elementSize ||
+                                        section.size % section.elementSize != 0)) {
+      throw std::runtime_error(path + " has a corrupt section table");
+    }
+  }
+
+  uint64_t count = 0;
+  terrain = getArray<TerrainRecord>(SectionType::Terrain, count);
+  if (count != 1) {
+    throw std::runtime_error(path + " has no terrain");
+  }
+}
+
+const Section* SceneFile::findSection(SectionType type) const {
+  for (uint32_t i = 0; i < header->sectionCount; ++i) {
+    if (sections[i].type == static_cast<uint32_t>(type)) {
+      return &sections[i];
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+const T* SceneFile::getArray(SectionType type, uint64_t& count) const {
+  const Section* section = findSection(type);
+  if (!section) {
+    throw std::runtime_error(file.getPath() + " has no section " +
+                             std::to_string(static_cast<uint32_t>(type)));
+  }
+  if (section->elementSize != sizeof(T)) {
+    throw std::runtime_error(file.getPath() + " section " +
+                             std::to_string(static_cast<uint32_t>(type)) + " has " +
+                             std::to_string(section->elementSize) + " byte elements, expected " +
+                             std::to_string(sizeof(T)));
+  }
+  count = section->count;
+  return reinterpret_cast<const T*>(file.data() + section->offset);
+}
+
+VertexFormat SceneFile::getVertexFormat() const {
+  switch (terrain->vertexFormat) {
+    case 1:
+      return VertexFormat::Compact;
+    case 2:
+      return VertexFormat::Displaced;
+    default:
+      return VertexFormat::Full;
+  }
+}
+
+Terrain SceneFile::makeTerrain() const {
+  PROFILE_FUNCTION();
+  const int chunkSize = terrain->chunkSize;
+  if (chunkSize <= 0 || chunkSize > (1 << (TerrainLod::kMaxLevels - 1)) ||
+      (chunkSize & (chunkSize - 1)) != 0 || terrain->size <= 0 || terrain->vertexFormat > 2 ||
+      (terrain->indexSize != 2 && terrain->indexSize != 4)) {
+    throw std::runtime_error(file.getPath() + " has invalid terrain parameters");
+  }
+  HeightMapParams params;
+  params.size = terrain->size;
+  params.spacing = terrain->spacing;
+  params.heightScale = terrain->heightScale;
+  params.frequency = terrain->frequency;
+  TerrainLodOptions lodOptions;
+  lodOptions.optimizeVertexCache = (terrain->lodFlags & kLodVertexCache) != 0;
+  lodOptions.triangleStrips = (terrain->lodFlags & kLodStrips) != 0;
+
+  uint64_t chunkCount = 0;
+  const TerrainChunk* chunks = getArray<TerrainChunk>(SectionType::TerrainChunks, chunkCount);
+  Terrain result(params, chunkSize, lodOptions,
+                 std::vector<TerrainChunk>(chunks, chunks + chunkCount));
+
+  // Draws index the vertex blob through the chunk positions and base
+  // vertices, so they must be the ones the terrain lays the chunks out with
+  const int chunksPerSide = result.getChunksPerSide();
+  const int verticesPerChunk = result.getVerticesPerChunk();
+  for (uint64_t i = 0; i < chunkCount; ++i) {
+    const int chunk = static_cast<int>(i);
+    if (chunks[i].chunkX != chunk % chunksPerSide || chunks[i].chunkY != chunk / chunksPerSide ||
+        chunks[i].baseVertex != chunk * verticesPerChunk) {
+      throw std::runtime_error(file.getPath() + " has an invalid chunk table entry " +
+                               std::to_string(i));
+    }
+  }
+
+  // The index lists are rebuilt from the chunk size and options, and the
+  // stored ones are drawn with their ranges, so both must agree
+  const Section* vertices = findSection(SectionType::TerrainVertices);
+  const Section* indices = findSection(SectionType::TerrainIndices);
+  const uint32_t vertexSize = static_cast<uint32_t>(getVertexSize(getVertexFormat()));
+  const uint64_t vertexCount = getVertexFormat() == VertexFormat::Displaced
+                                   ? params.vertexCount()
+                                   : chunkCount * result.getVerticesPerChunk();
+  if (!vertices || vertices->elementSize != vertexSize || vertices->count != vertexCount) {
+    throw std::runtime_error(file.getPath() + " has no vertices matching its chunks");
+  }
+  if (!indices || indices->elementSize != terrain->indexSize ||
+      indices->count != result.getLod().getIndices().size()) {
+    throw std::runtime_error(file.getPath() +
+                             " has no index lists matching its chunk size and LOD options");
+  }
+  TerrainMesh rebuilt;
+  buildTerrainIndices(result, rebuilt);
+  if (rebuilt.indices.size() != indices->size ||
+      std::memcmp(rebuilt.indices.data(), file.data() + indices->offset, indices->size) != 0) {
+    throw std::runtime_error(file.getPath() + " has index lists that do not match its LOD options");
+  }
+  return result;
+}
+
+TerrainMeshView SceneFile::getMesh() const {
+  const Section* vertices = findSection(SectionType::TerrainVertices);
+  const Section* indices = findSection(SectionType::TerrainIndices);
+  if (!vertices || !indices) {
+    throw std::runtime_error(file.getPath() + " has no terrain mesh");
+  }
+  file.willNeed(vertices->offset, vertices->size);
+  file.willNeed(indices->offset, indices->size);
+
+  TerrainMeshView mesh;
+  mesh.vertexFormat = getVertexFormat();
+  mesh.vertices = file.data() + vertices->offset;
+  mesh.vertexBytes = vertices->size;
+  mesh.gridSize = terrain->size;
+  mesh.indexType = terrain->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  mesh.indices = file.data() + indices->offset;
+  mesh.indexBytes = indices->size;
+  mesh.strips = (terrain->lodFlags & kLodStrips) != 0;
+  return mesh;
+}
+
+void SceneFile::readObjects(EntityStore& objects) const {
+  PROFILE_FUNCTION();
+  if (!findSection(SectionType::ObjectTypes)) {
+    objects.clear();
+    return;
+  }
+  uint64_t count = 0, positions = 0, rotations = 0, scales = 0, parents = 0, bounds = 0;
+  const uint32_t* typeData = getArray<uint32_t>(SectionType::ObjectTypes, count);
+  const glm::vec3* positionData = getArray<glm::vec3>(SectionType::ObjectPositions, positions);
+  const glm::quat* rotationData = getArray<glm::quat>(SectionType::ObjectRotations, rotations);
+  const glm::vec3* scaleData = getArray<glm::vec3>(SectionType::ObjectScales, scales);
+  const uint32_t* parentData = getArray<uint32_t>(SectionType::ObjectParents, parents);
+  const AABB* boundsData = getArray<AABB>(SectionType::ObjectBounds, bounds);
+  if (positions != count || rotations != count || scales != count || parents != count ||
+      bounds != count) {
+    throw std::runtime_error(file.getPath() + " has object sections of different lengths");
+  }
+  objects.assign(count, typeData, positionData, rotationData, scaleData, parentData,
+                 boundsData);
+}
+
+void saveScene(const std::string& path,
+               const Terrain& terrain,
+               VertexFormat format,
+               const EntityStore& objects,
+               const SceneFile* source) {
+  PROFILE_FUNCTION();
+  const bool fromSource = terrain.getVertices().empty();
+  if (fromSource && !source) {
+    throw std::runtime_error("Terrain has no vertices and no scene to copy them from");
+  }
+  if (fromSource) {
+    format = source->getVertexFormat();
+  }
+  TerrainMesh indices;
+  buildTerrainIndices(terrain, indices);
+
+  std::filesystem::path temporary(path);
+  temporary += ".tmp";
+  try {
+    SectionWriter writer(temporary);
+
+    const HeightMapParams& params = terrain.getParams();
+    const TerrainLodOptions& lodOptions = terrain.getLod().getOptions();
+    TerrainRecord record{};
+    record.size = params.size;
+    record.spacing = params.spacing;
+    record.heightScale = params.heightScale;
+    record.frequency = params.frequency;
+    record.chunkSize = terrain.getChunkSize();
+    record.lodFlags = (lodOptions.optimizeVertexCache ? kLodVertexCache : 0) |
+                      (lodOptions.triangleStrips ? kLodStrips : 0);
+    record.vertexFormat = format == VertexFormat::Displaced ? 2
+                          : format == VertexFormat::Compact ? 1
+                                                            : 0;
+    record.indexSize = indices.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    writer.writeArray(SectionType::Terrain, &record, 1);
+    writer.writeArray(SectionType::TerrainChunks, terrain.getChunks().data(),
+                      terrain.getChunks().size());
+
+    if (fromSource) {
+      const TerrainMeshView mesh = source->getMesh();
+      const uint32_t vertexSize = static_cast<uint32_t>(getVertexSize(format));
+      writer.begin(SectionType::TerrainVertices, vertexSize, mesh.vertexBytes / vertexSize);
+      writer.write(mesh.vertices, mesh.vertexBytes);
+      writer.end();
+    } else {
+      writeVertices(writer, terrain, format);
+    }
+    writer.begin(SectionType::TerrainIndices, record.indexSize,
+                 indices.indices.size() / record.indexSize);
+    writer.write(indices.indices.data(), indices.indices.size());
+    writer.end();
+
+    writer.writeArray(SectionType::ObjectTypes, objects.getTypes().data(), objects.size());
+    writer.writeArray(SectionType::ObjectPositions, objects.getPositions().data(),
+                      objects.size());
+    writer.writeArray(SectionType::ObjectRotations, objects.getRotations().data(),
+                      objects.size());
+    writer.writeArray(SectionType::ObjectScales, objects.getScales().data(), objects.size());
+    writer.writeArray(SectionType::ObjectParents, objects.getParents().data(), objects.size());
+    writer.writeArray(SectionType::ObjectBounds, objects.getLocalBounds().data(),
+                      objects.size());
+    writer.finish();
+  } catch (...) {
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+    throw;
+  }
+
+  // Readers never see a half-written file under the real name
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    const std::string reason = error.message();
+    std::filesystem::remove(temporary, error);
+    throw std::runtime_error("Cannot replace " + path + ": " + reason);
+  }
+}
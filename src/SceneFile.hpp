@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "EntityStore.hpp"
+#include "MappedFile.hpp"
+#include "Terrain.hpp"
+#include "TerrainRenderer.hpp"
+
+// Binary scene file layout, version 1, little-endian.
+//
+//   Header              kMagic, version, section count, file size
+//   Section[count]      Type, element size and count, offset and size
+//   padding             Up to the first kAlignment boundary
+//   section data        Each section starts on a kAlignment boundary
+//
+// Sections only refer to each other by index, never by address, so the file
+// is used in place wherever it is mapped: loading validates the header and
+// the section table and then reads the arrays straight from the mapping.
+// Readers skip section types they do not know; changing the layout of a
+// known section needs a new version.
+namespace SceneFormat {
+
+inline constexpr char kMagic[8] = {'T', 'E', 'R', 'R', 'S', 'C', 'N', '\0'};
+inline constexpr uint32_t kVersion = 1;
+inline constexpr uint64_t kAlignment = 4096;  // A page on common systems
+inline constexpr uint32_t kMaxSections = 64;
+
+enum class SectionType : uint32_t {
+  Terrain = 1,           // One TerrainRecord
+  TerrainChunks = 2,     // TerrainChunk per chunk, row-major
+  TerrainVertices = 3,   // VertexType or CompactVertexType per vertex, or float heights
+  TerrainIndices = 4,    // uint16_t or uint32_t LOD index lists
+  ObjectTypes = 16,      // uint32_t per entity
+  ObjectPositions = 17,  // glm::vec3 per entity
+  ObjectRotations = 18,  // glm::quat (x, y, z, w) per entity
+  ObjectScales = 19,     // glm::vec3 per entity
+  ObjectParents = 20,    // uint32_t entity index, EntityStore::kNoParent for roots
+  ObjectBounds = 21,     // Local AABB per entity
+};
+
+// Start of the file
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t sectionCount;
+  uint64_t fileSize;  // Catches truncated files
+};
+
+// Entry of the section table following the header
+struct Section {
+  uint32_t type;         // SectionType
+  uint32_t elementSize;  // Bytes per element
+  uint64_t count;        // Elements
+  uint64_t offset;       // From the start of the file, a multiple of kAlignment
+  uint64_t size;         // elementSize * count
+};
+
+// Terrain section
+struct TerrainRecord {
+  int32_t size;            // HeightMapParams
+  float spacing;
+  float heightScale;
+  float frequency;
+  int32_t chunkSize;       // Quads per chunk side
+  uint32_t lodFlags;       // kLodVertexCache | kLodStrips
+  uint32_t vertexFormat;   // 0 VertexType, 1 CompactVertexType, 2 height grid
+  uint32_t indexSize;      // 2 or 4
+};
+
+inline constexpr uint32_t kLodVertexCache = 1;
+inline constexpr uint32_t kLodStrips = 2;
+
+static_assert(sizeof(Header) == 24 && sizeof(Section) == 32 && sizeof(TerrainRecord) == 32,
+              "Scene file records must not change size");
+}  // namespace SceneFormat
+
+// A scene file mapped read-only. Opening reads only the header and section
+// table; the terrain chunks and objects are bulk-copied out of the mapping
+// and the mesh blobs are handed to GL without a copy.
+class SceneFile {
+ public:
+  // Maps and validates `path`; throws std::runtime_error if it is not a
+  // scene file of a supported version or is truncated
+  explicit SceneFile(const std::string& path);
+
+  // Returns the mapped file
+  const MappedFile& getFile() const { return file; }
+
+  // Returns the section of a type, or nullptr if the file has none
+  const SceneFormat::Section* findSection(SceneFormat::SectionType type) const;
+
+  // Returns the terrain with the chunk table of the file and no CPU vertices;
+  // throws std::runtime_error if the chunk table or the stored index lists
+  // are not the ones the terrain would build
+  Terrain makeTerrain() const;
+
+  // Returns the layout of the stored vertices
+  VertexFormat getVertexFormat() const;
+
+  // Returns the mesh blobs, pointing into the mapping, and asks the OS to
+  // start reading them in. They are only validated by makeTerrain.
+  TerrainMeshView getMesh() const;
+
+  // Replaces the contents of `objects` with the stored entities
+  void readObjects(EntityStore& objects) const;
+
+ private:
+  // Returns the section's elements; throws if it is missing or its
+  // elements are not `T`
+  template <typename T>
+  const T* getArray(SceneFormat::SectionType type, uint64_t& count) const;
+
+  MappedFile file;
+  const SceneFormat::Header* header = nullptr;
+  const SceneFormat::Section* sections = nullptr;
+  const SceneFormat::TerrainRecord* terrain = nullptr;
+};
+
+// Writes the terrain, its mesh in `format` and the objects to `path`. The
+// sections are streamed out one after another, compact vertices converted
+// in batches, so the file is never assembled in memory. A terrain without CPU
+// vertices must have been read from `source`, whose vertex blob is copied in
+// its stored format instead. The file is written under a temporary name and
+// renamed over `path` once complete. Throws std::runtime_error on failure.
+void saveScene(const std::string& path,
+               const Terrain& terrain,
+               VertexFormat format,
+               const EntityStore& objects,
+               const SceneFile* source = nullptr);
@@ -1,33 +1,53 @@
 #include "Shader.hpp"
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include "GLState.hpp"
+#include "ProgramCache.hpp"
+
 namespace {
-// Reads file contents into a vector, appending a null terminator
-void readFile(const std::string& filename, std::vector<char>& buffer) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
-    throw std::runtime_error("Failed to open file: " + filename);
-  }
-  file.seekg(0, std::ios::end);
-  auto size = file.tellg();
-  if (size <= 0) {
-    throw std::runtime_error("File is empty: " + filename);
-  }
-  file.seekg(0, std::ios::beg);
-  buffer.resize(static_cast<size_t>(size) + 1);
-  file.read(buffer.data(), size);
-  buffer.back() = '\0';
+// Milliseconds since `start`
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                   start)
+      .count();
 }
 }  // namespace
 
-Shader::Shader(const std::string& filename, GLenum type) {
-  // Load shader source
-  std::vector<char> source;
-  readFile(filename, source);
+Shader::Shader(const std::string& filename, GLenum type, const ShaderDefines& defines)
+    : filename(filename), type(type) {
+  PreprocessedShader preprocessed = preprocessShader(filename, defines);
+  source = std::move(preprocessed.source);
+  files = std::move(preprocessed.files);
+}
+
+Shader::Shader(const Shader& other)
+    : filename(other.filename), type(other.type), source(other.source), files(other.files) {}
+
+Shader::Shader(Shader&& other) noexcept
+    : filename(std::move(other.filename)),
+      type(other.type),
+      source(std::move(other.source)),
+      files(std::move(other.files)),
+      handle(std::exchange(other.handle, 0)),
+      checked(other.checked) {}
+
+GLuint Shader::getHandle() const {
+  compile();
+  check();
+  return handle;
+}
+
+void Shader::compile() const {
+  if (handle) {
+    return;
+  }
 
   // Create and compile shader
   handle = glCreateShader(type);
@@ -35,9 +55,15 @@ Shader::Shader(const std::string& filename, GLenum type) {
     throw std::runtime_error("Failed to create shader for: " + filename);
   }
 
-  const char* sourcePtr = source.data();
+  const char* sourcePtr = source.c_str();
   glShaderSource(handle, 1, &sourcePtr, nullptr);
   glCompileShader(handle);
+}
+
+void Shader::check() const {
+  if (checked) {
+    return;
+  }
 
   // Check compilation status
   GLint status;
@@ -47,9 +73,15 @@ Shader::Shader(const std::string& filename, GLenum type) {
     glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &logSize);
     std::vector<char> log(logSize + 1);
     glGetShaderInfoLog(handle, logSize, nullptr, log.data());
+    // Messages name files by their #line source string number
+    std::string sources;
+    for (size_t i = 0; i < files.size(); ++i) {
+      sources += "\n  " + std::to_string(i) + ": " + files[i];
+    }
     throw std::runtime_error("Shader compilation failed: " + filename + "\n" +
-                             log.data());
+                             log.data() + "Source strings:" + sources);
   }
+  checked = true;
   std::cout << "Shader compiled: " << filename << std::endl;
 }
 
@@ -67,105 +99,319 @@ ShaderProgram::ShaderProgram() {
 }
 
 ShaderProgram::ShaderProgram(std::initializer_list<Shader> shaderList)
+    : ShaderProgram(std::vector<Shader>(shaderList)) {
+  finish();
+}
+
+ShaderProgram::ShaderProgram(std::vector<Shader> shaders,
+                             const AttributeLocations& attributeLocations,
+                             const ShaderProgram* previous)
     : ShaderProgram() {
-  for (const auto& shader : shaderList) {
-    glAttachShader(handle, shader.getHandle());
+  const auto start = std::chrono::steady_clock::now();
+  pending = true;
+
+  // Bound attribute locations change the linked program, so they are part
+  // of the cache key along with the sources
+  std::vector<std::string> keyParts;
+  for (const Shader& shader : shaders) {
+    keyParts.push_back(std::to_string(shader.getType()));
+    keyParts.push_back(shader.getSource());
+  }
+  if (previous) {
+    blockBindings = previous->blockBindings;
+    previous->attributes.forEach([&](const ShaderVariable& attribute) {
+      glBindAttribLocation(handle, static_cast<GLuint>(attribute.location),
+                           attribute.name.c_str());
+      keyParts.push_back(attribute.name + "@" + std::to_string(attribute.location));
+    });
   }
-  link();
+  // Bound last, so they win over the previous program's locations
+  for (const auto& [name, attributeLocation] : attributeLocations) {
+    glBindAttribLocation(handle, attributeLocation, name.c_str());
+    keyParts.push_back(name + "@" + std::to_string(attributeLocation));
+  }
+  cacheKey = ProgramCache::makeKey(
+      std::vector<std::string_view>(keyParts.begin(), keyParts.end()));
+
+  loadedFromCache = ProgramCache::load(handle, cacheKey);
+  if (!loadedFromCache) {
+    // Submit everything at once; the status is only queried in finish()
+    for (const Shader& shader : shaders) {
+      shader.compile();
+      glAttachShader(handle, shader.handle);
+    }
+    ProgramCache::prepare(handle);
+    glLinkProgram(handle);
+    pendingShaders = std::move(shaders);
+  }
+  buildMilliseconds = millisecondsSince(start);
 }
 
-void ShaderProgram::link() {
-  glLinkProgram(handle);
-  GLint status;
-  glGetProgramiv(handle, GL_LINK_STATUS, &status);
-  if (status != GL_TRUE) {
-    GLint logSize = 0;
-    glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &logSize);
-    std::vector<char> log(logSize + 1);
-    glGetProgramInfoLog(handle, logSize, nullptr, log.data());
-    throw std::runtime_error("Shader program linking failed:\n" +
-                             std::string(log.data()));
+bool ShaderProgram::isComplete() const {
+  if (!pending || loadedFromCache ||
+      !(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)) {
+    return true;
+  }
+  GLint complete = GL_TRUE;
+  glGetProgramiv(handle, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete == GL_TRUE;
+}
+
+void ShaderProgram::finish() {
+  if (!pending) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  pending = false;
+  if (!loadedFromCache) {
+    GLint status;
+    glGetProgramiv(handle, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+      throwLinkError();
+    }
+    // The program keeps its executable; the shaders can go
+    for (const Shader& shader : pendingShaders) {
+      shader.check();
+      glDetachShader(handle, shader.handle);
+    }
+    pendingShaders.clear();
+  }
+
+  reflect();
+  std::vector<BlockBinding> bindings;
+  bindings.swap(blockBindings);
+  for (const BlockBinding& block : bindings) {
+    bindUniformBlock(block.name, block.binding, block.size);
   }
+  if (!loadedFromCache) {
+    ProgramCache::store(handle, cacheKey);
+  }
+  buildMilliseconds += millisecondsSince(start);
+  ProgramCache::record(loadedFromCache, buildMilliseconds);
 }
 
-GLint ShaderProgram::uniform(const std::string& name) {
-  auto it = uniforms.find(name);
-  if (it != uniforms.end()) {
-    return it->second;
+void ShaderProgram::throwLinkError() const {
+  // A shader that failed to compile explains more than the linker does
+  for (const Shader& shader : pendingShaders) {
+    shader.check();
   }
-  GLint loc = glGetUniformLocation(handle, name.c_str());
-  if (loc < 0) {
-    std::cerr << "Warning: Uniform '" << name << "' not found in program"
+  GLint logSize = 0;
+  glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &logSize);
+  std::vector<char> log(logSize + 1);
+  glGetProgramInfoLog(handle, logSize, nullptr, log.data());
+  throw std::runtime_error("Shader program linking failed:\n" +
+                           std::string(log.data()));
+}
+
+void ShaderProgram::swap(ShaderProgram& other) noexcept {
+  std::swap(handle, other.handle);
+  std::swap(uniforms, other.uniforms);
+  std::swap(attributes, other.attributes);
+  missingUniforms.swap(other.missingUniforms);
+  blockBindings.swap(other.blockBindings);
+  pendingShaders.swap(other.pendingShaders);
+  std::swap(cacheKey, other.cacheKey);
+  std::swap(pending, other.pending);
+  std::swap(loadedFromCache, other.loadedFromCache);
+  std::swap(buildMilliseconds, other.buildMilliseconds);
+}
+
+void ShaderProgram::reflect() {
+  GLint maxUniformLength = 0;
+  GLint maxAttributeLength = 0;
+  glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxUniformLength);
+  glGetProgramiv(handle, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxAttributeLength);
+  std::vector<char> buffer(std::max({maxUniformLength, maxAttributeLength, 1}));
+
+  // Reads the active variables of one kind; arrays are reported as "name[0]"
+  auto readVariables = [&](GLenum countQuery, auto getActive, auto getLocation) {
+    GLint count = 0;
+    glGetProgramiv(handle, countQuery, &count);
+    std::vector<ShaderVariable> variables;
+    for (GLint i = 0; i < count; ++i) {
+      GLsizei length = 0;
+      ShaderVariable variable;
+      getActive(handle, static_cast<GLuint>(i), static_cast<GLsizei>(buffer.size()),
+                &length, &variable.size, &variable.type, buffer.data());
+      variable.location = getLocation(handle, buffer.data());
+      // Uniform block members and built-in attributes have no location
+      if (variable.location < 0) {
+        continue;
+      }
+      variable.name.assign(buffer.data(), length);
+      if (variable.name.ends_with("[0]")) {
+        variable.name.resize(variable.name.size() - 3);
+      }
+      variable.hash = hashName(variable.name);
+      variables.push_back(std::move(variable));
+    }
+    return variables;
+  };
+
+  uniforms.assign(readVariables(
+      GL_ACTIVE_UNIFORMS,
+      [](auto... args) { glGetActiveUniform(args...); },
+      [](GLuint program, const char* name) { return glGetUniformLocation(program, name); }));
+  attributes.assign(readVariables(
+      GL_ACTIVE_ATTRIBUTES,
+      [](auto... args) { glGetActiveAttrib(args...); },
+      [](GLuint program, const char* name) { return glGetAttribLocation(program, name); }));
+}
+
+void ShaderProgram::bindUniformBlock(std::string_view name,
+                                     GLuint binding,
+                                     size_t size) {
+  const std::string blockName(name);
+  GLuint index = glGetUniformBlockIndex(handle, blockName.c_str());
+  if (index == GL_INVALID_INDEX) {
+    std::cerr << "Warning: Uniform block '" << name << "' not found in program"
               << std::endl;
+    return;
+  }
+  GLint dataSize = 0;
+  glGetActiveUniformBlockiv(handle, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+  if (static_cast<size_t>(dataSize) != size) {
+    throw std::runtime_error("Uniform block '" + blockName + "' is " +
+                             std::to_string(dataSize) + " bytes in GLSL but " +
+                             std::to_string(size) + " bytes in C++");
+  }
+  glUniformBlockBinding(handle, index, binding);
+
+  auto recorded = std::find_if(blockBindings.begin(), blockBindings.end(),
+                               [&](const BlockBinding& block) { return block.name == name; });
+  if (recorded == blockBindings.end()) {
+    blockBindings.push_back(BlockBinding{blockName, binding, size});
+  } else {
+    recorded->binding = binding;
+    recorded->size = size;
   }
-  uniforms[name] = loc;
-  return loc;
 }
 
-void ShaderProgram::setAttribute(const std::string& name,
+GLint ShaderProgram::uniform(std::string_view name) {
+  const uint64_t hash = hashName(name);
+  if (const ShaderVariable* variable = uniforms.find(hash)) {
+    return variable->location;
+  }
+  warnMissingUniform(hash, name);
+  return -1;
+}
+
+void ShaderProgram::warnMissingUniform(uint64_t hash, std::string_view name) {
+  if (std::find(missingUniforms.begin(), missingUniforms.end(), hash) !=
+      missingUniforms.end()) {
+    return;
+  }
+  missingUniforms.push_back(hash);
+  std::cerr << "Warning: Uniform '" << name << "' not found in program"
+            << std::endl;
+}
+
+void ShaderProgram::throwTypeMismatch(const ShaderVariable& variable,
+                                      const char* typeName) {
+  std::ostringstream message;
+  message << "Uniform '" << variable.name << "' has GLSL type 0x" << std::hex
+          << variable.type << " and cannot be set from a " << typeName;
+  throw std::runtime_error(message.str());
+}
+
+void ShaderProgram::setAttribute(std::string_view name,
                                  GLint size,
                                  GLsizei stride,
                                  GLuint offset,
                                  GLboolean normalize,
                                  GLenum type) {
-  GLint loc = glGetAttribLocation(handle, name.c_str());
-  if (loc < 0) {
+  const ShaderVariable* variable = attributes.find(hashName(name));
+  if (!variable) {
     std::cerr << "Warning: Attribute '" << name << "' not found in program"
               << std::endl;
     return;
   }
-  attributes[name] = loc;
+  GLuint loc = static_cast<GLuint>(variable->location);
   glEnableVertexAttribArray(loc);
   glVertexAttribPointer(
       loc, size, type, normalize, stride,
       reinterpret_cast<void*>(static_cast<uintptr_t>(offset)));
 }
 
-void ShaderProgram::setUniform(const std::string& name,
-                               float x,
-                               float y,
-                               float z) {
-  glUniform3f(uniform(name), x, y, z);
+void ShaderProgram::setUniform(std::string_view name, float x, float y, float z) {
+  set(hashName(name), name, glm::vec3(x, y, z));
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::vec3& v) {
-  glUniform3fv(uniform(name), 1, glm::value_ptr(v));
+void ShaderProgram::setUniform(std::string_view name, const glm::vec3& v) {
+  set(hashName(name), name, v);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::dvec3& v) {
-  glUniform3dv(uniform(name), 1, glm::value_ptr(v));
+void ShaderProgram::setUniform(std::string_view name, const glm::dvec3& v) {
+  set(hashName(name), name, v);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::vec4& v) {
-  glUniform4fv(uniform(name), 1, glm::value_ptr(v));
+void ShaderProgram::setUniform(std::string_view name, const glm::vec4& v) {
+  set(hashName(name), name, v);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::dvec4& v) {
-  glUniform4dv(uniform(name), 1, glm::value_ptr(v));
+void ShaderProgram::setUniform(std::string_view name, const glm::dvec4& v) {
+  set(hashName(name), name, v);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::mat4& m) {
-  glUniformMatrix4fv(uniform(name), 1, GL_FALSE, glm::value_ptr(m));
+void ShaderProgram::setUniform(std::string_view name, const glm::mat4& m) {
+  set(hashName(name), name, m);
 }
 
-void ShaderProgram::setUniform(const std::string& name, const glm::mat3& m) {
-  glUniformMatrix3fv(uniform(name), 1, GL_FALSE, glm::value_ptr(m));
+void ShaderProgram::setUniform(std::string_view name, const glm::mat3& m) {
+  set(hashName(name), name, m);
 }
 
-void ShaderProgram::setUniform(const std::string& name, float val) {
-  glUniform1f(uniform(name), val);
+void ShaderProgram::setUniform(std::string_view name, float val) {
+  set(hashName(name), name, val);
 }
 
-void ShaderProgram::setUniform(const std::string& name, int val) {
-  glUniform1i(uniform(name), val);
+void ShaderProgram::setUniform(std::string_view name, int val) {
+  set(hashName(name), name, val);
+}
+
+void ShaderProgram::upload(GLint location, float value) {
+  glUniform1f(location, value);
+}
+
+void ShaderProgram::upload(GLint location, int value) {
+  glUniform1i(location, value);
+}
+
+void ShaderProgram::upload(GLint location, const glm::vec3& v) {
+  glUniform3fv(location, 1, glm::value_ptr(v));
+}
+
+void ShaderProgram::upload(GLint location, const glm::vec4& v) {
+  glUniform4fv(location, 1, glm::value_ptr(v));
+}
+
+void ShaderProgram::upload(GLint location, const glm::dvec3& v) {
+  glUniform3dv(location, 1, glm::value_ptr(v));
+}
+
+void ShaderProgram::upload(GLint location, const glm::dvec4& v) {
+  glUniform4dv(location, 1, glm::value_ptr(v));
+}
+
+void ShaderProgram::upload(GLint location, const glm::mat3& m) {
+  glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(m));
+}
+
+void ShaderProgram::upload(GLint location, const glm::mat4& m) {
+  glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(m));
 }
 
 ShaderProgram::~ShaderProgram() {
   if (handle) {
     glDeleteProgram(handle);
+    GLState::forgetProgram(handle);
   }
 }
 
 void ShaderProgram::use() const {
-  glUseProgram(handle);
+  GLState::useProgram(handle);
+}
+
+void ShaderProgram::unuse() const {
+  GLState::useProgram(0);
 }
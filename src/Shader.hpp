@@ -3,74 +3,213 @@
 #define GLM_FORCE_RADIANS
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <initializer_list>
-#include <map>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ShaderPreprocessor.hpp"
+#include "ShaderVariables.hpp"
 
 // Forward declaration
 class ShaderProgram;
 
-// Manages an OpenGL shader (vertex, fragment, etc.).
+// Vertex attribute names bound to fixed locations before linking
+using AttributeLocations = std::vector<std::pair<std::string, GLuint>>;
+
+// Manages an OpenGL shader (vertex, fragment, etc.). The source is read and
+// preprocessed on construction but only compiled when the handle is first
+// needed, so a program found in the ProgramCache never compiles its shaders.
 class Shader {
  public:
-  // Loads and compiles a shader from a file
-  Shader(const std::string& filename, GLenum type);
+  // Loads a shader from a file, resolving #include directives and inserting
+  // `defines` to select a permutation
+  Shader(const std::string& filename, GLenum type,
+         const ShaderDefines& defines = ShaderDefines());
 
-  // Returns the OpenGL shader handle
-  GLuint getHandle() const { return handle; }
+  // Copies the source; the copy compiles its own handle when needed
+  Shader(const Shader& other);
+  Shader(Shader&& other) noexcept;
+  Shader& operator=(const Shader&) = delete;
+
+  // Returns the OpenGL shader handle, compiling the shader on first use and
+  // throwing if compilation failed
+  GLuint getHandle() const;
+
+  // Returns the file the source was read from
+  const std::string& getFilename() const { return filename; }
+
+  // Returns the file and every file it included
+  const std::vector<std::string>& getFiles() const { return files; }
+
+  // Returns the source given to the compiler
+  const std::string& getSource() const { return source; }
+
+  // Returns the shader type, e.g. GL_VERTEX_SHADER
+  GLenum getType() const { return type; }
 
   // Cleans up shader resources
   ~Shader();
 
  private:
-  GLuint handle = 0;  // OpenGL shader handle
+  std::string filename;        // Source file, for messages
+  GLenum type;                 // Shader stage
+  std::string source;          // Preprocessed GLSL source
+  std::vector<std::string> files;  // Source string numbers of #line directives
+  mutable GLuint handle = 0;   // OpenGL shader handle, 0 until compiled
+  mutable bool checked = false;  // Compile status was queried and logged
+
+  // Submits the source to the compiler without waiting for the result
+  void compile() const;
+
+  // Waits for the compiler and throws with its log on failure
+  void check() const;
+
   friend class ShaderProgram;
 };
 
 // Manages an OpenGL shader program, combining multiple shaders and providing
-// interfaces for setting uniforms and attributes using GLM types.
+// interfaces for setting uniforms and attributes using GLM types. The active
+// uniforms and attributes are introspected after linking; uniforms are best
+// set through constexpr Uniform<T> handles, which look the location up by a
+// precomputed hash and check the GLSL type.
 class ShaderProgram {
  public:
-  // Creates a program from a list of shaders
+  // Creates a program from a list of shaders, loading its binary from the
+  // ProgramCache when possible and storing it there otherwise
   ShaderProgram(std::initializer_list<Shader> shaderList);
 
+  // Starts building a program without waiting for the driver, which may
+  // compile in the background (KHR_parallel_shader_compile); call finish()
+  // before using it. `attributeLocations` are bound before linking, so
+  // vertex arrays can be shared between programs. A program that replaces
+  // `previous` keeps its other attribute locations, so vertex arrays set up
+  // for it stay valid, and its uniform block bindings.
+  explicit ShaderProgram(std::vector<Shader> shaders,
+                         const AttributeLocations& attributeLocations = AttributeLocations(),
+                         const ShaderProgram* previous = nullptr);
+
+  ShaderProgram(const ShaderProgram&) = delete;
+  ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+  // Returns false while the driver is still compiling or linking in the
+  // background; without KHR_parallel_shader_compile finish() may block
+  bool isComplete() const;
+
+  // Waits for the build, then introspects the program and stores it in the
+  // ProgramCache. Throws with the compiler or linker log on failure.
+  void finish();
+
+  // Exchanges two programs, e.g. to swap a rebuilt program in between frames
+  // while references to this object stay valid
+  void swap(ShaderProgram& other) noexcept;
+
   // Binds/unbinds the shader program
   void use() const;
-  void unuse() const { glUseProgram(0); }
+  void unuse() const;
 
   // Returns the OpenGL program handle
   GLuint getHandle() const { return handle; }
 
   // Sets vertex attribute parameters
-  void setAttribute(const std::string& name,
+  void setAttribute(std::string_view name,
                     GLint size,
                     GLsizei stride,
                     GLuint offset,
                     GLboolean normalize = GL_FALSE,
                     GLenum type = GL_FLOAT);
 
-  // Retrieves uniform location
-  GLint uniform(const std::string& name);
+  // Retrieves uniform location, or -1 if the uniform is not active
+  GLint uniform(std::string_view name);
+
+  // Returns the active uniforms found after linking
+  const ShaderVariableTable& getUniforms() const { return uniforms; }
+
+  // Returns the active vertex attributes found after linking
+  const ShaderVariableTable& getAttributes() const { return attributes; }
 
-  // Sets uniform values
-  void setUniform(const std::string& name, float x, float y, float z);
-  void setUniform(const std::string& name, const glm::vec3& v);
-  void setUniform(const std::string& name, const glm::dvec3& v);
-  void setUniform(const std::string& name, const glm::vec4& v);
-  void setUniform(const std::string& name, const glm::dvec4& v);
-  void setUniform(const std::string& name, const glm::mat4& m);
-  void setUniform(const std::string& name, const glm::mat3& m);
-  void setUniform(const std::string& name, float val);
-  void setUniform(const std::string& name, int val);
+  // Assigns a uniform block to a binding point. Throws if the block's size
+  // differs from `size`, which catches C++ structs not laid out as std140.
+  void bindUniformBlock(std::string_view name, GLuint binding, size_t size);
+
+  // Sets a uniform through a handle; throws if its GLSL type does not match
+  template <typename T>
+  void setUniform(const Uniform<T>& uniform, const std::type_identity_t<T>& value) {
+    set(uniform.hash, uniform.name, value);
+  }
+
+  // Sets uniform values by name, hashing the name on every call
+  void setUniform(std::string_view name, float x, float y, float z);
+  void setUniform(std::string_view name, const glm::vec3& v);
+  void setUniform(std::string_view name, const glm::dvec3& v);
+  void setUniform(std::string_view name, const glm::vec4& v);
+  void setUniform(std::string_view name, const glm::dvec4& v);
+  void setUniform(std::string_view name, const glm::mat4& m);
+  void setUniform(std::string_view name, const glm::mat3& m);
+  void setUniform(std::string_view name, float val);
+  void setUniform(std::string_view name, int val);
 
   // Cleans up program resources
   ~ShaderProgram();
 
  private:
-  ShaderProgram();  // Private constructor for initialization
-  void link();      // Links the shader program
+  // A uniform block binding, reapplied when a rebuilt program replaces this one
+  struct BlockBinding {
+    std::string name;
+    GLuint binding;
+    size_t size;
+  };
+
+  ShaderProgram();      // Private constructor for initialization
+  void reflect();       // Introspects the active uniforms and attributes
+
+  // Throws with the first failing shader's log, or with the linker's
+  void throwLinkError() const;
+
+  // Looks the uniform up, checks its type and uploads the value
+  template <typename T>
+  void set(uint64_t hash, std::string_view name, const T& value) {
+    const ShaderVariable* variable = uniforms.find(hash);
+    if (!variable) {
+      warnMissingUniform(hash, name);
+      return;
+    }
+    if (!UniformType<T>::accepts(variable->type)) {
+      throwTypeMismatch(*variable, UniformType<T>::name);
+    }
+    upload(variable->location, value);
+  }
+
+  // Logs a missing uniform the first time it is set
+  void warnMissingUniform(uint64_t hash, std::string_view name);
+
+  // Reports setting `variable` with a value of the wrong type
+  [[noreturn]] static void throwTypeMismatch(const ShaderVariable& variable,
+                                             const char* typeName);
+
+  // Uploads a value to a uniform location of the bound program
+  static void upload(GLint location, float value);
+  static void upload(GLint location, int value);
+  static void upload(GLint location, const glm::vec3& v);
+  static void upload(GLint location, const glm::vec4& v);
+  static void upload(GLint location, const glm::dvec3& v);
+  static void upload(GLint location, const glm::dvec4& v);
+  static void upload(GLint location, const glm::mat3& m);
+  static void upload(GLint location, const glm::mat4& m);
+
+  GLuint handle = 0;                     // OpenGL program handle
+  ShaderVariableTable uniforms;          // Active uniforms by name hash
+  ShaderVariableTable attributes;        // Active attributes by name hash
+  std::vector<uint64_t> missingUniforms; // Hashes already warned about
+  std::vector<BlockBinding> blockBindings;  // Applied by bindUniformBlock
 
-  GLuint handle = 0;                        // OpenGL program handle
-  std::map<std::string, GLint> uniforms;    // Cache for uniform locations
-  std::map<std::string, GLint> attributes;  // Cache for attribute locations
+  // Build in progress, cleared by finish()
+  std::vector<Shader> pendingShaders;    // Compiling shaders, empty if cached
+  uint64_t cacheKey = 0;                 // ProgramCache key of the sources
+  bool pending = false;                  // finish() has not run yet
+  bool loadedFromCache = false;          // The binary came from the cache
+  double buildMilliseconds = 0.0;        // Time spent blocked building
 };
@@ -0,0 +1,207 @@
+#include "ShaderManager.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <ostream>
+#include <utility>
+
+#include "GLDebug.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+ShaderManager::ShaderManager(const std::string& directory, bool hotReload)
+    : directory(directory) {
+  // Let the driver pick how many threads compile in the background
+  if (GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+  } else {
+    std::cout << "[Info] No parallel shader compilation, programs build one after another"
+              << std::endl;
+  }
+
+  if (!hotReload) {
+    return;
+  }
+#ifdef __linux__
+  inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyDescriptor >= 0) {
+    // Editors either rewrite the file or rename a new one over it
+    watchDescriptor = inotify_add_watch(inotifyDescriptor, directory.c_str(),
+                                        IN_CLOSE_WRITE | IN_MOVED_TO);
+  }
+  if (watchDescriptor < 0) {
+    std::cerr << "Warning: Cannot watch " << directory
+              << " for shader changes: " << std::strerror(errno) << std::endl;
+  } else {
+    std::cout << "[Info] Watching " << directory << " for shader changes"
+              << std::endl;
+  }
+#else
+  std::cout << "[Info] Shader hot-reload needs inotify and is disabled on this platform"
+            << std::endl;
+#endif
+}
+
+ShaderManager::~ShaderManager() {
+#ifdef __linux__
+  if (inotifyDescriptor >= 0) {
+    close(inotifyDescriptor);
+  }
+#endif
+}
+
+std::vector<Shader> ShaderManager::loadShaders(Entry& entry) {
+  std::vector<Shader> shaders;
+  std::vector<std::string> files;
+  shaders.reserve(entry.stages.size());
+  for (const ShaderStage& stage : entry.stages) {
+    shaders.emplace_back(stage.filename, stage.type, entry.defines);
+    for (const std::string& file : shaders.back().getFiles()) {
+      files.push_back(std::filesystem::path(file).lexically_normal().string());
+    }
+  }
+  entry.files = std::move(files);
+  return shaders;
+}
+
+ShaderManager::ProgramId ShaderManager::add(std::vector<ShaderStage> stages,
+                                            const ShaderDefines& defines,
+                                            const AttributeLocations& attributeLocations) {
+  for (size_t id = 0; id < entries.size(); ++id) {
+    const Entry& entry = entries[id];
+    if (entry.stages == stages && entry.defines == defines &&
+        entry.attributeLocations == attributeLocations) {
+      return id;
+    }
+  }
+
+  Entry entry;
+  entry.stages = std::move(stages);
+  entry.defines = defines;
+  entry.attributeLocations = attributeLocations;
+  entry.program = std::make_unique<ShaderProgram>(loadShaders(entry), attributeLocations);
+  label(entry);
+  entries.push_back(std::move(entry));
+  return entries.size() - 1;
+}
+
+void ShaderManager::label(const Entry& entry) {
+  std::string name;
+  for (const ShaderStage& stage : entry.stages) {
+    name += std::filesystem::path(stage.filename).filename().string() + " ";
+  }
+  GLDebug::label(GL_PROGRAM, entry.program->getHandle(),
+                 name + "[" + describeDefines(entry.defines) + "]");
+}
+
+void ShaderManager::printPrograms(std::ostream& out) const {
+  for (size_t id = 0; id < entries.size(); ++id) {
+    const Entry& entry = entries[id];
+    out << "  " << id << ":";
+    for (const ShaderStage& stage : entry.stages) {
+      out << " " << std::filesystem::path(stage.filename).filename().string();
+    }
+    out << " [" << describeDefines(entry.defines) << "]\n";
+  }
+}
+
+ShaderProgram& ShaderManager::get(ProgramId id) {
+  ShaderProgram& program = *entries.at(id).program;
+  program.finish();
+  return program;
+}
+
+void ShaderManager::update() {
+  readChanges();
+  for (Entry& entry : entries) {
+    if (entry.rebuild) {
+      if (!entry.rebuild->isComplete()) {
+        continue;
+      }
+      try {
+        entry.rebuild->finish();
+        entry.program->swap(*entry.rebuild);
+        label(entry);
+        ++reloads;
+        lastError.clear();
+        std::cout << "[Info] Reloaded shader program " << entry.stages.front().filename
+                  << " [" << describeDefines(entry.defines) << "]" << std::endl;
+      } catch (const std::exception& e) {
+        fail(e.what());
+      }
+      // Holds the replaced program after a swap, the failed one otherwise
+      entry.rebuild.reset();
+    }
+    if (entry.stale) {
+      startRebuild(entry);
+    }
+  }
+}
+
+bool ShaderManager::hasPendingWork() {
+  readChanges();
+  return std::any_of(entries.begin(), entries.end(), [](const Entry& entry) {
+    return entry.stale || entry.rebuild != nullptr;
+  });
+}
+
+void ShaderManager::readChanges() {
+#ifdef __linux__
+  if (watchDescriptor < 0) {
+    return;
+  }
+  alignas(inotify_event) char buffer[4096];
+  for (;;) {
+    // Non-blocking: fails with EAGAIN once the queue is drained
+    const ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return;
+    }
+    for (ssize_t offset = 0; offset < length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+      if (event->len == 0) {
+        continue;
+      }
+      const std::string changed =
+          (std::filesystem::path(directory) / event->name).lexically_normal().string();
+      for (Entry& entry : entries) {
+        if (std::find(entry.files.begin(), entry.files.end(), changed) !=
+            entry.files.end()) {
+          entry.stale = true;
+        }
+      }
+    }
+  }
+#endif
+}
+
+void ShaderManager::startRebuild(Entry& entry) {
+  // A rebuild in flight finishes first; the next update() starts over
+  if (entry.rebuild) {
+    return;
+  }
+  entry.stale = false;
+  try {
+    entry.rebuild = std::make_unique<ShaderProgram>(
+        loadShaders(entry), entry.attributeLocations, entry.program.get());
+  } catch (const std::exception& e) {
+    fail(e.what());
+  }
+}
+
+void ShaderManager::fail(const std::string& message) {
+  ++failures;
+  lastError = message;
+  std::cerr << "Warning: Shader reload failed, keeping the last good program:\n"
+            << message << std::endl;
+}
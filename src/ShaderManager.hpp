@@ -0,0 +1,115 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.hpp"
+
+// Source file and type of one shader of a managed program
+struct ShaderStage {
+  std::string filename;
+  GLenum type;
+
+  bool operator==(const ShaderStage&) const = default;
+};
+
+// Owns the application's shader programs. Each program is one permutation of
+// its stages, selected by the defines injected into every stage; adding the
+// same stages and defines twice returns the existing program. Programs are
+// submitted to the driver as soon as they are added, so with
+// KHR_parallel_shader_compile they compile in the background while start-up
+// continues. On Linux the shader directory is watched with inotify:
+// programs whose files, including #included ones, change are rebuilt in the
+// background and swapped in between frames, and a program that fails to
+// build keeps running its last good version.
+class ShaderManager {
+ public:
+  // Identifies a program added to the manager
+  using ProgramId = size_t;
+
+  // Watches `directory` for changes if `hotReload` is set; requires a
+  // current context
+  explicit ShaderManager(const std::string& directory, bool hotReload = true);
+
+  // Stops watching
+  ~ShaderManager();
+
+  ShaderManager(const ShaderManager&) = delete;
+  ShaderManager& operator=(const ShaderManager&) = delete;
+
+  // Reads the sources and starts building a program permutation without
+  // waiting for it, or returns the permutation added before. Throws if a
+  // file cannot be read.
+  ProgramId add(std::vector<ShaderStage> stages,
+                const ShaderDefines& defines = ShaderDefines(),
+                const AttributeLocations& attributeLocations = AttributeLocations());
+
+  // Waits for the first build of a program and returns it. The object stays
+  // the same across reloads, so references to it remain valid. Throws if the
+  // first build fails.
+  ShaderProgram& get(ProgramId id);
+
+  // Call between frames: starts rebuilding programs whose files changed and
+  // swaps in rebuilds that finished
+  void update();
+
+  // Picks up file changes and returns true if update() has work to do
+  bool hasPendingWork();
+
+  // Prints every program with its stages and defines
+  void printPrograms(std::ostream& out) const;
+
+  // Returns the number of programs
+  size_t getProgramCount() const { return entries.size(); }
+
+  // Returns true if file changes are picked up
+  bool isWatching() const { return watchDescriptor >= 0; }
+
+  // Returns the number of rebuilds swapped in
+  int getReloadCount() const { return reloads; }
+
+  // Returns the number of rebuilds that failed
+  int getFailureCount() const { return failures; }
+
+  // Returns the error of the last failed rebuild, empty after a success
+  const std::string& getLastError() const { return lastError; }
+
+ private:
+  // A program and its rebuild in progress
+  struct Entry {
+    std::vector<ShaderStage> stages;
+    ShaderDefines defines;
+    AttributeLocations attributeLocations;
+    std::vector<std::string> files;          // Stages and their includes
+    std::unique_ptr<ShaderProgram> program;  // Live program, never replaced
+    std::unique_ptr<ShaderProgram> rebuild;  // Pending replacement
+    bool stale = false;                      // A file changed since the rebuild started
+  };
+
+  // Reads and preprocesses the entry's sources and updates its file list
+  static std::vector<Shader> loadShaders(Entry& entry);
+
+  // Names the live program after its stages and defines
+  static void label(const Entry& entry);
+
+  // Drains the inotify queue and marks programs using changed files stale
+  void readChanges();
+
+  // Starts rebuilding a stale entry; failures keep the live program
+  void startRebuild(Entry& entry);
+
+  // Records a failed rebuild
+  void fail(const std::string& message);
+
+  std::string directory;              // Watched directory
+  std::vector<Entry> entries;         // Indexed by ProgramId
+  int inotifyDescriptor = -1;         // Non-blocking inotify instance
+  int watchDescriptor = -1;           // Watch on `directory`
+  int reloads = 0;
+  int failures = 0;
+  std::string lastError;
+};
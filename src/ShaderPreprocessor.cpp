@@ -0,0 +1,176 @@
+#include "ShaderPreprocessor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+// State shared by the files of one shader
+struct Context {
+  const ShaderFileReader& reader;
+  PreprocessedShader result;
+  std::vector<std::string> chain;  // Files being included, outermost first
+  int lineOffset = 0;  // 1 before GLSL 3.30, where #line N names the line before N
+};
+
+// Returns `line` without leading blanks if it is the given directive
+bool isDirective(std::string_view line, std::string_view directive,
+                 std::string_view& rest) {
+  size_t start = line.find_first_not_of(" \t");
+  if (start == std::string_view::npos || line[start] != '#') {
+    return false;
+  }
+  start = line.find_first_not_of(" \t", start + 1);
+  if (start == std::string_view::npos || line.compare(start, directive.size(), directive) != 0) {
+    return false;
+  }
+  rest = line.substr(start + directive.size());
+  return rest.empty() || rest.front() == ' ' || rest.front() == '\t';
+}
+
+std::string location(const std::string& path, int line) {
+  return path + ":" + std::to_string(line);
+}
+
+std::string lineDirective(int nextLine, size_t fileIndex, int lineOffset) {
+  return "#line " + std::to_string(nextLine - lineOffset) + " " +
+         std::to_string(fileIndex) + "\n";
+}
+
+std::string defineLines(const ShaderDefines& defines) {
+  std::string lines;
+  for (const auto& [name, value] : defines) {
+    const bool identifier =
+        !name.empty() && !std::isdigit(static_cast<unsigned char>(name.front())) &&
+        std::all_of(name.begin(), name.end(), [](char c) {
+          return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        });
+    if (!identifier) {
+      throw std::runtime_error("Invalid shader define name '" + name + "'");
+    }
+    lines += "#define " + name + " " + value + "\n";
+  }
+  return lines;
+}
+
+void processFile(const std::string& path, const ShaderDefines& defines, Context& context) {
+  const std::string text = context.reader(path);
+  const size_t fileIndex = context.result.files.size();
+  context.result.files.push_back(path);
+  const bool isMain = fileIndex == 0;
+  std::string& out = context.result.source;
+
+  // Without #version the defines go first and GLSL 1.10 rules apply
+  bool versionSeen = false;
+  if (!isMain) {
+    out += lineDirective(1, fileIndex, context.lineOffset);
+  } else if (text.find("#version") == std::string::npos) {
+    context.lineOffset = 1;
+    out += defineLines(defines);
+    out += lineDirective(1, fileIndex, context.lineOffset);
+    versionSeen = true;
+  }
+
+  std::istringstream lines(text);
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(lines, line)) {
+    ++lineNumber;
+    std::string_view rest;
+    if (isDirective(line, "version", rest)) {
+      if (!isMain) {
+        throw std::runtime_error("#version in included file " + location(path, lineNumber));
+      }
+      if (versionSeen) {
+        throw std::runtime_error("Second #version in " + location(path, lineNumber));
+      }
+      versionSeen = true;
+      context.lineOffset = std::atoi(std::string(rest).c_str()) < 330 ? 1 : 0;
+      out += line + "\n";
+      out += defineLines(defines);
+      out += lineDirective(lineNumber + 1, fileIndex, context.lineOffset);
+      continue;
+    }
+    if (!isDirective(line, "include", rest)) {
+      out += line + "\n";
+      continue;
+    }
+
+    // #include "name" or #include <name>, relative to this file
+    const size_t open = rest.find_first_of("\"<");
+    const char closing = open == std::string_view::npos ? '\0' : rest[open] == '<' ? '>' : '"';
+    const size_t close = open == std::string_view::npos ? open : rest.find(closing, open + 1);
+    if (close == std::string_view::npos || close == open + 1) {
+      throw std::runtime_error("Malformed #include in " + location(path, lineNumber));
+    }
+    const std::string included =
+        (std::filesystem::path(path).parent_path() / rest.substr(open + 1, close - open - 1))
+            .lexically_normal()
+            .generic_string();
+
+    if (std::find(context.chain.begin(), context.chain.end(), included) !=
+        context.chain.end()) {
+      std::string cycle;
+      for (const std::string& file : context.chain) {
+        cycle += file + " -> ";
+      }
+      throw std::runtime_error("Include cycle: " + cycle + included);
+    }
+    const auto& files = context.result.files;
+    if (std::find(files.begin(), files.end(), included) == files.end()) {
+      context.chain.push_back(included);
+      try {
+        processFile(included, defines, context);
+      } catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::string(e.what()) + "\n  included from " +
+                                 location(path, lineNumber));
+      }
+      context.chain.pop_back();
+    }
+    out += lineDirective(lineNumber + 1, fileIndex, context.lineOffset);
+  }
+}
+}  // namespace
+
+std::string describeDefines(const ShaderDefines& defines) {
+  if (defines.empty()) {
+    return "(none)";
+  }
+  std::string description;
+  for (const auto& [name, value] : defines) {
+    if (!description.empty()) {
+      description += ' ';
+    }
+    description += name + "=" + value;
+  }
+  return description;
+}
+
+std::string readShaderFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  if (contents.str().empty()) {
+    throw std::runtime_error("File is empty: " + path);
+  }
+  return contents.str();
+}
+
+PreprocessedShader preprocessShader(const std::string& filename,
+                                    const ShaderDefines& defines,
+                                    const ShaderFileReader& reader) {
+  Context context{reader, {}, {}, 0};
+  const std::string normalized =
+      std::filesystem::path(filename).lexically_normal().generic_string();
+  context.chain.push_back(normalized);
+  processFile(normalized, defines, context);
+  return std::move(context.result);
+}
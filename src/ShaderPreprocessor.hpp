@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// #defines selecting one shader permutation, ordered by name so equal sets
+// compare and hash alike
+using ShaderDefines = std::map<std::string, std::string>;
+
+// Formats defines as "NAME=VALUE NAME=VALUE", or "(none)"
+std::string describeDefines(const ShaderDefines& defines);
+
+// Returns the contents of a shader file; throws if it cannot be read
+using ShaderFileReader = std::function<std::string(const std::string& path)>;
+
+// Reads a file from disk; throws if it is missing or empty
+std::string readShaderFile(const std::string& path);
+
+// Result of preprocessing one shader
+struct PreprocessedShader {
+  std::string source;              // Text to hand to glShaderSource
+  std::vector<std::string> files;  // Files read; index = #line source number
+};
+
+// Resolves #include "file" directives, relative to the including file, and
+// inserts `defines` after the #version line. Each file is included at most
+// once; an include cycle or a missing file throws with the include chain.
+// #line directives keep compiler messages pointing at the original line,
+// with the index into `files` as the source string number. Conditionals are
+// left to the GLSL compiler, so the defines select code paths that it
+// removes as dead code.
+PreprocessedShader preprocessShader(const std::string& filename,
+                                    const ShaderDefines& defines,
+                                    const ShaderFileReader& reader = readShaderFile);
@@ -0,0 +1,29 @@
+#include "ShaderVariables.hpp"
+
+#include <stdexcept>
+
+void ShaderVariableTable::assign(std::vector<ShaderVariable> variables) {
+  size_t capacity = 4;
+  while (capacity < variables.size() * 2) {
+    capacity *= 2;
+  }
+  slots.assign(capacity, ShaderVariable{});
+  mask = capacity - 1;
+  count = 0;
+
+  for (ShaderVariable& variable : variables) {
+    if (variable.hash == 0) {
+      throw std::runtime_error("Shader variable '" + variable.name +
+                               "' hashes to the reserved value 0");
+    }
+    size_t i = variable.hash & mask;
+    for (; slots[i].hash != 0; i = (i + 1) & mask) {
+      if (slots[i].hash == variable.hash) {
+        throw std::runtime_error("Shader variables '" + slots[i].name + "' and '" +
+                                 variable.name + "' have the same name hash");
+      }
+    }
+    slots[i] = std::move(variable);
+    ++count;
+  }
+}
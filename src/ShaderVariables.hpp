@@ -0,0 +1,153 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 64-bit FNV-1a hash of a uniform or attribute name
+constexpr uint64_t hashName(std::string_view name) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// GLSL types a uniform of C++ type T may be set on
+template <typename T>
+struct UniformType;
+
+template <>
+struct UniformType<float> {
+  static constexpr const char* name = "float";
+  static bool accepts(GLenum type) { return type == GL_FLOAT; }
+};
+
+template <>
+struct UniformType<int> {
+  static constexpr const char* name = "int";
+  // bool and sampler uniforms are also set with glUniform1i
+  static bool accepts(GLenum type) {
+    switch (type) {
+      case GL_INT:
+      case GL_BOOL:
+      case GL_SAMPLER_1D:
+      case GL_SAMPLER_2D:
+      case GL_SAMPLER_3D:
+      case GL_SAMPLER_CUBE:
+      case GL_SAMPLER_2D_SHADOW:
+      case GL_SAMPLER_2D_ARRAY:
+      case GL_SAMPLER_BUFFER:
+      case GL_INT_SAMPLER_2D:
+      case GL_UNSIGNED_INT_SAMPLER_2D:
+        return true;
+      default:
+        return false;
+    }
+  }
+};
+
+template <>
+struct UniformType<glm::vec3> {
+  static constexpr const char* name = "vec3";
+  static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+};
+
+template <>
+struct UniformType<glm::vec4> {
+  static constexpr const char* name = "vec4";
+  static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+};
+
+template <>
+struct UniformType<glm::dvec3> {
+  static constexpr const char* name = "dvec3";
+  static bool accepts(GLenum type) { return type == GL_DOUBLE_VEC3; }
+};
+
+template <>
+struct UniformType<glm::dvec4> {
+  static constexpr const char* name = "dvec4";
+  static bool accepts(GLenum type) { return type == GL_DOUBLE_VEC4; }
+};
+
+template <>
+struct UniformType<glm::mat3> {
+  static constexpr const char* name = "mat3";
+  static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+};
+
+template <>
+struct UniformType<glm::mat4> {
+  static constexpr const char* name = "mat4";
+  static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+};
+
+// Handle naming a uniform of C++ type T. The name is hashed when the handle
+// is constructed, which must happen at compile time, so setting a uniform
+// through a handle neither allocates nor compares strings:
+//
+//   constexpr Uniform<glm::mat4> projection("projection");
+//   program.setUniform(projection, matrix);
+template <typename T>
+struct Uniform {
+  consteval explicit Uniform(std::string_view name)
+      : name(name), hash(hashName(name)) {}
+
+  std::string_view name;  // For diagnostics
+  uint64_t hash;          // hashName(name)
+};
+
+// An active uniform or attribute found by introspecting a linked program
+struct ShaderVariable {
+  uint64_t hash = 0;     // hashName(name); 0 marks an empty table slot
+  GLint location = -1;   // Uniform or attribute location
+  GLenum type = GL_NONE; // GLSL type, e.g. GL_FLOAT_MAT4
+  GLint size = 0;        // Array length, 1 for non-arrays
+  std::string name;      // Name without a trailing "[0]"
+};
+
+// Open-addressing hash table of the variables of one program, keyed by
+// name hash. Lookups probe a flat array and never compare strings.
+class ShaderVariableTable {
+ public:
+  // Replaces the contents; throws if two names hash to the same value
+  void assign(std::vector<ShaderVariable> variables);
+
+  // Returns the variable with the given name hash, or nullptr
+  const ShaderVariable* find(uint64_t hash) const {
+    if (slots.empty()) {
+      return nullptr;
+    }
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const ShaderVariable& slot = slots[i];
+      if (slot.hash == hash) {
+        return &slot;
+      }
+      if (slot.hash == 0) {
+        return nullptr;
+      }
+    }
+  }
+
+  // Returns the number of variables
+  size_t size() const { return count; }
+
+  // Calls fn for every variable
+  template <typename Fn>
+  void forEach(Fn&& fn) const {
+    for (const ShaderVariable& slot : slots) {
+      if (slot.hash != 0) {
+        fn(slot);
+      }
+    }
+  }
+
+ private:
+  std::vector<ShaderVariable> slots;  // Power-of-two sized, at most half full
+  size_t mask = 0;                    // slots.size() - 1
+  size_t count = 0;                   // Occupied slots
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// MSVC does not define __SSE2__; SSE2 is always available on x64 and
+// enabled on x86 by /arch:SSE2 or higher
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_MATH_SSE2 1
+#endif
+
+#if defined(__AVX2__) || defined(SIMD_MATH_SSE2)
+#include <immintrin.h>
+#endif
+
+// Minimal SIMD wrapper used by the CPU-side mesh kernels. The widest
+// instruction set enabled at compile time is selected (AVX2, SSE2), with a
+// scalar fallback for other targets. All kernels are written against the
+// small set of operations below so they compile unchanged for every width.
+namespace simd {
+
+#if defined(__AVX2__)
+
+constexpr int kWidth = 8;
+constexpr const char* kName = "AVX2";
+using Float = __m256;
+using Int = __m256i;
+
+inline Float load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+inline Float set1(float v) { return _mm256_set1_ps(v); }
+inline Int set1i(int32_t v) { return _mm256_set1_epi32(v); }
+inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+inline Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+inline Int roundToInt(Float a) { return _mm256_cvtps_epi32(a); }
+inline Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+inline Int addi(Int a, Int b) { return _mm256_add_epi32(a, b); }
+inline Int andi(Int a, Int b) { return _mm256_and_si256(a, b); }
+inline Int shiftLeft30(Int a) { return _mm256_slli_epi32(a, 30); }
+inline Int equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+inline Float select(Int mask, Float a, Float b) {
+  return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask));
+}
+inline Float flipSign(Float a, Int signBits) {
+  return _mm256_xor_ps(a, _mm256_castsi256_ps(signBits));
+}
+
+#elif defined(SIMD_MATH_SSE2)
+
+constexpr int kWidth = 4;
+constexpr const char* kName = "SSE2";
+using Float = __m128;
+using Int = __m128i;
+
+inline Float load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+inline Float set1(float v) { return _mm_set1_ps(v); }
+inline Int set1i(int32_t v) { return _mm_set1_epi32(v); }
+inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+inline Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+inline Int roundToInt(Float a) { return _mm_cvtps_epi32(a); }
+inline Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+inline Int addi(Int a, Int b) { return _mm_add_epi32(a, b); }
+inline Int andi(Int a, Int b) { return _mm_and_si128(a, b); }
+inline Int shiftLeft30(Int a) { return _mm_slli_epi32(a, 30); }
+inline Int equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+inline Float select(Int mask, Float a, Float b) {
+  Float m = _mm_castsi128_ps(mask);
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+inline Float flipSign(Float a, Int signBits) {
+  return _mm_xor_ps(a, _mm_castsi128_ps(signBits));
+}
+
+#else
+
+constexpr int kWidth = 1;
+constexpr const char* kName = "scalar";
+using Float = float;
+using Int = int32_t;
+
+inline Float load(const float* p) { return *p; }
+inline void store(float* p, Float v) { *p = v; }
+inline Float set1(float v) { return v; }
+inline Int set1i(int32_t v) { return v; }
+inline Float add(Float a, Float b) { return a + b; }
+inline Float sub(Float a, Float b) { return a - b; }
+inline Float mul(Float a, Float b) { return a * b; }
+inline Float div(Float a, Float b) { return a / b; }
+inline Float sqrt(Float a) { return std::sqrt(a); }
+inline Int roundToInt(Float a) { return static_cast<Int>(std::lrint(a)); }
+inline Float toFloat(Int a) { return static_cast<Float>(a); }
+inline Int addi(Int a, Int b) { return a + b; }
+inline Int andi(Int a, Int b) { return a & b; }
+inline Int shiftLeft30(Int a) {
+  return static_cast<Int>(static_cast<uint32_t>(a) << 30);
+}
+inline Int equal(Int a, Int b) { return a == b ? -1 : 0; }
+inline Float select(Int mask, Float a, Float b) { return mask ? a : b; }
+inline Float flipSign(Float a, Int signBits) {
+  return std::bit_cast<float>(std::bit_cast<uint32_t>(a) ^
+                              static_cast<uint32_t>(signBits));
+}
+
+#endif
+
+// Computes sin(x) and cos(x) for every lane. The argument is reduced to
+// [-pi/4, pi/4] with a three-part Cody-Waite split of pi/2 and evaluated with
+// the Cephes single-precision polynomials; the absolute error stays below
+// 2e-7 for |x| < 8192.
+inline void sincos(Float x, Float& s, Float& c) {
+  const Float twoOverPi = set1(0.636619772367581343f);
+  const Float dp1 = set1(1.5703125f);
+  const Float dp2 = set1(4.837512969970703125e-4f);
+  const Float dp3 = set1(7.549789948768648e-8f);
+
+  Int quadrant = roundToInt(mul(x, twoOverPi));
+  Float q = toFloat(quadrant);
+  Float r = sub(sub(sub(x, mul(q, dp1)), mul(q, dp2)), mul(q, dp3));
+  Float r2 = mul(r, r);
+
+  // sin(r) on the reduced range
+  Float ps = set1(-1.9515295891e-4f);
+  ps = add(mul(ps, r2), set1(8.3321608736e-3f));
+  ps = add(mul(ps, r2), set1(-1.6666654611e-1f));
+  ps = add(mul(mul(ps, r2), r), r);
+
+  // cos(r) on the reduced range
+  Float pc = set1(2.443315711809948e-5f);
+  pc = add(mul(pc, r2), set1(-1.388731625493765e-3f));
+  pc = add(mul(pc, r2), set1(4.166664568298827e-2f));
+  pc = add(sub(mul(mul(pc, r2), r2), mul(r2, set1(0.5f))), set1(1.0f));
+
+  // Odd quadrants swap the polynomials, quadrants 2-3 (sin) and 1-2 (cos)
+  // flip the sign
+  Int one = set1i(1);
+  Int two = set1i(2);
+  Int swap = equal(andi(quadrant, one), one);
+  Float sinValue = select(swap, pc, ps);
+  Float cosValue = select(swap, ps, pc);
+  s = flipSign(sinValue, shiftLeft30(andi(quadrant, two)));
+  c = flipSign(cosValue, shiftLeft30(andi(addi(quadrant, one), two)));
+}
+
+// Computes sin(x) for every lane
+inline Float sin(Float x) {
+  Float s, c;
+  sincos(x, s, c);
+  return s;
+}
+
+}  // namespace simd
@@ -0,0 +1,106 @@
+#include "Simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.hpp"
+
+Simulation::Simulation(double tickRate, bool threaded)
+    : period(1.0 / tickRate), start(Clock::now()) {
+  state.eye = orbitEye(state.cameraAngle);
+  snapshots.write() = Snapshot{state, state};
+  snapshots.publish();
+  if (threaded) {
+    worker = std::thread([this] { workerLoop(); });
+  }
+}
+
+Simulation::~Simulation() {
+  stopping = true;
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+void Simulation::setInput(const SimulationInput& input) {
+  inputs.write() = input;
+  inputs.publish();
+}
+
+SimulationState Simulation::sample(double time) {
+  if (!isThreaded()) {
+    // Slack so that rounding in `time` cannot leave a tick for the next frame
+    const uint64_t target = static_cast<uint64_t>(std::max(0.0, time / period + 0.5e-3));
+    while (state.tick < target) {
+      tick();
+    }
+  }
+  snapshots.update();
+  const Snapshot& snapshot = snapshots.read();
+  const SimulationState& a = snapshot.previous;
+  const SimulationState& b = snapshot.current;
+  const float t = static_cast<float>(std::clamp((time - b.time) / period, 0.0, 1.0));
+
+  SimulationState result = b;
+  result.time = b.time + t * period - period;
+  result.cameraAngle = a.cameraAngle + t * (b.cameraAngle - a.cameraAngle);
+  result.eye = orbitEye(result.cameraAngle);
+  result.lightPos = glm::mix(a.lightPos, b.lightPos, t);
+  return result;
+}
+
+double Simulation::now() const {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Simulation::Stats Simulation::getStats() const {
+  return Stats{ticks.load(std::memory_order_relaxed), dropped.load(std::memory_order_relaxed),
+               maxTickMs.load(std::memory_order_relaxed)};
+}
+
+glm::vec3 Simulation::orbitEye(float angle) {
+  return glm::vec3(20.0f * std::sin(angle), 20.0f * std::cos(angle), 20.0f);
+}
+
+void Simulation::tick() {
+  PROFILE_FUNCTION();
+  const Clock::time_point tickStart = Clock::now();
+  inputs.update();
+  const SimulationInput& input = inputs.read();
+
+  Snapshot& snapshot = snapshots.write();
+  snapshot.previous = state;
+  ++state.tick;
+  state.time = static_cast<double>(state.tick) * period;
+  if (input.animateCamera) {
+    state.cameraAngle += static_cast<float>(period);
+  }
+  state.eye = orbitEye(state.cameraAngle);
+  state.lightPos = input.lightPos;
+  snapshot.current = state;
+  snapshots.publish();
+
+  ticks.fetch_add(1, std::memory_order_relaxed);
+  const double ms = std::chrono::duration<double, std::milli>(Clock::now() - tickStart).count();
+  if (ms > maxTickMs.load(std::memory_order_relaxed)) {
+    maxTickMs.store(ms, std::memory_order_relaxed);
+  }
+}
+
+void Simulation::workerLoop() {
+  PROFILE_THREAD("Simulation");
+  const auto tickDuration =
+      std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+  while (!stopping.load(std::memory_order_relaxed)) {
+    Clock::time_point due = start + (state.tick + 1) * tickDuration;
+    std::this_thread::sleep_until(due);
+
+    // After a long stall, skip ahead instead of running a burst of ticks
+    const uint64_t behind = static_cast<uint64_t>((Clock::now() - due) / tickDuration);
+    if (behind > kMaxCatchUpTicks) {
+      state.tick += behind;
+      dropped.fetch_add(behind, std::memory_order_relaxed);
+    }
+    tick();
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <thread>
+
+#include "TripleBuffer.hpp"
+
+// Settings the render thread passes to the simulation
+struct SimulationInput {
+  bool animateCamera = true;                           // Advance the orbit
+  glm::vec3 lightPos = glm::vec3(10.0f, 10.0f, 10.0f);  // Light position
+};
+
+// The simulated scene after one tick
+struct SimulationState {
+  uint64_t tick = 0;
+  double time = 0.0;         // tick / tick rate, seconds
+  float cameraAngle = 0.0f;  // Orbit angle in radians
+  glm::vec3 eye = glm::vec3(0.0f);
+  glm::vec3 lightPos = glm::vec3(10.0f, 10.0f, 10.0f);
+};
+
+// Updates the scene at a fixed tick rate, independently of the frame rate.
+// Threaded, the ticks run on their own thread and every tick publishes the
+// last two states through a TripleBuffer; the render thread interpolates
+// between them, one tick behind, so motion stays smooth at any frame rate
+// and a hitch on either thread does not stall the other. Unthreaded, sample()
+// runs the ticks up to the requested time itself, which keeps headless runs
+// deterministic.
+class Simulation {
+ public:
+  // Tick counters, readable from any thread
+  struct Stats {
+    uint64_t ticks = 0;    // Ticks run
+    uint64_t dropped = 0;  // Ticks skipped to catch up after a long stall
+    double maxTickMs = 0.0;
+  };
+
+  // Starts the simulation thread if `threaded`
+  Simulation(double tickRate, bool threaded);
+
+  // Stops the simulation thread
+  ~Simulation();
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  // Render thread: passes settings on to the next tick
+  void setInput(const SimulationInput& input);
+
+  // Render thread: returns the scene interpolated to `time`, in seconds of
+  // simulation time; see now()
+  SimulationState sample(double time);
+
+  // Returns the seconds since the simulation started on the steady clock,
+  // the time a threaded simulation follows
+  double now() const;
+
+  // Returns true if ticks run on their own thread
+  bool isThreaded() const { return worker.joinable(); }
+
+  // Returns the tick counters
+  Stats getStats() const;
+
+  // Returns the camera position on its orbit at `angle`
+  static glm::vec3 orbitEye(float angle);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr uint64_t kMaxCatchUpTicks = 5;  // Beyond this, ticks are dropped
+
+  // The two most recent states, so the reader can interpolate
+  struct Snapshot {
+    SimulationState previous;
+    SimulationState current;
+  };
+
+  // Advances `state` by one tick with the latest input
+  void tick();
+
+  // Runs ticks on schedule until stopped
+  void workerLoop();
+
+  const double period;  // Seconds per tick
+  const Clock::time_point start;
+  TripleBuffer<SimulationInput> inputs;  // Render thread to simulation
+  TripleBuffer<Snapshot> snapshots;      // Simulation to render thread
+  SimulationState state;                 // Owned by whichever side runs tick()
+  std::atomic<uint64_t> ticks{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<double> maxTickMs{0.0};
+  std::atomic<bool> stopping{false};
+  std::thread worker;  // Started after the state above
+};
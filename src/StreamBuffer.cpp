@@ -0,0 +1,141 @@
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+
+StreamBuffer::StreamBuffer(GLenum target, size_t bytesPerFrame, std::string label,
+                           size_t alignment)
+    : target(target), label(std::move(label)), alignment(alignment) {
+  persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+  create(std::max<size_t>(bytesPerFrame, 256));
+}
+
+StreamBuffer::~StreamBuffer() {
+  destroy();
+}
+
+void StreamBuffer::create(size_t bytes) {
+  frameBytes = (bytes + alignment - 1) / alignment * alignment;
+  frame = 0;
+  glGenBuffers(1, &buffer);
+  GLState::bindBuffer(target, buffer);
+  if (persistent) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr total = static_cast<GLsizeiptr>(frameBytes) * kFrames;
+    glBufferStorage(target, total, nullptr, flags);
+    mapped = static_cast<uint8_t*>(glMapBufferRange(target, 0, total, flags));
+    if (!mapped) {
+      std::cerr << "Warning: Could not map " << label << ", falling back to orphaning"
+                << std::endl;
+      persistent = false;
+      // Immutable storage cannot be respecified, so start over
+      glDeleteBuffers(1, &buffer);
+      GLState::forgetBuffer(buffer);
+      glGenBuffers(1, &buffer);
+      GLState::bindBuffer(target, buffer);
+    }
+  }
+  if (!persistent) {
+    glBufferData(target, static_cast<GLsizeiptr>(frameBytes), nullptr, GL_STREAM_DRAW);
+  }
+  GLDebug::label(GL_BUFFER, buffer, label);
+}
+
+void StreamBuffer::destroy() {
+  for (GLsync& fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (mapped || mappedForFrame) {
+    GLState::bindBuffer(target, buffer);
+    glUnmapBuffer(target);
+    mapped = nullptr;
+    mappedForFrame = false;
+  }
+  // The driver keeps the storage alive until draws reading it completed
+  glDeleteBuffers(1, &buffer);
+  GLState::forgetBuffer(buffer);
+  buffer = 0;
+}
+
+void StreamBuffer::advance(size_t bytes) {
+  if (bytes > frameBytes) {
+    // Grow with headroom so that a slowly rising count does not reallocate
+    // every frame
+    destroy();
+    create(bytes + bytes / 2);
+  }
+
+  if (!persistent) {
+    // Orphan the storage the GPU may still read and write into a fresh one
+    GLState::bindBuffer(target, buffer);
+    glBufferData(target, static_cast<GLsizeiptr>(frameBytes), nullptr, GL_STREAM_DRAW);
+    return;
+  }
+
+  frame = (frame + 1) % kFrames;
+  GLsync& fence = fences[frame];
+  if (fence) {
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      ++stalls;
+      do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+}
+
+uint8_t* StreamBuffer::beginFrame(size_t bytes) {
+  PROFILE_FUNCTION();
+  advance(bytes);
+  if (persistent) {
+    return mapped + frame * frameBytes;
+  }
+  void* data = glMapBufferRange(target, 0, static_cast<GLsizeiptr>(std::max<size_t>(bytes, 1)),
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (!data) {
+    throw std::runtime_error("Could not map " + label);
+  }
+  mappedForFrame = true;
+  return static_cast<uint8_t*>(data);
+}
+
+void StreamBuffer::beginWrites(size_t bytes) {
+  PROFILE_FUNCTION();
+  advance(bytes);
+}
+
+void StreamBuffer::write(size_t offset, const void* data, size_t size) {
+  if (persistent) {
+    std::memcpy(mapped + frame * frameBytes + offset, data, size);
+  } else {
+    GLState::bindBuffer(target, buffer);
+    glBufferSubData(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+  }
+}
+
+void StreamBuffer::flush() {
+  if (mappedForFrame) {
+    GLState::bindBuffer(target, buffer);
+    glUnmapBuffer(target);
+    mappedForFrame = false;
+  }
+}
+
+void StreamBuffer::endFrame() {
+  if (persistent) {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
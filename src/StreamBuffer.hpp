@@ -0,0 +1,87 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Streams data that is rewritten every frame, such as per-instance vertex
+// attributes or the uniform blocks of UniformRing: with ARB_buffer_storage
+// the buffer is persistently mapped and split into kFrames regions used
+// round-robin, each guarded by a fence, so the CPU waits only if the GPU
+// still reads a region from kFrames frames ago. Without it the single region
+// is orphaned every frame. The caller either maps the frame's region and
+// writes straight into GPU-visible memory, or copies data in piece by piece;
+// the buffer grows when a frame needs more than it holds.
+class StreamBuffer {
+ public:
+  // Regions in flight
+  static constexpr int kFrames = 3;
+
+  // Creates the buffer; requires a current context. `label` names it in
+  // debug output. Regions start at multiples of `alignment`.
+  StreamBuffer(GLenum target, size_t bytesPerFrame, std::string label, size_t alignment = 256);
+
+  // Unmaps and deletes the buffer and the fences
+  ~StreamBuffer();
+
+  StreamBuffer(const StreamBuffer&) = delete;
+  StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+  // Moves to the next region, waiting for the GPU if it still reads it, and
+  // returns where to write `bytes` bytes. The pointer is valid until flush().
+  uint8_t* beginFrame(size_t bytes);
+
+  // Moves to the next region like beginFrame() but leaves it unmapped; fill
+  // it with write()
+  void beginWrites(size_t bytes);
+
+  // Copies `size` bytes to `offset` in the region of the current frame; the
+  // data is available to draws issued afterwards
+  void write(size_t offset, const void* data, size_t size);
+
+  // Makes the data written through beginFrame() available to the GPU; call
+  // before drawing
+  void flush();
+
+  // Fences the region; call after the draws that read it
+  void endFrame();
+
+  // Returns the buffer name
+  GLuint getBuffer() const { return buffer; }
+
+  // Returns the byte offset of the data written this frame
+  GLintptr getOffset() const { return static_cast<GLintptr>(frame * frameBytes); }
+
+  // Returns the bytes available per frame
+  size_t getCapacity() const { return frameBytes; }
+
+  // Returns true if the buffer is persistently mapped
+  bool isPersistent() const { return persistent; }
+
+  // Returns how many times beginFrame() had to wait for the GPU
+  uint64_t getStallCount() const { return stalls; }
+
+ private:
+  // Creates the storage for `bytes` per frame
+  void create(size_t bytes);
+
+  // Deletes the storage and the fences
+  void destroy();
+
+  // Grows the storage to `bytes` per frame if needed and moves to the next
+  // region: orphans the storage, or waits for the region's fence
+  void advance(size_t bytes);
+
+  GLenum target;
+  std::string label;
+  size_t alignment;
+  GLuint buffer = 0;
+  size_t frameBytes = 0;
+  bool persistent = false;      // ARB_buffer_storage is available
+  uint8_t* mapped = nullptr;    // Persistent mapping of all regions
+  bool mappedForFrame = false;  // The fallback mapping is open
+  GLsync fences[kFrames] = {};  // Signalled once a region was consumed
+  int frame = 0;                // Region of the current frame
+  uint64_t stalls = 0;
+};
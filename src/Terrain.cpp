@@ -0,0 +1,337 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+void measureTerrainChunk(const VertexType* block,
+                         int chunkSize,
+                         int levelCount,
+                         TerrainChunk& chunk) {
+  const int stride = chunkSize + 1;
+  chunk.bounds.min = chunk.bounds.max = block[0].position;
+  for (int v = 1; v < stride * stride; ++v) {
+    chunk.bounds.extend(block[v].position);
+  }
+
+  auto height = [&](int x, int y) { return block[x + stride * y].position.z; };
+
+  chunk.lodError[0] = 0.0f;
+  for (int level = 1; level < levelCount; ++level) {
+    const int step = 1 << level;
+    float error = 0.0f;
+    for (int y = 0; y <= chunkSize; ++y) {
+      for (int x = 0; x <= chunkSize; ++x) {
+        int x0 = std::min(x / step, chunkSize / step - 1) * step;
+        int y0 = std::min(y / step, chunkSize / step - 1) * step;
+        float u = static_cast<float>(x - x0) / step;
+        float v = static_cast<float>(y - y0) / step;
+        float h00 = height(x0, y0);
+        float h11 = height(x0 + step, y0 + step);
+        // Interpolate on the cell triangle containing (u, v); the diagonal
+        // runs from (0, 0) to (1, 1) as in TerrainLod
+        float interpolated;
+        if (u >= v) {
+          float h10 = height(x0 + step, y0);
+          interpolated = h00 + u * (h10 - h00) + v * (h11 - h10);
+        } else {
+          float h01 = height(x0, y0 + step);
+          interpolated = h00 + v * (h01 - h00) + u * (h11 - h01);
+        }
+        error = std::max(error, std::abs(height(x, y) - interpolated));
+      }
+    }
+    // Coarser levels never claim to be more accurate than finer ones
+    chunk.lodError[level] = std::max(error, chunk.lodError[level - 1]);
+  }
+}
+
+Terrain::Terrain(const HeightMapParams& params,
+                 int chunkSize,
+                 const TerrainLodOptions& lodOptions)
+    : params(params), chunkSize(chunkSize), lod(chunkSize, lodOptions) {
+  generate(AnalyticHeightSource(params));
+}
+
+Terrain::Terrain(const HeightSource& source,
+                 int chunkSize,
+                 const TerrainLodOptions& lodOptions)
+    : chunkSize(chunkSize), lod(chunkSize, lodOptions) {
+  const glm::ivec2 size = source.getSize();
+  if (size.x != size.y) {
+    throw std::runtime_error("Terrain needs a square height source, not " +
+                             std::to_string(size.x) + "x" + std::to_string(size.y));
+  }
+  params.size = size.x;
+  params.spacing = source.getSpacing();
+  params.heightScale = glm::max(glm::abs(source.getHeightRange().x),
+                                glm::abs(source.getHeightRange().y));
+  generate(source);
+}
+
+void Terrain::generate(const HeightSource& source) {
+  if (chunkSize <= 0 || params.size % chunkSize != 0) {
+    throw std::runtime_error("Terrain size " + std::to_string(params.size) +
+                             " is not a multiple of the chunk size " +
+                             std::to_string(chunkSize));
+  }
+  chunksPerSide = params.size / chunkSize;
+  PROFILE_SCOPE("Terrain generation");
+
+  const int chunkVertices = getVerticesPerChunk();
+  chunks.resize(static_cast<size_t>(chunksPerSide) * chunksPerSide);
+  vertices.resize(chunks.size() * chunkVertices);
+
+  // Generate the chunks in parallel, each into its own vertex block
+  ThreadPool::shared().parallelFor(chunks.size(), [&](size_t begin, size_t end) {
+    PROFILE_SCOPE("Terrain chunks");
+    for (size_t i = begin; i < end; ++i) {
+      TerrainChunk& chunk = chunks[i];
+      chunk.chunkX = static_cast<int>(i) % chunksPerSide;
+      chunk.chunkY = static_cast<int>(i) / chunksPerSide;
+      chunk.baseVertex = static_cast<int>(i) * chunkVertices;
+
+      HeightMapRegion region;
+      region.x = chunk.chunkX * chunkSize;
+      region.y = chunk.chunkY * chunkSize;
+      region.width = chunkSize + 1;
+      region.height = chunkSize + 1;
+      VertexType* block = vertices.data() + chunk.baseVertex;
+      source.generateRegion(region, block);
+      measureTerrainChunk(block, chunkSize, lod.getLevelCount(), chunk);
+    }
+  });
+}
+
+Terrain::Terrain(const HeightMapParams& params,
+                 int chunkSize,
+                 const TerrainLodOptions& lodOptions,
+                 std::vector<TerrainChunk> chunks)
+    : params(params), chunkSize(chunkSize), chunks(std::move(chunks)), lod(chunkSize, lodOptions) {
+  if (chunkSize <= 0 || params.size % chunkSize != 0) {
+    throw std::runtime_error("Terrain size " + std::to_string(params.size) +
+                             " is not a multiple of the chunk size " +
+                             std::to_string(chunkSize));
+  }
+  chunksPerSide = params.size / chunkSize;
+  if (this->chunks.size() != static_cast<size_t>(chunksPerSide) * chunksPerSide) {
+    throw std::runtime_error("Terrain has " + std::to_string(this->chunks.size()) +
+                             " chunks, expected " +
+                             std::to_string(chunksPerSide * chunksPerSide));
+  }
+}
+
+void Terrain::setLodOptions(const TerrainLodOptions& lodOptions) {
+  lod = TerrainLod(chunkSize, lodOptions);
+}
+
+void Terrain::getHeights(const HeightMapRegion& region, float* out) const {
+  if (vertices.empty()) {
+    throw std::runtime_error("Terrain has no CPU vertices to read heights from");
+  }
+  const int stride = chunkSize + 1;
+  for (int y = 0; y < region.height; ++y) {
+    const int gy = region.y + y;
+    const int chunkY = std::min(gy / chunkSize, chunksPerSide - 1);
+    for (int x = 0; x < region.width; ++x) {
+      const int gx = region.x + x;
+      const int chunkX = std::min(gx / chunkSize, chunksPerSide - 1);
+      const size_t block = static_cast<size_t>(chunkY * chunksPerSide + chunkX) * stride * stride;
+      const int local = (gx - chunkX * chunkSize) + stride * (gy - chunkY * chunkSize);
+      out[static_cast<size_t>(y) * region.width + x] = vertices[block + local].position.z;
+    }
+  }
+}
+
+template <typename Fn>
+void Terrain::forEachCopy(int x, int y, Fn&& fn) {
+  const int stride = chunkSize + 1;
+  const int lastX = std::min(x / chunkSize, chunksPerSide - 1);
+  const int lastY = std::min(y / chunkSize, chunksPerSide - 1);
+  const int firstX = x % chunkSize == 0 && x > 0 ? x / chunkSize - 1 : lastX;
+  const int firstY = y % chunkSize == 0 && y > 0 ? y / chunkSize - 1 : lastY;
+  for (int chunkY = firstY; chunkY <= lastY; ++chunkY) {
+    for (int chunkX = firstX; chunkX <= lastX; ++chunkX) {
+      const size_t block = static_cast<size_t>(chunkY * chunksPerSide + chunkX) * stride * stride;
+      const int local = (x - chunkX * chunkSize) + stride * (y - chunkY * chunkSize);
+      fn(vertices[block + local]);
+    }
+  }
+}
+
+HeightMapRegion Terrain::sculpt(const glm::vec2& center, float radius, float amount) {
+  PROFILE_FUNCTION();
+  if (vertices.empty()) {
+    throw std::runtime_error("Terrain has no CPU vertices to edit");
+  }
+  // Grid vertices under the brush
+  const int size = params.size;
+  const float spacing = params.spacing;
+  auto toGrid = [&](float world) { return world / spacing + static_cast<float>(size / 2); };
+  const int x0 = std::max(static_cast<int>(std::ceil(toGrid(center.x - radius))), 0);
+  const int y0 = std::max(static_cast<int>(std::ceil(toGrid(center.y - radius))), 0);
+  const int x1 = std::min(static_cast<int>(std::floor(toGrid(center.x + radius))), size);
+  const int y1 = std::min(static_cast<int>(std::floor(toGrid(center.y + radius))), size);
+  if (radius <= 0.0f || x0 > x1 || y0 > y1) {
+    return {};
+  }
+
+  // Normals change one vertex around the edit and need heights one further
+  auto expand = [&](const HeightMapRegion& region) {
+    const int left = std::max(region.x - 1, 0);
+    const int bottom = std::max(region.y - 1, 0);
+    return HeightMapRegion{left, bottom,
+                           std::min(region.x + region.width, size) - left + 1,
+                           std::min(region.y + region.height, size) - bottom + 1};
+  };
+  const HeightMapRegion edited{x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+  const HeightMapRegion changed = expand(edited);
+  const HeightMapRegion needed = expand(changed);
+  std::vector<float> heights(static_cast<size_t>(needed.width) * needed.height);
+  getHeights(needed, heights.data());
+  auto height = [&](int x, int y) -> float& {
+    return heights[static_cast<size_t>(y - needed.y) * needed.width + (x - needed.x)];
+  };
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      const glm::vec2 offset((x - size / 2) * spacing - center.x,
+                             (y - size / 2) * spacing - center.y);
+      const float t = std::min(glm::dot(offset, offset) / (radius * radius), 1.0f);
+      height(x, y) += amount * (1.0f - t) * (1.0f - t);
+    }
+  }
+
+  // Same central differences as TiledHeightSource, one-sided at the edges
+  for (int y = changed.y; y < changed.y + changed.height; ++y) {
+    for (int x = changed.x; x < changed.x + changed.width; ++x) {
+      const int left = std::max(x - 1, 0), right = std::min(x + 1, size);
+      const int below = std::max(y - 1, 0), above = std::min(y + 1, size);
+      const float hx = (height(right, y) - height(left, y)) / ((right - left) * spacing);
+      const float hy = (height(x, above) - height(x, below)) / ((above - below) * spacing);
+      const float h = height(x, y);
+      const float c = std::sin(h * 5.0f) * 0.5f + 0.5f;
+      const glm::vec3 normal = glm::normalize(glm::vec3(-hx, -hy, 1.0f));
+      forEachCopy(x, y, [&](VertexType& vertex) {
+        vertex.position.z = h;
+        vertex.normal = normal;
+        vertex.color = glm::vec4(c, 1.0f - c, 0.5f, 1.0f);
+      });
+    }
+  }
+
+  // The edit may have moved the bounds and LOD errors of its chunks
+  const int firstX = std::max(changed.x - 1, 0) / chunkSize;
+  const int firstY = std::max(changed.y - 1, 0) / chunkSize;
+  const int lastX = std::min((changed.x + changed.width - 1) / chunkSize, chunksPerSide - 1);
+  const int lastY = std::min((changed.y + changed.height - 1) / chunkSize, chunksPerSide - 1);
+  for (int chunkY = firstY; chunkY <= lastY; ++chunkY) {
+    for (int chunkX = firstX; chunkX <= lastX; ++chunkX) {
+      TerrainChunk& chunk = chunks[chunkY * chunksPerSide + chunkX];
+      measureTerrainChunk(vertices.data() + chunk.baseVertex, chunkSize, lod.getLevelCount(),
+                          chunk);
+    }
+  }
+  return changed;
+}
+
+void Terrain::cull(const Frustum& frustum, std::vector<int>& visible) const {
+  PROFILE_SCOPE("Terrain::cull");
+  visible.clear();
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (frustum.intersects(chunks[i].bounds)) {
+      visible.push_back(static_cast<int>(i));
+    }
+  }
+}
+
+void Terrain::selectLod(const TerrainLodSettings& settings,
+                        const glm::vec3& eye,
+                        const std::vector<int>& visible,
+                        std::vector<TerrainDraw>& draws) {
+  PROFILE_SCOPE("Terrain::selectLod");
+  selectChunkLod(settings, lod, eye, chunks, chunksPerSide, chunksPerSide, visible,
+                 chunkLevels, draws);
+}
+
+void selectChunkLod(const TerrainLodSettings& settings,
+                    const TerrainLod& lod,
+                    const glm::vec3& eye,
+                    const std::vector<TerrainChunk>& chunks,
+                    int columns,
+                    int rows,
+                    const std::vector<int>& visible,
+                    std::vector<int>& levels,
+                    std::vector<TerrainDraw>& draws) {
+  draws.clear();
+  levels.assign(chunks.size(), 0);
+
+  if (settings.enabled) {
+    // Pixels covered by one world unit at distance 1
+    const float pixelsPerUnit =
+        settings.viewportHeight / (2.0f * std::tan(settings.fieldOfView * 0.5f));
+
+    // Levels are chosen for every chunk, not only visible ones, because
+    // hidden neighbours still decide how visible chunks are stitched
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      const TerrainChunk& chunk = chunks[i];
+      glm::vec3 outside = glm::max(glm::max(chunk.bounds.min - eye,
+                                            eye - chunk.bounds.max),
+                                   glm::vec3(0.0f));
+      float distance = std::max(glm::length(outside), 1e-3f);
+      int level = 0;
+      while (level + 1 < lod.getLevelCount() &&
+             chunk.lodError[level + 1] * pixelsPerUnit / distance <=
+                 settings.pixelError) {
+        ++level;
+      }
+      levels[i] = level;
+    }
+
+    // Stitching only handles one level of difference, so refine chunks
+    // that are more than one level coarser than a neighbour
+    const int n = columns;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < n; ++x) {
+          int& level = levels[x + n * y];
+          int finest = level;
+          if (x > 0) finest = std::min(finest, levels[x - 1 + n * y] + 1);
+          if (x + 1 < n) finest = std::min(finest, levels[x + 1 + n * y] + 1);
+          if (y > 0) finest = std::min(finest, levels[x + n * (y - 1)] + 1);
+          if (y + 1 < rows) finest = std::min(finest, levels[x + n * (y + 1)] + 1);
+          if (finest < level) {
+            level = finest;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  draws.reserve(visible.size());
+  for (int index : visible) {
+    const TerrainChunk& chunk = chunks[index];
+    const int n = columns;
+    const int level = levels[index];
+    auto coarser = [&](int x, int y) {
+      return x >= 0 && x < n && y >= 0 && y < rows &&
+             levels[x + n * y] > level;
+    };
+
+    TerrainDraw draw;
+    draw.chunk = index;
+    draw.level = level;
+    if (coarser(chunk.chunkX - 1, chunk.chunkY)) draw.stitchMask |= TerrainLod::kStitchLeft;
+    if (coarser(chunk.chunkX + 1, chunk.chunkY)) draw.stitchMask |= TerrainLod::kStitchRight;
+    if (coarser(chunk.chunkX, chunk.chunkY - 1)) draw.stitchMask |= TerrainLod::kStitchBottom;
+    if (coarser(chunk.chunkX, chunk.chunkY + 1)) draw.stitchMask |= TerrainLod::kStitchTop;
+    draws.push_back(draw);
+  }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Frustum.hpp"
+#include "HeightMap.hpp"
+#include "HeightSource.hpp"
+#include "TerrainLod.hpp"
+
+// Square block of the heightmap grid that is culled and drawn as a unit
+struct TerrainChunk {
+  AABB bounds;         // World-space bounds of the chunk's vertices
+  int chunkX = 0;      // Chunk column
+  int chunkY = 0;      // Chunk row
+  int baseVertex = 0;  // Index of the chunk's first vertex in the buffer
+
+  // Largest vertical deviation from the full-resolution surface per LOD level
+  std::array<float, TerrainLod::kMaxLevels> lodError{};
+};
+
+// Controls how chunk detail levels are chosen
+struct TerrainLodSettings {
+  bool enabled = true;            // Draw every chunk at full resolution if off
+  float pixelError = 2.0f;        // Allowed screen-space error in pixels
+  float viewportHeight = 480.0f;  // Viewport height in pixels
+  float fieldOfView = 0.785398f;  // Vertical field of view in radians
+};
+
+// One chunk submission: which chunk, at which level, stitched how
+struct TerrainDraw {
+  int chunk = 0;            // Index into Terrain::getChunks()
+  int level = 0;            // LOD level, 0 is full resolution
+  unsigned stitchMask = 0;  // TerrainLod stitch bits
+};
+
+// Measures a chunk from its (chunkSize + 1)^2 vertex block: its bounds and how
+// far the surface deviates from its triangulation at each of `levelCount`
+// LOD levels
+void measureTerrainChunk(const VertexType* block,
+                         int chunkSize,
+                         int levelCount,
+                         TerrainChunk& chunk);
+
+// Picks the coarsest level whose projected error stays within the budget for
+// every chunk of a columns x rows grid (chunks row-major, chunkX and chunkY
+// their grid position), limits neighbouring chunks to one level of difference
+// and emits a draw with the matching stitch mask for each visible chunk.
+// `levels` receives the level of every chunk.
+void selectChunkLod(const TerrainLodSettings& settings,
+                    const TerrainLod& lod,
+                    const glm::vec3& eye,
+                    const std::vector<TerrainChunk>& chunks,
+                    int columns,
+                    int rows,
+                    const std::vector<int>& visible,
+                    std::vector<int>& levels,
+                    std::vector<TerrainDraw>& draws);
+
+// CPU-side heightmap terrain split into fixed-size chunks. Every chunk owns a
+// contiguous block of (chunkSize + 1)^2 vertices (border vertices are
+// duplicated) so all chunks share the TerrainLod index lists and are drawn
+// with a base vertex offset.
+class Terrain {
+ public:
+  // Generates the mesh of the analytic surface; chunkSize must be a power of
+  // two dividing params.size
+  Terrain(const HeightMapParams& params,
+          int chunkSize,
+          const TerrainLodOptions& lodOptions = {});
+
+  // Generates the mesh of a square source, e.g. elevation tiles; the params
+  // take the source's size and spacing
+  Terrain(const HeightSource& source,
+          int chunkSize,
+          const TerrainLodOptions& lodOptions = {});
+
+  // Adopts a chunk table computed earlier, e.g. read from a scene file,
+  // instead of generating the surface. The terrain then has no CPU
+  // vertices: its mesh must come from wherever the chunks came from.
+  Terrain(const HeightMapParams& params,
+          int chunkSize,
+          const TerrainLodOptions& lodOptions,
+          std::vector<TerrainChunk> chunks);
+
+  // Returns the grid parameters
+  const HeightMapParams& getParams() const { return params; }
+
+  // Returns the number of quads per chunk side
+  int getChunkSize() const { return chunkSize; }
+
+  // Returns the number of chunks per terrain side
+  int getChunksPerSide() const { return chunksPerSide; }
+
+  // Returns the number of vertices in each chunk's block
+  int getVerticesPerChunk() const { return (chunkSize + 1) * (chunkSize + 1); }
+
+  // Returns the chunks in row-major order
+  const std::vector<TerrainChunk>& getChunks() const { return chunks; }
+
+  // Returns the vertices of all chunks, one block per chunk; empty if the
+  // terrain was made from a chunk table
+  const std::vector<VertexType>& getVertices() const { return vertices; }
+
+  // Returns the LOD index lists shared by every chunk (chunk-local indices)
+  const TerrainLod& getLod() const { return lod; }
+
+  // Copies the heights of `region` (row-major) out of the chunk blocks;
+  // requires CPU vertices
+  void getHeights(const HeightMapRegion& region, float* out) const;
+
+  // Raises the surface by `amount` at `center` (world x/y), falling off
+  // smoothly to nothing at `radius`; a negative amount lowers it. Normals
+  // around the edit are recomputed from central differences and the
+  // touched chunks' bounds and LOD errors are remeasured. Returns the grid
+  // vertices that changed, empty if the brush misses the terrain. Throws if
+  // the terrain has no CPU vertices.
+  HeightMapRegion sculpt(const glm::vec2& center, float radius, float amount);
+
+  // Rebuilds the LOD index lists with different ordering options
+  void setLodOptions(const TerrainLodOptions& lodOptions);
+
+  // Collects the indices of the chunks that intersect the frustum
+  void cull(const Frustum& frustum, std::vector<int>& visible) const;
+
+  // Picks the chunk levels with selectChunkLod()
+  void selectLod(const TerrainLodSettings& settings,
+                 const glm::vec3& eye,
+                 const std::vector<int>& visible,
+                 std::vector<TerrainDraw>& draws);
+
+ private:
+  // Generates the chunks from `source`
+  void generate(const HeightSource& source);
+
+  // Calls fn(vertex) for every copy of grid vertex (x, y) in the chunk
+  // blocks: one inside a chunk, up to four on chunk borders
+  template <typename Fn>
+  void forEachCopy(int x, int y, Fn&& fn);
+
+  HeightMapParams params;            // Grid parameters
+  int chunkSize;                     // Quads per chunk side
+  int chunksPerSide;                 // Chunks per terrain side
+  std::vector<TerrainChunk> chunks;  // Chunk table
+  std::vector<VertexType> vertices;  // Vertex blocks of all chunks
+  TerrainLod lod;                    // Shared chunk index lists
+  std::vector<int> chunkLevels;      // Scratch: level chosen per chunk
+};
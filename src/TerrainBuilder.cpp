@@ -0,0 +1,99 @@
+#include "TerrainBuilder.hpp"
+
+#include <exception>
+#include <iostream>
+#include <utility>
+
+#include "Profiler.hpp"
+
+TerrainBuilder::TerrainBuilder(std::function<void()> onResult)
+    : onResult(std::move(onResult)), worker([this] { workerLoop(); }) {}
+
+TerrainBuilder::~TerrainBuilder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    pending.reset();
+  }
+  condition.notify_all();
+  worker.join();
+}
+
+void TerrainBuilder::request(const HeightMapParams& params,
+                             int chunkSize,
+                             const TerrainLodOptions& lodOptions,
+                             VertexFormat format) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = Request{params, chunkSize, lodOptions, format,
+                      std::chrono::steady_clock::now(), generation};
+  }
+  condition.notify_one();
+}
+
+void TerrainBuilder::cancel() {
+  std::lock_guard<std::mutex> lock(mutex);
+  ++generation;
+  pending.reset();
+  result.reset();
+}
+
+bool TerrainBuilder::isBusy() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return building || pending.has_value();
+}
+
+bool TerrainBuilder::hasResult() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return result != nullptr;
+}
+
+std::unique_ptr<TerrainBuild> TerrainBuilder::takeResult() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::move(result);
+}
+
+void TerrainBuilder::workerLoop() {
+  PROFILE_THREAD("Terrain Builder");
+  for (;;) {
+    Request job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return stopping || pending.has_value(); });
+      if (stopping) {
+        return;
+      }
+      job = *pending;
+      pending.reset();
+      building = true;
+    }
+
+    // Generation and mesh conversion both spread over ThreadPool::shared()
+    PROFILE_SCOPE("Terrain rebuild");
+    auto start = std::chrono::steady_clock::now();
+    auto build = std::make_unique<TerrainBuild>();
+    try {
+      build->terrain =
+          std::make_unique<Terrain>(job.params, job.chunkSize, job.lodOptions);
+      build->mesh = buildTerrainMesh(*build->terrain, job.format);
+    } catch (const std::exception& e) {
+      std::cerr << "Warning: Terrain rebuild failed: " << e.what() << std::endl;
+      build.reset();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      building = false;
+      if (!build || job.generation != generation) {
+        continue;
+      }
+      build->requested = job.requested;
+      build->buildSeconds = elapsed.count();
+      result = std::move(build);
+    }
+    if (onResult) {
+      onResult();
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Terrain.hpp"
+#include "TerrainRenderer.hpp"
+
+// Terrain and GPU-ready mesh produced by a background rebuild
+struct TerrainBuild {
+  std::unique_ptr<Terrain> terrain;                 // The new terrain
+  TerrainMesh mesh;                                 // Its buffer contents
+  std::chrono::steady_clock::time_point requested;  // When it was requested
+  double buildSeconds = 0.0;                        // Time spent on the worker
+};
+
+// Regenerates the terrain on a dedicated worker thread so parameter changes
+// never block the render loop. Requests are coalesced: while a build runs,
+// only the most recent request is kept and built next, and a finished build
+// replaces an older one that has not been taken yet.
+class TerrainBuilder {
+ public:
+  // Starts the worker thread. `onResult` runs on the worker after each
+  // finished build, e.g. to wake a render loop waiting for events.
+  explicit TerrainBuilder(std::function<void()> onResult = {});
+
+  // Discards pending work and joins the worker after the current build
+  ~TerrainBuilder();
+
+  TerrainBuilder(const TerrainBuilder&) = delete;
+  TerrainBuilder& operator=(const TerrainBuilder&) = delete;
+
+  // Queues a rebuild with the given parameters
+  void request(const HeightMapParams& params,
+               int chunkSize,
+               const TerrainLodOptions& lodOptions,
+               VertexFormat format);
+
+  // Discards the queued request, the untaken result and the result of the
+  // build in progress, e.g. when a scene is loaded in their place
+  void cancel();
+
+  // Returns true while a request is queued or being built
+  bool isBusy() const;
+
+  // Returns true if a finished build is waiting to be taken
+  bool hasResult() const;
+
+  // Returns the latest finished build, or nullptr if there is none
+  std::unique_ptr<TerrainBuild> takeResult();
+
+ private:
+  // Parameters of one rebuild
+  struct Request {
+    HeightMapParams params;
+    int chunkSize = 0;
+    TerrainLodOptions lodOptions;
+    VertexFormat format = VertexFormat::Full;
+    std::chrono::steady_clock::time_point requested;
+    uint64_t generation = 0;  // Of the builder when requested
+  };
+
+  void workerLoop();
+
+  mutable std::mutex mutex;              // Guards the members below
+  std::condition_variable condition;     // Signals new requests
+  std::optional<Request> pending;        // Most recent request not yet started
+  bool building = false;                 // The worker is building a request
+  std::unique_ptr<TerrainBuild> result;  // Finished build not yet taken
+  bool stopping = false;                 // Set when the builder shuts down
+  uint64_t generation = 0;               // Incremented by cancel()
+  std::function<void()> onResult;        // Called after a build finishes
+  std::thread worker;  // Builds the terrains; started after the state above
+};
@@ -0,0 +1,95 @@
+#include "TerrainLod.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "IndexOptimizer.hpp"
+#include "Profiler.hpp"
+
+TerrainLod::TerrainLod(int chunkSize, const TerrainLodOptions& options)
+    : chunkSize(chunkSize), levelCount(0), options(options) {
+  PROFILE_SCOPE("TerrainLod build");
+  if (chunkSize <= 0 || (chunkSize & (chunkSize - 1)) != 0 ||
+      chunkSize > (1 << (kMaxLevels - 1))) {
+    throw std::runtime_error("Chunk size " + std::to_string(chunkSize) +
+                             " is not a power of two up to " +
+                             std::to_string(1 << (kMaxLevels - 1)));
+  }
+  while ((1 << levelCount) <= chunkSize) {
+    ++levelCount;
+  }
+
+  const int stride = chunkSize + 1;
+  const uint32_t vertexCount = static_cast<uint32_t>(stride * stride);
+  ranges.resize(static_cast<size_t>(levelCount) * kMaskCount);
+  std::vector<uint32_t> list;
+  double totalTriangles = 0.0;
+
+  for (int level = 0; level < levelCount; ++level) {
+    const int step = 1 << level;
+    const int cells = chunkSize / step;
+
+    for (unsigned mask = 0; mask < kMaskCount; ++mask) {
+      // The coarsest level has no coarser neighbour to stitch to
+      const unsigned stitch = level + 1 < levelCount ? mask : 0;
+
+      // Moves odd edge vertices of stitched sides onto the next even vertex
+      auto vertex = [&](int x, int y) {
+        bool oddX = (x / step) % 2 == 1;
+        bool oddY = (y / step) % 2 == 1;
+        if ((stitch & kStitchLeft) && x == 0 && oddY) y += step;
+        if ((stitch & kStitchRight) && x == chunkSize && oddY) y += step;
+        if ((stitch & kStitchBottom) && y == 0 && oddX) x += step;
+        if ((stitch & kStitchTop) && y == chunkSize && oddX) x += step;
+        return static_cast<uint32_t>(x + stride * y);
+      };
+      auto triangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+        if (a != b && b != c && c != a) {
+          list.push_back(a);
+          list.push_back(b);
+          list.push_back(c);
+        }
+      };
+
+      // Row-major cells with the same diagonal as the full-resolution grid.
+      // The upper-left triangle comes first so a row forms a single strip.
+      list.clear();
+      for (int y = 0; y < cells; ++y) {
+        for (int x = 0; x < cells; ++x) {
+          uint32_t v00 = vertex(x * step, y * step);
+          uint32_t v10 = vertex((x + 1) * step, y * step);
+          uint32_t v11 = vertex((x + 1) * step, (y + 1) * step);
+          uint32_t v01 = vertex(x * step, (y + 1) * step);
+          triangle(v11, v01, v00);
+          triangle(v00, v10, v11);
+        }
+      }
+
+      const double triangles = static_cast<double>(list.size() / 3);
+      const double acmrOriginal =
+          IndexOptimizer::computeAcmr(list.data(), list.size(), vertexCount);
+      double acmrOptimized = acmrOriginal;
+      if (options.triangleStrips) {
+        list = IndexOptimizer::buildTriangleStrips(list.data(), list.size());
+        acmrOptimized =
+            IndexOptimizer::computeStripAcmr(list.data(), list.size(), vertexCount);
+      } else if (options.optimizeVertexCache) {
+        IndexOptimizer::optimizeVertexCache(list, vertexCount);
+        acmrOptimized =
+            IndexOptimizer::computeAcmr(list.data(), list.size(), vertexCount);
+      }
+      stats.acmrOriginal += acmrOriginal * triangles;
+      stats.acmrOptimized += acmrOptimized * triangles;
+      totalTriangles += triangles;
+
+      Range& range = ranges[level * kMaskCount + mask];
+      range.first = static_cast<uint32_t>(indices.size());
+      range.count = static_cast<uint32_t>(list.size());
+      range.triangles = static_cast<uint32_t>(triangles);
+      indices.insert(indices.end(), list.begin(), list.end());
+    }
+  }
+
+  stats.acmrOriginal /= totalTriangles;
+  stats.acmrOptimized /= totalTriangles;
+}
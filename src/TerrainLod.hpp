@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Controls how the LOD index lists are ordered and encoded
+struct TerrainLodOptions {
+  bool optimizeVertexCache = true;  // Reorder triangle lists (Forsyth)
+  bool triangleStrips = false;      // Emit strips with primitive restart
+
+  bool operator==(const TerrainLodOptions&) const = default;
+};
+
+// Precomputed chunk index lists for geomipmapping. Level l samples every
+// 2^l-th vertex of a chunk's (chunkSize + 1)^2 block. For each level there is
+// one list per stitch mask: when a side's bit is set the neighbour on that
+// side is one level coarser, and the odd vertices along that edge are snapped
+// onto the next even vertex so the edge matches the neighbour's and no
+// T-junction cracks appear. Triangles collapsed by the snapping are dropped.
+//
+// Lists are either triangle lists reordered for the post-transform vertex
+// cache, or row strips separated by IndexOptimizer::kRestartIndex.
+class TerrainLod {
+ public:
+  // Highest number of levels supported (chunk sizes up to 128)
+  static constexpr int kMaxLevels = 8;
+
+  // Stitch mask bits, one per chunk side
+  static constexpr unsigned kStitchLeft = 1;    // -x neighbour is coarser
+  static constexpr unsigned kStitchRight = 2;   // +x neighbour is coarser
+  static constexpr unsigned kStitchBottom = 4;  // -y neighbour is coarser
+  static constexpr unsigned kStitchTop = 8;     // +y neighbour is coarser
+  static constexpr unsigned kMaskCount = 16;
+
+  // Range of the packed index list used by one (level, mask) combination
+  struct Range {
+    uint32_t first = 0;      // Offset of the first index
+    uint32_t count = 0;      // Number of indices, including strip restarts
+    uint32_t triangles = 0;  // Number of triangles drawn
+  };
+
+  // Vertex cache efficiency of all lists, weighted by triangle count, on a
+  // 16 entry FIFO cache
+  struct Stats {
+    double acmrOriginal = 0.0;   // Plain row-major order
+    double acmrOptimized = 0.0;  // Order actually stored
+  };
+
+  // Builds every level for a chunk size that is a power of two
+  explicit TerrainLod(int chunkSize, const TerrainLodOptions& options = {});
+
+  // Returns the number of levels (log2(chunkSize) + 1)
+  int getLevelCount() const { return levelCount; }
+
+  // Returns the options the lists were built with
+  const TerrainLodOptions& getOptions() const { return options; }
+
+  // Returns true if the lists are triangle strips rather than triangle lists
+  bool usesTriangleStrips() const { return options.triangleStrips; }
+
+  // Returns the cache statistics gathered while building
+  const Stats& getStats() const { return stats; }
+
+  // Returns the packed triangle lists of all combinations
+  const std::vector<uint32_t>& getIndices() const { return indices; }
+
+  // Returns the index range for a level and stitch mask
+  const Range& getRange(int level, unsigned stitchMask) const {
+    return ranges[level * kMaskCount + stitchMask];
+  }
+
+ private:
+  int chunkSize;                  // Quads per chunk side
+  int levelCount;                 // Number of levels
+  TerrainLodOptions options;      // Ordering and encoding options
+  Stats stats;                    // Cache statistics
+  std::vector<uint32_t> indices;  // All lists, back to back
+  std::vector<Range> ranges;      // levelCount * kMaskCount ranges
+};
@@ -0,0 +1,439 @@
+#include "TerrainRenderer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "IndexOptimizer.hpp"
+#include "Profiler.hpp"
+#include "asset.hpp"
+
+namespace {
+// Enables an attribute of the bound vertex array, read from the bound buffer
+void setAttribute(GLuint location, GLint size, GLsizei stride, size_t offset,
+                  GLboolean normalize = GL_FALSE, GLenum type = GL_FLOAT) {
+  glEnableVertexAttribArray(location);
+  glVertexAttribPointer(location, size, type, normalize, stride,
+                        reinterpret_cast<void*>(static_cast<uintptr_t>(offset)));
+}
+}  // namespace
+
+AttributeLocations TerrainAttributes::getLocations() {
+  return {{"position", kPosition},
+          {"normal", kNormal},
+          {"color", kColor},
+          {"height", kHeight},
+          {"packedNormal", kPackedNormal},
+          {"instanceModel", kInstanceModel}};
+}
+
+void TerrainAttributes::setVertexType() {
+  setAttribute(kPosition, 3, sizeof(VertexType), offsetof(VertexType, position));
+  setAttribute(kNormal, 3, sizeof(VertexType), offsetof(VertexType, normal));
+  setAttribute(kColor, 4, sizeof(VertexType), offsetof(VertexType, color));
+}
+
+std::vector<ShaderStage> getTerrainShaderStages() {
+  return {{SHADER_DIR "/vertex_shader.glsl", GL_VERTEX_SHADER},
+          {SHADER_DIR "/fragment_shader.glsl", GL_FRAGMENT_SHADER}};
+}
+
+ShaderDefines makeTerrainDefines(VertexFormat format, bool specular, int lights,
+                                 bool instanced) {
+  return {{"COMPACT_VERTICES", format == VertexFormat::Compact ? "1" : "0"},
+          {"DISPLACED", format == VertexFormat::Displaced ? "1" : "0"},
+          {"INSTANCED", instanced ? "1" : "0"},
+          {"SPECULAR", specular ? "1" : "0"},
+          {"NUM_LIGHTS", std::to_string(std::clamp(lights, 1, TerrainUniforms::kMaxLights))}};
+}
+
+TerrainMeshView viewTerrainMesh(const TerrainMesh& mesh) {
+  return {mesh.vertexFormat, mesh.vertices.data(), mesh.vertices.size(),
+          mesh.gridSize,     mesh.indexType,       mesh.indices.data(),
+          mesh.indices.size(), mesh.strips};
+}
+
+TerrainMesh buildTerrainMesh(const Terrain& terrain, VertexFormat format) {
+  PROFILE_FUNCTION();
+  const auto& vertices = terrain.getVertices();
+  if (vertices.empty()) {
+    throw std::runtime_error("Terrain has no CPU vertices to build a mesh from");
+  }
+
+  TerrainMesh mesh;
+  mesh.vertexFormat = format;
+  mesh.gridSize = terrain.getParams().size;
+  if (format == VertexFormat::Displaced) {
+    const int side = terrain.getParams().verticesPerSide();
+    mesh.vertices.resize(terrain.getParams().vertexCount() * sizeof(float));
+    terrain.getHeights({0, 0, side, side}, reinterpret_cast<float*>(mesh.vertices.data()));
+  } else if (format == VertexFormat::Compact) {
+    mesh.vertices.resize(vertices.size() * sizeof(CompactVertexType));
+    compressVertices(vertices.data(), vertices.size(),
+                     reinterpret_cast<CompactVertexType*>(mesh.vertices.data()));
+  } else {
+    mesh.vertices.resize(vertices.size() * sizeof(VertexType));
+    std::memcpy(mesh.vertices.data(), vertices.data(), mesh.vertices.size());
+  }
+  buildTerrainIndices(terrain, mesh);
+  return mesh;
+}
+
+void buildTerrainIndices(const Terrain& terrain, TerrainMesh& mesh) {
+  buildTerrainIndices(terrain.getLod(), terrain.getVerticesPerChunk(), mesh);
+}
+
+void buildTerrainIndices(const TerrainLod& lod, int verticesPerChunk, TerrainMesh& mesh) {
+  const auto& indices = lod.getIndices();
+  mesh.strips = lod.usesTriangleStrips();
+
+  if (verticesPerChunk <= 0xFFFF) {
+    // Chunk-local indices fit in 16 bits; the restart index maps to 0xFFFF
+    mesh.indexType = GL_UNSIGNED_SHORT;
+    mesh.indices.resize(indices.size() * sizeof(uint16_t));
+    uint16_t* shortIndices = reinterpret_cast<uint16_t*>(mesh.indices.data());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      shortIndices[i] = indices[i] == IndexOptimizer::kRestartIndex
+                            ? static_cast<uint16_t>(0xFFFF)
+                            : static_cast<uint16_t>(indices[i]);
+    }
+  } else {
+    mesh.indexType = GL_UNSIGNED_INT;
+    mesh.indices.resize(indices.size() * sizeof(uint32_t));
+    std::memcpy(mesh.indices.data(), indices.data(), mesh.indices.size());
+  }
+}
+
+size_t TerrainDrawList::build(const TerrainLod& lod,
+                              GLenum indexType,
+                              const std::vector<TerrainChunk>& chunks,
+                              const std::vector<TerrainDraw>& draws) {
+  const size_t indexSize =
+      indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+  counts.resize(draws.size());
+  offsets.resize(draws.size());
+  baseVertices.resize(draws.size());
+  size_t triangles = 0;
+  for (size_t i = 0; i < draws.size(); ++i) {
+    const TerrainLod::Range& range = lod.getRange(draws[i].level, draws[i].stitchMask);
+    counts[i] = static_cast<GLsizei>(range.count);
+    offsets[i] = reinterpret_cast<const void*>(
+        static_cast<uintptr_t>(range.first) * indexSize);
+    baseVertices[i] = chunks[draws[i].chunk].baseVertex;
+    triangles += range.triangles;
+  }
+  return triangles;
+}
+
+void TerrainDrawList::submit(GLenum indexType, bool strips) const {
+  if (counts.empty()) {
+    return;
+  }
+  GLState::setEnabled(GL_PRIMITIVE_RESTART, strips);
+  if (strips) {
+    // The restart index is compared before the base vertex is added
+    GLState::primitiveRestartIndex(indexType == GL_UNSIGNED_SHORT
+                                       ? 0xFFFFu
+                                       : IndexOptimizer::kRestartIndex);
+  }
+  glMultiDrawElementsBaseVertex(strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES,
+                                counts.data(), indexType, offsets.data(),
+                                static_cast<GLsizei>(counts.size()),
+                                baseVertices.data());
+}
+
+TerrainRenderer::TerrainRenderer() {
+  for (int i = 0; i < 2; ++i) {
+    Buffers& set = buffers[i];
+    createBuffers(set);
+    const std::string suffix = " " + std::to_string(i);
+    GLDebug::label(GL_VERTEX_ARRAY, set.vao, "Terrain VAO" + suffix);
+    GLDebug::label(GL_VERTEX_ARRAY, set.compactVao, "Terrain compact VAO" + suffix);
+    GLDebug::label(GL_VERTEX_ARRAY, set.displacedVao, "Terrain displaced VAO" + suffix);
+    GLDebug::label(GL_TEXTURE, set.heightTexture, "Terrain heights" + suffix);
+    GLDebug::label(GL_BUFFER, set.vbo, "Terrain vertices" + suffix);
+    GLDebug::label(GL_BUFFER, set.ibo, "Terrain indices" + suffix);
+  }
+}
+
+TerrainRenderer::~TerrainRenderer() {
+  for (Buffers& set : buffers) {
+    glDeleteVertexArrays(1, &set.vao);
+    glDeleteVertexArrays(1, &set.compactVao);
+    glDeleteVertexArrays(1, &set.displacedVao);
+    glDeleteBuffers(1, &set.vbo);
+    glDeleteBuffers(1, &set.ibo);
+    glDeleteTextures(1, &set.heightTexture);
+    GLState::forgetVertexArray(set.vao);
+    GLState::forgetVertexArray(set.compactVao);
+    GLState::forgetVertexArray(set.displacedVao);
+    GLState::forgetBuffer(set.vbo);
+    GLState::forgetBuffer(set.ibo);
+    GLState::forgetTexture(set.heightTexture);
+  }
+}
+
+void TerrainRenderer::createBuffers(Buffers& set) {
+  glGenBuffers(1, &set.vbo);
+  glGenBuffers(1, &set.ibo);
+
+  // Set up Vertex Array Object (VAO)
+  glGenVertexArrays(1, &set.vao);
+  GLState::bindVertexArray(set.vao);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, set.vbo);
+
+  // Map vertex attributes to shader inputs
+  using namespace TerrainAttributes;
+  setVertexType();
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.ibo);
+
+  // The compact layout reads the same buffer with normalized integer types
+  glGenVertexArrays(1, &set.compactVao);
+  GLState::bindVertexArray(set.compactVao);
+  setAttribute(kHeight, 1, sizeof(CompactVertexType),
+               offsetof(CompactVertexType, height));
+  setAttribute(kPackedNormal, 2, sizeof(CompactVertexType),
+               offsetof(CompactVertexType, normal), GL_TRUE, GL_SHORT);
+  setAttribute(kColor, 4, sizeof(CompactVertexType),
+               offsetof(CompactVertexType, color), GL_TRUE, GL_UNSIGNED_BYTE);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.ibo);
+
+  // The displaced layout reads no attributes, only the indices
+  glGenVertexArrays(1, &set.displacedVao);
+  GLState::bindVertexArray(set.displacedVao);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.ibo);
+
+  GLState::bindVertexArray(0);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // Heights are fetched texel by texel, never filtered
+  glGenTextures(1, &set.heightTexture);
+  GLState::bindTexture(TerrainUniforms::kHeightTextureUnit, GL_TEXTURE_2D, set.heightTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void TerrainRenderer::setVertices(Buffers& set, const TerrainMeshView& mesh,
+                                  const void* vertices) {
+  const bool displaced = mesh.vertexFormat == VertexFormat::Displaced;
+  const int side = displaced ? mesh.gridSize + 1 : 0;
+  if (displaced) {
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (side > maxSize ||
+        mesh.vertexBytes != static_cast<size_t>(side) * side * sizeof(float)) {
+      throw std::runtime_error("Height grid of " + std::to_string(side) + "^2 samples (" +
+                               std::to_string(mesh.vertexBytes) + " bytes) does not fit a " +
+                               std::to_string(maxSize) + "^2 texture");
+    }
+  }
+  set.vertexFormat = mesh.vertexFormat;
+  set.vertexBytes = mesh.vertexBytes;
+  set.gridSize = mesh.gridSize;
+  GLState::bindBuffer(GL_ARRAY_BUFFER, set.vbo);
+  glBufferData(GL_ARRAY_BUFFER, displaced ? 0 : static_cast<GLsizeiptr>(set.vertexBytes),
+               displaced ? nullptr : vertices, GL_STATIC_DRAW);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+  GLState::bindTexture(TerrainUniforms::kHeightTextureUnit, GL_TEXTURE_2D, set.heightTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, side, side, 0, GL_RED, GL_FLOAT,
+               displaced ? vertices : nullptr);
+}
+
+void TerrainRenderer::setIndices(Buffers& set, const TerrainMeshView& mesh) {
+  set.indexType = mesh.indexType;
+  set.indexBytes = mesh.indexBytes;
+  set.strips = mesh.strips;
+
+  // Both vertex arrays reference the same element buffer
+  GLState::bindVertexArray(set.vao);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(set.indexBytes),
+               mesh.indices, GL_STATIC_DRAW);
+  GLState::bindVertexArray(0);
+}
+
+void TerrainRenderer::upload(const Terrain& terrain, VertexFormat format) {
+  TerrainMesh mesh = buildTerrainMesh(terrain, format);
+  upload(viewTerrainMesh(mesh));
+}
+
+void TerrainRenderer::upload(const TerrainMeshView& mesh) {
+  PROFILE_FUNCTION();
+  setVertices(buffers[front], mesh, mesh.vertices);
+  setIndices(buffers[front], mesh);
+}
+
+void TerrainRenderer::uploadIndices(const Terrain& terrain) {
+  TerrainMesh mesh;
+  buildTerrainIndices(terrain, mesh);
+  setIndices(buffers[front], viewTerrainMesh(mesh));
+}
+
+size_t TerrainRenderer::updateHeights(const Terrain& terrain, const HeightMapRegion& region) {
+  PROFILE_FUNCTION();
+  if (region.width <= 0 || region.height <= 0) {
+    return 0;
+  }
+  Buffers& set = buffers[front];
+  if (set.vertexFormat == VertexFormat::Displaced) {
+    std::vector<float> heights(static_cast<size_t>(region.width) * region.height);
+    terrain.getHeights(region, heights.data());
+    GLState::bindTexture(TerrainUniforms::kHeightTextureUnit, GL_TEXTURE_2D, set.heightTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, region.x, region.y, region.width, region.height, GL_RED,
+                    GL_FLOAT, heights.data());
+    return heights.size() * sizeof(float);
+  }
+
+  // Border vertices are duplicated, so a region on a chunk edge touches the
+  // chunks on both sides
+  const int chunkSize = terrain.getChunkSize();
+  const int chunksPerSide = terrain.getChunksPerSide();
+  const int firstX = std::max(region.x - 1, 0) / chunkSize;
+  const int firstY = std::max(region.y - 1, 0) / chunkSize;
+  const int lastX = std::min((region.x + region.width - 1) / chunkSize, chunksPerSide - 1);
+  const int lastY = std::min((region.y + region.height - 1) / chunkSize, chunksPerSide - 1);
+  const int verticesPerChunk = terrain.getVerticesPerChunk();
+  const size_t vertexSize = getVertexSize(set.vertexFormat);
+  const size_t blockBytes = verticesPerChunk * vertexSize;
+  std::vector<CompactVertexType> compact(
+      set.vertexFormat == VertexFormat::Compact ? verticesPerChunk : 0);
+  size_t bytes = 0;
+  GLState::bindBuffer(GL_ARRAY_BUFFER, set.vbo);
+  for (int chunkY = firstY; chunkY <= lastY; ++chunkY) {
+    for (int chunkX = firstX; chunkX <= lastX; ++chunkX) {
+      const TerrainChunk& chunk = terrain.getChunks()[chunkY * chunksPerSide + chunkX];
+      const VertexType* block = terrain.getVertices().data() + chunk.baseVertex;
+      const void* data = block;
+      if (!compact.empty()) {
+        for (int v = 0; v < verticesPerChunk; ++v) {
+          compact[v] = compressVertex(block[v]);
+        }
+        data = compact.data();
+      }
+      glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(chunk.baseVertex * vertexSize),
+                      static_cast<GLsizeiptr>(blockBytes), data);
+      bytes += blockBytes;
+    }
+  }
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+  return bytes;
+}
+
+void TerrainRenderer::beginUpload(TerrainMesh mesh) {
+  staging = std::move(mesh);
+  uploaded = 0;
+  uploading = true;
+
+  // Allocating new storage orphans whatever the GPU may still be reading from
+  // the back set, so the slices below never wait for it
+  Buffers& back = buffers[1 - front];
+  setVertices(back, viewTerrainMesh(staging), nullptr);
+  back.indexType = staging.indexType;
+  back.indexBytes = staging.indices.size();
+  back.strips = staging.strips;
+  GLState::bindVertexArray(back.vao);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(back.indexBytes),
+               nullptr, GL_STATIC_DRAW);
+  GLState::bindVertexArray(0);
+}
+
+bool TerrainRenderer::continueUpload(size_t byteBudget) {
+  if (!uploading) {
+    return false;
+  }
+  PROFILE_FUNCTION();
+
+  // Vertices first, then indices, as one contiguous byte range. The bindings
+  // are left in place so the next slice does not repeat them.
+  Buffers& back = buffers[1 - front];
+  const size_t vertexBytes = staging.vertices.size();
+  const size_t totalBytes = vertexBytes + staging.indices.size();
+  size_t end = std::min(totalBytes, uploaded + byteBudget);
+  if (uploaded < vertexBytes && back.vertexFormat == VertexFormat::Displaced) {
+    // Whole rows of texels, at least one per slice
+    const int side = back.gridSize + 1;
+    const size_t rowBytes = static_cast<size_t>(side) * sizeof(float);
+    const size_t rows = std::max<size_t>((std::min(end, vertexBytes) - uploaded) / rowBytes, 1);
+    GLState::bindTexture(TerrainUniforms::kHeightTextureUnit, GL_TEXTURE_2D, back.heightTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(uploaded / rowBytes), side,
+                    static_cast<GLsizei>(rows), GL_RED, GL_FLOAT,
+                    staging.vertices.data() + uploaded);
+    uploaded += rows * rowBytes;
+    end = std::max(end, uploaded);
+  } else if (uploaded < vertexBytes) {
+    size_t sliceEnd = std::min(end, vertexBytes);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, back.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(uploaded),
+                    static_cast<GLsizeiptr>(sliceEnd - uploaded),
+                    staging.vertices.data() + uploaded);
+    uploaded = sliceEnd;
+  }
+  if (uploaded >= vertexBytes && uploaded < end) {
+    size_t first = uploaded - vertexBytes;
+    GLState::bindVertexArray(back.vao);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(first),
+                    static_cast<GLsizeiptr>(end - uploaded),
+                    staging.indices.data() + first);
+    uploaded = end;
+  }
+
+  if (uploaded < totalBytes) {
+    return false;
+  }
+  front = 1 - front;
+  uploading = false;
+  staging = TerrainMesh();
+  return true;
+}
+
+void TerrainRenderer::cancelUpload() {
+  uploading = false;
+  uploaded = 0;
+  staging = TerrainMesh();
+}
+
+float TerrainRenderer::getUploadProgress() const {
+  size_t totalBytes = staging.vertices.size() + staging.indices.size();
+  return totalBytes > 0 ? static_cast<float>(uploaded) / totalBytes : 1.0f;
+}
+
+size_t TerrainRenderer::draw(const Terrain& terrain,
+                             const std::vector<TerrainDraw>& draws,
+                             ShaderProgram& program) {
+  PROFILE_FUNCTION();
+  if (draws.empty()) {
+    return 0;
+  }
+
+  const Buffers& set = buffers[front];
+  const size_t triangles =
+      drawList.build(terrain.getLod(), set.indexType, terrain.getChunks(), draws);
+
+  // Compact and displaced vertices rebuild x/y from gl_VertexID, which
+  // includes the base vertex of the chunk's block
+  const bool compact = set.vertexFormat == VertexFormat::Compact;
+  const bool displaced = set.vertexFormat == VertexFormat::Displaced;
+  if (compact || displaced) {
+    const HeightMapParams& params = terrain.getParams();
+    program.setUniform(TerrainUniforms::chunkSize, terrain.getChunkSize());
+    program.setUniform(TerrainUniforms::chunksPerSide, terrain.getChunksPerSide());
+    program.setUniform(TerrainUniforms::gridSpacing, params.spacing);
+  }
+  if (displaced) {
+    program.setUniform(TerrainUniforms::heightTexture,
+                       static_cast<int>(TerrainUniforms::kHeightTextureUnit));
+    GLState::bindTexture(TerrainUniforms::kHeightTextureUnit, GL_TEXTURE_2D, set.heightTexture);
+  }
+
+  // Bindings stay in place, so the next frame's identical calls are skipped
+  GLState::bindVertexArray(displaced ? set.displacedVao : compact ? set.compactVao : set.vao);
+  drawList.submit(set.indexType, set.strips);
+  return triangles;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+#include "Shader.hpp"
+#include "ShaderManager.hpp"
+#include "Terrain.hpp"
+#include "VertexFormat.hpp"
+
+// Uniforms of the terrain shader program
+namespace TerrainUniforms {
+// Uniform buffer binding points of the blocks below
+inline constexpr GLuint kFrameBinding = 0;
+inline constexpr GLuint kObjectBinding = 1;
+
+// Lights in FrameBlock, MAX_LIGHTS in frame_uniforms.glsl
+inline constexpr int kMaxLights = 4;
+
+// std140 FrameUniforms block, written once per frame
+struct FrameBlock {
+  glm::mat4 projection;
+  glm::mat4 view;
+  glm::vec4 lights[kMaxLights];  // World-space light positions, w unused
+};
+static_assert(sizeof(FrameBlock) == 192, "FrameBlock must match std140");
+
+// std140 ObjectUniforms block, written once per drawn object
+struct ObjectBlock {
+  glm::mat4 model;
+  glm::mat4 normalMatrix;  // transpose(inverse(model)); the shader uses its 3x3
+};
+static_assert(sizeof(ObjectBlock) == 128, "ObjectBlock must match std140");
+
+// Builds the block of an object, inverting its model matrix once on the CPU
+// instead of once per vertex
+inline ObjectBlock makeObjectBlock(const glm::mat4& model) {
+  return ObjectBlock{model, glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))))};
+}
+
+// Uniforms of the COMPACT_VERTICES and DISPLACED permutations
+inline constexpr Uniform<int> chunkSize("chunkSize");
+inline constexpr Uniform<int> chunksPerSide("chunksPerSide");
+inline constexpr Uniform<float> gridSpacing("gridSpacing");
+
+// Height texture of the DISPLACED permutations and its texture unit
+inline constexpr Uniform<int> heightTexture("heightTexture");
+inline constexpr GLuint kHeightTextureUnit = 1;
+
+// Assigns the blocks above to their binding points; INSTANCED permutations
+// have no ObjectUniforms
+inline void bindBlocks(ShaderProgram& program, bool instanced = false) {
+  program.bindUniformBlock("FrameUniforms", kFrameBinding, sizeof(FrameBlock));
+  if (!instanced) {
+    program.bindUniformBlock("ObjectUniforms", kObjectBinding, sizeof(ObjectBlock));
+  }
+}
+}  // namespace TerrainUniforms
+
+// Attribute locations shared by every terrain program permutation, so the
+// vertex arrays do not depend on the program drawing them
+namespace TerrainAttributes {
+inline constexpr GLuint kPosition = 0;
+inline constexpr GLuint kNormal = 1;
+inline constexpr GLuint kColor = 2;
+inline constexpr GLuint kHeight = 3;
+inline constexpr GLuint kPackedNormal = 4;
+inline constexpr GLuint kInstanceModel = 5;  // mat4, locations 5 to 8
+
+// Returns the locations to bind before linking
+AttributeLocations getLocations();
+
+// Points the position, normal and colour attributes of the bound vertex array
+// at VertexType data in the bound GL_ARRAY_BUFFER
+void setVertexType();
+}  // namespace TerrainAttributes
+
+// Returns the vertex and fragment shader of the terrain program
+std::vector<ShaderStage> getTerrainShaderStages();
+
+// Returns the defines of a terrain program permutation: the vertex layout
+// (COMPACT_VERTICES or DISPLACED),
+// specular highlights on or off, the number of lights shaded, and whether
+// the model matrix and colour are per-instance attributes (which requires
+// VertexFormat::Full)
+ShaderDefines makeTerrainDefines(VertexFormat format, bool specular, int lights,
+                                 bool instanced = false);
+
+// CPU-side contents of a terrain's GPU buffers. Building it does not touch
+// OpenGL, so it can be prepared on a worker thread and uploaded later.
+struct TerrainMesh {
+  VertexFormat vertexFormat = VertexFormat::Full;  // Layout of `vertices`
+  std::vector<uint8_t> vertices;       // VertexType, CompactVertexType or height grid
+  int gridSize = 0;                    // Quads per side of the terrain
+  GLenum indexType = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  std::vector<uint8_t> indices;        // Packed LOD index lists
+  bool strips = false;                 // Index lists are triangle strips
+};
+
+// TerrainMesh contents held elsewhere, e.g. in a mapped scene file
+struct TerrainMeshView {
+  VertexFormat vertexFormat = VertexFormat::Full;
+  const void* vertices = nullptr;
+  size_t vertexBytes = 0;
+  int gridSize = 0;
+  GLenum indexType = GL_UNSIGNED_INT;
+  const void* indices = nullptr;
+  size_t indexBytes = 0;
+  bool strips = false;
+};
+
+// Returns a view of `mesh`, valid while it is alive and unchanged
+TerrainMeshView viewTerrainMesh(const TerrainMesh& mesh);
+
+// Converts the terrain's vertices to the given layout and its LOD index lists
+// to the smallest index type that fits a chunk. The Displaced layout is the
+// (size + 1)^2 float heights of the grid, row-major, without duplicated chunk
+// borders. Throws if the terrain has no CPU vertices.
+TerrainMesh buildTerrainMesh(const Terrain& terrain, VertexFormat format);
+
+// Fills only the index part of `mesh`
+void buildTerrainIndices(const Terrain& terrain, TerrainMesh& mesh);
+
+// Fills the index part of `mesh` with the index lists of chunks of
+// `verticesPerChunk` vertices
+void buildTerrainIndices(const TerrainLod& lod, int verticesPerChunk, TerrainMesh& mesh);
+
+// Arguments of one glMultiDrawElementsBaseVertex call over chunk draws,
+// reused between frames to avoid allocations
+class TerrainDrawList {
+ public:
+  // Looks up the index range of each draw and the base vertex of its chunk;
+  // returns the number of triangles the draws submit
+  size_t build(const TerrainLod& lod,
+               GLenum indexType,
+               const std::vector<TerrainChunk>& chunks,
+               const std::vector<TerrainDraw>& draws);
+
+  // Draws the built list from the bound vertex array
+  void submit(GLenum indexType, bool strips) const;
+
+ private:
+  std::vector<GLsizei> counts;
+  std::vector<const void*> offsets;
+  std::vector<GLint> baseVertices;
+};
+
+// Owns the GPU buffers of a chunked Terrain and submits its visible chunks,
+// each at its own LOD level, with a single glMultiDrawElementsBaseVertex call.
+// Indices are chunk-local, so they are stored as 16-bit whenever a chunk has
+// at most 65535 vertices. Vertices are uploaded either as VertexType or as
+// CompactVertexType, each with its own vertex array and drawn by the
+// matching COMPACT_VERTICES permutation of the terrain program.
+//
+// The Displaced layout uploads no vertices at all. The grid heights go into
+// a GL_R32F texture and the DISPLACED permutation draws the same index lists
+// from a vertex array without attributes: it rebuilds each vertex's grid
+// position from gl_VertexID, fetches its height and derives the normal from
+// the neighbouring texels, so a height edit is a glTexSubImage2D of the
+// edited texels instead of a re-upload of whole vertex blocks.
+//
+// The buffers are double-buffered: a new mesh can be streamed into the back
+// set a slice per frame while the front set keeps drawing, and the two are
+// swapped once the upload completes.
+class TerrainRenderer {
+ public:
+  // Creates the vertex arrays with the TerrainAttributes locations
+  TerrainRenderer();
+
+  // Releases the GPU buffers
+  ~TerrainRenderer();
+
+  TerrainRenderer(const TerrainRenderer&) = delete;
+  TerrainRenderer& operator=(const TerrainRenderer&) = delete;
+
+  // Uploads the terrain's vertices in the given layout and the shared LOD
+  // index lists into the front buffers
+  void upload(const Terrain& terrain, VertexFormat format = VertexFormat::Compact);
+
+  // Uploads prepared buffer contents into the front buffers, straight from
+  // wherever `mesh` points
+  void upload(const TerrainMeshView& mesh);
+
+  // Re-uploads only the LOD index lists, e.g. after Terrain::setLodOptions
+  void uploadIndices(const Terrain& terrain);
+
+  // Re-uploads the part of the front buffers that depends on `region` of the
+  // terrain's vertices, e.g. after Terrain::sculpt: the texels of the region
+  // for Displaced, the vertex blocks of every chunk it touches otherwise.
+  // Returns the number of bytes uploaded.
+  size_t updateHeights(const Terrain& terrain, const HeightMapRegion& region);
+
+  // Orphans the back buffers and starts streaming `mesh` into them. Replaces
+  // an upload that is still in progress.
+  void beginUpload(TerrainMesh mesh);
+
+  // Copies up to `byteBudget` more bytes of the mesh passed to beginUpload().
+  // Returns true when the upload completed and the back buffers became the
+  // front buffers; the caller must draw the matching Terrain from then on.
+  bool continueUpload(size_t byteBudget);
+
+  // Returns true while beginUpload() data is still being streamed
+  bool isUploading() const { return uploading; }
+
+  // Abandons a streamed upload; the front buffers stay as they are
+  void cancelUpload();
+
+  // Returns the fraction of the streamed mesh uploaded so far
+  float getUploadProgress() const;
+
+  // Returns GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  GLenum getIndexType() const { return buffers[front].indexType; }
+
+  // Returns the size of the uploaded index buffer in bytes
+  size_t getIndexBytes() const { return buffers[front].indexBytes; }
+
+  // Returns the layout of the uploaded vertices
+  VertexFormat getVertexFormat() const { return buffers[front].vertexFormat; }
+
+  // Returns the size of the uploaded vertex buffer, or height texture, in bytes
+  size_t getVertexBytes() const { return buffers[front].vertexBytes; }
+
+  // Submits the chunk draws of the uploaded terrain and returns the number
+  // of triangles sent to the GPU. `program` must be in use and be the
+  // permutation for getVertexFormat().
+  size_t draw(const Terrain& terrain, const std::vector<TerrainDraw>& draws,
+              ShaderProgram& program);
+
+ private:
+  // One complete set of terrain buffers with the layout of their contents
+  struct Buffers {
+    GLuint vao = 0;            // Vertex Array Object for VertexType
+    GLuint compactVao = 0;     // Vertex Array Object for CompactVertexType
+    GLuint displacedVao = 0;   // Vertex Array Object without attributes
+    GLuint vbo = 0;            // Vertex Buffer Object
+    GLuint ibo = 0;            // Index Buffer Object
+    GLuint heightTexture = 0;  // Heights of the Displaced layout
+
+    VertexFormat vertexFormat = VertexFormat::Full;  // Layout of the vertices
+    size_t vertexBytes = 0;                          // Bytes in the vertex buffer or texture
+    int gridSize = 0;                                // Quads per terrain side
+    GLenum indexType = GL_UNSIGNED_INT;              // Type of the indices
+    size_t indexBytes = 0;                           // Bytes in the index buffer
+    bool strips = false;  // Index lists are triangle strips
+  };
+
+  // Creates the buffers and vertex arrays of one set
+  void createBuffers(Buffers& set);
+
+  // Replaces a set's vertex storage with storage for `mesh`'s layout, filled
+  // from `vertices` if not null. Whichever of the vertex buffer and the
+  // height texture the layout does not use is emptied.
+  void setVertices(Buffers& set, const TerrainMeshView& mesh, const void* vertices);
+
+  // Replaces the contents of a set's index buffer with `mesh`'s
+  void setIndices(Buffers& set, const TerrainMeshView& mesh);
+
+  Buffers buffers[2];      // Front and back buffer sets
+  int front = 0;           // Index of the set that is drawn
+
+  TerrainMesh staging;     // Mesh being streamed into the back set
+  size_t uploaded = 0;     // Bytes of `staging` already copied
+  bool uploading = false;  // A streamed upload is in progress
+
+  TerrainDrawList drawList;  // Per-draw arguments
+};
@@ -0,0 +1,239 @@
+#include "TerrainStreamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "GLDebug.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+TerrainStreamer::TerrainStreamer(HeightSource& source,
+                                 const TerrainStreamOptions& options,
+                                 const TerrainLodOptions& lodOptions)
+    : source(source), options(options), lod(options.chunkSize, lodOptions) {
+  const glm::ivec2 size = source.getSize();
+  const int chunkSize = options.chunkSize;
+  if (chunkSize <= 0 || chunkSize > 128 || (chunkSize & (chunkSize - 1)) != 0 ||
+      size.x % chunkSize != 0 || size.y % chunkSize != 0) {
+    throw std::runtime_error("Chunk size " + std::to_string(chunkSize) +
+                             " must be a power of two up to 128 dividing the terrain");
+  }
+  chunks = glm::ivec2(size.x / chunkSize, size.y / chunkSize);
+  verticesPerChunk = (chunkSize + 1) * (chunkSize + 1);
+  chunkBytes = static_cast<size_t>(verticesPerChunk) * sizeof(VertexType);
+
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &ibo);
+  glGenVertexArrays(1, &vao);
+  GLState::bindVertexArray(vao);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+  TerrainAttributes::setVertexType();
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  GLState::bindVertexArray(0);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+  GLDebug::label(GL_VERTEX_ARRAY, vao, "Streamed terrain VAO");
+  GLDebug::label(GL_BUFFER, vbo, "Streamed terrain vertices");
+  GLDebug::label(GL_BUFFER, ibo, "Streamed terrain indices");
+
+  setLodOptions(lodOptions);
+  allocate();
+}
+
+TerrainStreamer::~TerrainStreamer() {
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &vbo);
+  glDeleteBuffers(1, &ibo);
+  GLState::forgetVertexArray(vao);
+  GLState::forgetBuffer(vbo);
+  GLState::forgetBuffer(ibo);
+}
+
+void TerrainStreamer::setGpuBudget(size_t bytes) {
+  options.gpuBudget = bytes;
+  allocate();
+}
+
+void TerrainStreamer::setLodOptions(const TerrainLodOptions& lodOptions) {
+  lod = TerrainLod(options.chunkSize, lodOptions);
+  TerrainMesh mesh;
+  buildTerrainIndices(lod, verticesPerChunk, mesh);
+  indexType = mesh.indexType;
+  strips = mesh.strips;
+  GLState::bindVertexArray(vao);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(mesh.indices.size()),
+               mesh.indices.data(), GL_STATIC_DRAW);
+  GLState::bindVertexArray(0);
+}
+
+void TerrainStreamer::allocate() {
+  const size_t totalChunks = static_cast<size_t>(chunks.x) * chunks.y;
+  capacity = std::clamp<size_t>(options.gpuBudget / chunkBytes, 1, totalChunks);
+  nextSlot = 0;
+  cache.clear();
+  draws.clear();
+  GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity * chunkBytes), nullptr,
+               GL_DYNAMIC_DRAW);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+  stats.residentChunks = 0;
+  stats.residentBytes = 0;
+  stats.capacityBytes = capacity * chunkBytes;
+}
+
+HeightMapRegion TerrainStreamer::getRegion(int x, int y) const {
+  return {x * options.chunkSize, y * options.chunkSize, options.chunkSize + 1,
+          options.chunkSize + 1};
+}
+
+void TerrainStreamer::update(const glm::vec3& eye,
+                             const Frustum& frustum,
+                             const TerrainLodSettings& settings) {
+  PROFILE_FUNCTION();
+  ++frame;
+  stats.uploads = 0;
+
+  // Square of chunks around the eye, clamped to the terrain
+  const glm::ivec2 size = source.getSize();
+  const float spacing = source.getSpacing();
+  const glm::vec2 heightRange = source.getHeightRange();
+  const float chunkWorld = options.chunkSize * spacing;
+  const int radius = static_cast<int>(std::ceil(options.viewDistance / chunkWorld));
+  const int eyeX = static_cast<int>(std::floor((eye.x / spacing + size.x / 2) / options.chunkSize));
+  const int eyeY = static_cast<int>(std::floor((eye.y / spacing + size.y / 2) / options.chunkSize));
+  const int x0 = std::clamp(eyeX - radius, 0, chunks.x);
+  const int y0 = std::clamp(eyeY - radius, 0, chunks.y);
+  windowColumns = std::clamp(eyeX + radius + 1, 0, chunks.x) - x0;
+  windowRows = std::clamp(eyeY + radius + 1, 0, chunks.y) - y0;
+
+  window.assign(static_cast<size_t>(windowColumns) * windowRows, TerrainChunk());
+  windowKeys.resize(window.size());
+  visible.clear();
+  candidates.clear();
+  requests.clear();
+  stats.windowChunks = 0;
+  for (int y = 0; y < windowRows; ++y) {
+    for (int x = 0; x < windowColumns; ++x) {
+      const size_t index = static_cast<size_t>(x) + static_cast<size_t>(windowColumns) * y;
+      const uint64_t key = static_cast<uint64_t>(y0 + y) * chunks.x + (x0 + x);
+      TerrainChunk& chunk = window[index];
+      windowKeys[index] = key;
+      const ResidentChunk* resident = cache.peek(key);
+      if (resident) {
+        chunk = resident->chunk;
+      } else {
+        // Not generated yet: the whole height range, no LOD error
+        const HeightMapRegion region = getRegion(x0 + x, y0 + y);
+        chunk.bounds.min = glm::vec3((region.x - size.x / 2) * spacing,
+                                     (region.y - size.y / 2) * spacing, heightRange.x);
+        chunk.bounds.max = glm::vec3(chunk.bounds.min.x + chunkWorld,
+                                     chunk.bounds.min.y + chunkWorld, heightRange.y);
+        chunk.baseVertex = -1;
+      }
+      chunk.chunkX = x;
+      chunk.chunkY = y;
+
+      const glm::vec3 outside =
+          glm::max(glm::max(chunk.bounds.min - eye, eye - chunk.bounds.max), glm::vec3(0.0f));
+      const float distance = glm::length(outside);
+      if (distance > options.viewDistance) {
+        continue;
+      }
+      ++stats.windowChunks;
+      const bool inFrustum = frustum.intersects(chunk.bounds);
+      if (resident) {
+        if (inFrustum) {
+          // Only drawing a chunk makes it recent
+          cache.find(key)->lastFrame = frame;
+          visible.push_back(static_cast<int>(index));
+          ++stats.hits;
+        }
+        continue;
+      }
+      // Visible chunks load before hidden ones, each nearest first
+      requests.push_back({getRegion(x0 + x, y0 + y),
+                          inFrustum ? distance : distance + options.viewDistance});
+      if (inFrustum) {
+        candidates.push_back({static_cast<int>(index), distance});
+        ++stats.misses;
+      }
+    }
+  }
+  source.prefetch(requests);
+
+  // Take slots for the nearest candidates whose data is at hand, evicting
+  // chunks that were not visible this frame
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+  std::vector<std::pair<int, size_t>> builds;  // Window index and slot
+  for (const Candidate& candidate : candidates) {
+    if (static_cast<int>(builds.size()) >= options.uploadsPerFrame) {
+      break;
+    }
+    const TerrainChunk& chunk = window[candidate.index];
+    if (!source.isResident(getRegion(x0 + chunk.chunkX, y0 + chunk.chunkY))) {
+      continue;
+    }
+    size_t slot;
+    if (nextSlot < capacity) {
+      slot = nextSlot++;
+    } else if (!cache.empty() && cache.oldest().second.lastFrame != frame) {
+      slot = static_cast<size_t>(cache.oldest().second.chunk.baseVertex) / verticesPerChunk;
+      cache.popOldest();
+      ++stats.evictions;
+    } else {
+      break;  // Everything in the budget is on screen
+    }
+    builds.emplace_back(candidate.index, slot);
+  }
+
+  // Generate in parallel, upload in order
+  staging.resize(builds.size() * verticesPerChunk);
+  std::vector<TerrainChunk> built(builds.size());
+  ThreadPool::shared().parallelFor(builds.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const TerrainChunk& chunk = window[builds[i].first];
+      VertexType* block = staging.data() + i * verticesPerChunk;
+      source.generateRegion(getRegion(x0 + chunk.chunkX, y0 + chunk.chunkY), block);
+      measureTerrainChunk(block, options.chunkSize, lod.getLevelCount(), built[i]);
+    }
+  });
+  if (!builds.empty()) {
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+  }
+  for (size_t i = 0; i < builds.size(); ++i) {
+    const auto [index, slot] = builds[i];
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(slot * chunkBytes),
+                    static_cast<GLsizeiptr>(chunkBytes), staging.data() + i * verticesPerChunk);
+    TerrainChunk& chunk = window[index];
+    built[i].chunkX = chunk.chunkX;
+    built[i].chunkY = chunk.chunkY;
+    built[i].baseVertex = static_cast<int>(slot) * verticesPerChunk;
+    chunk = built[i];
+    cache.insert(windowKeys[index], ResidentChunk{chunk, frame});
+    visible.push_back(index);
+  }
+  stats.uploads = builds.size();
+  stats.visibleChunks = visible.size() + candidates.size() - builds.size();
+  stats.missingChunks = candidates.size() - builds.size();
+  stats.residentChunks = cache.size();
+  stats.residentBytes = cache.size() * chunkBytes;
+
+  // Chunks that are not resident have no LOD error and take the coarsest
+  // level their neighbours allow; they are never drawn
+  selectChunkLod(settings, lod, eye, window, windowColumns, windowRows, visible, levels, draws);
+}
+
+size_t TerrainStreamer::draw() {
+  PROFILE_FUNCTION();
+  if (draws.empty()) {
+    return 0;
+  }
+  const size_t triangles = drawList.build(lod, indexType, window, draws);
+  GLState::bindVertexArray(vao);
+  drawList.submit(indexType, strips);
+  return triangles;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Frustum.hpp"
+#include "HeightSource.hpp"
+#include "LruCache.hpp"
+#include "Terrain.hpp"
+#include "TerrainRenderer.hpp"
+
+// Settings of a TerrainStreamer
+struct TerrainStreamOptions {
+  int chunkSize = 32;          // Quads per chunk side, a power of two up to 128
+  float viewDistance = 100.0f;  // Chunks farther from the eye are neither loaded nor drawn
+  size_t gpuBudget = size_t(256) << 20;  // Bytes of chunk vertex buffer
+  int uploadsPerFrame = 32;    // Chunks generated and uploaded per update()
+};
+
+// Draws a HeightSource too large to generate or upload whole, such as a
+// TiledHeightSource, a chunk at a time around the eye. Every update() asks
+// the source to prefetch the chunks within the view distance, nearest and
+// visible first, then generates the visible chunks whose data is resident and
+// uploads them into slots of one vertex buffer. The slots form an LRU cache
+// bounded by the GPU budget: chunks drawn least recently give up their slot,
+// never ones drawn this frame. Resident chunks are drawn like Terrain chunks,
+// with per-chunk LOD, stitching and one glMultiDrawElementsBaseVertex call,
+// using the VertexType layout.
+class TerrainStreamer {
+ public:
+  // Measurements of the chunk cache
+  struct Stats {
+    uint64_t hits = 0;          // Visible chunks found resident, all frames
+    uint64_t misses = 0;        // Visible chunks not resident yet, all frames
+    uint64_t evictions = 0;     // Chunks that gave up their slot
+    size_t residentChunks = 0;  // Chunks in the vertex buffer
+    size_t residentBytes = 0;   // Their vertices
+    size_t capacityBytes = 0;   // Size of the vertex buffer
+    size_t windowChunks = 0;    // Chunks within the view distance, last update
+    size_t visibleChunks = 0;   // Of those, in the frustum
+    size_t missingChunks = 0;   // Of those, not resident after the update
+    size_t uploads = 0;         // Chunks uploaded by the last update
+  };
+
+  // Creates the vertex and index buffers; throws std::runtime_error if the
+  // chunk size does not divide the source. `source` must outlive the streamer.
+  TerrainStreamer(HeightSource& source,
+                  const TerrainStreamOptions& options = TerrainStreamOptions(),
+                  const TerrainLodOptions& lodOptions = {});
+
+  // Releases the buffers
+  ~TerrainStreamer();
+
+  TerrainStreamer(const TerrainStreamer&) = delete;
+  TerrainStreamer& operator=(const TerrainStreamer&) = delete;
+
+  // Returns the source the chunks are generated from
+  const HeightSource& getSource() const { return source; }
+
+  // Resizes the vertex buffer; every chunk is uploaded again
+  void setGpuBudget(size_t bytes);
+
+  // Rebuilds the LOD index lists with different ordering options
+  void setLodOptions(const TerrainLodOptions& lodOptions);
+
+  // Prefetches around the eye, uploads newly resident visible chunks and
+  // picks the detail level of each visible resident chunk. The source's
+  // prefetch() is only called from here.
+  void update(const glm::vec3& eye, const Frustum& frustum, const TerrainLodSettings& settings);
+
+  // Draws the chunks picked by the last update() and returns the number of
+  // triangles submitted. The VertexType permutation of the terrain program
+  // must be in use.
+  size_t draw();
+
+  // Returns true while visible chunks are waiting for their data
+  bool isStreaming() const { return stats.missingChunks > 0; }
+
+  // Returns the measurements
+  const Stats& getStats() const { return stats; }
+
+ private:
+  // A chunk in the vertex buffer
+  struct ResidentChunk {
+    TerrainChunk chunk;      // Bounds, LOD errors and base vertex of its slot
+    uint64_t lastFrame = 0;  // update() that last found it visible
+  };
+
+  // Visible chunk without a slot
+  struct Candidate {
+    int index = 0;  // Into window
+    float distance = 0.0f;
+  };
+
+  // Returns the grid region of the chunk at (x, y)
+  HeightMapRegion getRegion(int x, int y) const;
+
+  // Allocates the vertex buffer for the budget
+  void allocate();
+
+  HeightSource& source;
+  TerrainStreamOptions options;
+  glm::ivec2 chunks{0};     // Chunks along x and y
+  int verticesPerChunk = 0;
+  size_t chunkBytes = 0;    // Vertex bytes of one chunk
+  TerrainLod lod;
+
+  GLuint vao = 0;
+  GLuint vbo = 0;
+  GLuint ibo = 0;
+  GLenum indexType = GL_UNSIGNED_SHORT;
+  bool strips = false;
+  size_t capacity = 0;   // Chunk slots in the vertex buffer
+  size_t nextSlot = 0;   // First slot never used since allocate()
+
+  LruCache<uint64_t, ResidentChunk> cache;  // By chunk y * chunks.x + x
+  uint64_t frame = 0;                       // Number of update() calls
+
+  // The chunks around the eye, rebuilt by each update(); chunkX and chunkY
+  // are window positions, so selectChunkLod() can stitch them
+  std::vector<TerrainChunk> window;
+  std::vector<uint64_t> windowKeys;
+  int windowColumns = 0;
+  int windowRows = 0;
+
+  // Scratch reused between frames
+  std::vector<int> visible;
+  std::vector<Candidate> candidates;
+  std::vector<HeightRequest> requests;
+  std::vector<int> levels;
+  std::vector<TerrainDraw> draws;
+  std::vector<VertexType> staging;
+  TerrainDrawList drawList;
+  Stats stats;
+};
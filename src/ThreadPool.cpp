@@ -0,0 +1,129 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "Profiler.hpp"
+
+namespace {
+// Bookkeeping shared between parallelFor and its helper tasks. It is reference
+// counted because helpers may be dequeued after the loop has already finished.
+struct ParallelForState {
+  const std::function<void(size_t, size_t)>* fn = nullptr;
+  size_t count = 0;
+  size_t rangeSize = 0;
+  size_t rangeCount = 0;
+  std::atomic<size_t> nextRange{0};
+  std::atomic<size_t> finishedRanges{0};
+  std::mutex mutex;
+  std::condition_variable done;
+
+  // Claims and runs ranges until none are left
+  void work() {
+    for (;;) {
+      size_t range = nextRange.fetch_add(1, std::memory_order_relaxed);
+      if (range >= rangeCount) {
+        return;
+      }
+      size_t begin = range * rangeSize;
+      size_t end = std::min(count, begin + rangeSize);
+      (*fn)(begin, end);
+      if (finishedRanges.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          rangeCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+    }
+  }
+};
+}  // namespace
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i) {
+    workers.emplace_back([this, i] {
+      PROFILE_THREAD("Worker " + std::to_string(i));
+      workerLoop();
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t, size_t)>& fn,
+                             size_t grain) {
+  if (count == 0) {
+    return;
+  }
+  grain = std::max<size_t>(1, grain);
+
+  // Aim for a few ranges per thread so uneven ranges balance out
+  size_t threads = workers.size() + 1;
+  size_t rangeSize = std::max(grain, (count + threads * 4 - 1) / (threads * 4));
+  size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+  if (rangeCount == 1) {
+    fn(0, count);
+    return;
+  }
+
+  auto state = std::make_shared<ParallelForState>();
+  state->fn = &fn;
+  state->count = count;
+  state->rangeSize = rangeSize;
+  state->rangeCount = rangeCount;
+
+  size_t helpers = std::min(workers.size(), rangeCount - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    submit([state] { state->work(); });
+  }
+  state->work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&] {
+    return state->finishedRanges.load(std::memory_order_acquire) == rangeCount;
+  });
+}
+
+void ThreadPool::workerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (stopping && tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
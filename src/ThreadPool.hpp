@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads used to spread CPU work (mesh generation,
+// culling, transform updates) across cores.
+class ThreadPool {
+ public:
+  // Starts the given number of workers (0 selects the hardware concurrency)
+  explicit ThreadPool(unsigned threadCount = 0);
+
+  // Joins all workers after draining the queue
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Returns the process-wide pool shared by the engine subsystems
+  static ThreadPool& shared();
+
+  // Returns the number of worker threads
+  unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+  // Queues a task for asynchronous execution
+  void submit(std::function<void()> task);
+
+  // Splits [0, count) into ranges of at least `grain` items and runs
+  // fn(begin, end) on them in parallel. The calling thread takes part in the
+  // work and the call returns once every range has been processed.
+  void parallelFor(size_t count,
+                   const std::function<void(size_t, size_t)>& fn,
+                   size_t grain = 1);
+
+ private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;          // Worker threads
+  std::deque<std::function<void()>> tasks;   // Pending tasks
+  std::mutex mutex;                          // Guards tasks and stopping
+  std::condition_variable condition;         // Signals new tasks
+  bool stopping = false;                     // Set when the pool shuts down
+};
@@ -0,0 +1,433 @@
+#include "TiledHeightSource.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+// A chunk whose neighbours straddle tile corners needs up to 3x3 tiles
+constexpr size_t kMinTiles = 9;
+
+// Returns true if n is a positive power of two
+bool isPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+}  // namespace
+
+DemInfo readDemManifest(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open DEM manifest " + path);
+  }
+  DemInfo info;
+  bool hasRange = false;
+  int found = 0;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string key;
+    if (!(fields >> key)) {
+      continue;
+    }
+    bool valid = true;
+    if (key == "tiles") {
+      valid = static_cast<bool>(fields >> info.tilesX >> info.tilesY);
+      found |= 1;
+    } else if (key == "tile_size") {
+      valid = static_cast<bool>(fields >> info.tileSize);
+      found |= 2;
+    } else if (key == "spacing") {
+      valid = static_cast<bool>(fields >> info.spacing);
+      found |= 4;
+    } else if (key == "height_scale") {
+      valid = static_cast<bool>(fields >> info.heightScale);
+      found |= 8;
+    } else if (key == "height_offset") {
+      valid = static_cast<bool>(fields >> info.heightOffset);
+      found |= 16;
+    } else if (key == "height_range") {
+      valid = static_cast<bool>(fields >> info.heightRange.x >> info.heightRange.y);
+      hasRange = true;
+    } else {
+      std::cerr << "Warning: " << path << ":" << lineNumber << ": unknown key " << key
+                << std::endl;
+    }
+    if (!valid) {
+      throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": invalid " + key);
+    }
+  }
+  if (found != 31) {
+    throw std::runtime_error(path +
+                             " needs tiles, tile_size, spacing, height_scale and height_offset");
+  }
+  if (info.tilesX <= 0 || info.tilesY <= 0 ||
+      static_cast<uint64_t>(info.tilesX) * info.tilesY > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(path + ": invalid tile count");
+  }
+  if (!isPowerOfTwo(info.tileSize) || info.tileSize > 8192 ||
+      static_cast<int64_t>(info.tileSize) * std::max(info.tilesX, info.tilesY) >
+          std::numeric_limits<int>::max() / 2) {
+    throw std::runtime_error(path + ": tile_size must be a power of two up to 8192");
+  }
+  if (!(info.spacing > 0.0f) || !std::isfinite(info.heightScale) || info.heightScale == 0.0f ||
+      !std::isfinite(info.heightOffset)) {
+    throw std::runtime_error(path + ": invalid spacing or height scale");
+  }
+  if (!hasRange) {
+    const float top = info.heightOffset + 65535.0f * info.heightScale;
+    info.heightRange = glm::vec2(std::min(info.heightOffset, top), std::max(info.heightOffset, top));
+  }
+  if (!(info.heightRange.x <= info.heightRange.y)) {
+    throw std::runtime_error(path + ": invalid height_range");
+  }
+  return info;
+}
+
+std::string getDemTilePath(const std::string& manifestPath, int x, int y) {
+  const std::filesystem::path manifest(manifestPath);
+  return (manifest.parent_path() / (manifest.stem().string() + "_" + std::to_string(x) + "_" +
+                                    std::to_string(y) + ".r16"))
+      .string();
+}
+
+void writeDemTiles(const std::string& manifestPath, const HeightSource& source, int tileSize) {
+  PROFILE_FUNCTION();
+  const glm::ivec2 size = source.getSize();
+  if (!isPowerOfTwo(tileSize) || size.x % tileSize != 0 || size.y % tileSize != 0) {
+    throw std::runtime_error("DEM tile size " + std::to_string(tileSize) +
+                             " must be a power of two dividing the grid");
+  }
+  DemInfo info;
+  info.tilesX = size.x / tileSize;
+  info.tilesY = size.y / tileSize;
+  info.tileSize = tileSize;
+  info.spacing = source.getSpacing();
+  info.heightRange = source.getHeightRange();
+  info.heightOffset = info.heightRange.x;
+  info.heightScale = info.heightRange.y > info.heightRange.x
+                         ? (info.heightRange.y - info.heightRange.x) / 65535.0f
+                         : 1.0f;
+
+  // Tiles are independent, so they are generated and written in parallel
+  const int samples = info.samplesPerSide();
+  std::mutex errorMutex;
+  std::string error;
+  ThreadPool::shared().parallelFor(
+      static_cast<size_t>(info.tilesX) * info.tilesY, [&](size_t begin, size_t end) {
+        std::vector<VertexType> vertices(static_cast<size_t>(samples) * samples);
+        std::vector<uint8_t> bytes(info.fileBytes());
+        for (size_t i = begin; i < end; ++i) {
+          const int x = static_cast<int>(i % info.tilesX);
+          const int y = static_cast<int>(i / info.tilesX);
+          source.generateRegion({x * tileSize, y * tileSize, samples, samples}, vertices.data());
+          for (size_t v = 0; v < vertices.size(); ++v) {
+            const float step = (vertices[v].position.z - info.heightOffset) / info.heightScale;
+            const auto sample = static_cast<uint16_t>(std::clamp(std::lround(step), 0L, 65535L));
+            bytes[2 * v] = static_cast<uint8_t>(sample & 0xFF);
+            bytes[2 * v + 1] = static_cast<uint8_t>(sample >> 8);
+          }
+          const std::string tilePath = getDemTilePath(manifestPath, x, y);
+          std::ofstream file(tilePath, std::ios::binary | std::ios::trunc);
+          file.write(reinterpret_cast<const char*>(bytes.data()),
+                     static_cast<std::streamsize>(bytes.size()));
+          if (!file) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            error = "Cannot write " + tilePath;
+          }
+        }
+      });
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+
+  std::ofstream manifest(manifestPath, std::ios::trunc);
+  manifest << std::setprecision(9) << "# Terrain DEM tile set\n"
+           << "tiles " << info.tilesX << " " << info.tilesY << "\n"
+           << "tile_size " << info.tileSize << "\n"
+           << "spacing " << info.spacing << "\n"
+           << "height_scale " << info.heightScale << "\n"
+           << "height_offset " << info.heightOffset << "\n"
+           << "height_range " << info.heightRange.x << " " << info.heightRange.y << "\n";
+  if (!manifest) {
+    throw std::runtime_error("Cannot write " + manifestPath);
+  }
+}
+
+TiledHeightSource::TiledHeightSource(const std::string& manifestPath,
+                                     TileCacheOptions options)
+    : path(manifestPath), info(readDemManifest(manifestPath)), options(std::move(options)) {
+  tileBytes = static_cast<size_t>(info.samplesPerSide()) * info.samplesPerSide() * sizeof(float);
+  for (unsigned i = 0; i < std::max(1u, this->options.ioThreads); ++i) {
+    ioThreads.emplace_back([this] { ioLoop(); });
+  }
+}
+
+TiledHeightSource::~TiledHeightSource() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    queue.clear();
+  }
+  requested.notify_all();
+  for (std::thread& thread : ioThreads) {
+    thread.join();
+  }
+}
+
+glm::ivec2 TiledHeightSource::getSize() const {
+  return glm::ivec2(info.tilesX, info.tilesY) * info.tileSize;
+}
+
+void TiledHeightSource::setCacheBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  options.cacheBudget = bytes;
+  while (cache.size() > getCapacity()) {
+    cache.popOldest();
+  }
+}
+
+TiledHeightSource::Stats TiledHeightSource::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  Stats snapshot = stats;
+  snapshot.residentTiles = cache.size();
+  snapshot.residentBytes = cache.size() * tileBytes;
+  snapshot.budget = options.cacheBudget;
+  snapshot.queued = queue.size();
+  snapshot.loadMs = stats.loads > 0 ? 1000.0 * loadSeconds / stats.loads : 0.0;
+  return snapshot;
+}
+
+size_t TiledHeightSource::getCapacity() const {
+  return std::max(kMinTiles, options.cacheBudget / tileBytes);
+}
+
+template <typename Fn>
+void TiledHeightSource::forEachTile(const HeightMapRegion& region, Fn&& fn) const {
+  const glm::ivec2 size = getSize();
+  const int x0 = std::max(region.x - 1, 0) / info.tileSize;
+  const int y0 = std::max(region.y - 1, 0) / info.tileSize;
+  const int x1 = std::min(std::min(region.x + region.width, size.x) / info.tileSize, info.tilesX - 1);
+  const int y1 = std::min(std::min(region.y + region.height, size.y) / info.tileSize, info.tilesY - 1);
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      fn(static_cast<uint32_t>(y) * static_cast<uint32_t>(info.tilesX) + static_cast<uint32_t>(x));
+    }
+  }
+}
+
+bool TiledHeightSource::isResident(const HeightMapRegion& region) const {
+  // Only acquire() counts hits and misses; the streamer asks here before it
+  // generates the region, which would count every lookup twice
+  std::lock_guard<std::mutex> lock(mutex);
+  bool resident = true;
+  forEachTile(region, [&](uint32_t key) {
+    if (!cache.peek(key)) {
+      resident = false;
+    }
+  });
+  return resident;
+}
+
+void TiledHeightSource::prefetch(const std::vector<HeightRequest>& requests) {
+  // Nearest distance of every tile the requests touch
+  std::vector<PendingTile> wanted;
+  std::unordered_map<uint32_t, size_t> positions;
+  for (const HeightRequest& request : requests) {
+    forEachTile(request.region, [&](uint32_t key) {
+      auto [it, inserted] = positions.emplace(key, wanted.size());
+      if (inserted) {
+        wanted.push_back({key, request.distance});
+      } else {
+        wanted[it->second].distance = std::min(wanted[it->second].distance, request.distance);
+      }
+    });
+  }
+  std::sort(wanted.begin(), wanted.end(), [](const PendingTile& a, const PendingTile& b) {
+    return a.distance < b.distance;
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Loading more than fits would evict the nearest tiles for farther ones
+    wanted.resize(std::min(wanted.size(), getCapacity()));
+    // Touching the resident tiles farthest first leaves the nearest to be
+    // evicted last
+    queue.clear();
+    for (auto it = wanted.rbegin(); it != wanted.rend(); ++it) {
+      if (!cache.find(it->key) && !loading.count(it->key)) {
+        queue.push_back(*it);
+      }
+    }
+  }
+  requested.notify_all();
+}
+
+TiledHeightSource::Tile TiledHeightSource::acquire(uint32_t key) const {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (const Tile* tile = cache.find(key)) {
+    ++stats.hits;
+    return *tile;
+  }
+  ++stats.misses;
+  // An I/O thread may be decoding it already
+  while (loading.count(key)) {
+    loaded.wait(lock);
+  }
+  if (const Tile* tile = cache.find(key)) {
+    return *tile;
+  }
+  loading.insert(key);
+  lock.unlock();
+  Tile tile = decode(key);
+  lock.lock();
+  loading.erase(key);
+  store(key, tile);
+  loaded.notify_all();
+  return tile;
+}
+
+TiledHeightSource::Tile TiledHeightSource::decode(uint32_t key) const {
+  PROFILE_FUNCTION();
+  const auto start = std::chrono::steady_clock::now();
+  const int x = static_cast<int>(key % static_cast<uint32_t>(info.tilesX));
+  const int y = static_cast<int>(key / static_cast<uint32_t>(info.tilesX));
+  auto heights = std::make_shared<std::vector<float>>(tileBytes / sizeof(float));
+  bool failed = false;
+  try {
+    const MappedFile file(getDemTilePath(path, x, y));
+    if (file.size() != info.fileBytes()) {
+      throw std::runtime_error(file.getPath() + " has " + std::to_string(file.size()) +
+                               " bytes, expected " + std::to_string(info.fileBytes()));
+    }
+    file.willNeed(0, file.size());
+    const uint8_t* bytes = file.data();
+    for (size_t i = 0; i < heights->size(); ++i) {
+      const unsigned sample = bytes[2 * i] | (static_cast<unsigned>(bytes[2 * i + 1]) << 8);
+      (*heights)[i] = info.heightOffset + info.heightScale * static_cast<float>(sample);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Warning: DEM tile " << x << ", " << y << " is flat: " << e.what() << std::endl;
+    std::fill(heights->begin(), heights->end(), info.heightRange.x);
+    failed = true;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  loadSeconds += elapsed.count();
+  if (failed) {
+    ++stats.failures;
+  }
+  return heights;
+}
+
+void TiledHeightSource::store(uint32_t key, Tile tile) const {
+  cache.insert(key, std::move(tile));
+  ++stats.loads;
+  while (cache.size() > getCapacity()) {
+    cache.popOldest();
+  }
+}
+
+void TiledHeightSource::ioLoop() {
+  PROFILE_THREAD("Tile I/O");
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    requested.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (stopping) {
+      return;
+    }
+    const uint32_t key = queue.back().key;
+    queue.pop_back();
+    if (cache.peek(key) || loading.count(key)) {
+      continue;
+    }
+    loading.insert(key);
+    lock.unlock();
+    Tile tile = decode(key);
+    lock.lock();
+    loading.erase(key);
+    store(key, std::move(tile));
+    loaded.notify_all();
+    if (options.onLoaded) {
+      lock.unlock();
+      options.onLoaded();
+      lock.lock();
+    }
+  }
+}
+
+void TiledHeightSource::generateRegion(const HeightMapRegion& region, VertexType* out) const {
+  PROFILE_FUNCTION();
+  const glm::ivec2 size = getSize();
+  const int tileSize = info.tileSize;
+
+  // Heights of the region and the ring of neighbours around it, clamped to
+  // the grid, gathered tile by tile
+  const int x0 = std::max(region.x - 1, 0);
+  const int y0 = std::max(region.y - 1, 0);
+  const int x1 = std::min(region.x + region.width, size.x);
+  const int y1 = std::min(region.y + region.height, size.y);
+  const int stride = x1 - x0 + 1;
+  std::vector<float> heights(static_cast<size_t>(stride) * (y1 - y0 + 1));
+
+  const int firstTileX = x0 / tileSize;
+  const int lastTileX = std::min(x1 / tileSize, info.tilesX - 1);
+  std::vector<Tile> tiles;
+  forEachTile(region, [&](uint32_t key) { tiles.push_back(acquire(key)); });
+  const int tileColumns = lastTileX - firstTileX + 1;
+  const int samples = info.samplesPerSide();
+
+  // A sample on a tile border belongs to the tile on its right or above,
+  // except on the last tile of a row or column
+  for (int y = y0; y <= y1; ++y) {
+    const int tileY = std::min(y / tileSize, info.tilesY - 1);
+    const int localY = y - tileY * tileSize;
+    for (int tileX = firstTileX; tileX <= lastTileX; ++tileX) {
+      const int begin = std::max(x0, tileX * tileSize);
+      const int end = tileX == info.tilesX - 1 ? x1 : std::min(x1, (tileX + 1) * tileSize - 1);
+      const std::vector<float>& tile =
+          *tiles[(tileY - y0 / tileSize) * tileColumns + (tileX - firstTileX)];
+      std::copy_n(tile.data() + localY * samples + (begin - tileX * tileSize), end - begin + 1,
+                  heights.data() + (y - y0) * stride + (begin - x0));
+    }
+  }
+
+  // Central differences, one-sided at the edges of the grid
+  auto height = [&](int x, int y) { return heights[(y - y0) * stride + (x - x0)]; };
+  const float range = std::max(info.heightRange.y - info.heightRange.x, 1e-6f);
+  for (int row = 0; row < region.height; ++row) {
+    const int y = region.y + row;
+    const int below = std::max(y - 1, 0);
+    const int above = std::min(y + 1, size.y);
+    for (int column = 0; column < region.width; ++column) {
+      const int x = region.x + column;
+      const int left = std::max(x - 1, 0);
+      const int right = std::min(x + 1, size.x);
+      const float h = height(x, y);
+      const float hx = (height(right, y) - height(left, y)) / ((right - left) * info.spacing);
+      const float hy = (height(x, above) - height(x, below)) / ((above - below) * info.spacing);
+
+      VertexType& vertex = out[static_cast<size_t>(row) * region.width + column];
+      vertex.position = glm::vec3((x - size.x / 2) * info.spacing, (y - size.y / 2) * info.spacing, h);
+      vertex.normal = glm::normalize(glm::vec3(-hx, -hy, 1.0f));
+      // Colour by height within the tile set's range
+      const float c = std::clamp((h - info.heightRange.x) / range, 0.0f, 1.0f);
+      vertex.color = glm::vec4(c, 1.0f - c, 0.5f, 1.0f);
+    }
+  }
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "HeightSource.hpp"
+#include "LruCache.hpp"
+
+// Layout of a tile set, read from its manifest. A manifest is a text file of
+// "key value" lines ('#' starts a comment):
+//
+//   tiles 16 16          Tiles along x and y
+//   tile_size 256        Quads per tile side, a power of two
+//   spacing 0.1          Distance between neighbouring samples
+//   height_scale 0.001   Height of one 16-bit step
+//   height_offset -10    Height of sample value 0
+//   height_range -8 12   Lowest and highest height (optional)
+//
+// Tile (x, y) is the file <manifest stem>_<x>_<y>.r16 next to the manifest:
+// (tile_size + 1)^2 little-endian uint16 samples, row-major with y
+// increasing. Neighbouring tiles share their border row or column, as SRTM
+// tiles do, so each tile can be decoded on its own.
+struct DemInfo {
+  int tilesX = 0;
+  int tilesY = 0;
+  int tileSize = 0;
+  float spacing = 1.0f;
+  float heightScale = 1.0f;
+  float heightOffset = 0.0f;
+  glm::vec2 heightRange{0.0f};
+
+  // Returns the number of samples per tile side
+  int samplesPerSide() const { return tileSize + 1; }
+
+  // Returns the bytes of one tile file
+  size_t fileBytes() const {
+    return static_cast<size_t>(samplesPerSide()) * samplesPerSide() * sizeof(uint16_t);
+  }
+};
+
+// Reads a manifest; throws std::runtime_error if it is missing or invalid
+DemInfo readDemManifest(const std::string& path);
+
+// Returns the path of tile (x, y) of the tile set described by `manifestPath`
+std::string getDemTilePath(const std::string& manifestPath, int x, int y);
+
+// Writes `source` as a tile set: the manifest at `manifestPath` and its tiles.
+// Heights are quantized to 16 bits over the source's height range. The
+// source's size must be a multiple of `tileSize` along both axes.
+void writeDemTiles(const std::string& manifestPath, const HeightSource& source, int tileSize);
+
+// Settings of a TiledHeightSource
+struct TileCacheOptions {
+  size_t cacheBudget = size_t(256) << 20;  // Bytes of decoded tiles kept
+  unsigned ioThreads = 2;                  // Threads decoding prefetched tiles
+  std::function<void()> onLoaded;  // Runs on an I/O thread after each prefetched tile
+};
+
+// Elevation data far larger than memory, read from a tile set on demand.
+// Tile files are memory-mapped and decoded to float heights on a small pool
+// of I/O threads, nearest requested tile first. Decoded tiles live in an LRU
+// cache bounded by a byte budget; generating a region takes the tiles it needs
+// from the cache, or decodes missing ones on the calling thread.
+//
+// Vertex normals come from central differences of the decoded heights, taken
+// across tile borders, so neighbouring chunks shade seamlessly. Tiles that
+// cannot be read are logged and treated as flat.
+class TiledHeightSource : public HeightSource {
+ public:
+  // Cache counters since the source was opened
+  struct Stats {
+    uint64_t hits = 0;         // Tile lookups served from the cache
+    uint64_t misses = 0;       // Lookups that found the tile missing
+    uint64_t loads = 0;        // Tiles decoded
+    uint64_t failures = 0;     // Tiles that could not be read
+    size_t residentTiles = 0;  // Decoded tiles in the cache
+    size_t residentBytes = 0;  // Their size
+    size_t budget = 0;         // TileCacheOptions::cacheBudget
+    size_t queued = 0;         // Prefetches not started yet
+    double loadMs = 0.0;       // Average time to map and decode a tile
+  };
+
+  // Reads the manifest and starts the I/O threads; throws std::runtime_error
+  // if the manifest is invalid
+  explicit TiledHeightSource(const std::string& manifestPath,
+                             TileCacheOptions options = TileCacheOptions());
+
+  // Drops queued prefetches and joins the I/O threads
+  ~TiledHeightSource() override;
+
+  TiledHeightSource(const TiledHeightSource&) = delete;
+  TiledHeightSource& operator=(const TiledHeightSource&) = delete;
+
+  // Returns the tile set layout
+  const DemInfo& getInfo() const { return info; }
+
+  // Returns the manifest path
+  const std::string& getPath() const { return path; }
+
+  // Changes the decoded tile budget, evicting tiles beyond it
+  void setCacheBudget(size_t bytes);
+
+  // Returns a snapshot of the counters
+  Stats getStats() const;
+
+  glm::ivec2 getSize() const override;
+  float getSpacing() const override { return info.spacing; }
+  glm::vec2 getHeightRange() const override { return info.heightRange; }
+  bool isResident(const HeightMapRegion& region) const override;
+  void prefetch(const std::vector<HeightRequest>& requests) override;
+  void generateRegion(const HeightMapRegion& region, VertexType* out) const override;
+
+ private:
+  using Tile = std::shared_ptr<const std::vector<float>>;  // Decoded heights
+
+  // Tile waiting for an I/O thread
+  struct PendingTile {
+    uint32_t key = 0;
+    float distance = 0.0f;
+  };
+
+  // Calls fn(key) for every tile the vertices of `region` and their
+  // neighbours, which the normals need, lie in
+  template <typename Fn>
+  void forEachTile(const HeightMapRegion& region, Fn&& fn) const;
+
+  // Returns the tile, from the cache or decoded on the calling thread
+  Tile acquire(uint32_t key) const;
+
+  // Maps and decodes a tile file; a flat tile if it cannot be read
+  Tile decode(uint32_t key) const;
+
+  // Adds a decoded tile and evicts the oldest beyond the budget. The mutex
+  // must be held.
+  void store(uint32_t key, Tile tile) const;
+
+  // Returns how many tiles fit into the budget, at least one region's worth
+  size_t getCapacity() const;
+
+  void ioLoop();
+
+  std::string path;
+  DemInfo info;
+  TileCacheOptions options;
+  size_t tileBytes = 0;  // Bytes of one decoded tile
+
+  mutable std::mutex mutex;                  // Guards the members below
+  mutable std::condition_variable loaded;    // Signals finished decodes
+  mutable std::condition_variable requested;  // Signals new prefetches
+  mutable LruCache<uint32_t, Tile> cache;    // Decoded tiles
+  mutable std::unordered_set<uint32_t> loading;  // Tiles being decoded
+  std::vector<PendingTile> queue;            // Farthest first
+  bool stopping = false;
+  mutable Stats stats;
+  mutable double loadSeconds = 0.0;          // Total time spent decoding
+  std::vector<std::thread> ioThreads;        // Started after the state above
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks. Each side owns one of three slots and the third is shared: publish()
+// swaps the writer's slot with the shared one and marks it fresh, update()
+// swaps the reader's slot with the shared one if it is fresh. Neither side
+// ever waits for the other, the reader always sees a complete value, and
+// values the reader did not pick up in time are overwritten.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Writer: returns the slot to fill before publish(). It still holds the
+  // value published two calls ago, not the last one.
+  T& write() { return slots[back].value; }
+
+  // Writer: makes the written slot the latest value
+  void publish() {
+    back = shared.exchange(static_cast<uint8_t>(back | kFresh), std::memory_order_acq_rel) &
+           kIndex;
+  }
+
+  // Reader: picks up the latest published value and returns true if there
+  // was one since the last call
+  bool update() {
+    if (!(shared.load(std::memory_order_relaxed) & kFresh)) {
+      return false;
+    }
+    front = shared.exchange(front, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+
+  // Reader: returns the value picked up by the last update(), or a
+  // default-constructed one before the first publish()
+  const T& read() const { return slots[front].value; }
+
+ private:
+  static constexpr uint8_t kIndex = 0x3;
+  static constexpr uint8_t kFresh = 0x4;  // The shared slot has not been read
+  static constexpr size_t kLine = 64;     // Keeps the sides off each other's cache lines
+
+  struct alignas(kLine) Slot {
+    T value{};
+  };
+
+  std::array<Slot, 3> slots;
+  alignas(kLine) std::atomic<uint8_t> shared{1};  // Slot index and kFresh
+  alignas(kLine) uint8_t back = 0;                // Writer's slot
+  alignas(kLine) uint8_t front = 2;               // Reader's slot
+
+  static_assert(std::atomic<uint8_t>::is_always_lock_free);
+};
@@ -0,0 +1,45 @@
+#include "UniformRing.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "GLState.hpp"
+
+UniformRing::UniformRing(size_t bytesPerFrame)
+    : alignment(queryAlignment()),
+      stream(GL_UNIFORM_BUFFER, bytesPerFrame, "Uniform ring", alignment) {
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+size_t UniformRing::queryAlignment() {
+  GLint offsetAlignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+  return offsetAlignment > 0 ? static_cast<size_t>(offsetAlignment) : 256;
+}
+
+void UniformRing::beginFrame() {
+  used = 0;
+  stream.beginWrites(stream.getCapacity());
+}
+
+void UniformRing::endFrame() {
+  stream.endFrame();
+}
+
+UniformRing::Range UniformRing::push(const void* data, size_t size) {
+  if (used + size > stream.getCapacity()) {
+    throw std::runtime_error("Uniform ring region of " + std::to_string(stream.getCapacity()) +
+                             " bytes is full");
+  }
+  stream.write(used, data, size);
+  Range range;
+  range.offset = stream.getOffset() + static_cast<GLintptr>(used);
+  range.size = static_cast<GLsizeiptr>(size);
+  used += (size + alignment - 1) / alignment * alignment;
+  return range;
+}
+
+void UniformRing::bind(GLuint binding, const Range& range) const {
+  GLState::bindBufferRange(GL_UNIFORM_BUFFER, binding, stream.getBuffer(), range.offset,
+                           range.size);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "StreamBuffer.hpp"
+
+// Streams uniform block data to the GPU through a StreamBuffer of kFrames
+// regions used round-robin. Blocks are copied one after another into the
+// region of the current frame, each at the uniform buffer offset alignment:
+// straight into the persistent mapping, or with glBufferSubData into the
+// orphaned buffer without ARB_buffer_storage.
+class UniformRing {
+ public:
+  // Regions in flight
+  static constexpr int kFrames = StreamBuffer::kFrames;
+
+  // A block written this frame
+  struct Range {
+    GLintptr offset = 0;    // Byte offset into the buffer
+    GLsizeiptr size = 0;    // Size of the block
+  };
+
+  // Creates the buffer; requires a current context
+  explicit UniformRing(size_t bytesPerFrame);
+
+  // Moves to the next region, waiting for the GPU if it still reads it
+  void beginFrame();
+
+  // Fences the region written this frame
+  void endFrame();
+
+  // Copies one std140 block into the current region; throws if it is full
+  template <typename T>
+  Range push(const T& block) {
+    return push(&block, sizeof(T));
+  }
+  Range push(const void* data, size_t size);
+
+  // Binds a block written this frame to a uniform buffer binding point
+  void bind(GLuint binding, const Range& range) const;
+
+  // Returns true if the buffer is persistently mapped
+  bool isPersistent() const { return stream.isPersistent(); }
+
+  // Returns how many times beginFrame() had to wait for the GPU
+  uint64_t getStallCount() const { return stream.getStallCount(); }
+
+ private:
+  // Returns GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  static size_t queryAlignment();
+
+  size_t alignment;     // Of every block; ahead of `stream`, which uses it
+  StreamBuffer stream;  // The regions
+  size_t used = 0;      // Bytes written to the current region
+};
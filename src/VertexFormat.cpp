@@ -0,0 +1,96 @@
+#include "VertexFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+// Returns -1 for negative values and 1 otherwise, unlike std::copysign on -0
+float signNotZero(float v) {
+  return v < 0.0f ? -1.0f : 1.0f;
+}
+
+int16_t toSnorm16(float v) {
+  return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+float fromSnorm16(int16_t v) {
+  // GL maps snorm values with max(v / 32767, -1)
+  return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+}
+
+uint8_t toUnorm8(float v) {
+  return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+}  // namespace
+
+size_t getVertexSize(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::Compact:
+      return sizeof(CompactVertexType);
+    case VertexFormat::Displaced:
+      return sizeof(float);
+    default:
+      return sizeof(VertexType);
+  }
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& n) {
+  float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 e(n.x / l1, n.y / l1);
+  if (n.z < 0.0f) {
+    // Fold the lower hemisphere over the diagonals
+    e = glm::vec2((1.0f - std::abs(e.y)) * signNotZero(e.x),
+                  (1.0f - std::abs(e.x)) * signNotZero(e.y));
+  }
+  return e;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& e) {
+  glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+  if (n.z < 0.0f) {
+    float x = (1.0f - std::abs(n.y)) * signNotZero(n.x);
+    float y = (1.0f - std::abs(n.x)) * signNotZero(n.y);
+    n.x = x;
+    n.y = y;
+  }
+  return glm::normalize(n);
+}
+
+CompactVertexType compressVertex(const VertexType& vertex) {
+  CompactVertexType compact;
+  compact.height = vertex.position.z;
+  glm::vec2 e = encodeOctahedral(vertex.normal);
+  compact.normal[0] = toSnorm16(e.x);
+  compact.normal[1] = toSnorm16(e.y);
+  compact.color[0] = toUnorm8(vertex.color.x);
+  compact.color[1] = toUnorm8(vertex.color.y);
+  compact.color[2] = toUnorm8(vertex.color.z);
+  compact.color[3] = toUnorm8(vertex.color.w);
+  return compact;
+}
+
+VertexType decompressVertex(const CompactVertexType& vertex, const glm::vec2& xy) {
+  VertexType full;
+  full.position = glm::vec3(xy.x, xy.y, vertex.height);
+  full.normal = decodeOctahedral(
+      glm::vec2(fromSnorm16(vertex.normal[0]), fromSnorm16(vertex.normal[1])));
+  full.color = glm::vec4(vertex.color[0], vertex.color[1], vertex.color[2],
+                         vertex.color[3]) /
+               255.0f;
+  return full;
+}
+
+void compressVertices(const VertexType* in, size_t count, CompactVertexType* out) {
+  PROFILE_FUNCTION();
+  ThreadPool::shared().parallelFor(
+      count,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          out[i] = compressVertex(in[i]);
+        }
+      },
+      4096);
+}
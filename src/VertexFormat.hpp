@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "HeightMap.hpp"
+
+// Vertex layouts the terrain can be uploaded with
+enum class VertexFormat {
+  Full,       // VertexType, 40 bytes
+  Compact,    // CompactVertexType, 12 bytes
+  Displaced,  // No vertices: a float height texture, 4 bytes per grid sample
+};
+
+// Returns the bytes per vertex, or per height texel for Displaced
+size_t getVertexSize(VertexFormat format);
+
+// Quantized heightmap vertex. The grid x/y are not stored: the vertex shader
+// derives them from gl_VertexID, since the terrain is laid out as equally
+// sized row-major chunk blocks.
+struct CompactVertexType {
+  float height;       // position.z
+  int16_t normal[2];  // Octahedral-encoded unit normal, snorm16
+  uint8_t color[4];   // RGBA, unorm8
+};
+static_assert(sizeof(CompactVertexType) == 12, "Unexpected compact vertex size");
+
+// Round-trip error bounds of compressVertex() / decompressVertex()
+constexpr float kCompactNormalError = 1e-4f;  // Per normal component
+constexpr float kCompactColorError = 2e-3f;  // Per colour channel, ~0.5/255
+
+// Maps a unit vector onto the [-1, 1]^2 octahedral square
+glm::vec2 encodeOctahedral(const glm::vec3& n);
+
+// Inverse of encodeOctahedral(); the result is normalized
+glm::vec3 decodeOctahedral(const glm::vec2& e);
+
+// Quantizes one vertex; its x/y are dropped
+CompactVertexType compressVertex(const VertexType& vertex);
+
+// Expands a compact vertex, taking x/y from the grid position
+VertexType decompressVertex(const CompactVertexType& vertex, const glm::vec2& xy);
+
+// Quantizes `count` vertices, split across ThreadPool::shared()
+void compressVertices(const VertexType* in, size_t count, CompactVertexType* out);
@@ -0,0 +1,1702 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EntityStore.hpp"
+#include "Frustum.hpp"
+#include "HeightMap.hpp"
+#include "HeightSource.hpp"
+#include "IndexOptimizer.hpp"
+#include "ProgramCache.hpp"
+#include "RenderBench.hpp"
+#include "SceneFile.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "ShaderVariables.hpp"
+#include "SimdMath.hpp"
+#include "Simulation.hpp"
+#include "Terrain.hpp"
+#include "ThreadPool.hpp"
+#include "TiledHeightSource.hpp"
+#include "TripleBuffer.hpp"
+#include "VertexFormat.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Build type and options, set by CMakeLists.txt
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "unknown"
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// One reported number. Metrics are named "<scenario>.<quantity>_<unit>";
+// `lowerIsBetter` tells the baseline comparison which direction regresses.
+struct Metric {
+  double value;
+  std::string unit;
+  bool lowerIsBetter;
+};
+
+// Metrics collected by the scenarios, written as JSON at the end of a run
+class Report {
+ public:
+  // Records a metric, replacing an earlier one with the same name
+  void add(const std::string& name, double value, const std::string& unit,
+           bool lowerIsBetter = true) {
+    metrics[name] = Metric{value, unit, lowerIsBetter};
+  }
+
+  // Records p50/p95/p99 and the maximum of per-frame samples
+  void addPercentiles(const std::string& name, std::vector<double> samples,
+                      const std::string& unit) {
+    if (samples.empty()) {
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    // Nearest-rank percentile
+    auto percentile = [&](double p) {
+      size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+      return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+    add(name + "_p50_" + unit, percentile(50.0), unit);
+    add(name + "_p95_" + unit, percentile(95.0), unit);
+    add(name + "_p99_" + unit, percentile(99.0), unit);
+    add(name + "_max_" + unit, samples.back(), unit);
+  }
+
+  const std::map<std::string, Metric>& getMetrics() const { return metrics; }
+
+  // Writes the run configuration and the metrics as JSON
+  void writeJson(std::ostream& out,
+                 const std::map<std::string, std::string>& config) const {
+    out << std::setprecision(9) << "{\n  \"config\": {";
+    const char* separator = "";
+    for (const auto& [key, value] : config) {
+      out << separator << "\n    \"" << key << "\": \"" << value << "\"";
+      separator = ",";
+    }
+    out << "\n  },\n  \"metrics\": {";
+    separator = "";
+    for (const auto& [name, metric] : metrics) {
+      out << separator << "\n    \"" << name << "\": {\"value\": " << metric.value
+          << ", \"unit\": \"" << metric.unit << "\", \"lowerIsBetter\": "
+          << (metric.lowerIsBetter ? "true" : "false") << "}";
+      separator = ",";
+    }
+    out << "\n  }\n}\n";
+  }
+
+ private:
+  std::map<std::string, Metric> metrics;
+};
+
+// Reads the metric values of a JSON file written by Report::writeJson
+std::map<std::string, double> readBaseline(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Could not read baseline " + path);
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  const std::string json = text.str();
+
+  std::map<std::string, double> values;
+  const std::regex entry(R"re("([^"]+)": \{"value": ([-+0-9.eEinfa]+))re");
+  for (auto it = std::sregex_iterator(json.begin(), json.end(), entry);
+       it != std::sregex_iterator(); ++it) {
+    values[(*it)[1]] = std::strtod((*it)[2].str().c_str(), nullptr);
+  }
+  return values;
+}
+
+// Prints every metric next to its baseline and returns the number that got
+// worse by more than `tolerance` (a fraction of the baseline value)
+int compareWithBaseline(const Report& report,
+                        const std::map<std::string, double>& baseline,
+                        double tolerance) {
+  int regressions = 0;
+  std::cout << "[compare] Tolerance " << tolerance * 100.0 << "%\n";
+  for (const auto& [name, metric] : report.getMetrics()) {
+    auto it = baseline.find(name);
+    if (it == baseline.end() || it->second == 0.0) {
+      std::cout << "  " << name << ": " << metric.value << " " << metric.unit
+                << " (no baseline)\n";
+      continue;
+    }
+    double change = (metric.value - it->second) / std::abs(it->second);
+    bool regressed = metric.lowerIsBetter ? change > tolerance : change < -tolerance;
+    regressions += regressed;
+    std::cout << "  " << name << ": " << it->second << " -> " << metric.value << " "
+              << metric.unit << " (" << std::showpos << change * 100.0
+              << std::noshowpos << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+  }
+  std::cout << std::flush;
+  return regressions;
+}
+
+// Returns the peak resident set size of the process in MiB
+double peakMemoryMiB() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  counters.cb = sizeof(counters);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return 0.0;
+  }
+  return counters.PeakWorkingSetSize / 1048576.0;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  // macOS reports bytes
+  return usage.ru_maxrss / 1048576.0;
+#else
+  // Linux reports kilobytes
+  return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// Builds the grid the way MyApplication did before generateHeightMap existed:
+// one getHeightMap() call and one push_back per vertex
+std::vector<VertexType> generateSerial(const HeightMapParams& params) {
+  std::vector<VertexType> vertices;
+  for (int y = 0; y <= params.size; ++y) {
+    for (int x = 0; x <= params.size; ++x) {
+      float xx = (x - params.size / 2) * params.spacing;
+      float yy = (y - params.size / 2) * params.spacing;
+      vertices.push_back(getHeightMap({xx, yy}, params));
+    }
+  }
+  return vertices;
+}
+
+// Returns the best of `iterations` runs of fn in seconds
+template <typename Fn>
+double bestOf(int iterations, Fn&& fn) {
+  double best = 1e30;
+  for (int i = 0; i < iterations; ++i) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Keeps the compiler from discarding `value` or hoisting memory reads
+// across the call
+template <typename T>
+void doNotOptimize(const T& value) {
+#ifdef _MSC_VER
+  // MSVC has no inline assembly on x64; publishing the address through a
+  // volatile makes the value escape, and the barrier orders memory accesses
+  static const void* volatile sink;
+  sink = &value;
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+float maxDifference(const glm::vec3& a, const glm::vec3& b) {
+  return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y),
+                   std::abs(a.z - b.z)});
+}
+
+float maxDifference(const glm::vec4& a, const glm::vec4& b) {
+  return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y),
+                   std::abs(a.z - b.z), std::abs(a.w - b.w)});
+}
+
+// Compares heightmap mesh generation through the serial getHeightMap() path
+// with the parallel SIMD generator and reports vertices per second
+bool benchMeshGeneration(int size, int iterations, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+
+  const double vertexCount = static_cast<double>(params.vertexCount());
+  std::cout << "[meshgen] Grid: " << params.size << "x" << params.size << " ("
+            << params.vertexCount() << " vertices), SIMD: " << simd::kName
+            << ", threads: " << ThreadPool::shared().size() + 1 << "\n";
+
+  std::vector<VertexType> reference;
+  double serial = bestOf(iterations, [&] { reference = generateSerial(params); });
+
+  std::vector<VertexType> vertices;
+  double parallel = bestOf(iterations, [&] {
+    vertices.assign(params.vertexCount(), VertexType{});
+    generateHeightMap(params, vertices.data());
+  });
+
+  float positionError = 0.0f;
+  float normalError = 0.0f;
+  float colorError = 0.0f;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    positionError = std::max(
+        positionError, maxDifference(vertices[i].position, reference[i].position));
+    normalError = std::max(
+        normalError, maxDifference(vertices[i].normal, reference[i].normal));
+    colorError = std::max(
+        colorError, maxDifference(vertices[i].color, reference[i].color));
+  }
+
+  std::cout << "getHeightMap loop:  " << vertexCount / serial / 1e6
+            << " Mvertices/s (" << serial * 1e3 << " ms)\n"
+            << "generateHeightMap:  " << vertexCount / parallel / 1e6
+            << " Mvertices/s (" << parallel * 1e3 << " ms)\n"
+            << "Speedup: " << serial / parallel << "x\n"
+            << "Max difference: position=" << positionError
+            << " normal=" << normalError << " color=" << colorError
+            << std::endl;
+  report.add("meshgen.serial_ms", serial * 1e3, "ms");
+  report.add("meshgen.parallel_ms", parallel * 1e3, "ms");
+
+  bool withinTolerance =
+      positionError <= 1e-5f && colorError <= 1e-5f && normalError <= 1.5e-2f;
+  if (!withinTolerance) {
+    std::cerr << "Error: generated mesh exceeds the documented tolerance"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Returns true if any vertex of the chunk lies inside the clip volume
+bool chunkHasVisibleVertex(const Terrain& terrain,
+                           const TerrainChunk& chunk,
+                           const glm::mat4& viewProjection) {
+  const VertexType* block = terrain.getVertices().data() + chunk.baseVertex;
+  for (int v = 0; v < terrain.getVerticesPerChunk(); ++v) {
+    glm::vec4 clip = viewProjection * glm::vec4(block[v].position, 1.0f);
+    if (std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w &&
+        std::abs(clip.z) <= clip.w) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Measures frustum culling of the chunk table for a camera orbiting the
+// terrain, and checks that no chunk with a visible vertex gets culled
+bool benchCulling(int size, int iterations, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+  const int chunkSize = 16;
+  Terrain terrain(params, chunkSize);
+  const auto& chunks = terrain.getChunks();
+
+  const int views = 64;
+  const float extent = size * params.spacing;
+  std::vector<glm::mat4> viewProjections;
+  for (int i = 0; i < views; ++i) {
+    float angle = 6.2831853f * i / views;
+    glm::vec3 eye(0.3f * extent * std::sin(angle), 0.3f * extent * std::cos(angle),
+                  0.05f * extent);
+    glm::mat4 projection =
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f),
+                                 glm::vec3(0.0f, 0.0f, 1.0f));
+    viewProjections.push_back(projection * view);
+  }
+
+  std::vector<int> visible;
+  size_t visibleTotal = 0;
+  double seconds = bestOf(iterations, [&] {
+    visibleTotal = 0;
+    for (const auto& viewProjection : viewProjections) {
+      terrain.cull(Frustum(viewProjection), visible);
+      visibleTotal += visible.size();
+    }
+  });
+
+  // Conservative culling must never drop a chunk that has a vertex on screen
+  size_t falseNegatives = 0;
+  for (const auto& viewProjection : viewProjections) {
+    terrain.cull(Frustum(viewProjection), visible);
+    std::vector<bool> isVisible(chunks.size(), false);
+    for (int index : visible) {
+      isVisible[index] = true;
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      if (!isVisible[i] && chunkHasVisibleVertex(terrain, chunks[i], viewProjection)) {
+        ++falseNegatives;
+      }
+    }
+  }
+
+  double fraction = static_cast<double>(visibleTotal) / (chunks.size() * views);
+  std::cout << "[cull] Grid: " << size << "x" << size << ", " << chunks.size()
+            << " chunks of " << chunkSize << "x" << chunkSize << "\n"
+            << "Cull time: " << seconds / views * 1e6 << " us/frame ("
+            << chunks.size() * views / seconds / 1e6 << " Mchunks/s)\n"
+            << "Visible fraction: " << fraction * 100.0
+            << "% (vertex work relative to drawing everything)\n"
+            << "False negatives: " << falseNegatives << std::endl;
+  report.add("cull.frame_us", seconds / views * 1e6, "us");
+  if (falseNegatives != 0) {
+    std::cerr << "Error: culling dropped chunks with visible vertices"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Expands one LOD index range into a plain triangle list, unrolling strips
+std::vector<uint32_t> expandTriangles(const TerrainLod& lod,
+                                      const TerrainLod::Range& range) {
+  const uint32_t* indices = lod.getIndices().data() + range.first;
+  if (!lod.usesTriangleStrips()) {
+    return std::vector<uint32_t>(indices, indices + range.count);
+  }
+  std::vector<uint32_t> triangles;
+  size_t run = 0;
+  for (uint32_t i = 0; i < range.count; ++i) {
+    if (indices[i] == IndexOptimizer::kRestartIndex) {
+      run = 0;
+      continue;
+    }
+    if (++run >= 3) {
+      // Odd triangles of a strip have their first two vertices swapped
+      bool odd = (run - 3) % 2 == 1;
+      triangles.push_back(indices[i - (odd ? 1 : 2)]);
+      triangles.push_back(indices[i - (odd ? 2 : 1)]);
+      triangles.push_back(indices[i]);
+    }
+  }
+  return triangles;
+}
+
+// Checks that every (level, stitch mask) index list of the LOD covers the
+// chunk exactly once with counter-clockwise triangles
+bool validateLodTopology(const TerrainLod& lod, int chunkSize) {
+  const int stride = chunkSize + 1;
+  for (int level = 0; level < lod.getLevelCount(); ++level) {
+    for (unsigned mask = 0; mask < TerrainLod::kMaskCount; ++mask) {
+      const TerrainLod::Range& range = lod.getRange(level, mask);
+      std::vector<uint32_t> indices = expandTriangles(lod, range);
+      if (indices.size() != range.triangles * 3u) {
+        return false;
+      }
+      double area = 0.0;
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        auto corner = [&](size_t k) {
+          return glm::vec2(static_cast<float>(indices[k] % stride),
+                           static_cast<float>(indices[k] / stride));
+        };
+        glm::vec2 a = corner(i), b = corner(i + 1), c = corner(i + 2);
+        double signedArea =
+            0.5 * ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+        if (signedArea <= 0.0) {
+          return false;
+        }
+        area += signedArea;
+      }
+      if (std::abs(area - static_cast<double>(chunkSize) * chunkSize) > 1e-6) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Compares the LOD index layouts: row-major lists, vertex cache ordered
+// lists and strips. Reports the 16-entry FIFO ACMR, the 16-bit index buffer
+// size and the build time, and fails if a layout does not tile the chunks.
+bool benchIndices(int iterations, Report& report) {
+  struct Layout {
+    const char* name;
+    TerrainLodOptions options;
+  };
+  const Layout layouts[] = {
+      {"row-major", {false, false}},
+      {"cache-opt", {true, false}},
+      {"strips", {false, true}},
+  };
+
+  bool ok = true;
+  for (int chunkSize : {16, 32, 64, 128}) {
+    std::cout << "[indices] Chunk " << chunkSize << "x" << chunkSize << "\n";
+    for (const Layout& layout : layouts) {
+      double seconds = bestOf(iterations, [&] {
+        TerrainLod lod(chunkSize, layout.options);
+      });
+      TerrainLod lod(chunkSize, layout.options);
+      if (!validateLodTopology(lod, chunkSize)) {
+        std::cerr << "Error: " << layout.name
+                  << " index lists do not tile the chunk" << std::endl;
+        ok = false;
+      }
+      const TerrainLod::Range& full = lod.getRange(0, 0);
+      const uint32_t vertexCount = (chunkSize + 1) * (chunkSize + 1);
+      const bool shortIndices = vertexCount <= 0xFFFF;
+      const size_t bytes =
+          lod.getIndices().size() * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t));
+      std::cout << "  " << layout.name << ": ACMR " << lod.getStats().acmrOriginal
+                << " -> " << lod.getStats().acmrOptimized << ", level 0 "
+                << full.count << " indices for " << full.triangles
+                << " triangles, all levels " << bytes / 1024.0 << " KiB ("
+                << (shortIndices ? 16 : 32) << "-bit), build " << seconds * 1e3
+                << " ms\n";
+      const std::string prefix =
+          "indices." + std::string(layout.name) + "_" + std::to_string(chunkSize);
+      report.add(prefix + ".acmr", lod.getStats().acmrOptimized, "acmr");
+      report.add(prefix + ".build_ms", seconds * 1e3, "ms");
+    }
+  }
+  std::cout << std::flush;
+  return ok;
+}
+
+// Round-trips the terrain and a sweep of unit normals over both hemispheres
+// through CompactVertexType, checks the documented error bounds and reports
+// the buffer sizes and compression throughput. Then rebuilds the vertices
+// from the Displaced height grid the way the DISPLACED vertex shader does,
+// and checks that a brush edit keeps every copy of a vertex in step and
+// changes nothing outside the region it reports.
+bool benchVertexFormat(int size, int iterations, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+  std::vector<VertexType> vertices(params.vertexCount());
+  generateHeightMap(params, vertices.data());
+
+  std::vector<CompactVertexType> compact(vertices.size());
+  double seconds = bestOf(iterations, [&] {
+    compressVertices(vertices.data(), vertices.size(), compact.data());
+  });
+
+  float positionError = 0.0f;
+  float normalError = 0.0f;
+  float colorError = 0.0f;
+  const int stride = params.verticesPerSide();
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    // Same expression as the vertex shader: integer offset times spacing
+    int x = static_cast<int>(i % stride) - params.size / 2;
+    int y = static_cast<int>(i / stride) - params.size / 2;
+    VertexType decoded = decompressVertex(
+        compact[i], glm::vec2(x * params.spacing, y * params.spacing));
+    positionError =
+        std::max(positionError, maxDifference(decoded.position, vertices[i].position));
+    normalError =
+        std::max(normalError, maxDifference(decoded.normal, vertices[i].normal));
+    colorError = std::max(colorError, maxDifference(decoded.color, vertices[i].color));
+  }
+
+  // Terrain normals all point up, so also cover the folded lower hemisphere
+  const int steps = 256;
+  for (int i = 0; i <= steps; ++i) {
+    float theta = 3.14159265f * i / steps;
+    for (int j = 0; j < steps; ++j) {
+      float phi = 6.2831853f * j / steps;
+      VertexType vertex{};
+      vertex.normal = glm::vec3(std::sin(theta) * std::cos(phi),
+                                std::sin(theta) * std::sin(phi), std::cos(theta));
+      VertexType decoded = decompressVertex(compressVertex(vertex), glm::vec2(0.0f));
+      normalError = std::max(normalError, maxDifference(decoded.normal, vertex.normal));
+    }
+  }
+
+  std::cout << "[vertex] Grid: " << size << "x" << size << ", "
+            << sizeof(VertexType) << " -> " << sizeof(CompactVertexType)
+            << " bytes/vertex, " << vertices.size() * sizeof(VertexType) / 1048576.0
+            << " -> " << compact.size() * sizeof(CompactVertexType) / 1048576.0
+            << " MiB\n"
+            << "Compression: " << vertices.size() / seconds / 1e6
+            << " Mvertices/s\n"
+            << "Max error: position " << positionError << ", normal "
+            << normalError << " (bound " << kCompactNormalError << "), colour "
+            << colorError << " (bound " << kCompactColorError << ")" << std::endl;
+  report.add("vertex.compress_ms", seconds * 1e3, "ms");
+  bool ok = true;
+  if (positionError > 0.0f || normalError > kCompactNormalError ||
+      colorError > kCompactColorError) {
+    std::cerr << "Error: compact vertices exceed the documented error bounds"
+              << std::endl;
+    ok = false;
+  }
+
+  // Displaced: heights only, normals from central differences of the texels
+  Terrain terrain(params, 16);
+  const TerrainMesh displaced = buildTerrainMesh(terrain, VertexFormat::Displaced);
+  const float* texels = reinterpret_cast<const float*>(displaced.vertices.data());
+  auto texel = [&](int x, int y) { return texels[static_cast<size_t>(y) * stride + x]; };
+  float displacedPosition = 0.0f, displacedColor = 0.0f;
+  double displacedNormal = 0.0;
+  for (int y = 0; y < stride; ++y) {
+    for (int x = 0; x < stride; ++x) {
+      const VertexType& vertex = vertices[static_cast<size_t>(y) * stride + x];
+      const float h = texel(x, y);
+      const glm::vec3 position((x - params.size / 2) * params.spacing,
+                               (y - params.size / 2) * params.spacing, h);
+      const int left = std::max(x - 1, 0), right = std::min(x + 1, params.size);
+      const int below = std::max(y - 1, 0), above = std::min(y + 1, params.size);
+      const float hx = (texel(right, y) - texel(left, y)) / ((right - left) * params.spacing);
+      const float hy = (texel(x, above) - texel(x, below)) / ((above - below) * params.spacing);
+      const float c = std::sin(h * 5.0f) * 0.5f + 0.5f;
+      displacedPosition =
+          std::max(displacedPosition, maxDifference(position, vertex.position));
+      displacedColor = std::max(
+          displacedColor, maxDifference(glm::vec4(c, 1.0f - c, 0.5f, 1.0f), vertex.color));
+      displacedNormal += glm::length(glm::normalize(glm::vec3(-hx, -hy, 1.0f)) - vertex.normal);
+    }
+  }
+  displacedNormal /= static_cast<double>(vertices.size());
+
+  // A brush on a chunk corner, so its edit spans four chunks
+  const float spacing = params.spacing;
+  const glm::vec2 center(16 * spacing, 16 * spacing);
+  std::vector<float> before(vertices.size()), after(vertices.size());
+  terrain.getHeights({0, 0, stride, stride}, before.data());
+  const HeightMapRegion edited = terrain.sculpt(center, 8 * spacing, 0.5f);
+  terrain.getHeights({0, 0, stride, stride}, after.data());
+  bool editOk = edited.width > 0 && edited.height > 0;
+  for (int y = 0; y < stride && editOk; ++y) {
+    for (int x = 0; x < stride; ++x) {
+      const bool inside = x >= edited.x && x < edited.x + edited.width && y >= edited.y &&
+                          y < edited.y + edited.height;
+      const size_t i = static_cast<size_t>(y) * stride + x;
+      editOk &= inside || before[i] == after[i];
+    }
+  }
+  const int chunkStride = terrain.getChunkSize() + 1;
+  for (const TerrainChunk& chunk : terrain.getChunks()) {
+    for (int v = 0; v < terrain.getVerticesPerChunk(); ++v) {
+      const VertexType& vertex = terrain.getVertices()[chunk.baseVertex + v];
+      const int x = chunk.chunkX * terrain.getChunkSize() + v % chunkStride;
+      const int y = chunk.chunkY * terrain.getChunkSize() + v / chunkStride;
+      editOk &= vertex.position.z == after[static_cast<size_t>(y) * stride + x] &&
+                vertex.position.z >= chunk.bounds.min.z && vertex.position.z <= chunk.bounds.max.z;
+    }
+  }
+  const size_t texelBytes = static_cast<size_t>(edited.width) * edited.height * sizeof(float);
+  const size_t blockBytes = 4 * terrain.getVerticesPerChunk() * sizeof(VertexType);
+
+  std::cout << "[vertex] Displaced: " << sizeof(float) << " bytes/vertex, "
+            << displaced.vertices.size() / 1048576.0 << " MiB; max error position "
+            << displacedPosition << ", colour " << displacedColor << ", mean normal error "
+            << displacedNormal << "\n"
+            << "Edit of " << edited.width << "x" << edited.height << " vertices uploads "
+            << texelBytes / 1024.0 << " KiB of texels instead of "
+            << blockBytes / 1024.0 << " KiB of vertex blocks" << std::endl;
+  report.add("vertex.displaced_mib", displaced.vertices.size() / 1048576.0, "MiB");
+  if (displaced.vertices.size() != vertices.size() * sizeof(float) ||
+      displacedPosition > 0.0f || displacedColor > 1e-4f || displacedNormal > 1e-2) {
+    std::cerr << "Error: displaced vertices differ from the generated ones" << std::endl;
+    ok = false;
+  }
+  if (!editOk) {
+    std::cerr << "Error: terrain edit changed vertices outside its region or left "
+                 "chunk copies or bounds stale" << std::endl;
+    ok = false;
+  }
+  return ok;
+}
+
+// Measures LOD selection for an orbiting camera and reports how many
+// triangles are submitted compared with drawing every visible chunk at full
+// resolution
+bool benchLod(int size, int iterations, float pixelError, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+  const int chunkSize = 16;
+  Terrain terrain(params, chunkSize);
+  const TerrainLod& lod = terrain.getLod();
+
+  if (!validateLodTopology(lod, chunkSize)) {
+    std::cerr << "Error: LOD index lists do not tile the chunk" << std::endl;
+    return false;
+  }
+
+  TerrainLodSettings settings;
+  settings.pixelError = pixelError;
+  settings.viewportHeight = 1080.0f;
+
+  const int views = 64;
+  const float extent = size * params.spacing;
+  std::vector<int> visible;
+  std::vector<TerrainDraw> draws;
+  size_t fullTriangles = 0;
+  size_t lodTriangles = 0;
+  double seconds = bestOf(iterations, [&] {
+    fullTriangles = lodTriangles = 0;
+    for (int i = 0; i < views; ++i) {
+      float angle = 6.2831853f * i / views;
+      glm::vec3 eye(0.3f * extent * std::sin(angle),
+                    0.3f * extent * std::cos(angle), 0.05f * extent);
+      glm::mat4 viewProjection =
+          glm::perspective(settings.fieldOfView, 16.0f / 9.0f, 0.1f, extent) *
+          glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+      terrain.cull(Frustum(viewProjection), visible);
+      terrain.selectLod(settings, eye, visible, draws);
+      for (const TerrainDraw& draw : draws) {
+        lodTriangles += lod.getRange(draw.level, draw.stitchMask).triangles;
+        fullTriangles += lod.getRange(0, 0).triangles;
+      }
+    }
+  });
+
+  std::cout << "[lod] Grid: " << size << "x" << size << ", " << chunkSize
+            << "x" << chunkSize << " chunks, " << lod.getLevelCount()
+            << " levels, budget " << pixelError << " px\n"
+            << "Selection time: " << seconds / views * 1e6 << " us/frame\n"
+            << "Triangles per frame: " << lodTriangles / views << " (full "
+            << fullTriangles / views << ", "
+            << 100.0 * lodTriangles / std::max<size_t>(1, fullTriangles)
+            << "%)" << std::endl;
+  report.add("lod.selection_us", seconds / views * 1e6, "us");
+  report.add("lod.triangles", static_cast<double>(lodTriangles / views), "triangles");
+  return true;
+}
+
+// Compares resolving the terrain uniforms by name through a
+// std::map<std::string, GLint>, as ShaderProgram::uniform() did, with the
+// hashed table behind Uniform<T> handles, and checks both agree
+bool benchUniformLookup(int iterations, Report& report) {
+  using namespace TerrainUniforms;
+  // The first five moved to uniform blocks or defines but keep the set at
+  // its old size
+  constexpr Uniform<glm::mat4> projection("projection");
+  constexpr Uniform<glm::mat4> view("view");
+  constexpr Uniform<glm::mat4> model("model");
+  constexpr Uniform<glm::vec3> lightPos("lightPos");
+  constexpr Uniform<int> compactVertices("compactVertices");
+  const char* const names[] = {"projection",      "view",      "model",
+                               "lightPos",        "compactVertices", "chunkSize",
+                               "chunksPerSide",   "gridSpacing"};
+  const uint64_t hashes[] = {projection.hash,      view.hash,      model.hash,
+                             lightPos.hash,        compactVertices.hash, chunkSize.hash,
+                             chunksPerSide.hash,   gridSpacing.hash};
+  const int count = static_cast<int>(std::size(names));
+
+  std::map<std::string, GLint> map;
+  std::vector<ShaderVariable> variables;
+  for (int i = 0; i < count; ++i) {
+    map[names[i]] = i;
+    variables.push_back(ShaderVariable{hashName(names[i]), i, GL_FLOAT, 1, names[i]});
+  }
+  ShaderVariableTable table;
+  table.assign(variables);
+
+  bool ok = table.size() == static_cast<size_t>(count) &&
+            table.find(hashName("missing")) == nullptr &&
+            UniformType<glm::mat4>::accepts(GL_FLOAT_MAT4) &&
+            !UniformType<glm::mat4>::accepts(GL_FLOAT_MAT3) &&
+            UniformType<int>::accepts(GL_BOOL) && !UniformType<float>::accepts(GL_INT);
+  for (int i = 0; i < count; ++i) {
+    const ShaderVariable* variable = table.find(hashes[i]);
+    ok = ok && variable && variable->location == map[names[i]];
+  }
+
+  // One frame sets every uniform once; the old path built a std::string from
+  // each literal before walking the map
+  const int frames = 100000;
+  double mapSeconds = bestOf(iterations, [&] {
+    for (int f = 0; f < frames; ++f) {
+      for (const char* name : names) {
+        GLint location = map.find(std::string(name))->second;
+        doNotOptimize(location);
+      }
+    }
+  });
+  double hashSeconds = bestOf(iterations, [&] {
+    for (int f = 0; f < frames; ++f) {
+      for (uint64_t hash : hashes) {
+        GLint location = table.find(hash)->location;
+        doNotOptimize(location);
+      }
+    }
+  });
+
+  const double lookups = static_cast<double>(frames) * count;
+  std::cout << "[uniforms] " << count << " uniforms, " << frames << " frames\n"
+            << "std::map<std::string> lookup: " << mapSeconds / lookups * 1e9
+            << " ns\n"
+            << "Hashed handle lookup:         " << hashSeconds / lookups * 1e9
+            << " ns (" << mapSeconds / hashSeconds << "x)" << std::endl;
+  report.add("uniforms.map_ns", mapSeconds / lookups * 1e9, "ns");
+  report.add("uniforms.hash_ns", hashSeconds / lookups * 1e9, "ns");
+  if (!ok) {
+    std::cerr << "Error: hashed uniform table disagrees with the map" << std::endl;
+  }
+  return ok;
+}
+
+// Checks #include resolution, define injection, #line numbering and the
+// error cases of the shader preprocessor on in-memory files, then times
+// preprocessing every terrain program permutation from disk
+bool benchShaderPreprocessor(int iterations, Report& report) {
+  const std::map<std::string, std::string> files = {
+      {"/v/main.glsl",
+       "#version 150\n#include \"a.glsl\"\nvoid main() {}\n#include \"sub/b.glsl\"\n"},
+      {"/v/a.glsl", "#include \"sub/b.glsl\"\nfloat a;\n"},
+      {"/v/sub/b.glsl", "float b;\n"},
+      {"/v/core.glsl", "#version 330 core\n  #  include <sub/b.glsl>\n"},
+      {"/v/plain.glsl", "void main() {}\n"},
+      {"/v/cycle.glsl", "#version 150\n#include \"loop.glsl\"\n"},
+      {"/v/loop.glsl", "#include \"cycle.glsl\"\n"},
+      {"/v/missing.glsl", "#version 150\n\n#include \"nope.glsl\"\n"},
+      {"/v/malformed.glsl", "#version 150\n#include nope.glsl\n"},
+  };
+  const ShaderFileReader reader = [&](const std::string& path) {
+    auto file = files.find(path);
+    if (file == files.end()) {
+      throw std::runtime_error("Failed to open file: " + path);
+    }
+    return file->second;
+  };
+
+  bool ok = true;
+  // Compares a result with the expectation and reports the first mismatch
+  auto expect = [&](const char* name, const std::string& actual, const std::string& expected) {
+    if (actual != expected) {
+      std::cerr << "Error: preprocessor case '" << name << "' produced\n"
+                << actual << "instead of\n" << expected;
+      ok = false;
+    }
+  };
+  // Expects preprocessing to throw with `message` in the error
+  auto expectError = [&](const char* name, const std::string& file,
+                         const ShaderDefines& defines, const std::string& message) {
+    try {
+      preprocessShader(file, defines, reader);
+      std::cerr << "Error: preprocessor case '" << name << "' did not throw" << std::endl;
+      ok = false;
+    } catch (const std::runtime_error& e) {
+      if (std::string(e.what()).find(message) == std::string::npos) {
+        std::cerr << "Error: preprocessor case '" << name << "' threw\n"
+                  << e.what() << std::endl;
+        ok = false;
+      }
+    }
+  };
+
+  // Before GLSL 3.30 "#line N" numbers the following line N + 1; b.glsl is
+  // included once even though two files include it
+  PreprocessedShader main = preprocessShader("/v/main.glsl", {{"B", "2"}, {"A", "1"}}, reader);
+  expect("include", main.source,
+         "#version 150\n#define A 1\n#define B 2\n#line 1 0\n"
+         "#line 0 1\n#line 0 2\nfloat b;\n#line 1 1\nfloat a;\n"
+         "#line 2 0\nvoid main() {}\n#line 4 0\n");
+  expect("files", main.files.size() == 3 ? main.files[0] + " " + main.files[1] + " " + main.files[2]
+                                         : std::string("wrong count"),
+         "/v/main.glsl /v/a.glsl /v/sub/b.glsl");
+  expect("core", preprocessShader("/v/core.glsl", {{"X", "1"}}, reader).source,
+         "#version 330 core\n#define X 1\n#line 2 0\n#line 1 1\nfloat b;\n#line 3 0\n");
+  expect("no version", preprocessShader("/v/plain.glsl", {{"X", "1"}}, reader).source,
+         "#define X 1\n#line 0 0\nvoid main() {}\n");
+  expectError("cycle", "/v/cycle.glsl", {},
+              "Include cycle: /v/cycle.glsl -> /v/loop.glsl -> /v/cycle.glsl");
+  expectError("missing", "/v/missing.glsl", {},
+              "nope.glsl\n  included from /v/missing.glsl:3");
+  expectError("malformed", "/v/malformed.glsl", {}, "/v/malformed.glsl:2");
+  expectError("define", "/v/main.glsl", {{"1X", "1"}}, "Invalid shader define name");
+
+  // Every permutation of the real terrain shaders
+  std::vector<ShaderDefines> permutations;
+  for (VertexFormat format :
+       {VertexFormat::Full, VertexFormat::Compact, VertexFormat::Displaced}) {
+    for (bool specular : {false, true}) {
+      for (int lights = 1; lights <= TerrainUniforms::kMaxLights; ++lights) {
+        permutations.push_back(makeTerrainDefines(format, specular, lights));
+      }
+    }
+  }
+  const std::vector<ShaderStage> stages = getTerrainShaderStages();
+  size_t sourceBytes = 0;
+  const double seconds = bestOf(iterations, [&] {
+    sourceBytes = 0;
+    for (const ShaderDefines& defines : permutations) {
+      for (const ShaderStage& stage : stages) {
+        sourceBytes += preprocessShader(stage.filename, defines).source.size();
+      }
+    }
+  });
+  for (const ShaderDefines& defines : permutations) {
+    const std::string lights = "#define NUM_LIGHTS " + defines.at("NUM_LIGHTS") + "\n";
+    for (const ShaderStage& stage : stages) {
+      const std::string source = preprocessShader(stage.filename, defines).source;
+      if (source.find(lights) == std::string::npos ||
+          source.find("#include") != std::string::npos) {
+        std::cerr << "Error: " << stage.filename << " [" << describeDefines(defines)
+                  << "] was not preprocessed" << std::endl;
+        ok = false;
+      }
+    }
+  }
+
+  const double perProgram = seconds / permutations.size() * 1e6;
+  std::cout << "[preprocess] " << permutations.size() << " terrain permutations, "
+            << sourceBytes / permutations.size() << " bytes of GLSL each\n"
+            << "Preprocessing time: " << perProgram << " us/program" << std::endl;
+  report.add("preprocess.program_us", perProgram, "us");
+  return ok;
+}
+
+// Builds 100k entities, 10k roots with nine children each, and times
+// recomputing all world matrices and bounds, and only those under 1% of the
+// roots, in the EntityStore and in a tree of individually allocated nodes.
+// Also checks that both agree, that destroying a root takes its children
+// along and that handles to destroyed entities are rejected.
+bool benchEntities(int iterations, Report& report) {
+  struct Node {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale = glm::vec3(1.0f);
+    std::vector<Node*> children;
+    glm::mat4 world = glm::mat4(1.0f);
+    AABB bounds;
+  };
+  const int roots = 10000;
+  const int childrenPerRoot = 9;
+  const AABB unitBox{glm::vec3(-0.5f), glm::vec3(0.5f)};
+
+  EntityStore store;
+  std::vector<EntityHandle> rootHandles;
+  std::vector<std::unique_ptr<Node>> nodes;
+  std::vector<Node*> rootNodes;
+  for (int r = 0; r < roots; ++r) {
+    const glm::vec3 position(static_cast<float>(r % 100), static_cast<float>(r / 100), 0.0f);
+    const glm::quat rotation = glm::angleAxis(0.001f * r, glm::vec3(0.0f, 0.0f, 1.0f));
+    const EntityHandle root = store.create(0, position);
+    store.setRotation(root, rotation);
+    rootHandles.push_back(root);
+    nodes.push_back(std::make_unique<Node>(Node{position, rotation}));
+    Node* rootNode = nodes.back().get();
+    rootNodes.push_back(rootNode);
+    for (int c = 0; c < childrenPerRoot; ++c) {
+      const glm::vec3 offset(0.0f, 0.0f, 1.0f + c);
+      store.create(1, offset, root);
+      nodes.push_back(std::make_unique<Node>(Node{offset, glm::quat(1.0f, 0.0f, 0.0f, 0.0f)}));
+      rootNode->children.push_back(nodes.back().get());
+    }
+  }
+
+  // Same math as EntityStore::updateTransforms, one node at a time
+  auto updateNode = [&](auto& self, Node& node, const glm::mat4& parent) -> void {
+    const glm::mat3 rotation = glm::mat3_cast(node.rotation);
+    const glm::mat4 local(glm::vec4(rotation[0] * node.scale.x, 0.0f),
+                          glm::vec4(rotation[1] * node.scale.y, 0.0f),
+                          glm::vec4(rotation[2] * node.scale.z, 0.0f),
+                          glm::vec4(node.position, 1.0f));
+    node.world = parent * local;
+    node.bounds.min = node.bounds.max = glm::vec3(node.world * glm::vec4(unitBox.min, 1.0f));
+    for (int corner = 1; corner < 8; ++corner) {
+      const glm::vec3 p((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f,
+                        (corner & 4) ? 0.5f : -0.5f);
+      node.bounds.extend(glm::vec3(node.world * glm::vec4(p, 1.0f)));
+    }
+    for (Node* child : node.children) {
+      self(self, *child, node.world);
+    }
+  };
+
+  ThreadPool& pool = ThreadPool::shared();
+  size_t updated = 0;
+  const double allSeconds = bestOf(iterations, [&] {
+    for (EntityHandle root : rootHandles) {
+      store.setPosition(root, store.getPosition(root));
+    }
+    updated = store.updateTransforms(pool);
+  });
+  size_t partial = 0;
+  const double dirtySeconds = bestOf(iterations, [&] {
+    for (int r = 0; r < roots; r += 100) {
+      store.setPosition(rootHandles[r], store.getPosition(rootHandles[r]));
+    }
+    partial = store.updateTransforms(pool);
+  });
+  const double pointerSeconds = bestOf(iterations, [&] {
+    for (Node* root : rootNodes) {
+      updateNode(updateNode, *root, glm::mat4(1.0f));
+    }
+  });
+
+  // Both must agree on the roots, and with them on everything below
+  bool ok = updated == store.size() && partial == store.size() / 100;
+  float difference = 0.0f;
+  for (int r = 0; r < roots; ++r) {
+    const Node& node = *rootNodes[r];
+    const EntityHandle handle = rootHandles[r];
+    for (int column = 0; column < 4; ++column) {
+      difference = std::max(difference,
+                            maxDifference(store.getWorldMatrix(handle)[column], node.world[column]));
+    }
+    difference = std::max(difference,
+                          maxDifference(store.getWorldBounds(handle).min, node.bounds.min));
+  }
+  ok = ok && difference < 1e-4f;
+
+  // Destroying a root takes its children along and invalidates its handle
+  const size_t before = store.size();
+  store.destroy(rootHandles[0]);
+  const EntityHandle reused = store.create(0, glm::vec3(0.0f));
+  ok = ok && store.size() == before - childrenPerRoot && !store.isAlive(rootHandles[0]) &&
+       store.isAlive(reused);
+
+  const double count = static_cast<double>(before);
+  std::cout << "[entities] " << before << " entities in " << roots << " hierarchies, "
+            << pool.size() << " worker threads\n"
+            << "SoA update, all dirty:  " << allSeconds * 1e3 << " ms ("
+            << allSeconds / count * 1e9 << " ns/entity)\n"
+            << "SoA update, 1% dirty:   " << dirtySeconds * 1e3 << " ms\n"
+            << "Heap node tree update:  " << pointerSeconds * 1e3 << " ms ("
+            << pointerSeconds / allSeconds << "x)" << std::endl;
+  report.add("entities.update_all_ms", allSeconds * 1e3, "ms");
+  report.add("entities.update_dirty_ms", dirtySeconds * 1e3, "ms");
+  report.add("entities.pointer_update_ms", pointerSeconds * 1e3, "ms");
+  if (!ok) {
+    std::cerr << "Error: entity store disagrees with the node tree (max difference "
+              << difference << ")" << std::endl;
+  }
+  return ok;
+}
+
+// Writes a scene with the terrain of `size` quads per side and 100k entities
+// to the temp directory and times saving, opening it (mapping, chunk table,
+// objects) and reading the mesh blobs through the mapping, which stands in
+// for the driver copying them during glBufferData, against regenerating the
+// terrain and its mesh. Checks that terrain, mesh and objects round-trip in
+// every vertex format, that re-saving a loaded scene reproduces the file and
+// that truncated files and other versions are rejected. A grid of 5120
+// writes a scene of about 1.2 GB.
+bool benchScene(int size, int iterations, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+  const int chunkSize = 16;
+  const Terrain terrain(params, chunkSize);
+
+  EntityStore objects;
+  for (int r = 0; r < 10000; ++r) {
+    const EntityHandle root = objects.create(
+        r % 2, glm::vec3(static_cast<float>(r % 100), static_cast<float>(r / 100), 0.0f));
+    objects.setRotation(root, glm::angleAxis(0.001f * r, glm::vec3(0.0f, 0.0f, 1.0f)));
+    objects.setScale(root, glm::vec3(1.0f + 0.0001f * r));
+    for (int c = 0; c < 9; ++c) {
+      objects.create(1, glm::vec3(0.0f, 0.0f, 1.0f + c), root);
+    }
+  }
+  objects.updateTransforms(ThreadPool::shared());
+
+  const std::filesystem::path directory = std::filesystem::temp_directory_path();
+  const std::string path = (directory / "bench-scene.terrain").string();
+  const std::string copyPath = (directory / "bench-scene-copy.terrain").string();
+  const std::string badPath = (directory / "bench-scene-bad.terrain").string();
+  bool ok = true;
+  auto check = [&](bool condition, const char* what) {
+    if (!condition) {
+      std::cerr << "Error: scene " << what << std::endl;
+      ok = false;
+    }
+  };
+  auto sameBytes = [](const void* a, size_t aBytes, const void* b, size_t bBytes) {
+    return aBytes == bBytes && std::memcmp(a, b, aBytes) == 0;
+  };
+  auto sameArray = [&](const auto& a, const auto& b) {
+    return sameBytes(a.data(), a.size() * sizeof(a[0]), b.data(), b.size() * sizeof(b[0]));
+  };
+
+  double saveSeconds = 0.0, openSeconds = 0.0, readSeconds = 0.0, generateSeconds = 0.0;
+  uint64_t fileBytes = 0;
+  try {
+    // Compact vertices and the height grid first, then the full layout that
+    // is timed
+    saveScene(path, terrain, VertexFormat::Compact, objects);
+    {
+      const SceneFile scene(path);
+      const TerrainMesh expected = buildTerrainMesh(terrain, VertexFormat::Compact);
+      const TerrainMeshView mesh = scene.getMesh();
+      check(mesh.vertexFormat == VertexFormat::Compact &&
+                sameBytes(mesh.vertices, mesh.vertexBytes, expected.vertices.data(),
+                          expected.vertices.size()),
+            "compact vertices do not round-trip");
+    }
+    saveScene(path, terrain, VertexFormat::Displaced, objects);
+    {
+      const SceneFile scene(path);
+      const TerrainMesh expected = buildTerrainMesh(terrain, VertexFormat::Displaced);
+      const TerrainMeshView mesh = scene.getMesh();
+      check(mesh.vertexFormat == VertexFormat::Displaced && mesh.gridSize == size &&
+                scene.makeTerrain().getChunks().size() == terrain.getChunks().size() &&
+                sameBytes(mesh.vertices, mesh.vertexBytes, expected.vertices.data(),
+                          expected.vertices.size()),
+            "height grid does not round-trip");
+    }
+
+    saveSeconds = bestOf(iterations, [&] {
+      saveScene(path, terrain, VertexFormat::Full, objects);
+    });
+    const TerrainMesh expected = buildTerrainMesh(terrain, VertexFormat::Full);
+    openSeconds = bestOf(iterations, [&] {
+      const SceneFile scene(path);
+      const Terrain loaded = scene.makeTerrain();
+      EntityStore loadedObjects;
+      scene.readObjects(loadedObjects);
+    });
+
+    const SceneFile scene(path);
+    fileBytes = scene.getFile().size();
+    const Terrain loaded = scene.makeTerrain();
+    EntityStore loadedObjects;
+    scene.readObjects(loadedObjects);
+    const TerrainMeshView mesh = scene.getMesh();
+    uint64_t checksum = 0;
+    readSeconds = bestOf(iterations, [&] {
+      for (const auto& [data, bytes] : {std::pair(mesh.vertices, mesh.vertexBytes),
+                                        std::pair(mesh.indices, mesh.indexBytes)}) {
+        const auto* first = static_cast<const uint8_t*>(data);
+        for (size_t offset = 0; offset < bytes; offset += 4096) {
+          checksum += first[offset];
+        }
+      }
+    });
+    generateSeconds = bestOf(iterations, [&] {
+      const Terrain generated(params, chunkSize);
+      const TerrainMesh generatedMesh = buildTerrainMesh(generated, VertexFormat::Full);
+    });
+
+    // Round trip of the terrain, its mesh and the objects
+    check(loaded.getParams().size == params.size && loaded.getChunkSize() == chunkSize &&
+              loaded.getLod().getOptions() == terrain.getLod().getOptions() &&
+              sameArray(loaded.getChunks(), terrain.getChunks()) &&
+              loaded.getVertices().empty(),
+          "terrain does not round-trip");
+    check(mesh.vertexFormat == VertexFormat::Full && mesh.indexType == expected.indexType &&
+              mesh.strips == expected.strips &&
+              sameBytes(mesh.vertices, mesh.vertexBytes, expected.vertices.data(),
+                        expected.vertices.size()) &&
+              sameBytes(mesh.indices, mesh.indexBytes, expected.indices.data(),
+                        expected.indices.size()),
+          "mesh does not round-trip");
+    loadedObjects.updateTransforms(ThreadPool::shared());
+    check(loadedObjects.size() == objects.size() &&
+              sameArray(loadedObjects.getTypes(), objects.getTypes()) &&
+              sameArray(loadedObjects.getPositions(), objects.getPositions()) &&
+              sameArray(loadedObjects.getRotations(), objects.getRotations()) &&
+              sameArray(loadedObjects.getScales(), objects.getScales()) &&
+              sameArray(loadedObjects.getParents(), objects.getParents()) &&
+              sameArray(loadedObjects.getWorldMatrices(), objects.getWorldMatrices()),
+          "objects do not round-trip");
+
+    // A loaded terrain has no vertices, so saving copies the mapped blob
+    saveScene(copyPath, loaded, VertexFormat::Compact, loadedObjects, &scene);
+    {
+      const MappedFile copy(copyPath);
+      check(sameBytes(copy.data(), copy.size(), scene.getFile().data(), scene.getFile().size()),
+            "re-saved from its mapping differs from the original");
+    }
+
+    // Truncated files, other versions and inconsistent terrain are refused
+    auto rejects = [&](const std::string& bytes) {
+      std::ofstream(badPath, std::ios::binary | std::ios::trunc) << bytes;
+      try {
+        const SceneFile bad(badPath);
+        bad.makeTerrain();
+        return false;
+      } catch (const std::runtime_error&) {
+        return true;
+      }
+    };
+    const std::string head(reinterpret_cast<const char*>(scene.getFile().data()),
+                           SceneFormat::kAlignment);
+    std::string otherVersion = head;
+    SceneFormat::Header header;
+    std::memcpy(&header, otherVersion.data(), sizeof(header));
+    header.version = SceneFormat::kVersion + 1;
+    header.fileSize = otherVersion.size();
+    std::memcpy(otherVersion.data(), &header, sizeof(header));
+    check(rejects(head) && rejects(otherVersion) && rejects("not a scene"),
+          "accepted a truncated or foreign file");
+    const std::string whole(reinterpret_cast<const char*>(scene.getFile().data()),
+                            scene.getFile().size());
+    std::string badChunk = whole;
+    const size_t chunkOffset =
+        scene.findSection(SceneFormat::SectionType::TerrainChunks)->offset +
+        sizeof(TerrainChunk) + offsetof(TerrainChunk, baseVertex);
+    int baseVertex = 0;
+    std::memcpy(&baseVertex, badChunk.data() + chunkOffset, sizeof(baseVertex));
+    baseVertex += 1;
+    std::memcpy(badChunk.data() + chunkOffset, &baseVertex, sizeof(baseVertex));
+    std::string badIndices = whole;
+    badIndices[scene.findSection(SceneFormat::SectionType::TerrainIndices)->offset] ^= 1;
+    check(rejects(badChunk) && rejects(badIndices),
+          "accepted a corrupted chunk table or index list");
+    std::cout << "[scene] Mesh checksum " << checksum << "\n";
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    ok = false;
+  }
+  std::error_code error;
+  for (const std::string& file : {path, copyPath, badPath}) {
+    std::filesystem::remove(file, error);
+  }
+
+  std::cout << "[scene] Grid: " << size << "x" << size << ", " << objects.size()
+            << " objects, " << fileBytes / 1048576.0 << " MiB file\n"
+            << "Save:  " << saveSeconds * 1e3 << " ms ("
+            << fileBytes / 1048576.0 / saveSeconds << " MiB/s)\n"
+            << "Open:  " << openSeconds * 1e3 << " ms (map, chunk table, objects)\n"
+            << "Read mesh through the mapping: " << readSeconds * 1e3 << " ms\n"
+            << "Regenerate terrain and mesh:   " << generateSeconds * 1e3 << " ms"
+            << std::endl;
+  report.add("scene.save_ms", saveSeconds * 1e3, "ms");
+  report.add("scene.open_ms", openSeconds * 1e3, "ms");
+  report.add("scene.read_mesh_ms", readSeconds * 1e3, "ms");
+  report.add("scene.generate_ms", generateSeconds * 1e3, "ms");
+  report.add("scene.file_mib", fileBytes / 1048576.0, "MiB");
+  return ok;
+}
+
+// Writes the analytic surface of `size` quads per side as a DEM tile set in
+// the temp directory and reads it back through a TiledHeightSource whose
+// cache holds a quarter of the decoded tiles. Checks that a Terrain built
+// from the tiles matches the analytic one within the 16-bit quantization and
+// that its finite-difference normals stay close to the analytic ones,
+// then walks a camera across the grid, prefetching the chunks around it and
+// generating the nearest ones, and checks that the cache stays within its
+// budget. Reports the tile hit rate of the walk and the decode throughput.
+bool benchTiles(int size, int iterations, Report& report) {
+  HeightMapParams params;
+  params.size = size;
+  const int tileSize = std::min(size, 128);
+  const int chunkSize = 32;
+  const AnalyticHeightSource analytic(params);
+
+  const std::filesystem::path directory = std::filesystem::temp_directory_path();
+  const std::string path = (directory / "bench-tiles.dem").string();
+  bool ok = true;
+  auto check = [&](bool condition, const char* what) {
+    if (!condition) {
+      std::cerr << "Error: tiles " << what << std::endl;
+      ok = false;
+    }
+  };
+
+  double writeSeconds = 0.0, decodeSeconds = 0.0, walkSeconds = 0.0;
+  double hitRate = 0.0, residentMiB = 0.0;
+  size_t budget = 0, tileCount = 0;
+  try {
+    writeSeconds = bestOf(1, [&] { writeDemTiles(path, analytic, tileSize); });
+    const DemInfo info = readDemManifest(path);
+    tileCount = static_cast<size_t>(info.tilesX) * info.tilesY;
+    const size_t tileBytes =
+        static_cast<size_t>(info.samplesPerSide()) * info.samplesPerSide() * sizeof(float);
+    budget = std::max<size_t>(tileCount * tileBytes / 4, 9 * tileBytes);
+
+    // Every tile decoded once on the calling thread
+    decodeSeconds = bestOf(iterations, [&] {
+      TileCacheOptions options;
+      options.cacheBudget = tileCount * tileBytes;
+      TiledHeightSource source(path, options);
+      const Terrain tiled(source, chunkSize);
+    });
+
+    // Quantized heights; normals from differences of quantized heights
+    TileCacheOptions options;
+    options.cacheBudget = budget;
+    TiledHeightSource source(path, options);
+    {
+      const Terrain expected(params, chunkSize);
+      const Terrain tiled(source, chunkSize);
+      const std::vector<VertexType>& a = expected.getVertices();
+      const std::vector<VertexType>& b = tiled.getVertices();
+      float heightError = 0.0f, normalError = 0.0f, planarError = 0.0f;
+      double normalErrorSum = 0.0;
+      for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) {
+        heightError = std::max(heightError, std::abs(a[i].position.z - b[i].position.z));
+        const glm::vec3 offset = a[i].position - b[i].position;
+        planarError = std::max(planarError, std::abs(offset.x) + std::abs(offset.y));
+        normalError = std::max(normalError, glm::length(a[i].normal - b[i].normal));
+        normalErrorSum += glm::length(a[i].normal - b[i].normal);
+      }
+      const double meanNormalError = normalErrorSum / std::max<size_t>(b.size(), 1);
+      std::cout << "[tiles] Max height error " << heightError << ", normal error "
+                << normalError << " (mean " << meanNormalError << ")\n";
+      check(a.size() == b.size() && planarError < 1e-4f &&
+                heightError <= info.heightScale && meanNormalError < 1e-2,
+            "terrain differs from the analytic surface");
+      check(tiled.getChunks().size() == expected.getChunks().size() &&
+                source.getStats().residentBytes <= budget,
+            "source exceeded its cache budget while building the terrain");
+    }
+
+    // Straight walk along the diagonal, three chunks of view radius
+    const TiledHeightSource::Stats before = source.getStats();
+    const int chunks = size / chunkSize;
+    const int radius = 3;
+    const int steps = 4 * chunks;
+    std::vector<HeightRequest> requests;
+    std::vector<VertexType> block(static_cast<size_t>(chunkSize + 1) * (chunkSize + 1));
+    size_t maxResident = 0;
+    walkSeconds = bestOf(1, [&] {
+      for (int step = 0; step < steps; ++step) {
+        const float t = (step + 0.5f) / steps * chunks;
+        const int eyeX = std::min(static_cast<int>(t), chunks - 1);
+        const int eyeY = std::min(static_cast<int>(t * 0.5f + chunks / 4), chunks - 1);
+        requests.clear();
+        for (int y = std::max(eyeY - radius, 0); y <= std::min(eyeY + radius, chunks - 1); ++y) {
+          for (int x = std::max(eyeX - radius, 0); x <= std::min(eyeX + radius, chunks - 1); ++x) {
+            requests.push_back({{x * chunkSize, y * chunkSize, chunkSize + 1, chunkSize + 1},
+                                glm::length(glm::vec2(x - t, y - t * 0.5f - chunks / 4))});
+          }
+        }
+        source.prefetch(requests);
+        // The chunk under the eye is needed now, whether loaded or not
+        source.generateRegion({eyeX * chunkSize, eyeY * chunkSize, chunkSize + 1, chunkSize + 1},
+                              block.data());
+        maxResident = std::max(maxResident, source.getStats().residentBytes);
+      }
+    });
+    const TiledHeightSource::Stats after = source.getStats();
+    const uint64_t hits = after.hits - before.hits;
+    const uint64_t misses = after.misses - before.misses;
+    hitRate = hits + misses > 0 ? 100.0 * hits / (hits + misses) : 100.0;
+    residentMiB = maxResident / 1048576.0;
+    check(maxResident <= budget, "cache exceeded its budget during the walk");
+    check(after.failures == 0, "could not read some tiles");
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    ok = false;
+  }
+  std::error_code error;
+  const std::filesystem::path manifest(path);
+  for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+    const std::string name = entry.path().filename().string();
+    if (name == manifest.filename().string() ||
+        (name.rfind(manifest.stem().string() + "_", 0) == 0 &&
+         entry.path().extension() == ".r16")) {
+      std::filesystem::remove(entry.path(), error);
+    }
+  }
+
+  const double decodedMiB = static_cast<double>(tileCount) * (tileSize + 1) * (tileSize + 1) *
+                            sizeof(float) / 1048576.0;
+  std::cout << "[tiles] Grid: " << size << "x" << size << ", " << tileCount << " tiles of "
+            << tileSize << " quads, budget " << budget / 1048576.0 << " MiB\n"
+            << "Write tiles:      " << writeSeconds * 1e3 << " ms\n"
+            << "Decode and build: " << decodeSeconds * 1e3 << " ms ("
+            << decodedMiB / decodeSeconds << " MiB/s)\n"
+            << "Walk:             " << walkSeconds * 1e3 << " ms, " << hitRate
+            << "% tile hits, " << residentMiB << " MiB resident at most" << std::endl;
+  report.add("tiles.write_ms", writeSeconds * 1e3, "ms");
+  report.add("tiles.decode_mib_per_s", decodedMiB / decodeSeconds, "MiB/s", false);
+  report.add("tiles.walk_ms", walkSeconds * 1e3, "ms");
+  report.add("tiles.hit_rate_pct", hitRate, "%", false);
+  report.add("tiles.resident_mib", residentMiB, "MiB");
+  return ok;
+}
+
+// Hammers a TripleBuffer from a writer and a reader thread and checks that
+// every value read is whole and newer than the one before; build with
+// ENABLE_THREAD_SANITIZER to have races reported as well. Then checks that
+// a threaded Simulation only moves forward and that unthreaded runs repeat.
+bool benchSimulation(int iterations, Report& report) {
+  // Every word carries the sequence number, so a torn read shows up as a mix
+  struct Payload {
+    std::array<uint64_t, 16> words{};
+  };
+  const uint64_t publishes = 1000000;
+  uint64_t torn = 0;
+  uint64_t reordered = 0;
+  uint64_t pickedUp = 0;
+  const double seconds = bestOf(iterations, [&] {
+    TripleBuffer<Payload> buffer;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+      for (uint64_t sequence = 1; sequence <= publishes; ++sequence) {
+        buffer.write().words.fill(sequence);
+        buffer.publish();
+      }
+      done = true;
+    });
+    uint64_t last = 0;
+    pickedUp = 0;
+    for (;;) {
+      const bool finished = done.load();
+      if (buffer.update()) {
+        const Payload& payload = buffer.read();
+        const uint64_t sequence = payload.words[0];
+        torn += std::any_of(payload.words.begin(), payload.words.end(),
+                            [&](uint64_t word) { return word != sequence; });
+        reordered += sequence <= last;
+        last = sequence;
+        ++pickedUp;
+      } else if (finished) {
+        break;
+      }
+    }
+    writer.join();
+    reordered += last != publishes;  // The final value must arrive
+  });
+
+  // Ticks at 1 kHz while this thread samples as fast as it can
+  Simulation threaded(1000.0, true);
+  threaded.setInput(SimulationInput());
+  uint64_t lastTick = 0;
+  double lastTime = -1.0;
+  const auto until = Clock::now() + std::chrono::milliseconds(200);
+  while (Clock::now() < until) {
+    const SimulationState state = threaded.sample(threaded.now());
+    reordered += state.tick < lastTick || state.time < lastTime;
+    lastTick = state.tick;
+    lastTime = state.time;
+  }
+  const Simulation::Stats stats = threaded.getStats();
+
+  // Unthreaded simulations tick on the caller's clock and must agree exactly
+  Simulation first(60.0, false);
+  Simulation second(60.0, false);
+  bool deterministic = true;
+  for (int frame = 0; frame < 600; ++frame) {
+    const double time = frame / 144.0;
+    const SimulationState a = first.sample(time);
+    const SimulationState b = second.sample(time);
+    deterministic = deterministic && a.tick == b.tick && a.eye == b.eye &&
+                    a.cameraAngle == b.cameraAngle;
+  }
+
+  std::cout << "[simulation] " << publishes << " publishes of " << sizeof(Payload)
+            << " bytes, " << pickedUp << " picked up\n"
+            << "Publish time: " << seconds / publishes * 1e9 << " ns\n"
+            << "Torn reads: " << torn << ", out of order: " << reordered << "\n"
+            << "Threaded simulation: " << stats.ticks << " ticks in 200 ms, "
+            << stats.dropped << " dropped, " << stats.maxTickMs << " ms max tick"
+            << std::endl;
+  report.add("simulation.publish_ns", seconds / publishes * 1e9, "ns");
+  report.add("simulation.pickup_ratio", static_cast<double>(pickedUp) / publishes, "ratio",
+             false);
+  const bool ok = torn == 0 && reordered == 0 && deterministic && lastTick > 0;
+  if (!ok) {
+    std::cerr << "Error: triple buffer or simulation handed out inconsistent state"
+              << std::endl;
+  }
+  return ok;
+}
+
+// Renders the terrain for `options.frameCount` frames through RenderBench
+// and reports per-frame CPU, GPU and frame time percentiles
+bool benchRender(int size, const ApplicationOptions& options, bool lod, int objects,
+                 Report& report) {
+  RenderBenchResult result;
+  ProgramCache::Stats programs;
+  try {
+    RenderBench bench(options, size, lod, objects);
+    programs = ProgramCache::getStats();
+    bench.run();
+    result = bench.getResult();
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return false;
+  }
+
+  // Median of a copy of the samples, for the console summary
+  auto median = [](std::vector<double> samples) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    return samples[samples.size() / 2];
+  };
+  std::cout << "[render] Grid: " << size << "x" << size << ", "
+            << result.cpuTimes.size() << " frames, "
+            << (options.headless ? "headless" : "window")
+            << (options.headless ? "" : std::string(", ") +
+                                            getPacingModeName(options.pacing.mode))
+            << ", LOD " << (lod ? "on" : "off") << ", " << objects << " objects\n"
+            << "Median CPU " << median(result.cpuTimes) << " ms, GPU "
+            << (result.gpuTimes.empty() ? std::string("n/a")
+                                        : std::to_string(median(result.gpuTimes)) + " ms")
+            << ", frame " << median(result.frameTimes) << " ms, "
+            << result.trianglesPerFrame << " triangles/frame, GL state calls "
+            << result.stateCallsIssued << " issued, " << result.stateCallsSkipped
+            << " skipped\n"
+            << "Objects: " << result.instancesPerFrame << " instances in "
+            << result.drawCallsPerFrame << " draw calls/frame\n"
+            << "Shader programs: " << programs.milliseconds << " ms, "
+            << (programs.loaded > 0 ? "warm (from cache)" : "cold (compiled)")
+            << std::endl;
+
+  report.addPercentiles("render.cpu", result.cpuTimes, "ms");
+  report.addPercentiles("render.gpu", result.gpuTimes, "ms");
+  report.addPercentiles("render.frame", result.frameTimes, "ms");
+  report.addPercentiles("render.latency", result.latencies, "ms");
+  report.add("render.triangles", result.trianglesPerFrame, "triangles");
+  if (objects > 0) {
+    report.add("render.instances", result.instancesPerFrame, "instances", false);
+    report.add("render.draw_calls", result.drawCallsPerFrame, "calls");
+  }
+  report.add("render.programs", programs.milliseconds, "ms");
+  report.add("render.state_calls", static_cast<double>(result.stateCallsIssued), "calls");
+  report.add("render.state_skipped", static_cast<double>(result.stateCallsSkipped),
+             "calls", false);
+  return true;
+}
+
+const char* const usage =
+    "Usage: opengl-cmake-starter-project-bench [scenario] [grid size] [iterations] [options]\n"
+    "  scenario          all|meshgen|cull|lod|indices|vertex|uniforms|preprocess|\n"
+    "                    entities|simulation|scene|tiles|render\n"
+    "                    (default: all); 'all' runs the CPU-only scenarios\n"
+    "                    except 'scene' and 'tiles', which write to the temp\n"
+    "                    directory,\n"
+    "                    'render' needs OpenGL\n"
+    "  --size N          Grid size, a multiple of 16 (default: 2048)\n"
+    "  --iterations N    Runs per CPU measurement, the best is kept (default: 5)\n"
+    "  --frames N        Frames rendered by 'render' (default: 300)\n"
+    "  --pacing MODE     Frame pacing of 'render' with --window: vsync, adaptive,\n"
+    "                    uncapped or a frame rate (default: uncapped)\n"
+    "  --vsync on|off    Same as --pacing vsync or --pacing uncapped\n"
+    "  --frames-in-flight N\n"
+    "                    Frames 'render' queues ahead of the GPU (default: 2)\n"
+    "  --lod on|off      Level of detail in 'render' (default: on)\n"
+    "  --objects N       Instanced cubes and spheres drawn by 'render' (default: 0)\n"
+    "  --window          Render into a visible window instead of headless\n"
+    "  --shader-cache DIR|off\n"
+    "                    Program binary cache of 'render' (default: the app's)\n"
+    "  --json FILE       Write the configuration and metrics as JSON\n"
+    "  --baseline FILE   Compare the metrics with an earlier --json file\n"
+    "  --tolerance PCT   Allowed change before a metric regresses (default: 10)\n";
+
+// Benchmark configuration parsed from the command line
+struct BenchOptions {
+  std::string scenario = "all";
+  int size = 2048;
+  int iterations = 5;
+  int frames = 300;
+  FramePacingOptions pacing{PacingMode::Uncapped};
+  bool lod = true;
+  int objects = 0;
+  bool window = false;
+  std::string shaderCache;  // Directory, "off", or empty for the default
+  std::string jsonPath;
+  std::string baselinePath;
+  double tolerance = 10.0;
+};
+
+// Parses "on" or "off"
+bool parseSwitch(const std::string& option, const std::string& value) {
+  if (value != "on" && value != "off") {
+    throw std::runtime_error(option + " expects on or off, got " + value);
+  }
+  return value == "on";
+}
+
+// Parses the positional arguments and the options; throws on bad input
+BenchOptions parseOptions(int argc, const char* argv[]) {
+  BenchOptions options;
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--size") {
+      options.size = std::stoi(value());
+    } else if (arg == "--iterations") {
+      options.iterations = std::stoi(value());
+    } else if (arg == "--frames") {
+      options.frames = std::stoi(value());
+    } else if (arg == "--pacing") {
+      parsePacingMode(value(), options.pacing);
+    } else if (arg == "--vsync") {
+      options.pacing.mode = parseSwitch(arg, value()) ? PacingMode::Vsync : PacingMode::Uncapped;
+    } else if (arg == "--frames-in-flight") {
+      options.pacing.maxFramesInFlight = std::stoi(value());
+    } else if (arg == "--lod") {
+      options.lod = parseSwitch(arg, value());
+    } else if (arg == "--objects") {
+      options.objects = std::stoi(value());
+    } else if (arg == "--window") {
+      options.window = true;
+    } else if (arg == "--shader-cache") {
+      options.shaderCache = value();
+    } else if (arg == "--json") {
+      options.jsonPath = value();
+    } else if (arg == "--baseline") {
+      options.baselinePath = value();
+    } else if (arg == "--tolerance") {
+      options.tolerance = std::stod(value());
+    } else if (arg.rfind("--", 0) == 0) {
+      throw std::runtime_error("Unknown option " + arg);
+    } else if (positional == 0) {
+      options.scenario = arg;
+      ++positional;
+    } else if (positional == 1) {
+      options.size = std::stoi(arg);
+      ++positional;
+    } else if (positional == 2) {
+      options.iterations = std::stoi(arg);
+      ++positional;
+    } else {
+      throw std::runtime_error("Unexpected argument " + arg);
+    }
+  }
+
+  const std::string& scenario = options.scenario;
+  if (options.size <= 0 || options.size % 16 != 0) {
+    throw std::runtime_error("Grid size must be a positive multiple of 16");
+  }
+  if (options.iterations <= 0 || options.frames <= 1 || options.tolerance < 0.0 ||
+      options.pacing.maxFramesInFlight <= 0) {
+    throw std::runtime_error("Iterations, frames, frames in flight and tolerance must be positive");
+  }
+  if (options.pacing.maxFramesInFlight > FramePacingOptions::kMaxFramesInFlight) {
+    throw std::runtime_error("Frames in flight must be at most " +
+                             std::to_string(FramePacingOptions::kMaxFramesInFlight));
+  }
+  if (scenario != "all" && scenario != "meshgen" && scenario != "cull" &&
+      scenario != "uniforms" && scenario != "preprocess" &&
+      scenario != "entities" && scenario != "simulation" &&
+      scenario != "lod" && scenario != "indices" && scenario != "vertex" &&
+      scenario != "scene" && scenario != "tiles" && scenario != "render") {
+    throw std::runtime_error("Unknown scenario " + scenario);
+  }
+  return options;
+}
+}  // namespace
+
+/**
+ * Benchmark entry point.
+ * Runs the selected scenarios; only 'render' needs an OpenGL context.
+ * @param argc Number of command-line arguments
+ * @param argv Scenario, grid size, iterations and options, see `usage`
+ * @return Exit status: 0 on success, 1 if a scenario failed its check or the
+ *         arguments are invalid, 2 if a metric regressed against the baseline
+ */
+int main(int argc, const char* argv[]) {
+  BenchOptions options;
+  try {
+    options = parseOptions(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n" << usage;
+    return 1;
+  }
+  const std::string& scenario = options.scenario;
+  const int size = options.size;
+  const int iterations = options.iterations;
+
+  std::cout << "Build: " << BENCH_BUILD << std::endl;
+  Report report;
+  bool ok = true;
+  if (scenario == "all" || scenario == "meshgen") {
+    ok = benchMeshGeneration(size, iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "cull") {
+    ok = benchCulling(size, iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "lod") {
+    ok = benchLod(size, iterations, 2.0f, report) && ok;
+  }
+  if (scenario == "all" || scenario == "indices") {
+    ok = benchIndices(iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "vertex") {
+    ok = benchVertexFormat(size, iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "uniforms") {
+    ok = benchUniformLookup(iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "preprocess") {
+    ok = benchShaderPreprocessor(iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "entities") {
+    ok = benchEntities(iterations, report) && ok;
+  }
+  if (scenario == "all" || scenario == "simulation") {
+    ok = benchSimulation(iterations, report) && ok;
+  }
+  if (scenario == "scene") {
+    ok = benchScene(size, iterations, report) && ok;
+  }
+  if (scenario == "tiles") {
+    ok = benchTiles(size, iterations, report) && ok;
+  }
+  if (scenario == "render") {
+    ApplicationOptions renderOptions;
+    renderOptions.headless = !options.window;
+    renderOptions.frameCount = options.frames;
+    renderOptions.fixedTimestep = 1.0 / 60.0;
+    renderOptions.pacing = options.pacing;
+    renderOptions.shaderCache = options.shaderCache != "off";
+    if (renderOptions.shaderCache) {
+      renderOptions.shaderCacheDirectory = options.shaderCache;
+    }
+    ok = benchRender(size, renderOptions, options.lod, options.objects, report) && ok;
+  }
+  report.add("process.peak_rss_mib", peakMemoryMiB(), "MiB");
+  std::cout << "Peak memory: " << peakMemoryMiB() << " MiB" << std::endl;
+
+  if (!options.jsonPath.empty()) {
+    std::ofstream out(options.jsonPath);
+    report.writeJson(out, {{"scenario", scenario},
+                           {"size", std::to_string(size)},
+                           {"iterations", std::to_string(iterations)},
+                           {"frames", std::to_string(options.frames)},
+                           {"pacing", options.pacing.mode == PacingMode::Fixed
+                                          ? std::to_string(options.pacing.targetFps)
+                                          : getPacingModeName(options.pacing.mode)},
+                           {"frames_in_flight", std::to_string(options.pacing.maxFramesInFlight)},
+                           {"lod", options.lod ? "on" : "off"},
+                           {"objects", std::to_string(options.objects)},
+                           {"window", options.window ? "on" : "off"},
+                           {"shader_cache", options.shaderCache.empty() ? "default"
+                                                                        : options.shaderCache},
+                           {"build", BENCH_BUILD}});
+    if (!out) {
+      std::cerr << "Error: could not write " << options.jsonPath << std::endl;
+      return 1;
+    }
+  }
+
+  int regressions = 0;
+  if (!options.baselinePath.empty()) {
+    try {
+      regressions = compareWithBaseline(report, readBaseline(options.baselinePath),
+                                        options.tolerance / 100.0);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+    if (regressions > 0) {
+      std::cerr << "Error: " << regressions << " metrics regressed by more than "
+                << options.tolerance << "%" << std::endl;
+    }
+  }
+  if (!ok) {
+    return 1;
+  }
+  return regressions > 0 ? 2 : 0;
+}
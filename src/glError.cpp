@@ -2,13 +2,19 @@
 #include <iostream>
 #include <string>
 
+#include "GLDebug.hpp"
+
 /**
- * Retrieves and reports OpenGL errors until none remain.
+ * Retrieves and reports OpenGL errors until none remain, unless the debug
+ * output callback already reports them.
  * Prints error details including file and line number to stderr.
  * @param file Source file name
  * @param line Line number in the source file
  */
 void glCheckError(const char* file, unsigned int line) {
+  if (GLDebug::isEnabled()) {
+    return;
+  }
   GLenum errorCode;
   while ((errorCode = glGetError()) != GL_NO_ERROR) {
     std::string error = "Unknown error";
@@ -2,10 +2,27 @@
 
 #include <GL/glew.h>
 
+// glGetError polling is only compiled into builds without NDEBUG
+#ifndef GL_ERROR_CHECKS
+#ifdef NDEBUG
+#define GL_ERROR_CHECKS 0
+#else
+#define GL_ERROR_CHECKS 1
+#endif
+#endif
+
 /**
- * Checks for OpenGL errors and prints details to stderr.
- * Usage: glCheckError(__FILE__, __LINE__);
+ * Checks for OpenGL errors and prints details to stderr. Does nothing while
+ * GLDebug reports errors, since polling would make the driver catch up with
+ * every command queued so far.
+ * Usage: GL_CHECK_ERROR(), or glCheckError(__FILE__, __LINE__);
  * @param file Source file name (typically __FILE__)
  * @param line Line number in the source file (typically __LINE__)
  */
-void glCheckError(const char* file, unsigned int line);
\ No newline at end of file
+void glCheckError(const char* file, unsigned int line);
+
+#if GL_ERROR_CHECKS
+#define GL_CHECK_ERROR() glCheckError(__FILE__, __LINE__)
+#else
+#define GL_CHECK_ERROR() ((void)0)
+#endif
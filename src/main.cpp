@@ -1,6 +1,97 @@
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include "MyApplication.hpp"
 
+namespace {
+const char* const usage =
+    "Usage: opengl-cmake-starter-project [options]\n"
+    "  --headless        Render offscreen without a visible window\n"
+    "  --frames N        Exit after N frames (headless default: 60)\n"
+    "  --size WxH        Window or framebuffer size (default: 640x480)\n"
+    "  --timestep S      Advance time by S seconds per frame (headless default: 1/60)\n"
+    "  --capture DIR     Write every frame to DIR as frame_NNNNN.ppm\n"
+    "  --shader-cache DIR\n"
+    "                    Keep linked shader programs in DIR\n"
+    "                    (default: ~/.cache/opengl-cmake-starter-project/shaders)\n"
+    "  --no-shader-cache Compile every shader program from source\n"
+    "  --pacing MODE     vsync, adaptive, uncapped, or a frame rate limit\n"
+    "                    (default: vsync)\n"
+    "  --frames-in-flight N\n"
+    "                    Frames queued ahead of the GPU, 1-4 (default: 2)\n"
+    "  --on-demand       Draw only on input, animation or finished background work\n"
+    "  --gl-debug on|off|sync\n"
+    "                    OpenGL debug output; 'sync' reports errors inside the\n"
+    "                    offending call (default: on in debug builds)\n"
+    "  --help            Show this message\n";
+
+/**
+ * Parses the command line into application options.
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line argument strings
+ * @param options Receives the parsed options
+ * @return False if the usage was printed and the program should exit
+ * @throws std::runtime_error on unknown options or malformed values
+ */
+bool parseOptions(int argc, const char* argv[], ApplicationOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    // Returns the value following the current option
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames") {
+      options.frameCount = std::stoi(value());
+    } else if (arg == "--size") {
+      const std::string size = value();
+      if (std::sscanf(size.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+          options.width <= 0 || options.height <= 0) {
+        throw std::runtime_error("Invalid size " + size + ", expected WxH");
+      }
+    } else if (arg == "--timestep") {
+      options.fixedTimestep = std::stod(value());
+    } else if (arg == "--capture") {
+      options.captureDirectory = value();
+    } else if (arg == "--shader-cache") {
+      options.shaderCacheDirectory = value();
+    } else if (arg == "--no-shader-cache") {
+      options.shaderCache = false;
+    } else if (arg == "--pacing") {
+      parsePacingMode(value(), options.pacing);
+    } else if (arg == "--frames-in-flight") {
+      options.pacing.maxFramesInFlight = std::stoi(value());
+      if (options.pacing.maxFramesInFlight < 1 ||
+          options.pacing.maxFramesInFlight > FramePacingOptions::kMaxFramesInFlight) {
+        throw std::runtime_error("--frames-in-flight expects 1 to " +
+                                 std::to_string(FramePacingOptions::kMaxFramesInFlight));
+      }
+    } else if (arg == "--on-demand") {
+      options.onDemand = true;
+    } else if (arg == "--gl-debug") {
+      const std::string mode = value();
+      if (mode != "on" && mode != "off" && mode != "sync") {
+        throw std::runtime_error("Invalid --gl-debug mode " + mode + ", expected on|off|sync");
+      }
+      options.glDebug = mode != "off";
+      options.glDebugSynchronous = mode == "sync";
+    } else if (arg == "--help") {
+      std::cout << usage;
+      return false;
+    } else {
+      throw std::runtime_error("Unknown option " + arg + "\n" + usage);
+    }
+  }
+  return true;
+}
+}  // namespace
+
 /**
  * Program entry point.
  * Initializes and runs the MyApplication instance.
@@ -10,7 +101,11 @@
  */
 int main(int argc, const char* argv[]) {
   try {
-    MyApplication app;
+    ApplicationOptions options;
+    if (!parseOptions(argc, argv, options)) {
+      return 0;
+    }
+    MyApplication app(options);
     std::cout << "Starting MyApplication..." << std::endl;
     app.run();
     std::cout << "MyApplication terminated successfully." << std::endl;
@@ -19,4 +114,4 @@ int main(int argc, const char* argv[]) {
     std::cerr << "Error: " << e.what() << std::endl;
     return 1;
   }
-}
\ No newline at end of file
+}